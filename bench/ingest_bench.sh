@@ -0,0 +1,240 @@
+#!/bin/sh
+#
+# ingest_bench.sh
+#	End-to-end ingest benchmark against a local mock embedding server
+#
+# Starts bench/mock_embedding_server.py, points the vectorizer at it and
+# loads a synthetic corpus through enable_vectorization() and the
+# vectorization trigger, once for every combination of BENCH_WORKERS,
+# BENCH_BATCH_SIZES and BENCH_HYBRID.  For each run it reports end-to-end
+# chunks/s, the time spent in the trigger (chunking and enqueueing), the
+# time to drain the queue, the maximum queue lag and the average per-item
+# wait and embedding time recorded in the queue.
+#
+# The script changes pgedge_vectorizer settings with ALTER SYSTEM and
+# resets them afterwards, so run it against a scratch cluster that has
+# pgedge_vectorizer in shared_preload_libraries.  Changing num_workers
+# needs a restart, which is only done when BENCH_PGDATA is set.
+#
+# Copyright (c) 2025 - 2026, pgEdge, Inc.
+#
+
+set -e
+
+PSQL=${PSQL:-psql}
+PG_CTL=${PG_CTL:-pg_ctl}
+PYTHON=${PYTHON:-python3}
+BENCH_DB=${BENCH_DB:-postgres}
+BENCH_PGDATA=${BENCH_PGDATA:-}
+BENCH_PROVIDER=${BENCH_PROVIDER:-openai}
+BENCH_DOCS=${BENCH_DOCS:-1000}
+BENCH_DOC_BYTES=${BENCH_DOC_BYTES:-4000}
+BENCH_CHUNK_STRATEGY=${BENCH_CHUNK_STRATEGY:-token_based}
+BENCH_CHUNK_SIZE=${BENCH_CHUNK_SIZE:-400}
+BENCH_CHUNK_OVERLAP=${BENCH_CHUNK_OVERLAP:-50}
+BENCH_WORKERS=${BENCH_WORKERS:-2}
+BENCH_BATCH_SIZES=${BENCH_BATCH_SIZES:-10}
+BENCH_HYBRID=${BENCH_HYBRID:-off}
+BENCH_TIMEOUT=${BENCH_TIMEOUT:-600}
+MOCK_PORT=${MOCK_PORT:-8765}
+MOCK_DIM=${MOCK_DIM:-1536}
+MOCK_LATENCY_MS=${MOCK_LATENCY_MS:-50}
+MOCK_PER_ITEM_MS=${MOCK_PER_ITEM_MS:-1}
+MOCK_JITTER_MS=${MOCK_JITTER_MS:-0}
+MOCK_MAX_BATCH=${MOCK_MAX_BATCH:-0}
+MOCK_ERROR_RATE=${MOCK_ERROR_RATE:-0}
+MOCK_RATE_LIMIT_RATE=${MOCK_RATE_LIMIT_RATE:-0}
+
+here=$(cd "$(dirname "$0")" && pwd)
+rev=$(git -C "$here" rev-parse --short HEAD 2>/dev/null || echo unknown)
+mkdir -p "$here/results"
+out="$here/results/ingest-$rev.csv"
+workdir=$(mktemp -d)
+mock_pid=
+
+psql_cmd()
+{
+	$PSQL -X -q -At -v ON_ERROR_STOP=1 -d "$BENCH_DB" "$@"
+}
+
+mock_request()
+{
+	$PYTHON - "$1" "$2" <<'PY'
+import sys, urllib.request
+method, url = sys.argv[1], sys.argv[2]
+req = urllib.request.Request(url, data=b"" if method == "POST" else None,
+                             method=method)
+print(urllib.request.urlopen(req).read().decode())
+PY
+}
+
+mock_stat()
+{
+	$PYTHON -c "import json, sys; print(json.load(sys.stdin)['$1'])" \
+		< "$workdir/stats.json"
+}
+
+cleanup()
+{
+	if [ -n "$mock_pid" ]; then
+		kill "$mock_pid" 2>/dev/null || true
+	fi
+	psql_cmd <<SQL >/dev/null 2>&1 || true
+ALTER SYSTEM RESET pgedge_vectorizer.provider;
+ALTER SYSTEM RESET pgedge_vectorizer.api_url;
+ALTER SYSTEM RESET pgedge_vectorizer.api_key_file;
+ALTER SYSTEM RESET pgedge_vectorizer.model;
+ALTER SYSTEM RESET pgedge_vectorizer.batch_size;
+ALTER SYSTEM RESET pgedge_vectorizer.enable_hybrid;
+ALTER SYSTEM RESET pgedge_vectorizer.databases;
+ALTER SYSTEM RESET pgedge_vectorizer.num_workers;
+SELECT pg_reload_conf();
+SQL
+	rm -rf "$workdir"
+}
+trap cleanup EXIT INT TERM
+
+case "$BENCH_PROVIDER" in
+	openai|voyage) api_url="http://127.0.0.1:$MOCK_PORT/v1" ;;
+	ollama) api_url="http://127.0.0.1:$MOCK_PORT" ;;
+	*) echo "unknown provider $BENCH_PROVIDER" >&2; exit 1 ;;
+esac
+
+echo "mock-key" > "$workdir/api-key"
+chmod 600 "$workdir/api-key"
+
+$PYTHON "$here/mock_embedding_server.py" --port "$MOCK_PORT" \
+	--dim "$MOCK_DIM" --latency-ms "$MOCK_LATENCY_MS" \
+	--per-item-ms "$MOCK_PER_ITEM_MS" --jitter-ms "$MOCK_JITTER_MS" \
+	--max-batch "$MOCK_MAX_BATCH" --error-rate "$MOCK_ERROR_RATE" \
+	--rate-limit-rate "$MOCK_RATE_LIMIT_RATE" > "$workdir/mock.log" 2>&1 &
+mock_pid=$!
+sleep 1
+
+psql_cmd <<SQL > /dev/null
+SET client_min_messages = warning;
+CREATE EXTENSION IF NOT EXISTS vector;
+CREATE EXTENSION IF NOT EXISTS pgedge_vectorizer;
+SQL
+
+echo "provider,workers,batch_size,hybrid,docs,chunks,completed,failed,insert_s,drain_s,total_s,chunks_per_s,max_queue_lag_s,avg_wait_ms,avg_embed_ms,mock_requests,mock_max_in_flight,mock_errors" > "$out"
+
+for workers in $BENCH_WORKERS; do
+for batch in $BENCH_BATCH_SIZES; do
+for hybrid in $BENCH_HYBRID; do
+	echo "Running provider=$BENCH_PROVIDER workers=$workers batch_size=$batch hybrid=$hybrid"
+
+	current_workers=$(psql_cmd -c "SHOW pgedge_vectorizer.num_workers")
+
+	psql_cmd <<SQL
+ALTER SYSTEM SET pgedge_vectorizer.provider = '$BENCH_PROVIDER';
+ALTER SYSTEM SET pgedge_vectorizer.api_url = '$api_url';
+ALTER SYSTEM SET pgedge_vectorizer.api_key_file = '$workdir/api-key';
+ALTER SYSTEM SET pgedge_vectorizer.model = 'mock-embedding';
+ALTER SYSTEM SET pgedge_vectorizer.batch_size = $batch;
+ALTER SYSTEM SET pgedge_vectorizer.enable_hybrid = $hybrid;
+ALTER SYSTEM SET pgedge_vectorizer.databases = '$BENCH_DB';
+ALTER SYSTEM SET pgedge_vectorizer.num_workers = $workers;
+SQL
+
+	if [ "$current_workers" != "$workers" ]; then
+		if [ -z "$BENCH_PGDATA" ]; then
+			echo "num_workers is $current_workers; set BENCH_PGDATA to allow a restart to $workers" >&2
+			exit 1
+		fi
+		$PG_CTL -D "$BENCH_PGDATA" -w restart > /dev/null
+	else
+		psql_cmd -c "SELECT pg_reload_conf()" > /dev/null
+	fi
+
+	# Give the workers a moment to pick up the new configuration
+	sleep 2
+
+	psql_cmd <<SQL > /dev/null
+SET client_min_messages = warning;
+SELECT pgedge_vectorizer.disable_vectorization(to_regclass('bench_ingest'), NULL, true)
+WHERE to_regclass('bench_ingest') IS NOT NULL;
+DROP TABLE IF EXISTS bench_ingest;
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'bench_ingest_content_chunks';
+CREATE TABLE bench_ingest (id BIGINT PRIMARY KEY, content TEXT);
+SELECT pgedge_vectorizer.enable_vectorization(
+    'bench_ingest', 'content', '$BENCH_CHUNK_STRATEGY',
+    $BENCH_CHUNK_SIZE, $BENCH_CHUNK_OVERLAP, $MOCK_DIM);
+SQL
+
+	mock_request POST "http://127.0.0.1:$MOCK_PORT/stats/reset" > /dev/null
+
+	t0=$(psql_cmd -c "SELECT extract(epoch FROM clock_timestamp())")
+
+	# Documents are overlapping windows over one generated corpus so that
+	# every document (and hence every chunk) is different
+	psql_cmd <<SQL
+WITH c AS (
+    SELECT pgedge_vectorizer.bench_corpus('prose',
+               $BENCH_DOC_BYTES * 4 + 1000) AS corpus
+)
+INSERT INTO bench_ingest (id, content)
+SELECT i, substr(c.corpus, 1 + (i * 997) % ($BENCH_DOC_BYTES * 3), $BENCH_DOC_BYTES)
+          || ' Document ' || i || '.'
+FROM c, generate_series(1, $BENCH_DOCS) AS i;
+SQL
+
+	t1=$(psql_cmd -c "SELECT extract(epoch FROM clock_timestamp())")
+
+	# Wait for the queue to drain, tracking the age of the oldest pending item
+	max_lag=0
+	while :; do
+		row=$(psql_cmd -F ' ' -c "
+SELECT count(*) FILTER (WHERE status IN ('pending', 'processing')),
+       coalesce(round(extract(epoch FROM clock_timestamp() -
+           min(created_at) FILTER (WHERE status = 'pending'))::numeric, 3), 0),
+       extract(epoch FROM clock_timestamp()) - $t0
+FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'bench_ingest_content_chunks'")
+		set -- $row
+		max_lag=$(echo "$max_lag $2" | awk '{ print ($2 > $1) ? $2 : $1 }')
+		if [ "$1" -eq 0 ]; then
+			break
+		fi
+		if [ "$(echo "$3 $BENCH_TIMEOUT" | awk '{ print ($1 > $2) }')" -eq 1 ]; then
+			echo "timed out with $1 items outstanding" >&2
+			break
+		fi
+		sleep 1
+	done
+
+	t2=$(psql_cmd -c "SELECT extract(epoch FROM clock_timestamp())")
+
+	mock_request GET "http://127.0.0.1:$MOCK_PORT/stats" > "$workdir/stats.json"
+
+	psql_cmd -F ',' -c "
+SELECT '$BENCH_PROVIDER', $workers, $batch, '$hybrid', $BENCH_DOCS,
+       (SELECT count(*) FROM bench_ingest_content_chunks),
+       count(*) FILTER (WHERE status = 'completed'),
+       count(*) FILTER (WHERE status = 'failed'),
+       round(($t1 - $t0)::numeric, 3),
+       round(($t2 - $t1)::numeric, 3),
+       round(($t2 - $t0)::numeric, 3),
+       round((count(*) FILTER (WHERE status = 'completed') /
+              greatest($t2 - $t0, 0.001))::numeric, 1),
+       $max_lag,
+       round((avg(extract(epoch FROM processing_started_at - created_at))
+              * 1000)::numeric, 1),
+       round((avg(extract(epoch FROM processed_at - processing_started_at))
+              FILTER (WHERE status = 'completed') * 1000)::numeric, 1),
+       $(mock_stat requests), $(mock_stat max_in_flight),
+       $(( $(mock_stat errors) + $(mock_stat rate_limited) + $(mock_stat rejected_batches) ))
+FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'bench_ingest_content_chunks'" >> "$out"
+done
+done
+done
+
+psql_cmd <<SQL > /dev/null
+SET client_min_messages = warning;
+SELECT pgedge_vectorizer.disable_vectorization('bench_ingest'::regclass, NULL, true);
+DROP TABLE bench_ingest;
+SQL
+
+echo "Results written to $out"
+column -s, -t < "$out" 2>/dev/null || cat "$out"
@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+#
+# mock_embedding_server.py
+#     Local OpenAI/Voyage/Ollama-compatible embedding server for benchmarks
+#
+# Serves deterministic embeddings so ingest throughput can be measured
+# without calling a paid API. Latency, dimension, batch limits and error
+# injection are configurable; counters are available from GET /stats and
+# are reset by POST /stats/reset.
+#
+#     POST /embeddings, /v1/embeddings    OpenAI and Voyage batch format
+#     POST /api/embeddings                Ollama single-text format
+#
+# Only the Python standard library is required.
+#
+# Copyright (c) 2025 - 2026, pgEdge, Inc.
+#
+
+import argparse
+import hashlib
+import json
+import random
+import struct
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class Stats:
+    """Request counters shared by all handler threads."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        with self.lock:
+            self.requests = 0
+            self.items = 0
+            self.errors = 0
+            self.rate_limited = 0
+            self.rejected_batches = 0
+            self.busy_seconds = 0.0
+            self.in_flight = 0
+            self.max_in_flight = 0
+            self.max_batch = 0
+
+    def snapshot(self):
+        with self.lock:
+            return {
+                "requests": self.requests,
+                "items": self.items,
+                "errors": self.errors,
+                "rate_limited": self.rate_limited,
+                "rejected_batches": self.rejected_batches,
+                "busy_seconds": round(self.busy_seconds, 3),
+                "max_in_flight": self.max_in_flight,
+                "max_batch": self.max_batch,
+            }
+
+
+def embed(text, dim):
+    """Deterministic unit-length pseudo-embedding derived from the text."""
+    values = []
+    counter = 0
+    while len(values) < dim:
+        digest = hashlib.sha256(f"{counter}:{text}".encode()).digest()
+        for (word,) in struct.iter_unpack("<i", digest):
+            values.append(word / 2147483648.0)
+        counter += 1
+    values = values[:dim]
+    norm = sum(v * v for v in values) ** 0.5 or 1.0
+    return [round(v / norm, 6) for v in values]
+
+
+def make_handler(args, stats):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, fmt, *fargs):
+            if args.verbose:
+                super().log_message(fmt, *fargs)
+
+        def send_json(self, code, body):
+            payload = json.dumps(body).encode()
+            self.send_response(code)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(payload)))
+            self.end_headers()
+            self.wfile.write(payload)
+
+        def do_GET(self):
+            if self.path == "/stats":
+                self.send_json(200, stats.snapshot())
+            else:
+                self.send_json(404, {"error": "not found"})
+
+        def do_POST(self):
+            length = int(self.headers.get("Content-Length", 0))
+            raw = self.rfile.read(length)
+
+            if self.path == "/stats/reset":
+                stats.reset()
+                self.send_json(200, {"reset": True})
+                return
+
+            if self.path in ("/embeddings", "/v1/embeddings"):
+                ollama = False
+            elif self.path == "/api/embeddings":
+                ollama = True
+            else:
+                self.send_json(404, {"error": "not found"})
+                return
+
+            try:
+                request = json.loads(raw)
+            except ValueError:
+                self.send_json(400, {"error": "invalid JSON"})
+                return
+
+            if ollama:
+                texts = [request.get("prompt", "")]
+            else:
+                texts = request.get("input", [])
+                if isinstance(texts, str):
+                    texts = [texts]
+
+            with stats.lock:
+                stats.requests += 1
+                stats.in_flight += 1
+                stats.max_in_flight = max(stats.max_in_flight, stats.in_flight)
+                stats.max_batch = max(stats.max_batch, len(texts))
+
+            start = time.monotonic()
+            try:
+                self.respond(texts, ollama)
+            finally:
+                with stats.lock:
+                    stats.in_flight -= 1
+                    stats.busy_seconds += time.monotonic() - start
+
+        def respond(self, texts, ollama):
+            if args.max_batch and len(texts) > args.max_batch:
+                with stats.lock:
+                    stats.rejected_batches += 1
+                self.send_json(400, {"error": {
+                    "message": f"batch of {len(texts)} exceeds limit "
+                               f"of {args.max_batch}"}})
+                return
+
+            delay = (args.latency_ms + args.per_item_ms * len(texts)
+                     + random.uniform(-args.jitter_ms, args.jitter_ms))
+            if delay > 0:
+                time.sleep(delay / 1000.0)
+
+            roll = random.random()
+            if roll < args.rate_limit_rate:
+                with stats.lock:
+                    stats.rate_limited += 1
+                self.send_json(429, {"error": {"message": "rate limited"}})
+                return
+            if roll < args.rate_limit_rate + args.error_rate:
+                with stats.lock:
+                    stats.errors += 1
+                self.send_json(500, {"error": {"message": "injected failure"}})
+                return
+
+            with stats.lock:
+                stats.items += len(texts)
+
+            if ollama:
+                self.send_json(200, {"embedding": embed(texts[0], args.dim)})
+                return
+
+            tokens = sum((len(t) + 3) // 4 for t in texts)
+            self.send_json(200, {
+                "object": "list",
+                "data": [{"object": "embedding", "index": i,
+                          "embedding": embed(t, args.dim)}
+                         for i, t in enumerate(texts)],
+                "model": args.model,
+                "usage": {"prompt_tokens": tokens, "total_tokens": tokens},
+            })
+
+    return Handler
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Mock OpenAI/Voyage/Ollama embedding server")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8765)
+    parser.add_argument("--dim", type=int, default=1536,
+                        help="embedding dimension")
+    parser.add_argument("--model", default="mock-embedding")
+    parser.add_argument("--latency-ms", type=float, default=50.0,
+                        help="fixed latency per request")
+    parser.add_argument("--per-item-ms", type=float, default=1.0,
+                        help="additional latency per text in a batch")
+    parser.add_argument("--jitter-ms", type=float, default=0.0,
+                        help="uniform random latency jitter (+/-)")
+    parser.add_argument("--max-batch", type=int, default=0,
+                        help="reject batches larger than this (0 = no limit)")
+    parser.add_argument("--error-rate", type=float, default=0.0,
+                        help="fraction of requests failing with HTTP 500")
+    parser.add_argument("--rate-limit-rate", type=float, default=0.0,
+                        help="fraction of requests failing with HTTP 429")
+    parser.add_argument("--seed", type=int, default=42)
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    random.seed(args.seed)
+    stats = Stats()
+    server = ThreadingHTTPServer((args.host, args.port),
+                                 make_handler(args, stats))
+    server.daemon_threads = True
+    print(f"mock embedding server listening on "
+          f"http://{args.host}:{args.port} (dim={args.dim})", flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
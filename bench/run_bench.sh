@@ -0,0 +1,97 @@
+#!/bin/sh
+#
+# run_bench.sh
+#	Run the pgedge_vectorizer micro-benchmarks and compare with a baseline
+#
+# Results are written to bench/results/<git revision>.csv.  With
+# --baseline the results are also copied to bench/baseline.csv, which is
+# machine-specific and not committed; otherwise
+# they are compared with that file and the script exits non-zero when a
+# kernel's throughput drops, or its peak memory grows, by more than
+# BENCH_THRESHOLD percent.
+#
+# Copyright (c) 2025 - 2026, pgEdge, Inc.
+#
+
+set -e
+
+PSQL=${PSQL:-psql}
+BENCH_DB=${BENCH_DB:-postgres}
+BENCH_ITERATIONS=${BENCH_ITERATIONS:-20}
+BENCH_BYTES=${BENCH_BYTES:-65536}
+BENCH_THRESHOLD=${BENCH_THRESHOLD:-10}
+
+here=$(cd "$(dirname "$0")" && pwd)
+rev=$(git -C "$here" rev-parse --short HEAD 2>/dev/null || echo unknown)
+baseline="$here/baseline.csv"
+
+mkdir -p "$here/results"
+out="$here/results/$rev.csv"
+
+$PSQL -X -q --csv -v ON_ERROR_STOP=1 -d "$BENCH_DB" <<SQL > "$out"
+CREATE EXTENSION IF NOT EXISTS vector;
+CREATE EXTENSION IF NOT EXISTS pgedge_vectorizer;
+SELECT kernel, corpus_kind, scan_impl, input_bytes,
+       round(total_ms::numeric, 3) AS total_ms,
+       round(mb_per_sec::numeric, 2) AS mb_per_sec,
+       items_per_iteration,
+       round(items_per_sec::numeric, 1) AS items_per_sec,
+       retained_context_bytes, peak_context_bytes
+FROM pgedge_vectorizer.bench_chunking($BENCH_ITERATIONS, $BENCH_BYTES);
+SQL
+
+echo "Results for $rev written to $out"
+
+if [ "$1" = "--baseline" ]; then
+	cp "$out" "$baseline"
+	echo "Baseline recorded in $baseline"
+	exit 0
+fi
+
+if [ ! -f "$baseline" ]; then
+	echo "No baseline found; record one with 'make bench-baseline'"
+	column -s, -t < "$out" 2>/dev/null || cat "$out"
+	exit 0
+fi
+
+awk -F, -v thr="$BENCH_THRESHOLD" '
+NR == FNR {
+	if (FNR > 1)
+	{
+		base[$1 "," $2] = $6
+		peak[$1 "," $2] = $10
+	}
+	next
+}
+FNR == 1 {
+	printf "%-14s %-12s %12s %12s %9s %12s %12s\n",
+		"kernel", "corpus", "base MB/s", "MB/s", "delta", "base peak", "peak"
+	next
+}
+{
+	key = $1 "," $2
+	flag = ""
+	delta = "n/a"
+
+	if ((key in base) && base[key] > 0)
+	{
+		d = ($6 - base[key]) * 100 / base[key]
+		delta = sprintf("%+.1f%%", d)
+		if (d < -thr)
+			flag = "THROUGHPUT"
+	}
+
+	if ((key in peak) && peak[key] > 0 && ($10 - peak[key]) * 100 / peak[key] > thr)
+		flag = flag (flag != "" ? "," : "") "MEMORY"
+
+	if (flag != "")
+		failed = 1
+
+	printf "%-14s %-12s %12s %12s %9s %12s %12s %s\n",
+		$1, $2, base[key], $6, delta, peak[key], $10, flag
+}
+END {
+	if (failed)
+		print "Regressions beyond " thr "% detected"
+	exit failed
+}' "$baseline" "$out"
@@ -23,6 +23,16 @@ CREATE TABLE pgedge_vectorizer.vectorizers (
     source_table  TEXT NOT NULL,
     source_column NAME NOT NULL,
     chunk_table   TEXT NOT NULL,
+    source_pk     NAME,
+    chunk_storage TEXT NOT NULL DEFAULT 'content'
+        CHECK (chunk_storage IN ('content', 'offsets')),
+    chunk_strategy TEXT,
+    chunk_size    INT,
+    chunk_overlap INT,
+    indexes_deferred BOOLEAN NOT NULL DEFAULT FALSE,
+    embedding_table TEXT,
+    embedding_column NAME,
+    model         TEXT,         -- Set by finish_model_migration(), else the configured model
     created_at    TIMESTAMPTZ NOT NULL DEFAULT NOW(),
     UNIQUE (source_table, source_column)
 );
@@ -38,7 +48,7 @@ CREATE TABLE pgedge_vectorizer.queue (
     id BIGSERIAL PRIMARY KEY,
     chunk_id BIGINT NOT NULL,          -- ID of the chunk in the chunk table
     chunk_table TEXT NOT NULL,          -- Name of the chunk table
-    content TEXT NOT NULL,              -- Text content to embed
+    content TEXT,                       -- Text to embed (NULL: read from chunk offsets)
     status TEXT NOT NULL DEFAULT 'pending'
         CHECK (status IN ('pending', 'processing', 'completed', 'failed')),
     attempts INT NOT NULL DEFAULT 0,
@@ -48,7 +58,9 @@ CREATE TABLE pgedge_vectorizer.queue (
     processing_started_at TIMESTAMPTZ,
     processed_at TIMESTAMPTZ,
     next_retry_at TIMESTAMPTZ,
-    metadata JSONB
+    metadata JSONB,
+    -- Claim bucket: each worker polls its own buckets (see worker.c)
+    bucket SMALLINT NOT NULL GENERATED ALWAYS AS ((chunk_id % 64)::SMALLINT) STORED
 );
 
 -- Indexes for efficient queue processing
@@ -60,6 +72,112 @@ CREATE INDEX idx_queue_chunk ON pgedge_vectorizer.queue(chunk_table, chunk_id);
 CREATE INDEX idx_queue_created_at ON pgedge_vectorizer.queue(created_at)
     WHERE status = 'pending';
 
+-- Per-bucket claim index: workers polling different buckets work on
+-- different index pages instead of all skipping over the same head rows.
+-- Within a bucket it is in claim order: retries first, then oldest first.
+CREATE INDEX idx_queue_bucket ON pgedge_vectorizer.queue(bucket, attempts DESC, created_at)
+    WHERE status = 'pending';
+
+---------------------------------------------------------------------------
+-- Model migrations
+-- Chunk tables being re-embedded with another model.  The new vectors go
+-- to a shadow embedding_next column while searches keep using the current
+-- ones (see start_model_migration()).
+---------------------------------------------------------------------------
+
+CREATE TABLE pgedge_vectorizer.model_migrations (
+    chunk_table   TEXT PRIMARY KEY,
+    model         TEXT NOT NULL,
+    dimension     INT NOT NULL,
+    status        TEXT NOT NULL DEFAULT 'running'
+        CHECK (status IN ('running', 'indexing', 'ready', 'failed')),
+    last_chunk_id BIGINT NOT NULL DEFAULT 0,   -- Re-embedded up to this chunk id
+    error_message TEXT,
+    started_at    TIMESTAMPTZ NOT NULL DEFAULT NOW(),
+    ready_at      TIMESTAMPTZ
+);
+
+COMMENT ON TABLE pgedge_vectorizer.model_migrations IS
+'Chunk tables being re-embedded with a new model into their embedding_next column';
+
+---------------------------------------------------------------------------
+-- Provider usage
+-- Tokens and requests spent at the embedding provider per chunk table,
+-- added by the workers about once a minute.
+---------------------------------------------------------------------------
+
+CREATE TABLE pgedge_vectorizer.usage_stats (
+    chunk_table   TEXT PRIMARY KEY,
+    tokens        BIGINT NOT NULL DEFAULT 0,   -- Reported by the provider, else estimated
+    requests      BIGINT NOT NULL DEFAULT 0,
+    items         BIGINT NOT NULL DEFAULT 0,   -- Texts sent to the provider
+    cache_hits    BIGINT NOT NULL DEFAULT 0,   -- Stored dense embeddings reused
+    retries       BIGINT NOT NULL DEFAULT 0,   -- Queue items attempted again
+    created_at    TIMESTAMPTZ NOT NULL DEFAULT NOW(),
+    updated_at    TIMESTAMPTZ NOT NULL DEFAULT NOW()
+);
+
+COMMENT ON TABLE pgedge_vectorizer.usage_stats IS
+'Embedding provider tokens, requests, reused embeddings and retries per chunk table';
+
+---------------------------------------------------------------------------
+-- Ingestion traces
+-- Pipeline events of the documents sampled by trace_sample_rate, written
+-- by the vectorization trigger and the workers (see trace_document()).
+-- Workers keep it to about trace_max_rows rows.
+---------------------------------------------------------------------------
+
+CREATE TABLE pgedge_vectorizer.ingest_trace (
+    id            BIGSERIAL PRIMARY KEY,
+    chunk_table   TEXT NOT NULL,
+    source_id     TEXT NOT NULL,               -- Primary key of the source row
+    chunk_id      BIGINT,                      -- NULL for events of the whole document
+    stage         TEXT NOT NULL
+        CHECK (stage IN ('chunk', 'queue', 'claim', 'embed', 'write', 'bm25', 'failed')),
+    recorded_at   TIMESTAMPTZ NOT NULL DEFAULT clock_timestamp(),
+    duration_ms   FLOAT8,
+    size          INT,                         -- Chunks or bytes, depending on the stage
+    detail        TEXT
+);
+
+CREATE INDEX idx_ingest_trace_source ON pgedge_vectorizer.ingest_trace(chunk_table, source_id);
+
+COMMENT ON TABLE pgedge_vectorizer.ingest_trace IS
+'Pipeline events of sampled documents, from chunking to stored embeddings';
+
+---------------------------------------------------------------------------
+-- Throughput history
+-- A ring of history_size snapshots of the throughput, queue depth, errors
+-- and provider latency, taken by the first worker of the database every
+-- history_interval seconds (see capture_throughput()).  A new snapshot
+-- overwrites the oldest one.
+---------------------------------------------------------------------------
+
+CREATE TABLE pgedge_vectorizer.throughput_history (
+    slot              INT PRIMARY KEY,             -- Position in the ring
+    captured_at       TIMESTAMPTZ NOT NULL,
+    interval_secs     FLOAT8,                      -- Since the previous snapshot; NULL for the first
+    items_per_sec     FLOAT8,                      -- Texts embedded
+    tokens_per_sec    FLOAT8,
+    requests_per_sec  FLOAT8,                      -- Provider requests, all databases
+    retries_per_sec   FLOAT8,                      -- Queue items attempted again
+    failure_rate      FLOAT8,                      -- Failed share of the provider requests
+    latency_p50_ms    FLOAT8,                      -- Provider request latency over the interval
+    latency_p90_ms    FLOAT8,
+    latency_p99_ms    FLOAT8,
+    pending           BIGINT NOT NULL DEFAULT 0,   -- Queue table items by status
+    processing        BIGINT NOT NULL DEFAULT 0,
+    failed            BIGINT NOT NULL DEFAULT 0,
+    hot_queued        INT NOT NULL DEFAULT 0,      -- Chunks on the hot queue, all databases
+    tables            JSONB NOT NULL DEFAULT '{}', -- The same figures per chunk table
+    counters          JSONB NOT NULL DEFAULT '{}'  -- Cumulative counts the next rates are taken from
+);
+
+CREATE INDEX idx_throughput_history_captured ON pgedge_vectorizer.throughput_history(captured_at);
+
+COMMENT ON TABLE pgedge_vectorizer.throughput_history IS
+'Periodic snapshots of throughput, queue depth, errors and provider latency, kept in a fixed-size ring';
+
 ---------------------------------------------------------------------------
 -- C function declarations
 ---------------------------------------------------------------------------
@@ -77,6 +195,524 @@ LANGUAGE C IMMUTABLE STRICT;
 COMMENT ON FUNCTION pgedge_vectorizer.chunk_text IS
 'Split text into chunks according to the specified strategy';
 
+-- Chunking with byte offsets of each chunk in the source text
+CREATE FUNCTION pgedge_vectorizer.chunk_text_offsets(
+    content TEXT,
+    strategy TEXT DEFAULT NULL,
+    chunk_size INT DEFAULT NULL,
+    overlap INT DEFAULT NULL,
+    OUT chunks TEXT[],
+    OUT start_offsets INT[],
+    OUT lengths INT[]
+)
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_chunk_text_offsets_sql'
+LANGUAGE C IMMUTABLE STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.chunk_text_offsets IS
+'Split text into chunks and return the byte offset and length of each chunk in the source (NULL when not found verbatim)';
+
+-- Byte range of a source document, fetched without detoasting the rest
+CREATE FUNCTION pgedge_vectorizer.chunk_slice(
+    source TEXT,
+    start_offset INT,
+    length INT
+) RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_chunk_slice'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION pgedge_vectorizer.chunk_slice IS
+'Return length bytes of source starting at byte start_offset (0-based)';
+
+-- Shared-memory hot queue (pgedge_vectorizer.hot_queue_size)
+CREATE FUNCTION pgedge_vectorizer.hot_enqueue(
+    chunk_table TEXT,
+    chunk_id BIGINT,
+    traced BOOLEAN DEFAULT FALSE
+) RETURNS BOOLEAN
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_hot_enqueue'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.hot_enqueue IS
+'Queue a chunk on the in-memory hot queue at commit; false when disabled or full';
+
+CREATE FUNCTION pgedge_vectorizer.hot_queue_status(
+    OUT capacity INT,
+    OUT queued INT,
+    OUT reserved INT
+)
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_hot_queue_status'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.hot_queue_status IS
+'Capacity of the in-memory hot queue, chunks waiting in it, and slots reserved by open transactions';
+
+CREATE FUNCTION pgedge_vectorizer.hot_queue_entries(
+    OUT chunk_table TEXT,
+    OUT chunk_id BIGINT,
+    OUT queued_at TIMESTAMPTZ
+) RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_hot_queue_entries'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.hot_queue_entries IS
+'Chunks of the current database waiting on the in-memory hot queue, oldest first';
+
+-- Queue depth and lag counters kept in shared memory
+CREATE FUNCTION pgedge_vectorizer.queue_stats(
+    OUT chunk_table TEXT,
+    OUT status TEXT,
+    OUT count BIGINT,
+    OUT oldest TIMESTAMPTZ,
+    OUT newest TIMESTAMPTZ,
+    OUT avg_processing_time_secs FLOAT8
+) RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_queue_stats'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.queue_stats IS
+'Queue items per chunk table and status, read from shared-memory counters instead of the queue table';
+
+CREATE FUNCTION pgedge_vectorizer.refresh_queue_stats()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_refresh_queue_stats'
+LANGUAGE C;
+
+COMMENT ON FUNCTION pgedge_vectorizer.refresh_queue_stats IS
+'Count the queue table into the shared-memory counters read by queue_stats()';
+
+CREATE FUNCTION pgedge_vectorizer.queue_stats_trigger()
+RETURNS TRIGGER
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_queue_stats_trigger'
+LANGUAGE C;
+
+CREATE TRIGGER queue_stats_trigger
+    AFTER INSERT OR DELETE OR UPDATE OF chunk_table, status, created_at, processed_at
+    ON pgedge_vectorizer.queue
+    FOR EACH ROW EXECUTE FUNCTION pgedge_vectorizer.queue_stats_trigger();
+
+CREATE TRIGGER queue_stats_truncate_trigger
+    AFTER TRUNCATE ON pgedge_vectorizer.queue
+    FOR EACH STATEMENT EXECUTE FUNCTION pgedge_vectorizer.queue_stats_trigger();
+
+-- Provider latency histograms and request rates
+CREATE FUNCTION pgedge_vectorizer.provider_stats(
+    OUT provider TEXT,
+    OUT model TEXT,
+    OUT endpoint TEXT,
+    OUT requests BIGINT,
+    OUT failures BIGINT,
+    OUT items BIGINT,
+    OUT tokens BIGINT,
+    OUT request_bytes BIGINT,
+    OUT response_bytes BIGINT,
+    OUT latency_p50_ms FLOAT8,
+    OUT latency_p90_ms FLOAT8,
+    OUT latency_p99_ms FLOAT8,
+    OUT avg_ttfb_ms FLOAT8,
+    OUT avg_transfer_ms FLOAT8,
+    OUT avg_parse_ms FLOAT8,
+    OUT requests_last_min BIGINT,
+    OUT items_per_sec FLOAT8,
+    OUT tokens_per_sec FLOAT8
+) RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_provider_stats'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.provider_stats IS
+'Requests, latency percentiles and rates over the last minute per provider endpoint';
+
+CREATE FUNCTION pgedge_vectorizer.provider_latency_histogram(
+    OUT provider TEXT,
+    OUT model TEXT,
+    OUT endpoint TEXT,
+    OUT phase TEXT,
+    OUT le_ms FLOAT8,
+    OUT count BIGINT
+) RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_provider_latency_histogram'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.provider_latency_histogram IS
+'Provider request latency histograms (total, ttfb, transfer, parse), one row per bucket';
+
+CREATE FUNCTION pgedge_vectorizer.reset_provider_stats()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_reset_provider_stats'
+LANGUAGE C;
+
+COMMENT ON FUNCTION pgedge_vectorizer.reset_provider_stats IS
+'Discard the provider latency histograms and counters';
+
+CREATE FUNCTION pgedge_vectorizer.batch_stats(
+    OUT batches BIGINT,
+    OUT items BIGINT,
+    OUT failed BIGINT,
+    OUT claim_ms FLOAT8,
+    OUT probe_ms FLOAT8,
+    OUT request_build_ms FLOAT8,
+    OUT http_ms FLOAT8,
+    OUT parse_ms FLOAT8,
+    OUT write_ms FLOAT8,
+    OUT bm25_tokenize_ms FLOAT8,
+    OUT bm25_score_ms FLOAT8,
+    OUT bm25_idf_ms FLOAT8,
+    OUT commit_ms FLOAT8,
+    OUT other_ms FLOAT8,
+    OUT total_ms FLOAT8,
+    OUT max_batch_ms FLOAT8,
+    OUT avg_peak_memory BIGINT,
+    OUT max_peak_memory BIGINT,
+    OUT stats_reset TIMESTAMPTZ
+) RETURNS RECORD
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_batch_stats'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.batch_stats IS
+'Cumulative worker batch counts and time per pipeline stage';
+
+CREATE FUNCTION pgedge_vectorizer.recent_batches(
+    OUT finished_at TIMESTAMPTZ,
+    OUT worker_id INT,
+    OUT source TEXT,
+    OUT items INT,
+    OUT failed INT,
+    OUT claim_ms FLOAT8,
+    OUT probe_ms FLOAT8,
+    OUT request_build_ms FLOAT8,
+    OUT http_ms FLOAT8,
+    OUT parse_ms FLOAT8,
+    OUT write_ms FLOAT8,
+    OUT bm25_tokenize_ms FLOAT8,
+    OUT bm25_score_ms FLOAT8,
+    OUT bm25_idf_ms FLOAT8,
+    OUT commit_ms FLOAT8,
+    OUT other_ms FLOAT8,
+    OUT total_ms FLOAT8,
+    OUT peak_memory BIGINT
+) RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_recent_batches'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.recent_batches IS
+'Time per pipeline stage and peak memory of the last 128 worker batches';
+
+CREATE FUNCTION pgedge_vectorizer.reset_batch_stats()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_reset_batch_stats'
+LANGUAGE C;
+
+COMMENT ON FUNCTION pgedge_vectorizer.reset_batch_stats IS
+'Discard the worker batch counters and recent batches';
+
+CREATE FUNCTION pgedge_vectorizer.freshness_stats(
+    OUT chunk_table TEXT,
+    OUT embedded BIGINT,
+    OUT avg_secs FLOAT8,
+    OUT p50_secs FLOAT8,
+    OUT p90_secs FLOAT8,
+    OUT p99_secs FLOAT8,
+    OUT max_secs FLOAT8,
+    OUT pending_lag_secs FLOAT8
+) RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_freshness_stats'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.freshness_stats IS
+'Time from queuing to searchable embeddings, and age of the oldest pending chunk, per chunk table';
+
+CREATE FUNCTION pgedge_vectorizer.freshness_histogram(
+    OUT chunk_table TEXT,
+    OUT le_secs FLOAT8,
+    OUT count BIGINT
+) RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_freshness_histogram'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.freshness_histogram IS
+'Histogram of the time from queuing to searchable embeddings per chunk table, one row per bucket';
+
+CREATE FUNCTION pgedge_vectorizer.reset_freshness_stats()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_reset_freshness_stats'
+LANGUAGE C;
+
+COMMENT ON FUNCTION pgedge_vectorizer.reset_freshness_stats IS
+'Discard the freshness histograms of the current database';
+
+-- Per-phase timing of hybrid_search() (pgedge_vectorizer.profile_search)
+CREATE FUNCTION pgedge_vectorizer.record_search_profile(
+    chunk_table TEXT,
+    phase_ms FLOAT8[],
+    dense_candidates INT,
+    sparse_candidates INT,
+    results INT
+) RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_record_search_profile'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.record_search_profile IS
+'Record the phase timings of a hybrid_search() call; called by hybrid_search()';
+
+CREATE FUNCTION pgedge_vectorizer.search_stats(
+    OUT searches BIGINT,
+    OUT lookup_ms FLOAT8,
+    OUT embed_ms FLOAT8,
+    OUT bm25_query_ms FLOAT8,
+    OUT idf_load_ms FLOAT8,
+    OUT dense_scan_ms FLOAT8,
+    OUT sparse_scan_ms FLOAT8,
+    OUT merge_ms FLOAT8,
+    OUT total_ms FLOAT8,
+    OUT max_search_ms FLOAT8,
+    OUT avg_dense_candidates FLOAT8,
+    OUT avg_sparse_candidates FLOAT8,
+    OUT avg_results FLOAT8,
+    OUT stats_reset TIMESTAMPTZ
+) RETURNS RECORD
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_search_stats'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.search_stats IS
+'Cumulative hybrid_search() calls, time per phase and candidates per ranked list';
+
+CREATE FUNCTION pgedge_vectorizer.reset_search_stats()
+RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_reset_search_stats'
+LANGUAGE C;
+
+COMMENT ON FUNCTION pgedge_vectorizer.reset_search_stats IS
+'Discard the hybrid_search() counters';
+
+-- Provider usage of one call, charged to usage_stats as the workers do
+-- (exposed for testing)
+CREATE FUNCTION pgedge_vectorizer.record_usage(
+    chunk_tables TEXT[],
+    contents TEXT[],
+    tokens BIGINT,
+    requests INT DEFAULT 1
+) RETURNS VOID
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_record_usage'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.record_usage IS
+'Charge the tokens and requests of a provider call to the chunk tables of its texts in usage_stats';
+
+-- Metrics in the OpenMetrics text format, e.g. for Prometheus
+CREATE FUNCTION pgedge_vectorizer.metrics()
+RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_metrics'
+LANGUAGE C;
+
+COMMENT ON FUNCTION pgedge_vectorizer.metrics IS
+'Queue, worker, provider, freshness and usage metrics in the OpenMetrics text format';
+
+-- Ingestion traces (pgedge_vectorizer.trace_sample_rate)
+CREATE FUNCTION pgedge_vectorizer.trace_sampled(
+    source_table REGCLASS
+) RETURNS BOOLEAN
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_trace_sampled'
+LANGUAGE C STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.trace_sampled IS
+'Whether the vectorization trigger traces a document of the table, drawn at trace_sample_rate';
+
+CREATE FUNCTION pgedge_vectorizer.trace_document(
+    source_table REGCLASS,
+    id ANYELEMENT
+) RETURNS TABLE (
+    recorded_at TIMESTAMPTZ,
+    elapsed_ms FLOAT8,
+    chunk_table TEXT,
+    chunk_id BIGINT,
+    stage TEXT,
+    duration_ms FLOAT8,
+    size INT,
+    detail TEXT
+) AS $$
+    SELECT t.recorded_at,
+           extract(epoch FROM t.recorded_at - min(t.recorded_at) OVER ()) * 1000,
+           t.chunk_table, t.chunk_id, t.stage, t.duration_ms, t.size, t.detail
+    FROM pgedge_vectorizer.ingest_trace t
+    WHERE t.chunk_table IN (SELECT v.chunk_table
+                            FROM pgedge_vectorizer.vectorizers v
+                            WHERE v.source_table = trace_document.source_table::TEXT)
+      AND t.source_id = trace_document.id::TEXT
+    ORDER BY t.recorded_at, t.id;
+$$ LANGUAGE sql STABLE;
+
+COMMENT ON FUNCTION pgedge_vectorizer.trace_document IS
+'Timeline of the traced pipeline events of a source document';
+
+-- Throughput history (pgedge_vectorizer.history_interval)
+CREATE FUNCTION pgedge_vectorizer.counter_rate(
+    reading BIGINT,
+    previous_reading BIGINT,
+    secs FLOAT8
+) RETURNS FLOAT8 AS $$
+    -- A counter below its previous reading was reset and counts from zero
+    SELECT CASE WHEN secs > 0 AND reading IS NOT NULL THEN
+               (CASE WHEN reading >= COALESCE(previous_reading, 0)
+                     THEN reading - COALESCE(previous_reading, 0)
+                     ELSE reading END) / secs
+           END;
+$$ LANGUAGE sql IMMUTABLE;
+
+COMMENT ON FUNCTION pgedge_vectorizer.counter_rate IS
+'Per-second rate of a counter between two readings, allowing for a reset in between';
+
+CREATE FUNCTION pgedge_vectorizer.histogram_percentile(
+    bounds FLOAT8[],
+    counts BIGINT[],
+    fraction FLOAT8
+) RETURNS FLOAT8 AS $$
+    -- Interpolates linearly within the bucket, like provider_stats(); the
+    -- last bucket (Infinity) is reported at its lower bound
+    SELECT CASE WHEN b.le = 'Infinity' THEN b.lower_bound
+                ELSE b.lower_bound + (b.le - b.lower_bound) * (b.target - (b.cum - b.cnt)) / b.cnt
+           END
+    FROM (SELECT h.i, h.le, h.cnt,
+                 COALESCE(lag(h.le) OVER (ORDER BY h.i), 0) AS lower_bound,
+                 (sum(h.cnt) OVER (ORDER BY h.i))::FLOAT8 AS cum,
+                 fraction * (sum(h.cnt) OVER ())::FLOAT8 AS target
+          FROM unnest(bounds, counts) WITH ORDINALITY AS h(le, cnt, i)) b
+    WHERE b.cnt > 0 AND b.cum >= b.target
+    ORDER BY b.i
+    LIMIT 1;
+$$ LANGUAGE sql IMMUTABLE;
+
+COMMENT ON FUNCTION pgedge_vectorizer.histogram_percentile IS
+'Percentile estimated from histogram bucket upper bounds and counts; NULL for an empty histogram';
+
+CREATE FUNCTION pgedge_vectorizer.capture_throughput()
+RETURNS VOID AS $$
+DECLARE
+    v_size         INT := COALESCE(current_setting('pgedge_vectorizer.history_size', true), '2016')::INT;
+    v_now          TIMESTAMPTZ := clock_timestamp();
+    v_prev         pgedge_vectorizer.throughput_history%ROWTYPE;
+    v_secs         FLOAT8;
+    v_usage        JSONB;
+    v_provider     BIGINT[];
+    v_bounds       FLOAT8[];
+    v_latency      BIGINT[];
+    v_delta        BIGINT[];
+    v_tables       JSONB;
+BEGIN
+    SELECT * INTO v_prev
+    FROM pgedge_vectorizer.throughput_history
+    ORDER BY captured_at DESC
+    LIMIT 1;
+
+    v_secs := extract(epoch FROM v_now - v_prev.captured_at)::FLOAT8;
+
+    -- Cumulative counters: usage per chunk table (items, tokens, requests,
+    -- retries), provider requests and failures, and the latency histogram
+    -- of whole provider requests
+    SELECT COALESCE(jsonb_object_agg(u.chunk_table,
+                        jsonb_build_array(u.items, u.tokens, u.requests, u.retries)), '{}')
+    INTO v_usage
+    FROM pgedge_vectorizer.usage_stats u;
+
+    SELECT ARRAY[COALESCE(sum(ps.requests), 0), COALESCE(sum(ps.failures), 0)]::BIGINT[]
+    INTO v_provider
+    FROM pgedge_vectorizer.provider_stats() ps;
+
+    SELECT array_agg(h.le_ms ORDER BY h.le_ms), array_agg(h.count ORDER BY h.le_ms)
+    INTO v_bounds, v_latency
+    FROM (SELECT le_ms, sum(count)::BIGINT AS count
+          FROM pgedge_vectorizer.provider_latency_histogram()
+          WHERE phase = 'total'
+          GROUP BY le_ms) h;
+
+    -- Requests of the interval per latency bucket
+    IF v_secs IS NOT NULL THEN
+        SELECT array_agg(CASE WHEN d.cur >= COALESCE(d.prev, 0)
+                              THEN d.cur - COALESCE(d.prev, 0)
+                              ELSE d.cur END ORDER BY d.i)
+        INTO v_delta
+        FROM unnest(v_latency,
+                    ARRAY(SELECT e.value::BIGINT
+                          FROM jsonb_array_elements_text(v_prev.counters->'latency')
+                               WITH ORDINALITY AS e(value, i)
+                          ORDER BY e.i)) WITH ORDINALITY AS d(cur, prev, i)
+        WHERE d.cur IS NOT NULL;
+    END IF;
+
+    SELECT COALESCE(jsonb_object_agg(t.chunk_table, jsonb_build_object(
+               'items_per_sec', pgedge_vectorizer.counter_rate(
+                   (v_usage->t.chunk_table->>0)::BIGINT,
+                   (v_prev.counters->'usage'->t.chunk_table->>0)::BIGINT, v_secs),
+               'tokens_per_sec', pgedge_vectorizer.counter_rate(
+                   (v_usage->t.chunk_table->>1)::BIGINT,
+                   (v_prev.counters->'usage'->t.chunk_table->>1)::BIGINT, v_secs),
+               'retries_per_sec', pgedge_vectorizer.counter_rate(
+                   (v_usage->t.chunk_table->>3)::BIGINT,
+                   (v_prev.counters->'usage'->t.chunk_table->>3)::BIGINT, v_secs),
+               'pending', COALESCE(q.pending, 0),
+               'processing', COALESCE(q.processing, 0),
+               'failed', COALESCE(q.failed, 0))), '{}')
+    INTO v_tables
+    FROM (SELECT qs.chunk_table FROM pgedge_vectorizer.queue_stats() qs
+          UNION
+          SELECT jsonb_object_keys(v_usage)) t
+    LEFT JOIN (SELECT qs.chunk_table,
+                      sum(qs.count) FILTER (WHERE qs.status = 'pending') AS pending,
+                      sum(qs.count) FILTER (WHERE qs.status = 'processing') AS processing,
+                      sum(qs.count) FILTER (WHERE qs.status = 'failed') AS failed
+               FROM pgedge_vectorizer.queue_stats() qs
+               GROUP BY qs.chunk_table) q ON q.chunk_table = t.chunk_table;
+
+    INSERT INTO pgedge_vectorizer.throughput_history
+        (slot, captured_at, interval_secs, items_per_sec, tokens_per_sec,
+         requests_per_sec, retries_per_sec, failure_rate,
+         latency_p50_ms, latency_p90_ms, latency_p99_ms,
+         pending, processing, failed, hot_queued, tables, counters)
+    SELECT COALESCE((v_prev.slot + 1) % v_size, 0),
+           v_now,
+           v_secs,
+           CASE WHEN v_secs IS NOT NULL THEN COALESCE(sum((r.value->>'items_per_sec')::FLOAT8), 0) END,
+           CASE WHEN v_secs IS NOT NULL THEN COALESCE(sum((r.value->>'tokens_per_sec')::FLOAT8), 0) END,
+           pgedge_vectorizer.counter_rate(v_provider[1], (v_prev.counters->'provider'->>0)::BIGINT, v_secs),
+           CASE WHEN v_secs IS NOT NULL THEN COALESCE(sum((r.value->>'retries_per_sec')::FLOAT8), 0) END,
+           pgedge_vectorizer.counter_rate(v_provider[2], (v_prev.counters->'provider'->>1)::BIGINT, v_secs)
+               / NULLIF(pgedge_vectorizer.counter_rate(v_provider[1], (v_prev.counters->'provider'->>0)::BIGINT, v_secs), 0),
+           pgedge_vectorizer.histogram_percentile(v_bounds, v_delta, 0.50),
+           pgedge_vectorizer.histogram_percentile(v_bounds, v_delta, 0.90),
+           pgedge_vectorizer.histogram_percentile(v_bounds, v_delta, 0.99),
+           COALESCE(sum((r.value->>'pending')::BIGINT), 0),
+           COALESCE(sum((r.value->>'processing')::BIGINT), 0),
+           COALESCE(sum((r.value->>'failed')::BIGINT), 0),
+           (SELECT hq.queued FROM pgedge_vectorizer.hot_queue_status() hq),
+           v_tables,
+           jsonb_build_object('usage', v_usage,
+                              'provider', to_jsonb(v_provider),
+                              'latency', COALESCE(to_jsonb(v_latency), '[]'::JSONB))
+    FROM jsonb_each(v_tables) r
+    ON CONFLICT (slot) DO UPDATE SET
+        captured_at = EXCLUDED.captured_at,
+        interval_secs = EXCLUDED.interval_secs,
+        items_per_sec = EXCLUDED.items_per_sec,
+        tokens_per_sec = EXCLUDED.tokens_per_sec,
+        requests_per_sec = EXCLUDED.requests_per_sec,
+        retries_per_sec = EXCLUDED.retries_per_sec,
+        failure_rate = EXCLUDED.failure_rate,
+        latency_p50_ms = EXCLUDED.latency_p50_ms,
+        latency_p90_ms = EXCLUDED.latency_p90_ms,
+        latency_p99_ms = EXCLUDED.latency_p99_ms,
+        pending = EXCLUDED.pending,
+        processing = EXCLUDED.processing,
+        failed = EXCLUDED.failed,
+        hot_queued = EXCLUDED.hot_queued,
+        tables = EXCLUDED.tables,
+        counters = EXCLUDED.counters;
+
+    -- Slots left over from a larger history_size
+    DELETE FROM pgedge_vectorizer.throughput_history WHERE slot >= v_size;
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.capture_throughput IS
+'Add a snapshot to throughput_history, overwriting the oldest once history_size snapshots are kept';
+
 -- Embedding generation function
 CREATE FUNCTION pgedge_vectorizer.generate_embedding(
     query_text TEXT
@@ -84,9 +720,30 @@ CREATE FUNCTION pgedge_vectorizer.generate_embedding(
 AS 'MODULE_PATHNAME', 'pgedge_vectorizer_generate_embedding'
 LANGUAGE C STABLE STRICT;
 
-COMMENT ON FUNCTION pgedge_vectorizer.generate_embedding IS
+COMMENT ON FUNCTION pgedge_vectorizer.generate_embedding(TEXT) IS
 'Generate an embedding vector from query text using the configured provider';
 
+-- Embedding generation with a given model
+-- Queries against a chunk table migrated to another model must be embedded
+-- with that model; the configured one is restored afterwards.
+CREATE FUNCTION pgedge_vectorizer.generate_embedding(
+    query_text TEXT,
+    model TEXT
+) RETURNS vector AS $$
+DECLARE
+    configured TEXT := current_setting('pgedge_vectorizer.model');
+    result vector;
+BEGIN
+    PERFORM set_config('pgedge_vectorizer.model', model, true);
+    result := pgedge_vectorizer.generate_embedding(query_text);
+    PERFORM set_config('pgedge_vectorizer.model', configured, true);
+    RETURN result;
+END;
+$$ LANGUAGE plpgsql STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.generate_embedding(TEXT, TEXT) IS
+'Generate an embedding vector from query text using the given model of the configured provider';
+
 -- Embedding dimension detection function
 CREATE FUNCTION pgedge_vectorizer.detect_embedding_dimension()
 RETURNS INT
@@ -129,6 +786,41 @@ LANGUAGE C STRICT;
 COMMENT ON FUNCTION pgedge_vectorizer.bm25_tokenize IS
 'Tokenize text and return the non-stopword terms (useful for testing)';
 
+-- Micro-benchmark for a single chunking, tokenizing or parsing kernel
+CREATE FUNCTION pgedge_vectorizer.bench_kernel(
+    kernel TEXT,
+    iterations INT DEFAULT 100,
+    corpus TEXT DEFAULT NULL,
+    corpus_kind TEXT DEFAULT NULL,
+    corpus_bytes INT DEFAULT 65536,
+    chunk_size INT DEFAULT NULL,
+    chunk_overlap INT DEFAULT NULL,
+    OUT scan_impl TEXT,
+    OUT input_bytes BIGINT,
+    OUT total_ms FLOAT8,
+    OUT mb_per_sec FLOAT8,
+    OUT items_per_iteration BIGINT,
+    OUT items_per_sec FLOAT8,
+    OUT retained_context_bytes BIGINT,
+    OUT peak_context_bytes BIGINT
+)
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_bench_kernel'
+LANGUAGE C VOLATILE;
+
+COMMENT ON FUNCTION pgedge_vectorizer.bench_kernel IS
+'Run a chunking, tokenizing or provider parsing kernel repeatedly and report throughput and memory usage';
+
+-- Deterministic synthetic corpus used by the benchmarks
+CREATE FUNCTION pgedge_vectorizer.bench_corpus(
+    corpus_kind TEXT,
+    corpus_bytes INT DEFAULT 65536
+) RETURNS TEXT
+AS 'MODULE_PATHNAME', 'pgedge_vectorizer_bench_corpus'
+LANGUAGE C IMMUTABLE STRICT;
+
+COMMENT ON FUNCTION pgedge_vectorizer.bench_corpus IS
+'Generate the deterministic synthetic corpus (prose, markdown, code, cjk, openai_json, ollama_json) used by bench_kernel()';
+
 ---------------------------------------------------------------------------
 -- SQL Functions
 ---------------------------------------------------------------------------
@@ -142,7 +834,11 @@ CREATE FUNCTION pgedge_vectorizer.enable_vectorization(
     chunk_overlap INT DEFAULT NULL,
     embedding_dimension INT DEFAULT NULL,
     chunk_table_name TEXT DEFAULT NULL,
-    source_pk NAME DEFAULT NULL
+    source_pk NAME DEFAULT NULL,
+    chunk_storage TEXT DEFAULT 'content',
+    defer_indexes BOOLEAN DEFAULT FALSE,
+    embedding_storage TEXT DEFAULT 'inline',
+    partitions INT DEFAULT NULL
 ) RETURNS VOID AS $$
 DECLARE
     chunk_table TEXT;
@@ -152,7 +848,34 @@ DECLARE
     actual_chunk_overlap INT;
     pk_col_type TEXT;
     pk_count INT;
+    offset_cols TEXT;
+    offset_vals TEXT;
+    offset_set TEXT;
+    embedding_table TEXT;
+    vector_table TEXT;
+    has_inline BOOLEAN;
+    table_existed BOOLEAN := FALSE;
 BEGIN
+    IF chunk_storage IS NULL OR chunk_storage NOT IN ('content', 'offsets') THEN
+        RAISE EXCEPTION 'Invalid chunk_storage "%"', chunk_storage
+            USING HINT = 'Use ''content'' to store chunk text or ''offsets'' to store offsets into the source column.';
+    END IF;
+
+    IF embedding_storage IS NULL OR embedding_storage NOT IN ('inline', 'table') THEN
+        RAISE EXCEPTION 'Invalid embedding_storage "%"', embedding_storage
+            USING HINT = 'Use ''inline'' to store embeddings in the chunk table or ''table'' to store them in a separate table.';
+    END IF;
+
+    IF partitions IS NOT NULL AND partitions < 2 THEN
+        RAISE EXCEPTION 'Invalid partitions %', partitions
+            USING HINT = 'Use NULL for a single chunk table or at least 2 hash partitions.';
+    END IF;
+
+    IF partitions IS NOT NULL AND embedding_storage = 'table' THEN
+        RAISE EXCEPTION 'Partitioned chunk tables cannot use embedding_storage ''table'''
+            USING HINT = 'The embeddings table references chunk ids, which are not unique on their own in a table partitioned by source_id.';
+    END IF;
+
     -- Use defaults from GUC if not provided
     actual_strategy := COALESCE(chunk_strategy,
         current_setting('pgedge_vectorizer.default_chunk_strategy'));
@@ -218,36 +941,150 @@ BEGIN
     chunk_table := COALESCE(chunk_table_name,
                             source_table::TEXT || '_' || source_column || '_chunks');
 
+    -- vector_table is the table that holds the embedding columns
+    IF embedding_storage = 'table' THEN
+        embedding_table := chunk_table || '_embeddings';
+        vector_table := embedding_table;
+    ELSE
+        vector_table := chunk_table;
+    END IF;
+
+    -- An existing chunk table keeps the layout it was created with
+    IF to_regclass(quote_ident(chunk_table)) IS NOT NULL THEN
+        table_existed := TRUE;
+
+        SELECT EXISTS (
+            SELECT 1 FROM pg_attribute a
+            WHERE a.attrelid = to_regclass(quote_ident(chunk_table))
+              AND a.attname = 'embedding'
+              AND NOT a.attisdropped)
+        INTO has_inline;
+
+        IF has_inline <> (embedding_storage = 'inline') THEN
+            RAISE EXCEPTION 'Chunk table % already exists with % embedding storage',
+                chunk_table, CASE WHEN has_inline THEN 'inline' ELSE 'table' END
+                USING HINT = 'Drop the chunk table with disable_vectorization() or pass the embedding_storage it was created with.';
+        END IF;
+
+        IF (SELECT c.relkind = 'p' FROM pg_class c
+            WHERE c.oid = to_regclass(quote_ident(chunk_table))) <> (partitions IS NOT NULL)
+        THEN
+            RAISE EXCEPTION 'Chunk table % already exists and is %partitioned',
+                chunk_table, CASE WHEN partitions IS NULL THEN '' ELSE 'not ' END
+                USING HINT = 'Drop the chunk table with disable_vectorization() or pass the partitions it was created with.';
+        END IF;
+    END IF;
+
+    -- A direct vectorizer on the column uses the same trigger name
+    DECLARE
+        has_direct BOOLEAN;
+    BEGIN
+        EXECUTE
+            'SELECT EXISTS (SELECT 1 FROM pgedge_vectorizer.vectorizers
+                             WHERE source_table = $1 AND source_column = $2
+                               AND embedding_column IS NOT NULL)'
+        INTO has_direct
+        USING source_table::TEXT, source_column;
+
+        IF has_direct THEN
+            RAISE EXCEPTION 'Column % of % already has a direct vectorizer', source_column, source_table
+                USING HINT = 'Disable it with disable_vectorization() first.';
+        END IF;
+    END;
+
     -- Create chunks table
     -- Note: pk_col_type uses %s (not %I) because format_type() returns
     -- canonical SQL type names (e.g. "character varying(26)") that would
     -- be incorrectly double-quoted by %I. This value is system-controlled.
+    -- A partitioned table's primary key must include the partition key.
     EXECUTE format('
         CREATE TABLE IF NOT EXISTS %I (
-            id BIGSERIAL PRIMARY KEY,
+            id BIGSERIAL%s,
             source_id %s NOT NULL,
             chunk_index INT NOT NULL,
             content TEXT NOT NULL,
-            token_count INT,
-            embedding vector(%s),
-            sparse_embedding sparsevec(65536),
+            token_count INT,%s
             created_at TIMESTAMPTZ DEFAULT NOW(),
             updated_at TIMESTAMPTZ DEFAULT NOW(),
-            UNIQUE(source_id, chunk_index)
-        )', chunk_table, pk_col_type, embedding_dimension);
+            UNIQUE(source_id, chunk_index)%s
+        )%s', chunk_table,
+        CASE WHEN partitions IS NULL THEN ' PRIMARY KEY' END,
+        pk_col_type,
+        CASE WHEN embedding_table IS NULL THEN format('
+            embedding vector(%s),
+            sparse_embedding sparsevec(65536),', embedding_dimension)
+        END,
+        CASE WHEN partitions IS NOT NULL THEN ',
+            PRIMARY KEY (id, source_id)'
+        END,
+        CASE WHEN partitions IS NOT NULL THEN ' PARTITION BY HASH (source_id)' END);
+
+    -- Hash partitions by source_id.  The indexes created on the parent
+    -- below give every partition its own HNSW graphs, so index builds,
+    -- vacuum and searches each work on a fraction of the chunks.
+    IF partitions IS NOT NULL AND NOT table_existed THEN
+        FOR p IN 0 .. partitions - 1 LOOP
+            EXECUTE format('
+                CREATE TABLE %I PARTITION OF %I
+                FOR VALUES WITH (MODULUS %s, REMAINDER %s)',
+                chunk_table || '_p' || p, chunk_table, partitions, p);
+        END LOOP;
+    END IF;
 
     -- Add sparse columns to pre-existing chunk tables (upgrade path).
     -- These are no-ops for freshly created tables (columns exist already).
-    EXECUTE format('
-        ALTER TABLE %I
-        ADD COLUMN IF NOT EXISTS sparse_embedding sparsevec(65536)',
-        chunk_table);
+    IF embedding_table IS NULL THEN
+        EXECUTE format('
+            ALTER TABLE %I
+            ADD COLUMN IF NOT EXISTS sparse_embedding sparsevec(65536)',
+            chunk_table);
+    END IF;
 
-    -- Create vector index for similarity search
-    EXECUTE format('
-        CREATE INDEX IF NOT EXISTS %I ON %I
-        USING hnsw (embedding vector_cosine_ops)',
-        chunk_table || '_embedding_idx', chunk_table);
+    -- In offsets mode a chunk that occurs verbatim in the source stores
+    -- its byte range instead of a copy of its text.  Rows that keep their
+    -- text (content mode, or chunks rewritten by the chunker) are unchanged.
+    IF chunk_storage = 'offsets' THEN
+        EXECUTE format('
+            ALTER TABLE %I
+            ALTER COLUMN content DROP NOT NULL,
+            ADD COLUMN IF NOT EXISTS start_offset INT,
+            ADD COLUMN IF NOT EXISTS length INT',
+            chunk_table);
+        offset_cols := ', start_offset, length';
+        offset_vals := ', $5, $6';
+        offset_set := ', start_offset = EXCLUDED.start_offset, length = EXCLUDED.length';
+    END IF;
+
+    -- With embedding_storage => 'table' the vectors live in a narrow table
+    -- keyed by chunk id, so the worker writes them with a single INSERT
+    -- instead of creating new versions of the wide chunk row.  A view
+    -- presents the joined shape of an inline chunk table.
+    IF embedding_table IS NOT NULL THEN
+        EXECUTE format('
+            CREATE TABLE IF NOT EXISTS %I (
+                chunk_id BIGINT PRIMARY KEY REFERENCES %I (id) ON DELETE CASCADE,
+                embedding vector(%s),
+                sparse_embedding sparsevec(65536)
+            )', embedding_table, chunk_table, embedding_dimension);
+
+        EXECUTE format('
+            CREATE OR REPLACE VIEW %I AS
+            SELECT c.*, e.embedding, e.sparse_embedding
+            FROM %I c
+            LEFT JOIN %I e ON e.chunk_id = c.id',
+            chunk_table || '_view', chunk_table, embedding_table);
+    END IF;
+
+    -- Create vector index for similarity search.  With defer_indexes the
+    -- HNSW indexes are left out until the initial backfill has drained, so
+    -- every embedding update does not pay for an incremental graph insert;
+    -- build_deferred_indexes() then builds them in one (parallel) pass.
+    IF NOT COALESCE(defer_indexes, FALSE) THEN
+        EXECUTE format('
+            CREATE INDEX IF NOT EXISTS %I ON %I
+            USING hnsw (embedding vector_cosine_ops)',
+            chunk_table || '_embedding_idx', vector_table);
+    END IF;
 
     -- Create index on source_id for joins
     EXECUTE format('
@@ -255,11 +1092,13 @@ BEGIN
         chunk_table || '_source_id_idx', chunk_table);
 
     -- Create HNSW index on sparse_embedding for fast sparse search
-    EXECUTE format('
-        CREATE INDEX IF NOT EXISTS %I ON %I
-        USING hnsw (sparse_embedding sparsevec_ip_ops)
-        WHERE sparse_embedding IS NOT NULL',
-        chunk_table || '_sparse_idx', chunk_table);
+    IF NOT COALESCE(defer_indexes, FALSE) THEN
+        EXECUTE format('
+            CREATE INDEX IF NOT EXISTS %I ON %I
+            USING hnsw (sparse_embedding sparsevec_ip_ops)
+            WHERE sparse_embedding IS NOT NULL',
+            chunk_table || '_sparse_idx', vector_table);
+    END IF;
 
     -- Create BM25 IDF statistics table for this chunk table
     EXECUTE format('
@@ -275,34 +1114,60 @@ BEGIN
     -- Use EXECUTE...USING to avoid PL/pgSQL variable/column ambiguity.
     EXECUTE
         'INSERT INTO pgedge_vectorizer.vectorizers
-             (source_table, source_column, chunk_table)
-         VALUES ($1, $2, $3)
+             (source_table, source_column, chunk_table, source_pk, chunk_storage,
+              chunk_strategy, chunk_size, chunk_overlap,
+              indexes_deferred, embedding_table)
+         VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10)
          ON CONFLICT (source_table, source_column)
-         DO UPDATE SET chunk_table = EXCLUDED.chunk_table'
-    USING source_table::TEXT, source_column, chunk_table;
-
-    -- Create trigger to chunk and queue on insert/update
+         DO UPDATE SET chunk_table = EXCLUDED.chunk_table,
+                       source_pk = EXCLUDED.source_pk,
+                       chunk_storage = EXCLUDED.chunk_storage,
+                       chunk_strategy = EXCLUDED.chunk_strategy,
+                       chunk_size = EXCLUDED.chunk_size,
+                       chunk_overlap = EXCLUDED.chunk_overlap,
+                       indexes_deferred = EXCLUDED.indexes_deferred,
+                       embedding_table = EXCLUDED.embedding_table'
+    USING source_table::TEXT, source_column, chunk_table, source_pk, chunk_storage,
+          actual_strategy, actual_chunk_size, actual_chunk_overlap,
+          COALESCE(defer_indexes, FALSE), embedding_table;
+
+    -- Chunk and queue on insert/update.  The per-column trigger of earlier
+    -- versions gives way to the table's combined trigger.
     trigger_name := source_table::TEXT || '_' || source_column || '_vectorization_trigger';
 
-    EXECUTE format('
-        CREATE OR REPLACE TRIGGER %I
-        AFTER INSERT OR UPDATE ON %s
-        FOR EACH ROW
-        EXECUTE FUNCTION pgedge_vectorizer.vectorization_trigger(%L, %L, %L, %L, %L, %L, %L)',
-        trigger_name, source_table,
-        source_column, chunk_table, actual_strategy,
-        actual_chunk_size, actual_chunk_overlap, source_pk, pk_col_type);
+    IF EXISTS (SELECT 1 FROM pg_trigger t
+               WHERE t.tgrelid = source_table AND t.tgname = trigger_name) THEN
+        EXECUTE format('DROP TRIGGER %I ON %s', trigger_name, source_table);
+    END IF;
+
+    PERFORM pgedge_vectorizer.refresh_vectorization_trigger(source_table);
 
     RAISE NOTICE 'Vectorization enabled: % -> %', source_table, chunk_table;
     RAISE NOTICE 'Strategy: %, chunk_size: %, overlap: %',
         actual_strategy, actual_chunk_size, actual_chunk_overlap;
+    IF chunk_storage = 'offsets' THEN
+        RAISE NOTICE 'Chunk storage: offsets into %.%', source_table, source_column;
+    END IF;
+    IF embedding_table IS NOT NULL THEN
+        RAISE NOTICE 'Embedding storage: % (joined view %)',
+            embedding_table, chunk_table || '_view';
+    END IF;
+    IF partitions IS NOT NULL THEN
+        RAISE NOTICE 'Chunk table hash-partitioned by source_id into % partitions', partitions;
+    END IF;
+    IF defer_indexes THEN
+        RAISE NOTICE 'Vector indexes deferred until the queue for % drains', chunk_table;
+    END IF;
 
     -- Process existing rows
     DECLARE
         row_record RECORD;
         doc_content TEXT;
         chunks TEXT[];
+        starts INT[];
+        lens INT[];
         chunk_text TEXT;
+        stored_text TEXT;
         i INT;
         chunk_id BIGINT;
         needs_embedding BOOLEAN;
@@ -317,35 +1182,82 @@ BEGIN
             doc_content := row_record.content;
 
             -- Chunk the document
-            chunks := pgedge_vectorizer.chunk_text(doc_content, actual_strategy, actual_chunk_size, actual_chunk_overlap);
+            IF chunk_storage = 'offsets' THEN
+                SELECT o.chunks, o.start_offsets, o.lengths
+                INTO chunks, starts, lens
+                FROM pgedge_vectorizer.chunk_text_offsets(doc_content, actual_strategy, actual_chunk_size, actual_chunk_overlap) o;
+            ELSE
+                chunks := pgedge_vectorizer.chunk_text(doc_content, actual_strategy, actual_chunk_size, actual_chunk_overlap);
+            END IF;
 
             -- Insert chunks and queue for embedding
             FOR i IN 1..array_length(chunks, 1) LOOP
                 chunk_text := chunks[i];
-
-                -- Insert or update chunk (only clear embedding if content changed)
-                EXECUTE format('
-                    INSERT INTO %I (source_id, chunk_index, content, token_count)
-                    VALUES ($1, $2, $3, $4)
-                    ON CONFLICT (source_id, chunk_index)
-                    DO UPDATE SET content = EXCLUDED.content,
-                                  token_count = EXCLUDED.token_count,
-                                  embedding = CASE
-                                      WHEN %I.content = EXCLUDED.content THEN %I.embedding
-                                      ELSE NULL
-                                  END,
-                                  sparse_embedding = CASE
-                                      WHEN %I.content = EXCLUDED.content THEN %I.sparse_embedding
-                                      ELSE NULL
-                                  END,
-                                  updated_at = NOW()
-                    RETURNING id,
-                              (embedding IS NULL) AS needs_embedding,
-                              (sparse_embedding IS NULL) AS needs_sparse',
-                    chunk_table, chunk_table, chunk_table, chunk_table, chunk_table)
-                USING row_record.pk_val, i, chunk_text,
-                      length(chunk_text) / 4  -- Approximate token count
-                INTO chunk_id, needs_embedding, needs_sparse;
+                stored_text := CASE WHEN starts[i] IS NULL THEN chunk_text END;
+
+                IF embedding_table IS NULL THEN
+                    -- Insert or update chunk (only clear embedding if content changed).
+                    -- Chunks stored as offsets have no old text to compare with,
+                    -- so they are always re-embedded.
+                    EXECUTE format('
+                        INSERT INTO %I (source_id, chunk_index, content, token_count%s)
+                        VALUES ($1, $2, $3, $4%s)
+                        ON CONFLICT (source_id, chunk_index)
+                        DO UPDATE SET content = EXCLUDED.content,
+                                      token_count = EXCLUDED.token_count%s,
+                                      embedding = CASE
+                                          WHEN %I.content = EXCLUDED.content THEN %I.embedding
+                                          ELSE NULL
+                                      END,
+                                      sparse_embedding = CASE
+                                          WHEN %I.content = EXCLUDED.content THEN %I.sparse_embedding
+                                          ELSE NULL
+                                      END,
+                                      updated_at = NOW()
+                        RETURNING id,
+                                  (embedding IS NULL) AS needs_embedding,
+                                  (sparse_embedding IS NULL) AS needs_sparse',
+                        chunk_table, offset_cols, offset_vals, offset_set,
+                        chunk_table, chunk_table, chunk_table, chunk_table)
+                    USING row_record.pk_val, i, stored_text,
+                          length(chunk_text) / 4,  -- Approximate token count
+                          starts[i], lens[i]
+                    INTO chunk_id, needs_embedding, needs_sparse;
+                ELSE
+                    -- A row only comes back when it was inserted or its text
+                    -- changed; any embeddings of the old text are dropped.
+                    EXECUTE format('
+                        INSERT INTO %I AS c (source_id, chunk_index, content, token_count%s)
+                        VALUES ($1, $2, $3, $4%s)
+                        ON CONFLICT (source_id, chunk_index)
+                        DO UPDATE SET content = EXCLUDED.content,
+                                      token_count = EXCLUDED.token_count%s,
+                                      updated_at = NOW()
+                        WHERE c.content IS NULL
+                           OR c.content IS DISTINCT FROM EXCLUDED.content
+                        RETURNING id',
+                        chunk_table, offset_cols, offset_vals, offset_set)
+                    USING row_record.pk_val, i, stored_text,
+                          length(chunk_text) / 4,  -- Approximate token count
+                          starts[i], lens[i]
+                    INTO chunk_id;
+
+                    IF chunk_id IS NOT NULL THEN
+                        EXECUTE format('DELETE FROM %I WHERE chunk_id = $1', embedding_table)
+                        USING chunk_id;
+                        needs_embedding := TRUE;
+                        needs_sparse := TRUE;
+                    ELSE
+                        EXECUTE format('
+                            SELECT c.id, e.embedding IS NULL, e.sparse_embedding IS NULL
+                            FROM %I c
+                            LEFT JOIN %I e ON e.chunk_id = c.id
+                            WHERE c.source_id = $1 AND c.chunk_index = $2',
+                            chunk_table, embedding_table)
+                        USING row_record.pk_val, i
+                        INTO chunk_id, needs_embedding, needs_sparse;
+                    END IF;
+                END IF;
 
                 -- Queue if dense or sparse work is needed.
                 IF needs_embedding OR needs_sparse THEN
@@ -353,7 +1265,7 @@ BEGIN
                     VALUES (
                         chunk_id,
                         chunk_table,
-                        chunk_text,
+                        stored_text,
                         CASE
                             WHEN NOT needs_embedding AND needs_sparse
                                 THEN jsonb_build_object('sparse_only', true)
@@ -394,6 +1306,138 @@ $$ LANGUAGE plpgsql;
 COMMENT ON FUNCTION pgedge_vectorizer.enable_vectorization IS
 'Enable automatic chunking and vectorization for a table column';
 
+-- Enable direct vectorization for a short text column
+-- Short texts (titles, tags, subjects) always make exactly one chunk, so
+-- instead of a chunk table each row gets one embedding, stored in a vector
+-- column added to the source table.  There is no chunking and no join at
+-- query time.  Queue items refer to the rows by primary key under the
+-- name <table>_<column>_embedding, which the registry records as the
+-- vectorizer's chunk_table.
+CREATE FUNCTION pgedge_vectorizer.enable_direct_vectorization(
+    source_table REGCLASS,
+    source_column NAME,
+    embedding_dimension INT DEFAULT NULL,
+    source_pk NAME DEFAULT NULL
+) RETURNS VOID AS $$
+DECLARE
+    pk_count INT;
+    pk_col_type TEXT;
+    embedding_column NAME;
+    queue_key TEXT;
+    trigger_name TEXT;
+    has_chunks BOOLEAN;
+BEGIN
+    IF NOT EXISTS (
+        SELECT 1 FROM pg_attribute a
+        WHERE a.attrelid = source_table
+          AND a.attname = source_column
+          AND NOT a.attisdropped)
+    THEN
+        RAISE EXCEPTION 'Column "%" does not exist on table %',
+            source_column, source_table;
+    END IF;
+
+    -- A chunked vectorizer on the column uses the same trigger name
+    EXECUTE
+        'SELECT EXISTS (SELECT 1 FROM pgedge_vectorizer.vectorizers
+                         WHERE source_table = $1 AND source_column = $2
+                           AND embedding_column IS NULL)'
+    INTO has_chunks
+    USING source_table::TEXT, source_column;
+
+    IF has_chunks THEN
+        RAISE EXCEPTION 'Column % of % already has a chunked vectorizer', source_column, source_table
+            USING HINT = 'Disable it with disable_vectorization() first.';
+    END IF;
+
+    -- Auto-detect the PK column if source_pk not specified
+    IF source_pk IS NULL THEN
+        SELECT count(*), min(a.attname)
+        INTO pk_count, source_pk
+        FROM pg_index i
+        JOIN pg_attribute a ON a.attrelid = i.indrelid
+          AND a.attnum = ANY(i.indkey)
+        WHERE i.indrelid = source_table
+          AND i.indisprimary;
+
+        IF pk_count <> 1 THEN
+            RAISE EXCEPTION 'Table % has no single-column primary key. Use the source_pk parameter to specify the column to use as row identifier.',
+                source_table;
+        END IF;
+    END IF;
+
+    SELECT format_type(a.atttypid, a.atttypmod)
+    INTO pk_col_type
+    FROM pg_attribute a
+    WHERE a.attrelid = source_table
+      AND a.attname = source_pk
+      AND NOT a.attisdropped;
+
+    IF pk_col_type IS NULL THEN
+        RAISE EXCEPTION 'Column "%" does not exist on table %',
+            source_pk, source_table;
+    END IF;
+
+    -- Queue items carry the row identifier in their BIGINT chunk_id
+    IF pk_col_type NOT IN ('smallint', 'integer', 'bigint') THEN
+        RAISE EXCEPTION 'Direct vectorization needs an integer row identifier, but % is %',
+            source_pk, pk_col_type
+            USING HINT = 'Use enable_vectorization() for tables keyed by other types.';
+    END IF;
+
+    RAISE NOTICE 'Using primary key column: % (%)', source_pk, pk_col_type;
+
+    -- Auto-detect embedding dimension from configured model if not specified
+    IF embedding_dimension IS NULL THEN
+        embedding_dimension := pgedge_vectorizer.detect_embedding_dimension();
+        RAISE NOTICE 'Auto-detected embedding dimension: %', embedding_dimension;
+    END IF;
+
+    embedding_column := source_column || '_embedding';
+    queue_key := source_table::TEXT || '_' || source_column || '_embedding';
+
+    -- source_table is a regclass and already quoted (%s)
+    EXECUTE format('ALTER TABLE %s ADD COLUMN IF NOT EXISTS %I vector(%s)',
+        source_table, embedding_column, embedding_dimension);
+
+    EXECUTE format('
+        CREATE INDEX IF NOT EXISTS %I ON %s
+        USING hnsw (%I vector_cosine_ops)',
+        queue_key || '_idx', source_table, embedding_column);
+
+    -- Register in vectorizers table.
+    -- Use EXECUTE...USING to avoid PL/pgSQL variable/column ambiguity.
+    EXECUTE
+        'INSERT INTO pgedge_vectorizer.vectorizers
+             (source_table, source_column, chunk_table, source_pk, embedding_column)
+         VALUES ($1, $2, $3, $4, $5)
+         ON CONFLICT (source_table, source_column)
+         DO UPDATE SET chunk_table = EXCLUDED.chunk_table,
+                       source_pk = EXCLUDED.source_pk,
+                       embedding_column = EXCLUDED.embedding_column'
+    USING source_table::TEXT, source_column, queue_key, source_pk, embedding_column;
+
+    -- Queue rows whose text changes; the trigger only watches source_column
+    trigger_name := source_table::TEXT || '_' || source_column || '_vectorization_trigger';
+
+    EXECUTE format('
+        CREATE OR REPLACE TRIGGER %I
+        BEFORE INSERT OR UPDATE OF %I ON %s
+        FOR EACH ROW
+        EXECUTE FUNCTION pgedge_vectorizer.direct_vectorization_trigger(%L, %L, %L, %L)',
+        trigger_name, source_column, source_table,
+        source_column, embedding_column, queue_key, source_pk);
+
+    RAISE NOTICE 'Direct vectorization enabled: %.% -> %', source_table, source_column, embedding_column;
+
+    -- Queue existing rows without an embedding
+    PERFORM pgedge_vectorizer.reprocess_chunks(queue_key);
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.enable_direct_vectorization IS
+'Enable vectorization of a short text column into one embedding per row, stored on the source table';
+
 -- Disable vectorization for a table column
 CREATE FUNCTION pgedge_vectorizer.disable_vectorization(
     source_table REGCLASS,
@@ -403,8 +1447,13 @@ CREATE FUNCTION pgedge_vectorizer.disable_vectorization(
 DECLARE
     trigger_name TEXT;
     chunk_table TEXT;
+    embedding_table TEXT;
+    embedding_column NAME;
     trigger_rec RECORD;
     chunk_tables_to_drop TEXT[];
+    embedding_tables_to_drop TEXT[];
+    direct_keys TEXT[];
+    embedding_columns_to_drop TEXT[];
     ct TEXT;
 BEGIN
     -- If column specified, drop that specific trigger
@@ -417,21 +1466,30 @@ BEGIN
         -- Use EXECUTE...USING to avoid variable/column name ambiguity for
         -- source_table and source_column (same pattern as the DELETE below).
         EXECUTE
-            'SELECT v.chunk_table FROM pgedge_vectorizer.vectorizers v
+            'SELECT v.chunk_table, v.embedding_table, v.embedding_column
+               FROM pgedge_vectorizer.vectorizers v
               WHERE v.source_table = $1 AND v.source_column = $2'
-        INTO chunk_table
+        INTO chunk_table, embedding_table, embedding_column
         USING source_table::TEXT, source_column;
 
         IF chunk_table IS NULL THEN
             chunk_table := source_table::TEXT || '_' || source_column || '_chunks';
         END IF;
 
-        -- Drop trigger
-        EXECUTE format('DROP TRIGGER IF EXISTS %I ON %s', trigger_name, source_table);
+        -- Drop the column's own trigger: a direct vectorizer's, or the
+        -- per-column trigger of earlier versions
+        IF EXISTS (SELECT 1 FROM pg_trigger t
+                   WHERE t.tgrelid = source_table AND t.tgname = trigger_name) THEN
+            EXECUTE format('DROP TRIGGER %I ON %s', trigger_name, source_table);
+        END IF;
 
         -- Remove orphaned queue items for this chunk table
         EXECUTE format('DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = %L AND status IN (''pending'', ''processing'')', chunk_table);
 
+        -- Stop re-embedding the chunk table for a model migration
+        EXECUTE 'DELETE FROM pgedge_vectorizer.model_migrations WHERE chunk_table = $1'
+        USING chunk_table;
+
         -- Remove from vectorizers registry.
         -- Use EXECUTE...USING to avoid PL/pgSQL variable/column
         -- name ambiguity for source_table and source_column.
@@ -440,10 +1498,28 @@ BEGIN
               WHERE source_table = $1 AND source_column = $2'
         USING source_table::TEXT, source_column;
 
+        -- Take the column out of the table's combined trigger
+        PERFORM pgedge_vectorizer.refresh_vectorization_trigger(source_table);
+
+        -- A direct vectorizer has no chunk table; optionally drop its
+        -- embedding column (and with it the vector index)
+        IF embedding_column IS NOT NULL THEN
+            IF drop_chunk_table THEN
+                EXECUTE format('ALTER TABLE %s DROP COLUMN IF EXISTS %I',
+                               source_table, embedding_column);
+                RAISE NOTICE 'Vectorization disabled and embedding column dropped: %.%',
+                    source_table, embedding_column;
+            ELSE
+                RAISE NOTICE 'Vectorization disabled (embedding column preserved): %.%',
+                    source_table, embedding_column;
+            END IF;
         -- Optionally drop chunk table and IDF stats table
-        IF drop_chunk_table THEN
+        ELSIF drop_chunk_table THEN
             EXECUTE format('DROP TABLE IF EXISTS %I CASCADE',
                            chunk_table || '_idf_stats');
+            IF embedding_table IS NOT NULL THEN
+                EXECUTE format('DROP TABLE IF EXISTS %I CASCADE', embedding_table);
+            END IF;
             EXECUTE format('DROP TABLE IF EXISTS %I CASCADE', chunk_table);
             RAISE NOTICE 'Vectorization disabled and chunk table dropped: %', chunk_table;
         ELSE
@@ -470,15 +1546,47 @@ BEGIN
                 SELECT v.chunk_table
                 FROM pgedge_vectorizer.vectorizers v
                 WHERE v.source_table = $1
+                  AND v.embedding_column IS NULL
             )'
         INTO chunk_tables_to_drop
         USING source_table::TEXT;
 
+        EXECUTE
+            'SELECT ARRAY(
+                SELECT v.chunk_table
+                FROM pgedge_vectorizer.vectorizers v
+                WHERE v.source_table = $1
+                  AND v.embedding_column IS NOT NULL
+                ORDER BY v.id
+            ), ARRAY(
+                SELECT v.embedding_column
+                FROM pgedge_vectorizer.vectorizers v
+                WHERE v.source_table = $1
+                  AND v.embedding_column IS NOT NULL
+                ORDER BY v.id
+            )'
+        INTO direct_keys, embedding_columns_to_drop
+        USING source_table::TEXT;
+
+        EXECUTE
+            'SELECT ARRAY(
+                SELECT v.embedding_table
+                FROM pgedge_vectorizer.vectorizers v
+                WHERE v.source_table = $1
+                  AND v.embedding_table IS NOT NULL
+            )'
+        INTO embedding_tables_to_drop
+        USING source_table::TEXT;
+
         -- Remove orphaned queue items for exact chunk tables from registry.
         DELETE FROM pgedge_vectorizer.queue q
-        WHERE q.chunk_table = ANY(COALESCE(chunk_tables_to_drop, '{}'))
+        WHERE q.chunk_table = ANY(COALESCE(chunk_tables_to_drop, '{}') ||
+                                  COALESCE(direct_keys, '{}'))
         AND q.status IN ('pending', 'processing');
 
+        DELETE FROM pgedge_vectorizer.model_migrations m
+        WHERE m.chunk_table = ANY(COALESCE(chunk_tables_to_drop, '{}'));
+
         -- Remove all vectorizer registry entries for this source table
         EXECUTE
             'DELETE FROM pgedge_vectorizer.vectorizers WHERE source_table = $1'
@@ -486,11 +1594,19 @@ BEGIN
 
         -- Optionally drop all chunk tables and their IDF stats tables
         IF drop_chunk_table THEN
+            FOREACH ct IN ARRAY COALESCE(embedding_tables_to_drop, '{}') LOOP
+                EXECUTE format('DROP TABLE IF EXISTS %I CASCADE', ct);
+            END LOOP;
             FOREACH ct IN ARRAY COALESCE(chunk_tables_to_drop, '{}') LOOP
                 EXECUTE format('DROP TABLE IF EXISTS %I CASCADE', ct || '_idf_stats');
                 EXECUTE format('DROP TABLE IF EXISTS %I CASCADE', ct);
                 RAISE NOTICE 'Vectorization disabled and chunk table dropped: %', ct;
             END LOOP;
+            FOREACH ct IN ARRAY COALESCE(embedding_columns_to_drop, '{}') LOOP
+                EXECUTE format('ALTER TABLE %s DROP COLUMN IF EXISTS %I', source_table, ct);
+                RAISE NOTICE 'Vectorization disabled and embedding column dropped: %.%',
+                    source_table, ct;
+            END LOOP;
         END IF;
     END IF;
 END;
@@ -546,9 +1662,20 @@ COMMENT ON FUNCTION pgedge_vectorizer.bm25_decrement_idf_stats IS
 'Decrement doc_freq in the _idf_stats table for a set of terms before their source chunks are deleted';
 
 -- Trigger function for vectorization
+-- One trigger per source table handles all of its vectorized columns.  The
+-- trigger arguments hold eight settings per column (see
+-- refresh_vectorization_trigger()); the row is read once for all columns,
+-- unchanged columns are skipped, and the chunks of every column are queued
+-- with a single INSERT.
 CREATE FUNCTION pgedge_vectorizer.vectorization_trigger()
 RETURNS TRIGGER AS $$
 DECLARE
+    -- Per-column triggers of earlier versions may have fewer arguments
+    ncols INT := (TG_NARGS + 7) / 8;
+    col INT;
+    read_sql TEXT := '';
+    new_vals TEXT[];
+    old_vals TEXT[];
     content_col TEXT;
     chunk_table TEXT;
     strategy TEXT;
@@ -556,128 +1683,772 @@ DECLARE
     overlap INT;
     pk_col TEXT;
     pk_type TEXT;
+    storage TEXT;
+    raw_content TEXT;
     doc_content TEXT;
+    old_content TEXT;
     chunks TEXT[];
+    starts INT[];
+    lens INT[];
     chunk_text TEXT;
+    stored_text TEXT;
     i INT;
     chunk_id BIGINT;
     source_id_val TEXT;
+    notify_id TEXT;
     deleted_chunks_count INT := 0;
+    queue_chunk_ids BIGINT[] := '{}';
+    queue_chunk_tables TEXT[] := '{}';
+    queue_contents TEXT[] := '{}';
+    traced BOOLEAN;
+    hot BOOLEAN;
+    chunked_at TIMESTAMPTZ;
 BEGIN
-    -- Extract trigger arguments
-    content_col := TG_ARGV[0];
-    chunk_table := TG_ARGV[1];
-    strategy := TG_ARGV[2];
-    chunk_sz := TG_ARGV[3]::INT;
-    overlap := TG_ARGV[4]::INT;
-    pk_col := COALESCE(TG_ARGV[5], 'id');
-    pk_type := COALESCE(TG_ARGV[6], 'bigint');
-
-    -- Get source document ID
-    EXECUTE format('SELECT ($1).%I', pk_col) USING NEW INTO source_id_val;
-
-    -- Get document content
-    EXECUTE format('SELECT $1.%I', content_col) USING NEW INTO doc_content;
-
-    -- Trim whitespace for empty check
-    IF doc_content IS NOT NULL THEN
-        doc_content := trim(doc_content);
-    END IF;
+    -- Trace a sample of the documents (pgedge_vectorizer.trace_sample_rate)
+    traced := pgedge_vectorizer.trace_sampled(TG_RELID);
+
+    -- Read the content and source document ID of every column with one
+    -- statement per row version
+    FOR col IN 0 .. ncols - 1 LOOP
+        read_sql := read_sql || format('%s($1).%I::TEXT, ($1).%I::TEXT',
+            CASE WHEN col > 0 THEN ', ' ELSE '' END,
+            TG_ARGV[col * 8], COALESCE(TG_ARGV[col * 8 + 5], 'id'));
+    END LOOP;
+    read_sql := 'SELECT ARRAY[' || read_sql || ']';
 
-    -- Skip if content unchanged (on UPDATE)
+    EXECUTE read_sql USING NEW INTO new_vals;
     IF TG_OP = 'UPDATE' THEN
-        DECLARE
-            old_content TEXT;
-        BEGIN
-            EXECUTE format('SELECT $1.%I', content_col) USING OLD INTO old_content;
-            IF old_content IS NOT NULL THEN
-                old_content := trim(old_content);
-            END IF;
-            IF doc_content = old_content OR (doc_content IS NULL AND old_content IS NULL) THEN
-                RETURN NEW;
-            END IF;
-        END;
+        EXECUTE read_sql USING OLD INTO old_vals;
     END IF;
 
-    -- On UPDATE, decrement IDF stats for the old document's terms before
-    -- deleting the old chunks.  This prevents doc_freq from drifting upward
-    -- when the worker later re-increments stats for the new chunks.
-    IF TG_OP = 'UPDATE' THEN
-        DECLARE
-            old_terms TEXT[];
-            old_content_for_idf TEXT;
-        BEGIN
-            EXECUTE format('SELECT $1.%I', content_col) USING OLD INTO old_content_for_idf;
-            IF old_content_for_idf IS NOT NULL THEN
-                old_content_for_idf := trim(old_content_for_idf);
+    FOR col IN 0 .. ncols - 1 LOOP
+        -- Extract this column's trigger arguments
+        content_col := TG_ARGV[col * 8];
+        chunk_table := TG_ARGV[col * 8 + 1];
+        strategy := TG_ARGV[col * 8 + 2];
+        chunk_sz := TG_ARGV[col * 8 + 3]::INT;
+        overlap := TG_ARGV[col * 8 + 4]::INT;
+        pk_col := COALESCE(TG_ARGV[col * 8 + 5], 'id');
+        pk_type := COALESCE(TG_ARGV[col * 8 + 6], 'bigint');
+        storage := COALESCE(TG_ARGV[col * 8 + 7], 'content');
+
+        raw_content := new_vals[col * 2 + 1];
+        source_id_val := new_vals[col * 2 + 2];
+
+        -- Trim whitespace for empty check
+        doc_content := trim(raw_content);
+
+        -- Skip if content unchanged (on UPDATE)
+        IF TG_OP = 'UPDATE' THEN
+            old_content := trim(old_vals[col * 2 + 1]);
+            IF doc_content IS NOT DISTINCT FROM old_content THEN
+                CONTINUE;
+            END IF;
+        END IF;
+
+        -- On UPDATE, decrement IDF stats for the old document's terms before
+        -- deleting the old chunks.  This prevents doc_freq from drifting upward
+        -- when the worker later re-increments stats for the new chunks.
+        IF TG_OP = 'UPDATE' AND old_content IS NOT NULL AND old_content <> '' THEN
+            EXECUTE format(
+                'SELECT count(*)::int FROM %I WHERE source_id = $1::%s',
+                chunk_table, pk_type
+            )
+            INTO deleted_chunks_count
+            USING source_id_val;
+
+            PERFORM pgedge_vectorizer.bm25_decrement_idf_stats(
+                chunk_table, pgedge_vectorizer.bm25_tokenize(old_content),
+                deleted_chunks_count);
+        END IF;
+
+        -- Delete queue entries for this document's chunks before deleting the chunks.
+        -- Prevents orphaned queue entries that waste embedding API calls on deleted chunks.
+        -- Only targets 'pending'/'failed'; 'processing' items are left for the
+        -- worker to handle gracefully via its SPI_processed == 0 check.
+        EXECUTE format(
+            'DELETE FROM pgedge_vectorizer.queue
+             WHERE chunk_table = %L
+               AND chunk_id IN (SELECT id FROM %I WHERE source_id = $1::%s)
+               AND status IN (''pending'', ''failed'')',
+            chunk_table, chunk_table, pk_type)
+            USING source_id_val;
+
+        -- Delete existing chunks for this document
+        -- pk_type uses %s: value from format_type() is system-controlled (see enable_vectorization)
+        EXECUTE format('DELETE FROM %I WHERE source_id = $1::%s', chunk_table, pk_type)
+            USING source_id_val;
+
+        -- Skip if content is NULL or empty (after deleting old chunks)
+        IF doc_content IS NULL OR doc_content = '' THEN
+            CONTINUE;
+        END IF;
+
+        -- Chunk the document.  In offsets mode, chunks found verbatim in the
+        -- source are stored (and queued) as a byte range instead of a copy.
+        chunked_at := clock_timestamp();
+        IF storage = 'offsets' THEN
+            SELECT o.chunks, o.start_offsets, o.lengths
+            INTO chunks, starts, lens
+            FROM pgedge_vectorizer.chunk_text_offsets(raw_content, strategy, chunk_sz, overlap) o;
+        ELSE
+            chunks := pgedge_vectorizer.chunk_text(doc_content, strategy, chunk_sz, overlap);
+            starts := NULL;
+            lens := NULL;
+        END IF;
+
+        IF traced THEN
+            INSERT INTO pgedge_vectorizer.ingest_trace
+                (chunk_table, source_id, stage, duration_ms, size, detail)
+            VALUES (chunk_table, source_id_val, 'chunk',
+                    extract(epoch FROM clock_timestamp() - chunked_at) * 1000,
+                    cardinality(chunks),
+                    format('%s bytes, %s', octet_length(raw_content), strategy));
+        END IF;
+
+        -- Insert chunks and collect them for the queue
+        FOR i IN 1..array_length(chunks, 1) LOOP
+            chunk_text := chunks[i];
+            stored_text := CASE WHEN starts[i] IS NULL THEN chunk_text END;
+
+            -- Insert chunk
+            IF storage = 'offsets' THEN
+                EXECUTE format('
+                    INSERT INTO %I (source_id, chunk_index, content, token_count,
+                                    start_offset, length)
+                    VALUES ($1::%s, $2, $3, $4, $5, $6)
+                    RETURNING id', chunk_table, pk_type)
+                USING source_id_val, i, stored_text,
+                      length(chunk_text) / 4,  -- Approximate token count
+                      starts[i], lens[i]
+                INTO chunk_id;
+            ELSE
+                EXECUTE format('
+                    INSERT INTO %I (source_id, chunk_index, content, token_count)
+                    VALUES ($1::%s, $2, $3, $4)
+                    RETURNING id', chunk_table, pk_type)
+                USING source_id_val, i, chunk_text,
+                      length(chunk_text) / 4  -- Approximate token count
+                INTO chunk_id;
             END IF;
-            IF old_content_for_idf IS NOT NULL AND old_content_for_idf <> '' THEN
-                old_terms := pgedge_vectorizer.bm25_tokenize(old_content_for_idf);
-                EXECUTE format(
-                    'SELECT count(*)::int FROM %I WHERE source_id = $1::%s',
-                    chunk_table, pk_type
-                )
-                INTO deleted_chunks_count
-                USING source_id_val;
-
-                PERFORM pgedge_vectorizer.bm25_decrement_idf_stats(
-                    chunk_table, old_terms, deleted_chunks_count);
+
+            -- Queue for embedding: on the in-memory hot queue while it has
+            -- room, in the queue table otherwise
+            hot := pgedge_vectorizer.hot_enqueue(chunk_table, chunk_id, traced);
+            IF NOT hot THEN
+                queue_chunk_ids := queue_chunk_ids || chunk_id;
+                queue_chunk_tables := queue_chunk_tables || chunk_table;
+                queue_contents := queue_contents || stored_text;
             END IF;
-        END;
+
+            IF traced THEN
+                INSERT INTO pgedge_vectorizer.ingest_trace
+                    (chunk_table, source_id, chunk_id, stage, size, detail)
+                VALUES (chunk_table, source_id_val, chunk_id, 'queue',
+                        octet_length(chunk_text),
+                        CASE WHEN hot THEN 'hot queue' ELSE 'queue table' END);
+            END IF;
+        END LOOP;
+
+        notify_id := source_id_val;
+    END LOOP;
+
+    -- Queue the chunks of all columns with one INSERT; workers trace the
+    -- chunks of sampled documents through their metadata
+    IF cardinality(queue_chunk_ids) > 0 THEN
+        INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content, metadata)
+        SELECT u.*, CASE WHEN traced THEN '{"trace": true}'::JSONB END
+        FROM unnest(queue_chunk_ids, queue_chunk_tables, queue_contents) u;
     END IF;
 
-    -- Delete queue entries for this document's chunks before deleting the chunks.
-    -- Prevents orphaned queue entries that waste embedding API calls on deleted chunks.
-    -- Only targets 'pending'/'failed'; 'processing' items are left for the
-    -- worker to handle gracefully via its SPI_processed == 0 check.
-    EXECUTE format(
-        'DELETE FROM pgedge_vectorizer.queue
-         WHERE chunk_table = %L
-           AND chunk_id IN (SELECT id FROM %I WHERE source_id = $1::%s)
-           AND status IN (''pending'', ''failed'')',
-        chunk_table, chunk_table, pk_type)
-        USING source_id_val;
-
-    -- Delete existing chunks for this document
-    -- pk_type uses %s: value from format_type() is system-controlled (see enable_vectorization)
-    EXECUTE format('DELETE FROM %I WHERE source_id = $1::%s', chunk_table, pk_type)
-        USING source_id_val;
-
-    -- Skip if content is NULL or empty (after deleting old chunks)
-    IF doc_content IS NULL OR doc_content = '' THEN
-        RETURN NEW;
+    -- Notify workers (they will pick up work via polling and SKIP LOCKED)
+    IF notify_id IS NOT NULL THEN
+        PERFORM pg_notify('pgedge_vectorizer_queue', notify_id);
     END IF;
 
-    -- Chunk the document
-    chunks := pgedge_vectorizer.chunk_text(doc_content, strategy, chunk_sz, overlap);
+    RETURN NEW;
+END;
+$$ LANGUAGE plpgsql;
 
-    -- Insert chunks and queue for embedding
-    FOR i IN 1..array_length(chunks, 1) LOOP
-        chunk_text := chunks[i];
+COMMENT ON FUNCTION pgedge_vectorizer.vectorization_trigger IS
+'Trigger function that chunks text and queues for vectorization';
 
-        -- Insert chunk
-        EXECUTE format('
-            INSERT INTO %I (source_id, chunk_index, content, token_count)
-            VALUES ($1::%s, $2, $3, $4)
-            RETURNING id', chunk_table, pk_type)
-        USING source_id_val, i, chunk_text,
-              length(chunk_text) / 4  -- Approximate token count
-        INTO chunk_id;
-
-        -- Queue for embedding
-        INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content)
-        VALUES (chunk_id, chunk_table, chunk_text);
+-- (Re)create the vectorization trigger of a source table
+-- The trigger carries eight arguments per chunked column of the table:
+-- column, chunk table, strategy, chunk size, overlap, primary key column,
+-- its type and chunk storage.  It only fires on updates of those columns,
+-- and is dropped when none is left.  Direct vectorizers keep their own
+-- BEFORE trigger.
+CREATE FUNCTION pgedge_vectorizer.refresh_vectorization_trigger(
+    source_table REGCLASS
+) RETURNS VOID AS $$
+DECLARE
+    trigger_name TEXT;
+    trigger_args TEXT := '';
+    trigger_cols TEXT := '';
+    v RECORD;
+BEGIN
+    trigger_name := source_table::TEXT || '_vectorization_trigger';
+
+    -- Use EXECUTE...USING to avoid PL/pgSQL variable/column ambiguity.
+    -- pk_type uses format_type() like enable_vectorization().
+    FOR v IN EXECUTE
+        'SELECT v.source_column, v.chunk_table, v.chunk_strategy, v.chunk_size,
+                v.chunk_overlap, v.source_pk, v.chunk_storage,
+                format_type(a.atttypid, a.atttypmod) AS pk_type
+         FROM pgedge_vectorizer.vectorizers v
+         LEFT JOIN pg_attribute a ON a.attrelid = $2
+                                 AND a.attname = v.source_pk
+                                 AND NOT a.attisdropped
+         WHERE v.source_table = $1
+           AND v.embedding_column IS NULL
+         ORDER BY v.id'
+    USING source_table::TEXT, source_table
+    LOOP
+        trigger_args := trigger_args ||
+            CASE WHEN trigger_args = '' THEN '' ELSE ', ' END ||
+            format('%L, %L, %L, %L, %L, %L, %L, %L',
+                v.source_column, v.chunk_table, v.chunk_strategy, v.chunk_size,
+                v.chunk_overlap, COALESCE(v.source_pk, 'id'),
+                COALESCE(v.pk_type, 'bigint'), v.chunk_storage);
+        trigger_cols := trigger_cols ||
+            CASE WHEN trigger_cols = '' THEN '' ELSE ', ' END ||
+            quote_ident(v.source_column);
     END LOOP;
 
+    IF trigger_args = '' THEN
+        IF EXISTS (SELECT 1 FROM pg_trigger t
+                   WHERE t.tgrelid = source_table AND t.tgname = trigger_name) THEN
+            EXECUTE format('DROP TRIGGER %I ON %s', trigger_name, source_table);
+        END IF;
+        RETURN;
+    END IF;
+
+    EXECUTE format('
+        CREATE OR REPLACE TRIGGER %I
+        AFTER INSERT OR UPDATE OF %s ON %s
+        FOR EACH ROW
+        EXECUTE FUNCTION pgedge_vectorizer.vectorization_trigger(%s)',
+        trigger_name, trigger_cols, source_table, trigger_args);
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.refresh_vectorization_trigger IS
+'Recreate the combined vectorization trigger of a table from the vectorizers registry';
+
+-- Trigger function for direct vectorization
+-- Runs BEFORE the row is written, so clearing the embedding of changed
+-- text costs no extra row version.
+CREATE FUNCTION pgedge_vectorizer.direct_vectorization_trigger()
+RETURNS TRIGGER AS $$
+DECLARE
+    content_col TEXT;
+    embedding_col TEXT;
+    queue_key TEXT;
+    pk_col TEXT;
+    doc_content TEXT;
+    old_content TEXT;
+    row_id BIGINT;
+BEGIN
+    -- Extract trigger arguments
+    content_col := TG_ARGV[0];
+    embedding_col := TG_ARGV[1];
+    queue_key := TG_ARGV[2];
+    pk_col := TG_ARGV[3];
+
+    EXECUTE format('SELECT ($1).%I', pk_col) USING NEW INTO row_id;
+    EXECUTE format('SELECT trim(($1).%I)', content_col) USING NEW INTO doc_content;
+
+    -- Skip if content unchanged (on UPDATE)
+    IF TG_OP = 'UPDATE' THEN
+        EXECUTE format('SELECT trim(($1).%I)', content_col) USING OLD INTO old_content;
+        IF doc_content IS NOT DISTINCT FROM old_content THEN
+            RETURN NEW;
+        END IF;
+    END IF;
+
+    -- The stored embedding belongs to the old text
+    NEW := jsonb_populate_record(NEW, jsonb_build_object(embedding_col, NULL));
+
+    -- Drop queue entries for the old text.  'processing' items are left
+    -- to the worker; the new entry below overwrites what they store.
+    DELETE FROM pgedge_vectorizer.queue q
+    WHERE q.chunk_table = queue_key
+      AND q.chunk_id = row_id
+      AND q.status IN ('pending', 'failed');
+
+    IF doc_content IS NULL OR doc_content = '' THEN
+        RETURN NEW;
+    END IF;
+
+    -- Queue for embedding: on the in-memory hot queue while it has
+    -- room, in the queue table otherwise
+    IF NOT pgedge_vectorizer.hot_enqueue(queue_key, row_id) THEN
+        INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content)
+        VALUES (row_id, queue_key, doc_content);
+    END IF;
+
     -- Notify workers (they will pick up work via polling and SKIP LOCKED)
-    PERFORM pg_notify('pgedge_vectorizer_queue', source_id_val::TEXT);
+    PERFORM pg_notify('pgedge_vectorizer_queue', row_id::TEXT);
 
     RETURN NEW;
 END;
 $$ LANGUAGE plpgsql;
 
-COMMENT ON FUNCTION pgedge_vectorizer.vectorization_trigger IS
-'Trigger function that chunks text and queues for vectorization';
+COMMENT ON FUNCTION pgedge_vectorizer.direct_vectorization_trigger IS
+'Trigger function that queues a row of a direct vectorizer for embedding';
+
+-- Text of a batch of chunks, read from the source column when stored as
+-- offsets.  Returns the 1-based position in the arrays of each chunk found;
+-- chunks that no longer exist are left out.
+CREATE FUNCTION pgedge_vectorizer.chunk_contents(
+    p_chunk_tables TEXT[],
+    p_chunk_ids BIGINT[]
+) RETURNS TABLE (item INT, content TEXT) AS $$
+DECLARE
+    v_chunk_table TEXT;
+    v_source_table TEXT;
+    v_source_column NAME;
+    v_source_pk NAME;
+    v_storage TEXT;
+    v_direct BOOLEAN;
+BEGIN
+    FOR v_chunk_table IN
+        SELECT DISTINCT t FROM unnest(p_chunk_tables) AS t
+    LOOP
+        SELECT v.source_table, v.source_column, v.source_pk, v.chunk_storage,
+               v.embedding_column IS NOT NULL
+        INTO v_source_table, v_source_column, v_source_pk, v_storage, v_direct
+        FROM pgedge_vectorizer.vectorizers v
+        WHERE v.chunk_table = v_chunk_table
+        ORDER BY (v.embedding_column IS NOT NULL) DESC,
+                 (v.chunk_storage = 'offsets') DESC
+        LIMIT 1;
+
+        -- Direct vectorizers embed the source column of the row itself
+        IF v_direct THEN
+            IF to_regclass(v_source_table) IS NULL THEN
+                CONTINUE;
+            END IF;
+
+            -- source_table is a regclass text and already quoted (%s)
+            RETURN QUERY EXECUTE format(
+                'SELECT u.item::INT, NULLIF(trim(s.%I), '''')
+                 FROM unnest($1, $2) WITH ORDINALITY AS u(chunk_table, chunk_id, item)
+                 JOIN %s s ON s.%I = u.chunk_id
+                 WHERE u.chunk_table = %L',
+                v_source_column, v_source_table, v_source_pk, v_chunk_table)
+            USING p_chunk_tables, p_chunk_ids;
+            CONTINUE;
+        END IF;
+
+        -- Queue items can outlive a dropped chunk table
+        IF to_regclass(quote_ident(v_chunk_table)) IS NULL THEN
+            CONTINUE;
+        END IF;
+
+        IF v_storage IS DISTINCT FROM 'offsets' OR v_source_pk IS NULL THEN
+            RETURN QUERY EXECUTE format(
+                'SELECT u.item::INT, c.content
+                 FROM unnest($1, $2) WITH ORDINALITY AS u(chunk_table, chunk_id, item)
+                 JOIN %I c ON c.id = u.chunk_id
+                 WHERE u.chunk_table = %L',
+                v_chunk_table, v_chunk_table)
+            USING p_chunk_tables, p_chunk_ids;
+        ELSE
+            RETURN QUERY EXECUTE format(
+                'SELECT u.item::INT,
+                        COALESCE(c.content,
+                                 pgedge_vectorizer.chunk_slice(s.%I, c.start_offset, c.length))
+                 FROM unnest($1, $2) WITH ORDINALITY AS u(chunk_table, chunk_id, item)
+                 JOIN %I c ON c.id = u.chunk_id
+                 JOIN %s s ON s.%I = c.source_id
+                 WHERE u.chunk_table = %L',
+                v_source_column, v_chunk_table, v_source_table, v_source_pk,
+                v_chunk_table)
+            USING p_chunk_tables, p_chunk_ids;
+        END IF;
+    END LOOP;
+END;
+$$ LANGUAGE plpgsql STABLE;
+
+COMMENT ON FUNCTION pgedge_vectorizer.chunk_contents IS
+'Return the text of a batch of chunks, given as parallel arrays of chunk tables and chunk ids, in one query per chunk table';
+
+-- Text of a chunk, read from the source column when stored as offsets
+CREATE FUNCTION pgedge_vectorizer.chunk_content(
+    p_chunk_table TEXT,
+    p_chunk_id BIGINT
+) RETURNS TEXT AS $$
+    SELECT c.content
+    FROM pgedge_vectorizer.chunk_contents(ARRAY[p_chunk_table], ARRAY[p_chunk_id]) c;
+$$ LANGUAGE sql STABLE;
+
+COMMENT ON FUNCTION pgedge_vectorizer.chunk_content IS
+'Return the text of a chunk, rebuilding it from the source column for chunks stored as offsets';
+
+-- Statements that build the vector indexes deferred by
+-- enable_vectorization(defer_indexes), for the chunk tables whose backlog
+-- has drained.  An invalid index left behind by a failed concurrent build
+-- is dropped first.
+CREATE FUNCTION pgedge_vectorizer.deferred_index_statements(
+    chunk_table_name TEXT DEFAULT NULL,
+    force BOOLEAN DEFAULT FALSE,
+    concurrently BOOLEAN DEFAULT TRUE
+) RETURNS TABLE (vectorizer_id BIGINT, chunk_table TEXT, statement TEXT) AS $$
+DECLARE
+    rec RECORD;
+    idx RECORD;
+    v_mode TEXT := CASE WHEN concurrently THEN 'CONCURRENTLY ' ELSE '' END;
+BEGIN
+    FOR rec IN
+        SELECT v.id, v.chunk_table,
+               COALESCE(v.embedding_table, v.chunk_table) AS vector_table
+        FROM pgedge_vectorizer.vectorizers v
+        WHERE v.indexes_deferred
+          AND (chunk_table_name IS NULL OR v.chunk_table = chunk_table_name)
+        ORDER BY v.id
+    LOOP
+        IF to_regclass(quote_ident(rec.vector_table)) IS NULL THEN
+            CONTINUE;
+        END IF;
+
+        -- Keep incremental inserts out of the backfill until it drains,
+        -- counting the chunks waiting on the hot queue as well
+        IF NOT force AND (
+            EXISTS (SELECT 1 FROM pgedge_vectorizer.queue q
+                    WHERE q.chunk_table = rec.chunk_table
+                      AND q.status IN ('pending', 'processing'))
+            OR EXISTS (SELECT 1 FROM pgedge_vectorizer.hot_queue_entries() h
+                       WHERE h.chunk_table = rec.chunk_table))
+        THEN
+            CONTINUE;
+        END IF;
+
+        FOR idx IN
+            SELECT i.name, i.definition
+            FROM (VALUES
+                (rec.chunk_table || '_embedding_idx',
+                 format('ON %I USING hnsw (embedding vector_cosine_ops)',
+                        rec.vector_table)),
+                (rec.chunk_table || '_sparse_idx',
+                 format('ON %I USING hnsw (sparse_embedding sparsevec_ip_ops) '
+                        'WHERE sparse_embedding IS NOT NULL',
+                        rec.vector_table))
+            ) AS i(name, definition)
+        LOOP
+            IF EXISTS (SELECT 1 FROM pg_index x
+                       WHERE x.indexrelid = to_regclass(quote_ident(idx.name))
+                         AND NOT x.indisvalid)
+            THEN
+                vectorizer_id := rec.id;
+                chunk_table := rec.chunk_table;
+                statement := format('DROP INDEX %sIF EXISTS %I', v_mode, idx.name);
+                RETURN NEXT;
+            END IF;
+
+            vectorizer_id := rec.id;
+            chunk_table := rec.chunk_table;
+            statement := format('CREATE INDEX %sIF NOT EXISTS %I %s',
+                                v_mode, idx.name, idx.definition);
+            RETURN NEXT;
+        END LOOP;
+    END LOOP;
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.deferred_index_statements IS
+'Statements that build the deferred HNSW indexes of chunk tables whose queue and hot queue have drained (or all with force)';
+
+-- Build the vector indexes deferred by enable_vectorization(defer_indexes)
+-- in the calling transaction.  Workers build them with CREATE INDEX
+-- CONCURRENTLY on their own once the backlog has drained.
+CREATE FUNCTION pgedge_vectorizer.build_deferred_indexes(
+    chunk_table_name TEXT DEFAULT NULL,
+    force BOOLEAN DEFAULT FALSE,
+    parallel_workers INT DEFAULT NULL
+) RETURNS INT AS $$
+DECLARE
+    rec RECORD;
+    built BIGINT[] := '{}';
+BEGIN
+    PERFORM set_config('max_parallel_maintenance_workers',
+        COALESCE(parallel_workers,
+                 current_setting('pgedge_vectorizer.index_build_workers')::INT)::TEXT,
+        true);
+
+    FOR rec IN
+        SELECT s.vectorizer_id, s.chunk_table, s.statement
+        FROM pgedge_vectorizer.deferred_index_statements(chunk_table_name, force, false) s
+    LOOP
+        EXECUTE rec.statement;
+
+        IF NOT rec.vectorizer_id = ANY (built) THEN
+            built := built || rec.vectorizer_id;
+            RAISE NOTICE 'Built vector indexes for %', rec.chunk_table;
+        END IF;
+    END LOOP;
+
+    UPDATE pgedge_vectorizer.vectorizers
+    SET indexes_deferred = FALSE
+    WHERE id = ANY (built);
+
+    RETURN cardinality(built);
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.build_deferred_indexes IS
+'Build the HNSW indexes of chunk tables enabled with defer_indexes once their queue has drained (or immediately with force)';
+
+-- Start re-embedding a chunk table with another model
+-- The new embeddings go to a shadow embedding_next column next to the
+-- current ones, which keep serving searches.  Workers fill it with the
+-- text and ids of the existing chunks whenever their queue is empty
+-- (pgedge_vectorizer.migration_batch_size chunks per poll interval), and
+-- index it once every chunk is done.  BM25 sparse vectors and IDF stats
+-- do not depend on the model and are kept as they are.
+CREATE FUNCTION pgedge_vectorizer.start_model_migration(
+    chunk_table_name TEXT,
+    new_model TEXT,
+    embedding_dimension INT DEFAULT NULL
+) RETURNS BIGINT AS $$
+DECLARE
+    v_embedding_table TEXT;
+    v_embedding_column NAME;
+    v_configured TEXT;
+    v_chunks BIGINT;
+BEGIN
+    SELECT v.embedding_table, v.embedding_column
+    INTO v_embedding_table, v_embedding_column
+    FROM pgedge_vectorizer.vectorizers v
+    WHERE v.chunk_table = chunk_table_name;
+
+    IF NOT FOUND THEN
+        RAISE EXCEPTION 'No vectorizer found for chunk table %', chunk_table_name;
+    END IF;
+
+    IF v_embedding_column IS NOT NULL THEN
+        RAISE EXCEPTION 'Direct vectorizer % cannot be migrated to another model', chunk_table_name
+            USING HINT = 'Disable it and enable it again with the new model configured.';
+    END IF;
+
+    IF EXISTS (SELECT 1 FROM pgedge_vectorizer.model_migrations m
+               WHERE m.chunk_table = chunk_table_name) THEN
+        RAISE EXCEPTION 'A model migration of % is already in progress', chunk_table_name
+            USING HINT = 'Finish it with finish_model_migration() or cancel it with cancel_model_migration().';
+    END IF;
+
+    -- Ask the new model for its dimension when it is not given
+    IF embedding_dimension IS NULL THEN
+        v_configured := current_setting('pgedge_vectorizer.model');
+        PERFORM set_config('pgedge_vectorizer.model', new_model, true);
+        embedding_dimension := pgedge_vectorizer.detect_embedding_dimension();
+        PERFORM set_config('pgedge_vectorizer.model', v_configured, true);
+    END IF;
+
+    EXECUTE format('ALTER TABLE %I ADD COLUMN embedding_next vector(%s)',
+        COALESCE(v_embedding_table, chunk_table_name), embedding_dimension);
+
+    INSERT INTO pgedge_vectorizer.model_migrations (chunk_table, model, dimension)
+    VALUES (chunk_table_name, new_model, embedding_dimension);
+
+    EXECUTE format('SELECT count(*) FROM %I', chunk_table_name) INTO v_chunks;
+
+    RAISE NOTICE 'Migrating % to model % (% dimensions): % chunks to re-embed',
+        chunk_table_name, new_model, embedding_dimension, v_chunks;
+
+    RETURN v_chunks;
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.start_model_migration IS
+'Start re-embedding a chunk table with another model into a shadow column, while searches keep using the current embeddings';
+
+-- Chunks of a model migration without an embedding from the new model
+-- Walks the chunk ids after p_after_id in order, from the primary key
+-- index.  Chunks stored as offsets whose source row is gone have no text
+-- to embed and are left out.
+CREATE FUNCTION pgedge_vectorizer.model_migration_chunks(
+    p_chunk_table TEXT,
+    p_after_id BIGINT DEFAULT 0,
+    p_limit INT DEFAULT NULL
+) RETURNS TABLE (chunk_id BIGINT, content TEXT) AS $$
+DECLARE
+    v_embedding_table TEXT;
+BEGIN
+    SELECT v.embedding_table INTO v_embedding_table
+    FROM pgedge_vectorizer.vectorizers v
+    WHERE v.chunk_table = p_chunk_table;
+
+    RETURN QUERY EXECUTE format($sql$
+        SELECT s.id, s.chunk_text
+        FROM (SELECT c.id,
+                     COALESCE(c.content,
+                              pgedge_vectorizer.chunk_content(%L, c.id)) AS chunk_text
+              FROM %I c %s
+              WHERE c.id > $1
+                AND %s.embedding_next IS NULL) s
+        WHERE s.chunk_text IS NOT NULL
+        ORDER BY s.id
+        LIMIT $2$sql$,
+        p_chunk_table, p_chunk_table,
+        CASE WHEN v_embedding_table IS NOT NULL
+             THEN format('LEFT JOIN %I e ON e.chunk_id = c.id', v_embedding_table)
+             ELSE '' END,
+        CASE WHEN v_embedding_table IS NOT NULL THEN 'e' ELSE 'c' END)
+    USING p_after_id, p_limit;
+END;
+$$ LANGUAGE plpgsql STABLE;
+
+COMMENT ON FUNCTION pgedge_vectorizer.model_migration_chunks IS
+'Chunks of a model migration that have no embedding from the new model yet';
+
+-- Switch a chunk table over to the embeddings of its model migration
+-- In one transaction the current embeddings and their index are dropped,
+-- embedding_next and its index take their names, and the vectorizer
+-- records the new model.  Chunks written since the workers reached the
+-- end of the table are embedded here first.  Workers and hybrid_search() embed new chunks
+-- and queries of the table with that model from then on, whatever
+-- pgedge_vectorizer.model is set to.
+CREATE FUNCTION pgedge_vectorizer.finish_model_migration(
+    chunk_table_name TEXT
+) RETURNS VOID AS $$
+DECLARE
+    v_model TEXT;
+    v_dimension INT;
+    v_status TEXT;
+    v_embedding_table TEXT;
+    v_vector_table TEXT;
+    v_missing BIGINT;
+BEGIN
+    SELECT m.model, m.dimension, m.status
+    INTO v_model, v_dimension, v_status
+    FROM pgedge_vectorizer.model_migrations m
+    WHERE m.chunk_table = chunk_table_name
+    FOR UPDATE;
+
+    IF NOT FOUND THEN
+        RAISE EXCEPTION 'No model migration of % in progress', chunk_table_name;
+    END IF;
+
+    SELECT v.embedding_table INTO v_embedding_table
+    FROM pgedge_vectorizer.vectorizers v
+    WHERE v.chunk_table = chunk_table_name;
+
+    v_vector_table := COALESCE(v_embedding_table, chunk_table_name);
+
+    -- Hold off new chunks and searches until the switch-over commits
+    EXECUTE format('LOCK TABLE %I IN ACCESS EXCLUSIVE MODE', chunk_table_name);
+    EXECUTE format('LOCK TABLE %I IN ACCESS EXCLUSIVE MODE', v_vector_table);
+
+    SELECT count(*) INTO v_missing
+    FROM pgedge_vectorizer.model_migration_chunks(chunk_table_name);
+
+    -- Wait for the workers until they have been through every chunk
+    IF v_missing > 0 AND v_status NOT IN ('indexing', 'ready') THEN
+        RAISE EXCEPTION 'Model migration of % is not complete: % chunks have no embedding from %',
+            chunk_table_name, v_missing, v_model
+            USING HINT = 'Workers re-embed pgedge_vectorizer.migration_batch_size chunks per poll interval while their queue is empty.';
+    END IF;
+
+    -- Past that point they only re-embed chunks written since, so with
+    -- ongoing writes a few are left; embed them here, under the locks
+    IF v_missing > 0 THEN
+        IF v_embedding_table IS NOT NULL THEN
+            EXECUTE format('
+                INSERT INTO %I (chunk_id, embedding_next)
+                SELECT m.chunk_id, pgedge_vectorizer.generate_embedding(m.content, %L)
+                FROM pgedge_vectorizer.model_migration_chunks(%L) m
+                ON CONFLICT (chunk_id) DO UPDATE SET
+                    embedding_next = EXCLUDED.embedding_next',
+                v_embedding_table, v_model, chunk_table_name);
+        ELSE
+            EXECUTE format('
+                UPDATE %I c
+                SET embedding_next = pgedge_vectorizer.generate_embedding(m.content, %L)
+                FROM pgedge_vectorizer.model_migration_chunks(%L) m
+                WHERE c.id = m.chunk_id',
+                chunk_table_name, v_model, chunk_table_name);
+        END IF;
+    END IF;
+
+    -- The workers index embedding_next when they finish; build it here if
+    -- they have not got to it yet, or if their concurrent build failed
+    -- and left an invalid index behind
+    IF EXISTS (SELECT 1 FROM pg_index x
+               WHERE x.indexrelid = to_regclass(quote_ident(chunk_table_name || '_embedding_next_idx'))
+                 AND NOT x.indisvalid)
+    THEN
+        EXECUTE format('DROP INDEX %I', chunk_table_name || '_embedding_next_idx');
+    END IF;
+
+    EXECUTE format('
+        CREATE INDEX IF NOT EXISTS %I ON %I
+        USING hnsw (embedding_next vector_cosine_ops)',
+        chunk_table_name || '_embedding_next_idx', v_vector_table);
+
+    IF v_embedding_table IS NOT NULL THEN
+        EXECUTE format('DROP VIEW IF EXISTS %I', chunk_table_name || '_view');
+    END IF;
+
+    EXECUTE format('ALTER TABLE %I DROP COLUMN embedding', v_vector_table);
+    EXECUTE format('ALTER TABLE %I RENAME COLUMN embedding_next TO embedding',
+        v_vector_table);
+    EXECUTE format('ALTER INDEX %I RENAME TO %I',
+        chunk_table_name || '_embedding_next_idx', chunk_table_name || '_embedding_idx');
+
+    IF v_embedding_table IS NOT NULL THEN
+        EXECUTE format('
+            CREATE VIEW %I AS
+            SELECT c.*, e.embedding, e.sparse_embedding
+            FROM %I c
+            LEFT JOIN %I e ON e.chunk_id = c.id',
+            chunk_table_name || '_view', chunk_table_name, v_embedding_table);
+    END IF;
+
+    UPDATE pgedge_vectorizer.vectorizers v
+    SET model = v_model
+    WHERE v.chunk_table = chunk_table_name;
+
+    DELETE FROM pgedge_vectorizer.model_migrations m
+    WHERE m.chunk_table = chunk_table_name;
+
+    RAISE NOTICE 'Switched % to model % (% dimensions)',
+        chunk_table_name, v_model, v_dimension;
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.finish_model_migration IS
+'Atomically replace the embeddings of a chunk table with those of its completed model migration';
+
+-- Cancel a model migration, dropping the embeddings made so far
+CREATE FUNCTION pgedge_vectorizer.cancel_model_migration(
+    chunk_table_name TEXT
+) RETURNS VOID AS $$
+DECLARE
+    v_embedding_table TEXT;
+BEGIN
+    DELETE FROM pgedge_vectorizer.model_migrations m
+    WHERE m.chunk_table = chunk_table_name;
+
+    IF NOT FOUND THEN
+        RAISE EXCEPTION 'No model migration of % in progress', chunk_table_name;
+    END IF;
+
+    SELECT v.embedding_table INTO v_embedding_table
+    FROM pgedge_vectorizer.vectorizers v
+    WHERE v.chunk_table = chunk_table_name;
+
+    -- Drops the migration index along with the column
+    EXECUTE format('ALTER TABLE %I DROP COLUMN IF EXISTS embedding_next',
+        COALESCE(v_embedding_table, chunk_table_name));
+
+    RAISE NOTICE 'Model migration of % cancelled', chunk_table_name;
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.cancel_model_migration IS
+'Cancel the model migration of a chunk table and drop its embedding_next column';
 
 ---------------------------------------------------------------------------
 -- Views for monitoring
@@ -688,16 +2459,15 @@ CREATE VIEW pgedge_vectorizer.queue_status AS
 SELECT
     chunk_table,
     status,
-    COUNT(*) as count,
-    MIN(created_at) as oldest,
-    MAX(created_at) as newest,
-    AVG(EXTRACT(EPOCH FROM (COALESCE(processed_at, NOW()) - created_at))) as avg_processing_time_secs
-FROM pgedge_vectorizer.queue
-GROUP BY chunk_table, status
+    count,
+    oldest,
+    newest,
+    avg_processing_time_secs::numeric as avg_processing_time_secs
+FROM pgedge_vectorizer.queue_stats()
 ORDER BY chunk_table, status;
 
 COMMENT ON VIEW pgedge_vectorizer.queue_status IS
-'Summary of queue items by table and status';
+'Summary of queue items by table and status (see queue_stats())';
 
 -- Failed items view
 CREATE VIEW pgedge_vectorizer.failed_items AS
@@ -710,7 +2480,7 @@ SELECT
     error_message,
     created_at,
     next_retry_at,
-    LEFT(content, 100) as content_preview
+    LEFT(COALESCE(content, pgedge_vectorizer.chunk_content(chunk_table, chunk_id)), 100) as content_preview
 FROM pgedge_vectorizer.queue
 WHERE status = 'failed'
 ORDER BY created_at DESC;
@@ -721,9 +2491,9 @@ COMMENT ON VIEW pgedge_vectorizer.failed_items IS
 -- Pending items count
 CREATE VIEW pgedge_vectorizer.pending_count AS
 SELECT
-    COUNT(*) as pending_items,
-    COUNT(DISTINCT chunk_table) as affected_tables
-FROM pgedge_vectorizer.queue
+    COALESCE(SUM(count), 0)::bigint as pending_items,
+    COUNT(*) as affected_tables
+FROM pgedge_vectorizer.queue_stats()
 WHERE status = 'pending';
 
 COMMENT ON VIEW pgedge_vectorizer.pending_count IS
@@ -783,24 +2553,85 @@ CREATE FUNCTION pgedge_vectorizer.reprocess_chunks(
 DECLARE
     rows_affected INT := 0;
     chunk_record RECORD;
+    chunk_query TEXT;
+    emb_table TEXT;
+    emb_column NAME;
+    src_table TEXT;
+    src_column NAME;
+    src_pk NAME;
     hybrid_enabled BOOLEAN;
+    hot_ids BIGINT[];
 BEGIN
     hybrid_enabled := COALESCE(
         current_setting('pgedge_vectorizer.enable_hybrid', true),
         'false'
     )::BOOLEAN;
 
+    -- Chunks waiting on the hot queue are queued already
+    SELECT COALESCE(array_agg(h.chunk_id), '{}')
+    INTO hot_ids
+    FROM pgedge_vectorizer.hot_queue_entries() h
+    WHERE h.chunk_table = chunk_table_name;
+
+    SELECT v.embedding_table, v.embedding_column, v.source_table,
+           v.source_column, v.source_pk
+    INTO emb_table, emb_column, src_table, src_column, src_pk
+    FROM pgedge_vectorizer.vectorizers v
+    WHERE v.chunk_table = chunk_table_name;
+
+    -- A direct vectorizer queues the source rows without an embedding,
+    -- in one statement; it keeps no sparse vectors
+    IF emb_column IS NOT NULL THEN
+        EXECUTE format(
+            'INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content) '
+            'SELECT s.%I, %L, trim(s.%I) '
+            'FROM %s s '
+            'WHERE s.%I IS NULL '
+            '  AND trim(s.%I) <> '''' '
+            '  AND NOT EXISTS ('
+            '      SELECT 1 FROM pgedge_vectorizer.queue q '
+            '      WHERE q.chunk_table = %L AND q.chunk_id = s.%I '
+            '        AND q.status IN (''pending'', ''processing'')) '
+            '  AND s.%I <> ALL (%L::BIGINT[])',
+            src_pk, chunk_table_name, src_column,
+            src_table,
+            emb_column,
+            src_column,
+            chunk_table_name, src_pk,
+            src_pk, hot_ids);
+        GET DIAGNOSTICS rows_affected = ROW_COUNT;
+
+        RAISE NOTICE 'Queued % rows from % for processing', rows_affected, src_table;
+        RETURN rows_affected;
+    END IF;
+
     -- Queue chunks that need dense embeddings, and when hybrid is enabled,
     -- also queue chunks missing sparse embeddings.
-    FOR chunk_record IN EXECUTE format(
-        'SELECT id, content, (embedding IS NULL) AS needs_embedding, '
-        '       (sparse_embedding IS NULL) AS needs_sparse '
-        'FROM %I '
-        'WHERE embedding IS NULL '
-        '   OR (sparse_embedding IS NULL AND %L::boolean)',
-        chunk_table_name,
-        hybrid_enabled
-    )
+    IF emb_table IS NULL THEN
+        chunk_query := format(
+            'SELECT id, content, (embedding IS NULL) AS needs_embedding, '
+            '       (sparse_embedding IS NULL) AS needs_sparse '
+            'FROM %I '
+            'WHERE embedding IS NULL '
+            '   OR (sparse_embedding IS NULL AND %L::boolean)',
+            chunk_table_name,
+            hybrid_enabled
+        );
+    ELSE
+        chunk_query := format(
+            'SELECT c.id, c.content, (e.embedding IS NULL) AS needs_embedding, '
+            '       (e.sparse_embedding IS NULL) AS needs_sparse '
+            'FROM %I c '
+            'LEFT JOIN %I e ON e.chunk_id = c.id '
+            'WHERE e.embedding IS NULL '
+            '   OR (e.sparse_embedding IS NULL AND %L::boolean)',
+            chunk_table_name,
+            emb_table,
+            hybrid_enabled
+        );
+    END IF;
+
+    FOR chunk_record IN EXECUTE chunk_query
     LOOP
         -- Check if already queued
         PERFORM 1 FROM pgedge_vectorizer.queue
@@ -809,7 +2640,7 @@ BEGIN
           AND status IN ('pending', 'processing');
 
         -- Only queue if not already queued
-        IF NOT FOUND THEN
+        IF NOT FOUND AND chunk_record.id <> ALL (hot_ids) THEN
             INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content, metadata)
             VALUES (
                 chunk_record.id,
@@ -834,6 +2665,50 @@ $$ LANGUAGE plpgsql;
 COMMENT ON FUNCTION pgedge_vectorizer.reprocess_chunks IS
 'Queue existing chunks without embeddings for processing';
 
+-- Switch the queue between logged and unlogged storage
+-- Queue rows can be rebuilt from the chunk tables, so an unlogged queue
+-- skips their WAL and replication traffic.  After a crash PostgreSQL
+-- empties unlogged tables and the workers run recover_queue().
+CREATE FUNCTION pgedge_vectorizer.set_queue_unlogged(
+    unlogged BOOLEAN DEFAULT TRUE
+) RETURNS VOID AS $$
+BEGIN
+    IF unlogged THEN
+        ALTER TABLE pgedge_vectorizer.queue SET UNLOGGED;
+    ELSE
+        ALTER TABLE pgedge_vectorizer.queue SET LOGGED;
+    END IF;
+
+    RAISE NOTICE 'Embedding queue is now %', CASE WHEN unlogged THEN 'unlogged' ELSE 'logged' END;
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.set_queue_unlogged IS
+'Make the embedding queue unlogged (or logged again)';
+
+-- Rebuild the queue from the chunk tables
+CREATE FUNCTION pgedge_vectorizer.recover_queue() RETURNS INT AS $$
+DECLARE
+    v RECORD;
+    rows_affected INT := 0;
+BEGIN
+    FOR v IN
+        SELECT chunk_table FROM pgedge_vectorizer.vectorizers
+        WHERE to_regclass(quote_ident(chunk_table)) IS NOT NULL
+           OR (embedding_column IS NOT NULL AND to_regclass(source_table) IS NOT NULL)
+        ORDER BY chunk_table
+    LOOP
+        rows_affected := rows_affected +
+            pgedge_vectorizer.reprocess_chunks(v.chunk_table);
+    END LOOP;
+
+    RETURN rows_affected;
+END;
+$$ LANGUAGE plpgsql;
+
+COMMENT ON FUNCTION pgedge_vectorizer.recover_queue IS
+'Queue every chunk without embeddings in all vectorized chunk tables';
+
 -- Recreate all chunks from scratch
 CREATE FUNCTION pgedge_vectorizer.recreate_chunks(
     source_table_name REGCLASS,
@@ -843,7 +2718,6 @@ DECLARE
     chunk_table_name TEXT;
     rows_affected INT := 0;
     trigger_name TEXT;
-    trigger_exists BOOLEAN;
 BEGIN
     -- Prefer authoritative mapping from vectorizers registry.
     SELECT v.chunk_table
@@ -862,17 +2736,20 @@ BEGIN
         RAISE EXCEPTION 'Chunk table % does not exist. Use enable_vectorization() first.', chunk_table_name;
     END IF;
 
-    -- Verify trigger exists
-    trigger_name := source_table_name::TEXT || '_' || source_column_name || '_vectorization_trigger';
-    SELECT EXISTS (
-        SELECT 1 FROM pg_trigger t
-        JOIN pg_class c ON t.tgrelid = c.oid
-        WHERE c.oid = source_table_name
-        AND t.tgname = trigger_name
-    ) INTO trigger_exists;
-
-    IF NOT trigger_exists THEN
-        RAISE EXCEPTION 'Vectorization trigger % does not exist. Use enable_vectorization() first.', trigger_name;
+    -- Verify trigger exists: the table's combined trigger, or the
+    -- per-column trigger of earlier versions
+    SELECT t.tgname
+    INTO trigger_name
+    FROM pg_trigger t
+    WHERE t.tgrelid = source_table_name
+      AND t.tgname IN (source_table_name::TEXT || '_vectorization_trigger',
+                       source_table_name::TEXT || '_' || source_column_name || '_vectorization_trigger')
+    ORDER BY t.tgname = source_table_name::TEXT || '_vectorization_trigger' DESC
+    LIMIT 1;
+
+    IF trigger_name IS NULL THEN
+        RAISE EXCEPTION 'Vectorization trigger % does not exist. Use enable_vectorization() first.',
+            source_table_name::TEXT || '_vectorization_trigger';
     END IF;
 
     RAISE NOTICE 'Recreating chunks for %.% -> %', source_table_name, source_column_name, chunk_table_name;
@@ -902,7 +2779,10 @@ BEGIN
         row_record RECORD;
         doc_content TEXT;
         chunks TEXT[];
+        starts INT[];
+        lens INT[];
         chunk_text TEXT;
+        stored_text TEXT;
         i INT;
         chunk_id BIGINT;
         rows_processed INT := 0;
@@ -911,11 +2791,13 @@ BEGIN
         actual_chunk_overlap INT;
         pk_col TEXT;
         pk_type TEXT;
+        storage TEXT;
     BEGIN
         -- Get chunking configuration from trigger arguments
         -- In PostgreSQL 17+, tgargs is bytea and needs to be decoded
         DECLARE
             tgargs_array TEXT[];
+            base INT := 0;
         BEGIN
             SELECT string_to_array(encode(t.tgargs, 'escape'), E'\\000')
             INTO tgargs_array
@@ -924,12 +2806,24 @@ BEGIN
             WHERE c.oid = source_table_name
             AND t.tgname = trigger_name;
 
-            -- Arguments: 1=content_col, 2=chunk_table, 3=strategy, 4=size, 5=overlap, 6=pk_col, 7=pk_type
-            actual_strategy := tgargs_array[3];
-            actual_chunk_size := tgargs_array[4]::INT;
-            actual_chunk_overlap := tgargs_array[5]::INT;
-            pk_col := COALESCE(tgargs_array[6], 'id');
-            pk_type := COALESCE(tgargs_array[7], 'bigint');
+            -- Eight arguments per column: 1=content_col, 2=chunk_table, 3=strategy,
+            -- 4=size, 5=overlap, 6=pk_col, 7=pk_type, 8=storage
+            WHILE base < COALESCE(array_length(tgargs_array, 1), 0)
+                  AND tgargs_array[base + 1] IS DISTINCT FROM source_column_name LOOP
+                base := base + 8;
+            END LOOP;
+
+            IF tgargs_array[base + 1] IS DISTINCT FROM source_column_name THEN
+                RAISE EXCEPTION 'Vectorization trigger % does not handle column %. Use enable_vectorization() first.',
+                    trigger_name, source_column_name;
+            END IF;
+
+            actual_strategy := tgargs_array[base + 3];
+            actual_chunk_size := tgargs_array[base + 4]::INT;
+            actual_chunk_overlap := tgargs_array[base + 5]::INT;
+            pk_col := COALESCE(tgargs_array[base + 6], 'id');
+            pk_type := COALESCE(tgargs_array[base + 7], 'bigint');
+            storage := COALESCE(NULLIF(tgargs_array[base + 8], ''), 'content');
         END;
 
         RAISE NOTICE 'Re-chunking with strategy=%, size=%, overlap=%',
@@ -943,25 +2837,44 @@ BEGIN
             doc_content := row_record.content;
 
             -- Chunk the document
-            chunks := pgedge_vectorizer.chunk_text(doc_content, actual_strategy, actual_chunk_size, actual_chunk_overlap);
+            IF storage = 'offsets' THEN
+                SELECT o.chunks, o.start_offsets, o.lengths
+                INTO chunks, starts, lens
+                FROM pgedge_vectorizer.chunk_text_offsets(doc_content, actual_strategy, actual_chunk_size, actual_chunk_overlap) o;
+            ELSE
+                chunks := pgedge_vectorizer.chunk_text(doc_content, actual_strategy, actual_chunk_size, actual_chunk_overlap);
+            END IF;
 
             -- Insert chunks and queue for embedding
             FOR i IN 1..array_length(chunks, 1) LOOP
                 chunk_text := chunks[i];
+                stored_text := CASE WHEN starts[i] IS NULL THEN chunk_text END;
 
                 -- Insert chunk
                 -- pk_type uses %s: value from format_type() is system-controlled (see enable_vectorization)
-                EXECUTE format('
-                    INSERT INTO %I (source_id, chunk_index, content, token_count)
-                    VALUES ($1::%s, $2, $3, $4)
-                    RETURNING id', chunk_table_name, pk_type)
-                USING row_record.pk_val, i, chunk_text,
-                      length(chunk_text) / 4  -- Approximate token count
-                INTO chunk_id;
+                IF storage = 'offsets' THEN
+                    EXECUTE format('
+                        INSERT INTO %I (source_id, chunk_index, content, token_count,
+                                        start_offset, length)
+                        VALUES ($1::%s, $2, $3, $4, $5, $6)
+                        RETURNING id', chunk_table_name, pk_type)
+                    USING row_record.pk_val, i, stored_text,
+                          length(chunk_text) / 4,  -- Approximate token count
+                          starts[i], lens[i]
+                    INTO chunk_id;
+                ELSE
+                    EXECUTE format('
+                        INSERT INTO %I (source_id, chunk_index, content, token_count)
+                        VALUES ($1::%s, $2, $3, $4)
+                        RETURNING id', chunk_table_name, pk_type)
+                    USING row_record.pk_val, i, chunk_text,
+                          length(chunk_text) / 4  -- Approximate token count
+                    INTO chunk_id;
+                END IF;
 
                 -- Queue for embedding
                 INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content)
-                VALUES (chunk_id, chunk_table_name, chunk_text);
+                VALUES (chunk_id, chunk_table_name, stored_text);
             END LOOP;
 
             rows_processed := rows_processed + 1;
@@ -996,6 +2909,55 @@ $$ LANGUAGE plpgsql;
 COMMENT ON FUNCTION pgedge_vectorizer.show_config IS
 'Show all pgedge_vectorizer configuration settings';
 
+-- Run the standard benchmark matrix (used by make bench)
+CREATE FUNCTION pgedge_vectorizer.bench_chunking(
+    iterations INT DEFAULT 20,
+    corpus_bytes INT DEFAULT 65536
+)
+RETURNS TABLE (
+    kernel TEXT,
+    corpus_kind TEXT,
+    scan_impl TEXT,
+    input_bytes BIGINT,
+    total_ms FLOAT8,
+    mb_per_sec FLOAT8,
+    items_per_iteration BIGINT,
+    items_per_sec FLOAT8,
+    retained_context_bytes BIGINT,
+    peak_context_bytes BIGINT
+)
+LANGUAGE sql VOLATILE AS $$
+    SELECT m.kernel, m.corpus_kind, b.*
+    FROM (VALUES
+        (1, 'token_based', 'prose'),
+        (2, 'token_based', 'markdown'),
+        (3, 'token_based', 'code'),
+        (4, 'token_based', 'cjk'),
+        (5, 'markdown', 'prose'),
+        (6, 'markdown', 'markdown'),
+        (7, 'markdown', 'code'),
+        (8, 'hybrid', 'prose'),
+        (9, 'hybrid', 'markdown'),
+        (10, 'hybrid', 'code'),
+        (11, 'bm25_tokenize', 'prose'),
+        (12, 'bm25_tokenize', 'markdown'),
+        (13, 'bm25_tokenize', 'cjk'),
+        (14, 'openai_parse', 'openai_json'),
+        (15, 'ollama_parse', 'ollama_json')
+    ) AS m(ord, kernel, corpus_kind),
+    LATERAL pgedge_vectorizer.bench_kernel(
+        m.kernel,
+        bench_chunking.iterations,
+        NULL,
+        m.corpus_kind,
+        bench_chunking.corpus_bytes
+    ) AS b
+    ORDER BY m.ord;
+$$;
+
+COMMENT ON FUNCTION pgedge_vectorizer.bench_chunking IS
+'Benchmark every chunking, tokenizing and parsing kernel over the standard synthetic corpora';
+
 ---------------------------------------------------------------------------
 -- Grants (for non-superuser usage - optional)
 ---------------------------------------------------------------------------
@@ -1032,26 +2994,44 @@ RETURNS TABLE (
 LANGUAGE plpgsql AS $$
 DECLARE
     v_chunk_table  TEXT;
+    v_vector_table TEXT;
+    v_vector_key   TEXT;
+    v_direct_col   NAME;
+    v_model        TEXT;
+    v_relations    TEXT[];
+    v_dense_sql    TEXT;
+    v_sparse_sql   TEXT;
     v_query_dense  vector;
     v_query_sparse sparsevec;
+    v_dense_ids    BIGINT[];
+    v_sparse_ids   BIGINT[];
+    v_results      INT;
+    v_phase_start  TIMESTAMPTZ;
+    v_phase_ms     FLOAT8[] := '{}';
 BEGIN
     IF COALESCE(current_setting('pgedge_vectorizer.enable_hybrid', true), 'false')::boolean IS NOT TRUE THEN
         RAISE EXCEPTION
             'Hybrid search is disabled. Set pgedge_vectorizer.enable_hybrid = true and allow workers to populate sparse_embedding.';
     END IF;
 
+    -- Each phase is timed for record_search_profile(): the lookups, the
+    -- dense and BM25 query vectors, the two scans and the merge
+    v_phase_start := clock_timestamp();
+
     -- Look up the chunk table from the vectorizers registry.
     -- When p_source_column is provided, use the exact mapping.
     -- When NULL, raise an exception if the table has more than one
     -- vectorized column to avoid silently returning results from the
     -- wrong chunk table.
     IF p_source_column IS NOT NULL THEN
-        SELECT vz.chunk_table INTO v_chunk_table
+        SELECT vz.chunk_table, vz.embedding_table, vz.embedding_column, vz.model
+        INTO v_chunk_table, v_vector_table, v_direct_col, v_model
         FROM pgedge_vectorizer.vectorizers vz
         WHERE vz.source_table = p_source_table::TEXT
           AND vz.source_column = p_source_column;
     ELSE
-        SELECT vz.chunk_table INTO v_chunk_table
+        SELECT vz.chunk_table, vz.embedding_table, vz.embedding_column, vz.model
+        INTO v_chunk_table, v_vector_table, v_direct_col, v_model
         FROM pgedge_vectorizer.vectorizers vz
         WHERE vz.source_table = p_source_table::TEXT
         LIMIT 1;
@@ -1074,60 +3054,116 @@ BEGIN
             p_source_table;
     END IF;
 
-    -- Generate dense query vector via the existing C function
-    v_query_dense := pgedge_vectorizer.generate_embedding(p_query);
+    IF v_direct_col IS NOT NULL THEN
+        RAISE EXCEPTION
+            'Table % is vectorized directly into its % column, which has no chunks for hybrid search',
+            p_source_table, v_direct_col
+            USING HINT = 'Order by the column''s distance to generate_embedding() of the query instead.';
+    END IF;
+
+    -- Chunks created with embedding_storage => 'table' are ranked from
+    -- their narrow embeddings table
+    IF v_vector_table IS NULL THEN
+        v_vector_table := v_chunk_table;
+        v_vector_key := 'id';
+    ELSE
+        v_vector_key := 'chunk_id';
+    END IF;
+
+    -- A hash-partitioned chunk table is searched partition by partition:
+    -- each partition returns its own top candidates from its HNSW index
+    -- and the lists are merged.  The UNION ALL lets the planner spread the
+    -- partitions over parallel workers (Parallel Append).
+    SELECT COALESCE(array_agg(i.inhrelid::regclass::TEXT ORDER BY i.inhrelid),
+                    ARRAY[quote_ident(v_vector_table)])
+    INTO v_relations
+    FROM pg_inherits i
+    WHERE i.inhparent = to_regclass(quote_ident(v_vector_table));
+
+    SELECT string_agg(format($sql$
+            (SELECT %I AS id, embedding <=> $1 AS dist
+             FROM %s
+             WHERE embedding IS NOT NULL
+             ORDER BY dist
+             LIMIT %s)$sql$, v_vector_key, rel, p_limit * 3), ' UNION ALL'),
+           string_agg(format($sql$
+            (SELECT %I AS id, sparse_embedding <#> $1 AS dist
+             FROM %s
+             WHERE sparse_embedding IS NOT NULL
+             ORDER BY dist ASC
+             LIMIT %s)$sql$, v_vector_key, rel, p_limit * 3), ' UNION ALL')
+    INTO v_dense_sql, v_sparse_sql
+    FROM unnest(v_relations) AS rel;
+
+    v_phase_ms := v_phase_ms || extract(epoch FROM clock_timestamp() - v_phase_start)::float8 * 1000;
+    v_phase_start := clock_timestamp();
+
+    -- Generate dense query vector, with the model the chunks were embedded
+    -- with when a model migration has set one
+    IF v_model IS NULL THEN
+        v_query_dense := pgedge_vectorizer.generate_embedding(p_query);
+    ELSE
+        v_query_dense := pgedge_vectorizer.generate_embedding(p_query, v_model);
+    END IF;
+
+    v_phase_ms := v_phase_ms || extract(epoch FROM clock_timestamp() - v_phase_start)::float8 * 1000;
+    v_phase_start := clock_timestamp();
 
     -- Generate sparse BM25 query vector
     v_query_sparse := pgedge_vectorizer.bm25_query_vector(
                           p_query, v_chunk_table);
 
-    -- Run both ranked lists and merge with Reciprocal Rank Fusion.
-    -- Join on chunk id (not source_id) to avoid mixing unrelated chunks
-    -- from the same document.  source_id is cast to TEXT to support
-    -- arbitrary PK types (BIGINT, UUID, VARCHAR, etc.).
+    v_phase_ms := v_phase_ms || extract(epoch FROM clock_timestamp() - v_phase_start)::float8 * 1000;
+    v_phase_start := clock_timestamp();
+
+    -- Rank the candidates of each list by chunk id from the table holding
+    -- the vectors.  The lists are collected one after the other so that
+    -- each scan can be timed.
+    EXECUTE format($sql$
+        SELECT array_agg(id ORDER BY dist)
+        FROM (SELECT id, dist
+              FROM (%s
+              ) AS per_relation
+              ORDER BY dist
+              LIMIT %s) AS candidates
+    $sql$, v_dense_sql, p_limit * 3)
+    INTO v_dense_ids
+    USING v_query_dense;
+
+    v_phase_ms := v_phase_ms || extract(epoch FROM clock_timestamp() - v_phase_start)::float8 * 1000;
+    v_phase_start := clock_timestamp();
+
+    EXECUTE format($sql$
+        SELECT array_agg(id ORDER BY dist ASC)
+        FROM (SELECT id, dist
+              FROM (%s
+              ) AS per_relation
+              ORDER BY dist ASC
+              LIMIT %s) AS candidates
+    $sql$, v_sparse_sql, p_limit * 3)
+    INTO v_sparse_ids
+    USING v_query_sparse;
+
+    v_phase_ms := v_phase_ms || extract(epoch FROM clock_timestamp() - v_phase_start)::float8 * 1000;
+    v_phase_start := clock_timestamp();
+
+    -- Merge both ranked lists with Reciprocal Rank Fusion.  source_id and
+    -- text are only joined in for the final rows.  Joining on chunk id
+    -- (not source_id) avoids mixing unrelated chunks from the same
+    -- document, and source_id is cast to TEXT to support arbitrary PK
+    -- types (BIGINT, UUID, VARCHAR, etc.).
     RETURN QUERY EXECUTE format($sql$
-        WITH dense_candidates AS (
-            SELECT
-                id,
-                source_id::text AS source_id,
-                content AS chunk,
-                embedding <=> %L::vector AS dist
-            FROM %I
-            WHERE embedding IS NOT NULL
-            ORDER BY dist
-            LIMIT %s * 3
-        ),
-        dense AS (
-            SELECT
-                id,
-                source_id,
-                chunk,
-                ROW_NUMBER() OVER (ORDER BY dist) AS rnk
-            FROM dense_candidates
-        ),
-        sparse_candidates AS (
-            SELECT
-                id,
-                source_id::text AS source_id,
-                content AS chunk,
-                sparse_embedding <#> %L::sparsevec AS dist
-            FROM %I
-            WHERE sparse_embedding IS NOT NULL
-            ORDER BY dist ASC
-            LIMIT %s * 3
+        WITH dense AS (
+            SELECT id, rnk
+            FROM unnest($1::BIGINT[]) WITH ORDINALITY AS d(id, rnk)
         ),
         sparse AS (
-            SELECT
-                id,
-                source_id,
-                chunk,
-                ROW_NUMBER() OVER (ORDER BY dist ASC) AS rnk
-            FROM sparse_candidates
+            SELECT id, rnk
+            FROM unnest($2::BIGINT[]) WITH ORDINALITY AS s(id, rnk)
         ),
         merged AS (
             SELECT
-                COALESCE(d.source_id, s.source_id)  AS source_id,
-                COALESCE(d.chunk,     s.chunk)       AS chunk,
+                id,
                 COALESCE(d.rnk, 9999)::INT           AS dense_rank,
                 COALESCE(s.rnk, 9999)::INT           AS sparse_rank,
                 (
@@ -1136,23 +3172,37 @@ BEGIN
                 )                                    AS rrf_score
             FROM dense d
             FULL OUTER JOIN sparse s USING (id)
+        ),
+        top AS (
+            SELECT *
+            FROM merged
+            ORDER BY rrf_score DESC
+            LIMIT %s
         )
         SELECT
-            source_id,
-            chunk,
-            dense_rank,
-            sparse_rank,
-            rrf_score
-        FROM merged
-        ORDER BY rrf_score DESC
-        LIMIT %s
+            c.source_id::text,
+            COALESCE(c.content, pgedge_vectorizer.chunk_content(%L, c.id)),
+            t.dense_rank,
+            t.sparse_rank,
+            t.rrf_score
+        FROM top t
+        JOIN %I c ON c.id = t.id
+        ORDER BY t.rrf_score DESC
     $sql$,
-        v_query_dense,   v_chunk_table, p_limit,
-        v_query_sparse,  v_chunk_table, p_limit,
         p_alpha, p_rrf_k,
         p_alpha, p_rrf_k,
-        p_limit
-    );
+        p_limit, v_chunk_table, v_chunk_table
+    )
+    USING v_dense_ids, v_sparse_ids;
+
+    GET DIAGNOSTICS v_results = ROW_COUNT;
+    v_phase_ms := v_phase_ms || extract(epoch FROM clock_timestamp() - v_phase_start)::float8 * 1000;
+
+    PERFORM pgedge_vectorizer.record_search_profile(
+        v_chunk_table, v_phase_ms,
+        COALESCE(cardinality(v_dense_ids), 0),
+        COALESCE(cardinality(v_sparse_ids), 0),
+        v_results);
 END;
 $$;
 
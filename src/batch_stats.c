@@ -0,0 +1,408 @@
+/*-------------------------------------------------------------------------
+ *
+ * batch_stats.c
+ *		Per-stage timing and memory use of the workers' batches
+ *
+ * A worker times each batch it takes off the hot queue or the queue
+ * table, from the claim to the commit of its transaction, split into the
+ * stages of BatchStage.  The provider's HTTP and parse times come from
+ * provider_stats_record(); the other stages are timed around the code
+ * doing them with batch_stats_stage_begin() and batch_stats_stage_end().
+ * The memory allocated in the batch's transaction is sampled at the end
+ * of each stage to estimate its peak.
+ *
+ * Finished batches are added to cumulative counters in shared memory and
+ * to a ring of the most recent batches, read with batch_stats() and
+ * recent_batches().  Polls that claim nothing are not recorded, and
+ * neither are batches cut short by an error.  Without
+ * shared_preload_libraries nothing is recorded.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "portability/instr_time.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+/* Finished batches kept for recent_batches() */
+#define RECENT_BATCHES 128
+
+typedef struct BatchRecord
+{
+	TimestampTz finished_at;
+	int			worker_id;		/* Worker number as in the server log */
+	bool		hot;			/* Taken off the hot queue */
+	int			items;
+	int			failed;
+	int64		stage_us[BATCH_NSTAGES];
+	int64		total_us;
+	int64		peak_memory;	/* Bytes */
+} BatchRecord;
+
+typedef struct BatchStatsShared
+{
+	LWLock	   *lock;
+	int64		batches;
+	int64		items;
+	int64		failed;
+	int64		stage_us[BATCH_NSTAGES];
+	int64		total_us;
+	int64		max_total_us;
+	int64		peak_memory_sum;
+	int64		max_peak_memory;
+	TimestampTz stats_reset;
+	uint64		nrecorded;		/* Batches ever added to the ring */
+	BatchRecord recent[RECENT_BATCHES];
+} BatchStatsShared;
+
+/* The batch this process is timing */
+typedef struct BatchTiming
+{
+	bool		active;
+	bool		hot;
+	instr_time	start;
+	instr_time	stage_start[BATCH_NSTAGES];
+	double		stage_secs[BATCH_NSTAGES];
+	int64		peak_memory;
+} BatchTiming;
+
+static BatchStatsShared *batch_stats = NULL;
+static BatchTiming batch;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void batch_stats_shmem_request(void);
+static void batch_stats_shmem_startup(void);
+static void sample_memory(void);
+
+/*
+ * Request shared memory and the lock for the batch statistics
+ *
+ * Called during _PG_init when shared_preload_libraries is processed.
+ */
+void
+batch_stats_init(void)
+{
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = batch_stats_shmem_request;
+#else
+	batch_stats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = batch_stats_shmem_startup;
+}
+
+static void
+batch_stats_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(sizeof(BatchStatsShared));
+	RequestNamedLWLockTranche("pgedge_vectorizer_batch_stats", 1);
+}
+
+static void
+batch_stats_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	batch_stats = ShmemInitStruct("pgedge_vectorizer batch stats",
+								  sizeof(BatchStatsShared), &found);
+	if (!found)
+	{
+		memset(batch_stats, 0, sizeof(BatchStatsShared));
+		batch_stats->lock = &(GetNamedLWLockTranche("pgedge_vectorizer_batch_stats"))->lock;
+		batch_stats->stats_reset = GetCurrentTimestamp();
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Note the memory allocated in the batch's transaction so far
+ */
+static void
+sample_memory(void)
+{
+	int64		allocated;
+
+	if (!IsTransactionState())
+		return;
+
+	allocated = (int64) MemoryContextMemAllocated(TopTransactionContext, true);
+	if (allocated > batch.peak_memory)
+		batch.peak_memory = allocated;
+}
+
+/*
+ * Start timing a batch; forgets any batch left unfinished by an error
+ */
+void
+batch_stats_begin(bool hot)
+{
+	memset(&batch, 0, sizeof(BatchTiming));
+	batch.active = true;
+	batch.hot = hot;
+	INSTR_TIME_SET_CURRENT(batch.start);
+}
+
+void
+batch_stats_stage_begin(BatchStage stage)
+{
+	if (!batch.active)
+		return;
+
+	INSTR_TIME_SET_CURRENT(batch.stage_start[stage]);
+}
+
+void
+batch_stats_stage_end(BatchStage stage)
+{
+	instr_time	duration;
+
+	if (!batch.active)
+		return;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, batch.stage_start[stage]);
+	batch.stage_secs[stage] += INSTR_TIME_GET_DOUBLE(duration);
+	sample_memory();
+}
+
+/*
+ * Add time measured elsewhere, e.g. by the provider, to a stage
+ */
+void
+batch_stats_add(BatchStage stage, double secs)
+{
+	if (!batch.active)
+		return;
+
+	batch.stage_secs[stage] += secs;
+	sample_memory();
+}
+
+/*
+ * Time spent so far in a stage of the batch being timed
+ */
+double
+batch_stats_stage_secs(BatchStage stage)
+{
+	return batch.active ? batch.stage_secs[stage] : 0.0;
+}
+
+/*
+ * Record the batch being timed once its transaction has committed
+ */
+void
+batch_stats_finish(int worker_id, int items, int failed)
+{
+	instr_time	total;
+	double		secs[BATCH_NSTAGES];
+	double		total_secs;
+	double		staged = 0.0;
+	BatchRecord *rec;
+
+	if (!batch.active)
+		return;
+	batch.active = false;
+
+	if (items == 0 || batch_stats == NULL)
+		return;
+
+	INSTR_TIME_SET_CURRENT(total);
+	INSTR_TIME_SUBTRACT(total, batch.start);
+	total_secs = INSTR_TIME_GET_DOUBLE(total);
+
+	/* Take the nested stages out of the ones they ran in */
+	memcpy(secs, batch.stage_secs, sizeof(secs));
+	secs[BATCH_STAGE_REQUEST_BUILD] = Max(secs[BATCH_STAGE_REQUEST_BUILD] -
+										  secs[BATCH_STAGE_HTTP] -
+										  secs[BATCH_STAGE_PARSE], 0.0);
+	secs[BATCH_STAGE_WRITE] = Max(secs[BATCH_STAGE_WRITE] -
+								  secs[BATCH_STAGE_BM25_TOKENIZE] -
+								  secs[BATCH_STAGE_BM25_SCORE] -
+								  secs[BATCH_STAGE_BM25_IDF], 0.0);
+	for (int s = 0; s < BATCH_STAGE_OTHER; s++)
+		staged += secs[s];
+	secs[BATCH_STAGE_OTHER] = Max(total_secs - staged, 0.0);
+
+	LWLockAcquire(batch_stats->lock, LW_EXCLUSIVE);
+
+	rec = &batch_stats->recent[batch_stats->nrecorded % RECENT_BATCHES];
+	batch_stats->nrecorded++;
+
+	rec->finished_at = GetCurrentTimestamp();
+	rec->worker_id = worker_id + 1;
+	rec->hot = batch.hot;
+	rec->items = items;
+	rec->failed = failed;
+	rec->total_us = (int64) (total_secs * 1000000.0);
+	rec->peak_memory = batch.peak_memory;
+	for (int s = 0; s < BATCH_NSTAGES; s++)
+	{
+		rec->stage_us[s] = (int64) (secs[s] * 1000000.0);
+		batch_stats->stage_us[s] += rec->stage_us[s];
+	}
+
+	batch_stats->batches++;
+	batch_stats->items += items;
+	batch_stats->failed += failed;
+	batch_stats->total_us += rec->total_us;
+	batch_stats->max_total_us = Max(batch_stats->max_total_us, rec->total_us);
+	batch_stats->peak_memory_sum += rec->peak_memory;
+	batch_stats->max_peak_memory = Max(batch_stats->max_peak_memory, rec->peak_memory);
+
+	LWLockRelease(batch_stats->lock);
+}
+
+/*
+ * Cumulative batch counts and time per stage since the last reset
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_batch_stats);
+
+Datum
+pgedge_vectorizer_batch_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	BatchStatsShared *copy;
+	Datum		values[BATCH_NSTAGES + 8];
+	bool		nulls[BATCH_NSTAGES + 8];
+	int			col = 0;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	memset(nulls, 0, sizeof(nulls));
+	copy = palloc0(offsetof(BatchStatsShared, recent));
+
+	if (batch_stats != NULL)
+	{
+		LWLockAcquire(batch_stats->lock, LW_SHARED);
+		memcpy(copy, batch_stats, offsetof(BatchStatsShared, recent));
+		LWLockRelease(batch_stats->lock);
+	}
+
+	values[col++] = Int64GetDatum(copy->batches);
+	values[col++] = Int64GetDatum(copy->items);
+	values[col++] = Int64GetDatum(copy->failed);
+	for (int s = 0; s < BATCH_NSTAGES; s++)
+		values[col++] = Float8GetDatum(copy->stage_us[s] / 1000.0);
+	values[col++] = Float8GetDatum(copy->total_us / 1000.0);
+	values[col++] = Float8GetDatum(copy->max_total_us / 1000.0);
+	values[col++] = Int64GetDatum(copy->batches > 0 ? copy->peak_memory_sum / copy->batches : 0);
+	values[col++] = Int64GetDatum(copy->max_peak_memory);
+	if (batch_stats != NULL)
+		values[col++] = TimestampTzGetDatum(copy->stats_reset);
+	else
+		nulls[col++] = true;
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * The most recent batches with their time per stage, newest first
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_recent_batches);
+
+Datum
+pgedge_vectorizer_recent_batches(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	BatchRecord *recent;
+	uint64		nrecorded = 0;
+	int			n;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+		!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "set-valued function called in a context that cannot accept a set");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	recent = palloc(sizeof(BatchRecord) * RECENT_BATCHES);
+
+	if (batch_stats != NULL)
+	{
+		LWLockAcquire(batch_stats->lock, LW_SHARED);
+		nrecorded = batch_stats->nrecorded;
+		memcpy(recent, batch_stats->recent, sizeof(BatchRecord) * RECENT_BATCHES);
+		LWLockRelease(batch_stats->lock);
+	}
+
+	n = (int) Min(nrecorded, RECENT_BATCHES);
+
+	for (int i = 0; i < n; i++)
+	{
+		BatchRecord *rec = &recent[(nrecorded - 1 - i) % RECENT_BATCHES];
+		Datum		values[BATCH_NSTAGES + 7];
+		bool		nulls[BATCH_NSTAGES + 7];
+		int			col = 0;
+
+		memset(nulls, 0, sizeof(nulls));
+		values[col++] = TimestampTzGetDatum(rec->finished_at);
+		values[col++] = Int32GetDatum(rec->worker_id);
+		values[col++] = CStringGetTextDatum(rec->hot ? "hot" : "queue");
+		values[col++] = Int32GetDatum(rec->items);
+		values[col++] = Int32GetDatum(rec->failed);
+		for (int s = 0; s < BATCH_NSTAGES; s++)
+			values[col++] = Float8GetDatum(rec->stage_us[s] / 1000.0);
+		values[col++] = Float8GetDatum(rec->total_us / 1000.0);
+		values[col++] = Int64GetDatum(rec->peak_memory);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Zero the cumulative counters and forget the recent batches
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_reset_batch_stats);
+
+Datum
+pgedge_vectorizer_reset_batch_stats(PG_FUNCTION_ARGS)
+{
+	if (batch_stats != NULL)
+	{
+		LWLock	   *lock = batch_stats->lock;
+
+		LWLockAcquire(lock, LW_EXCLUSIVE);
+		memset(batch_stats, 0, sizeof(BatchStatsShared));
+		batch_stats->lock = lock;
+		batch_stats->stats_reset = GetCurrentTimestamp();
+		LWLockRelease(lock);
+	}
+
+	PG_RETURN_VOID();
+}
@@ -0,0 +1,579 @@
+/*-------------------------------------------------------------------------
+ *
+ * bench.c
+ *		Micro-benchmarks for the chunking, tokenizing and parsing kernels
+ *
+ * This file implements SQL-callable functions that run one of the
+ * extension's CPU-bound kernels repeatedly over a supplied or generated
+ * corpus and report throughput and memory usage.  Every iteration runs in
+ * a private memory context that is reset afterwards, so the context sizes
+ * reflect a single call of the kernel.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "bm25.h"
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "mb/pg_wchar.h"
+#include "portability/instr_time.h"
+#include "utils/array.h"
+#include "utils/memutils.h"
+
+/* Upper bound on generated corpus size, well below MaxAllocSize */
+#define BENCH_MAX_CORPUS_BYTES	(64 * 1024 * 1024)
+
+/* Dimension used for generated provider responses */
+#define BENCH_EMBEDDING_DIM		1536
+
+/* Number of output columns of bench_kernel() */
+#define BENCH_RESULT_COLS		8
+
+/*
+ * Kernels that can be benchmarked
+ */
+typedef enum
+{
+	BENCH_KERNEL_TOKEN,
+	BENCH_KERNEL_MARKDOWN,
+	BENCH_KERNEL_HYBRID,
+	BENCH_KERNEL_BM25_TOKENIZE,
+	BENCH_KERNEL_OPENAI_PARSE,
+	BENCH_KERNEL_OLLAMA_PARSE
+} BenchKernel;
+
+/* Words used to build synthetic prose */
+static const char *const bench_words[] = {
+	"the", "database", "vector", "query", "index", "table", "search",
+	"embedding", "model", "text", "result", "chunk", "document", "worker",
+	"queue", "provider", "batch", "system", "performance", "memory",
+	"retrieval", "semantic", "context", "heading", "section", "paragraph",
+	"replication", "cluster", "node", "transaction", "latency", "throughput",
+	"storage", "format", "value", "number", "process", "update", "insert",
+	"select"
+};
+
+#define BENCH_NWORDS	lengthof(bench_words)
+
+/* Forward declarations */
+static BenchKernel parse_bench_kernel(const char *name);
+static char *generate_corpus(const char *kind, int target_bytes);
+static int64 run_kernel(BenchKernel kernel, const char *corpus,
+						int embedding_count, ChunkConfig *config);
+
+/*
+ * Small deterministic PRNG so generated corpora are identical across runs
+ * and platforms; quality is irrelevant here.
+ */
+static inline uint32
+bench_rand(uint32 *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return (*state >> 16) & 0x7fff;
+}
+
+/*
+ * Append a sentence of random words, capitalised and terminated by ". "
+ */
+static void
+append_sentence(StringInfo buf, uint32 *state, int min_words, int max_words)
+{
+	int nwords = min_words + bench_rand(state) % (max_words - min_words + 1);
+
+	for (int i = 0; i < nwords; i++)
+	{
+		const char *word = bench_words[bench_rand(state) % BENCH_NWORDS];
+
+		if (i == 0)
+		{
+			appendStringInfoChar(buf, pg_toupper((unsigned char) word[0]));
+			appendStringInfoString(buf, word + 1);
+		}
+		else
+		{
+			appendStringInfoChar(buf, ' ');
+			appendStringInfoString(buf, word);
+		}
+	}
+	appendStringInfoString(buf, ". ");
+}
+
+/*
+ * Append one UTF-8 encoded code point in the BMP
+ */
+static void
+append_utf8_bmp(StringInfo buf, uint32 cp)
+{
+	appendStringInfoChar(buf, (char) (0xE0 | (cp >> 12)));
+	appendStringInfoChar(buf, (char) (0x80 | ((cp >> 6) & 0x3F)));
+	appendStringInfoChar(buf, (char) (0x80 | (cp & 0x3F)));
+}
+
+static void
+generate_prose(StringInfo buf, int target, uint32 *state)
+{
+	int sentence = 0;
+
+	while (buf->len < target)
+	{
+		append_sentence(buf, state, 8, 20);
+		if (++sentence % 5 == 0)
+			appendStringInfoString(buf, "\n\n");
+	}
+}
+
+static void
+generate_markdown(StringInfo buf, int target, uint32 *state)
+{
+	int section = 0;
+
+	appendStringInfoString(buf, "# Benchmark Document\n\n");
+
+	while (buf->len < target)
+	{
+		int nitems;
+
+		section++;
+		appendStringInfo(buf, "## Section %d\n\n", section);
+
+		for (int i = 0; i < 3; i++)
+			append_sentence(buf, state, 8, 20);
+		appendStringInfoString(buf, "\n\n");
+
+		nitems = 3 + bench_rand(state) % 3;
+		for (int i = 0; i < nitems; i++)
+		{
+			appendStringInfoString(buf, "- ");
+			append_sentence(buf, state, 4, 10);
+			appendStringInfoChar(buf, '\n');
+		}
+		appendStringInfoChar(buf, '\n');
+
+		if (section % 3 == 0)
+		{
+			appendStringInfoString(buf, "```sql\n");
+			appendStringInfo(buf, "SELECT id, content FROM docs_%d\n", section);
+			appendStringInfoString(buf, "WHERE embedding IS NOT NULL\n");
+			appendStringInfoString(buf, "ORDER BY id LIMIT 10;\n```\n\n");
+		}
+
+		if (section % 4 == 0)
+		{
+			appendStringInfoString(buf, "| Setting | Value |\n|---|---|\n");
+			for (int i = 0; i < 3; i++)
+				appendStringInfo(buf, "| %s | %u |\n",
+								 bench_words[bench_rand(state) % BENCH_NWORDS],
+								 bench_rand(state));
+			appendStringInfoChar(buf, '\n');
+		}
+
+		if (section % 5 == 0)
+		{
+			appendStringInfoString(buf, "> ");
+			append_sentence(buf, state, 8, 16);
+			appendStringInfoString(buf, "\n\n");
+		}
+	}
+}
+
+static void
+generate_code(StringInfo buf, int target, uint32 *state)
+{
+	int func = 0;
+
+	while (buf->len < target)
+	{
+		uint32 a = bench_rand(state);
+		uint32 b = bench_rand(state);
+
+		func++;
+		appendStringInfo(buf,
+						 "/*\n * %s %s\n */\n"
+						 "static int\nfunc_%d(int arg)\n{\n"
+						 "\tint result = arg * %u;\n\n"
+						 "\tif (result > %u)\n\t\treturn result - %u;\n"
+						 "\treturn result;\n}\n\n",
+						 bench_words[a % BENCH_NWORDS],
+						 bench_words[b % BENCH_NWORDS],
+						 func, a, b, b);
+	}
+}
+
+static void
+generate_cjk(StringInfo buf, int target, uint32 *state)
+{
+	int sentence = 0;
+
+	while (buf->len < target)
+	{
+		int nchars = 10 + bench_rand(state) % 21;
+
+		/* CJK Unified Ideographs, U+4E00 .. U+9FA5 */
+		for (int i = 0; i < nchars; i++)
+			append_utf8_bmp(buf, 0x4E00 + bench_rand(state) % 0x51A6);
+
+		/* Ideographic full stop */
+		append_utf8_bmp(buf, 0x3002);
+
+		if (++sentence % 8 == 0)
+			appendStringInfoString(buf, "\n\n");
+	}
+}
+
+/*
+ * Append a JSON array of dim pseudo-random embedding values
+ */
+static void
+append_embedding_json(StringInfo buf, int dim, uint32 *state)
+{
+	appendStringInfoChar(buf, '[');
+	for (int i = 0; i < dim; i++)
+	{
+		int v = (int) bench_rand(state) - 16384;
+
+		if (i > 0)
+			appendStringInfoChar(buf, ',');
+		appendStringInfo(buf, "%.6f", v / 163840.0);
+	}
+	appendStringInfoChar(buf, ']');
+}
+
+static void
+generate_openai_json(StringInfo buf, int target, uint32 *state)
+{
+	/* Roughly 10 bytes per value */
+	int count = Max(1, target / (BENCH_EMBEDDING_DIM * 10));
+
+	appendStringInfoString(buf, "{\"object\":\"list\",\"data\":[");
+	for (int i = 0; i < count; i++)
+	{
+		if (i > 0)
+			appendStringInfoChar(buf, ',');
+		appendStringInfo(buf, "{\"object\":\"embedding\",\"index\":%d,\"embedding\":", i);
+		append_embedding_json(buf, BENCH_EMBEDDING_DIM, state);
+		appendStringInfoChar(buf, '}');
+	}
+	appendStringInfo(buf, "],\"model\":\"bench\",\"usage\":{\"prompt_tokens\":%d,\"total_tokens\":%d}}",
+					 count * 100, count * 100);
+}
+
+static void
+generate_ollama_json(StringInfo buf, int target, uint32 *state)
+{
+	/* A single embedding whose dimension scales with the target size */
+	appendStringInfoString(buf, "{\"embedding\":");
+	append_embedding_json(buf, Max(16, target / 10), state);
+	appendStringInfoChar(buf, '}');
+}
+
+/*
+ * Generate a deterministic synthetic corpus of roughly target_bytes
+ *
+ * Text corpora are cut to exactly target_bytes (on a character boundary);
+ * JSON corpora are kept well-formed and so only approximate the size.
+ */
+static char *
+generate_corpus(const char *kind, int target_bytes)
+{
+	StringInfoData buf;
+	uint32 state = 42;
+	bool is_text = true;
+
+	if (target_bytes <= 0 || target_bytes > BENCH_MAX_CORPUS_BYTES)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("corpus size must be between 1 and %d bytes",
+						BENCH_MAX_CORPUS_BYTES)));
+
+	initStringInfo(&buf);
+
+	if (pg_strcasecmp(kind, "prose") == 0)
+		generate_prose(&buf, target_bytes, &state);
+	else if (pg_strcasecmp(kind, "markdown") == 0)
+		generate_markdown(&buf, target_bytes, &state);
+	else if (pg_strcasecmp(kind, "code") == 0)
+		generate_code(&buf, target_bytes, &state);
+	else if (pg_strcasecmp(kind, "cjk") == 0)
+		generate_cjk(&buf, target_bytes, &state);
+	else if (pg_strcasecmp(kind, "openai_json") == 0)
+	{
+		generate_openai_json(&buf, target_bytes, &state);
+		is_text = false;
+	}
+	else if (pg_strcasecmp(kind, "ollama_json") == 0)
+	{
+		generate_ollama_json(&buf, target_bytes, &state);
+		is_text = false;
+	}
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("unknown corpus kind \"%s\"", kind),
+				 errhint("Valid kinds are prose, markdown, code, cjk, openai_json and ollama_json.")));
+
+	if (is_text && buf.len > target_bytes)
+	{
+		int len = target_bytes;
+
+		/* Never leave a partial UTF-8 sequence at the end */
+		while (len > 0 && (buf.data[len] & 0xC0) == 0x80)
+			len--;
+		buf.data[len] = '\0';
+		buf.len = len;
+	}
+
+	return buf.data;
+}
+
+static BenchKernel
+parse_bench_kernel(const char *name)
+{
+	if (pg_strcasecmp(name, "token_based") == 0)
+		return BENCH_KERNEL_TOKEN;
+	else if (pg_strcasecmp(name, "markdown") == 0)
+		return BENCH_KERNEL_MARKDOWN;
+	else if (pg_strcasecmp(name, "hybrid") == 0)
+		return BENCH_KERNEL_HYBRID;
+	else if (pg_strcasecmp(name, "bm25_tokenize") == 0)
+		return BENCH_KERNEL_BM25_TOKENIZE;
+	else if (pg_strcasecmp(name, "openai_parse") == 0)
+		return BENCH_KERNEL_OPENAI_PARSE;
+	else if (pg_strcasecmp(name, "ollama_parse") == 0)
+		return BENCH_KERNEL_OLLAMA_PARSE;
+
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("unknown benchmark kernel \"%s\"", name),
+			 errhint("Valid kernels are token_based, markdown, hybrid, bm25_tokenize, openai_parse and ollama_parse.")));
+	return BENCH_KERNEL_TOKEN;	/* keep compiler quiet */
+}
+
+/*
+ * Count the embeddings in a provider response so the batch parser can be
+ * told how many to expect, as the provider would be.  Only "embedding"
+ * keys count; OpenAI also uses the string as the value of "object".
+ */
+static int
+count_embeddings(const char *json)
+{
+	int count = 0;
+	const char *p = json;
+
+	while ((p = strstr(p, "\"embedding\"")) != NULL)
+	{
+		p += strlen("\"embedding\"");
+		while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+			p++;
+		if (*p == ':')
+			count++;
+	}
+	return count;
+}
+
+/*
+ * Run one iteration of a kernel and return the number of items it produced
+ * (chunks, terms or embeddings).
+ */
+static int64
+run_kernel(BenchKernel kernel, const char *corpus, int embedding_count,
+		   ChunkConfig *config)
+{
+	ArrayType *chunks;
+	int ntokens;
+	int dim = 0;
+	char *error_msg = NULL;
+
+	switch (kernel)
+	{
+		case BENCH_KERNEL_TOKEN:
+			chunks = chunk_by_tokens(corpus, config);
+			return ArrayGetNItems(ARR_NDIM(chunks), ARR_DIMS(chunks));
+
+		case BENCH_KERNEL_MARKDOWN:
+			chunks = chunk_markdown(corpus, config);
+			return ArrayGetNItems(ARR_NDIM(chunks), ARR_DIMS(chunks));
+
+		case BENCH_KERNEL_HYBRID:
+			chunks = chunk_hybrid(corpus, config);
+			return ArrayGetNItems(ARR_NDIM(chunks), ARR_DIMS(chunks));
+
+		case BENCH_KERNEL_BM25_TOKENIZE:
+			(void) bm25_tokenize(corpus, &ntokens);
+			return ntokens;
+
+		case BENCH_KERNEL_OPENAI_PARSE:
+			if (openai_parse_embedding_response(corpus, embedding_count,
+												&dim, &error_msg) == NULL)
+				elog(ERROR, "failed to parse embedding response: %s",
+					 error_msg ? error_msg : "unknown error");
+			return embedding_count;
+
+		case BENCH_KERNEL_OLLAMA_PARSE:
+			if (ollama_parse_embedding_response(corpus, &dim, &error_msg) == NULL)
+				elog(ERROR, "failed to parse embedding response: %s",
+					 error_msg ? error_msg : "unknown error");
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * SQL-callable function returning a generated benchmark corpus
+ *
+ * Useful for inspecting what the benchmarks run over, or for feeding the
+ * same input to chunk_text() and friends.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_bench_corpus);
+
+Datum
+pgedge_vectorizer_bench_corpus(PG_FUNCTION_ARGS)
+{
+	char *kind = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	int target_bytes = PG_GETARG_INT32(1);
+	char *corpus;
+
+	if (pg_strcasecmp(kind, "cjk") == 0 && GetDatabaseEncoding() != PG_UTF8)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("the cjk corpus can only be returned in a UTF8 database")));
+
+	corpus = generate_corpus(kind, target_bytes);
+
+	PG_RETURN_TEXT_P(cstring_to_text(corpus));
+}
+
+/*
+ * SQL-callable micro-benchmark
+ *
+ * Runs the named kernel 'iterations' times over the supplied corpus, or a
+ * generated one of the given kind and size, and returns timing and memory
+ * figures.  Chunk size and overlap default to the configured defaults.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_bench_kernel);
+
+Datum
+pgedge_vectorizer_bench_kernel(PG_FUNCTION_ARGS)
+{
+	BenchKernel kernel;
+	int iterations;
+	char *corpus;
+	const char *kind;
+	int64 input_bytes;
+	int embedding_count = 0;
+	ChunkConfig config;
+	MemoryContext bench_context;
+	MemoryContext old_context;
+	instr_time start_time;
+	instr_time duration;
+	instr_time total_time;
+	int64 items = 0;
+	int64 retained_total = 0;
+	int64 peak_bytes = 0;
+	double total_sec;
+	TupleDesc tupdesc;
+	Datum values[BENCH_RESULT_COLS];
+	bool nulls[BENCH_RESULT_COLS];
+
+	if (PG_ARGISNULL(0))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("benchmark kernel cannot be NULL")));
+
+	kernel = parse_bench_kernel(text_to_cstring(PG_GETARG_TEXT_PP(0)));
+	iterations = PG_ARGISNULL(1) ? 100 : PG_GETARG_INT32(1);
+
+	if (iterations <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("iterations must be positive")));
+
+	/* Use the supplied corpus, or generate one */
+	if (!PG_ARGISNULL(2))
+		corpus = text_to_cstring(PG_GETARG_TEXT_PP(2));
+	else
+	{
+		if (!PG_ARGISNULL(3))
+			kind = text_to_cstring(PG_GETARG_TEXT_PP(3));
+		else if (kernel == BENCH_KERNEL_OPENAI_PARSE)
+			kind = "openai_json";
+		else if (kernel == BENCH_KERNEL_OLLAMA_PARSE)
+			kind = "ollama_json";
+		else
+			kind = "prose";
+
+		corpus = generate_corpus(kind,
+								 PG_ARGISNULL(4) ? 65536 : PG_GETARG_INT32(4));
+	}
+
+	/* flawfinder: ignore - corpus is null-terminated */
+	input_bytes = strlen(corpus);
+
+	if (kernel == BENCH_KERNEL_OPENAI_PARSE)
+	{
+		embedding_count = count_embeddings(corpus);
+		if (embedding_count == 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("corpus does not contain any embeddings")));
+	}
+
+	config.strategy = CHUNK_STRATEGY_TOKEN;
+	config.chunk_size = PG_ARGISNULL(5) ?
+		pgedge_vectorizer_default_chunk_size : PG_GETARG_INT32(5);
+	config.overlap = PG_ARGISNULL(6) ?
+		pgedge_vectorizer_default_chunk_overlap : PG_GETARG_INT32(6);
+	config.separators = NULL;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	bench_context = AllocSetContextCreate(CurrentMemoryContext,
+										  "pgedge_vectorizer benchmark",
+										  ALLOCSET_DEFAULT_SIZES);
+
+	INSTR_TIME_SET_ZERO(total_time);
+
+	for (int i = 0; i < iterations; i++)
+	{
+		int64 used;
+
+		CHECK_FOR_INTERRUPTS();
+
+		old_context = MemoryContextSwitchTo(bench_context);
+
+		INSTR_TIME_SET_CURRENT(start_time);
+		items = run_kernel(kernel, corpus, embedding_count, &config);
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start_time);
+		INSTR_TIME_ADD(total_time, duration);
+
+		MemoryContextSwitchTo(old_context);
+
+		/* Block space the context holds, not the bytes the kernel asked for */
+		used = MemoryContextMemAllocated(bench_context, true);
+		retained_total += used;
+		peak_bytes = Max(peak_bytes, used);
+
+		MemoryContextReset(bench_context);
+	}
+
+	MemoryContextDelete(bench_context);
+
+	total_sec = INSTR_TIME_GET_DOUBLE(total_time);
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = CStringGetTextDatum(text_scan_implementation());
+	values[1] = Int64GetDatum(input_bytes);
+	values[2] = Float8GetDatum(total_sec * 1000.0);
+	values[3] = Float8GetDatum(total_sec > 0 ?
+							   (double) input_bytes * iterations / (1024.0 * 1024.0) / total_sec : 0);
+	values[4] = Int64GetDatum(items);
+	values[5] = Float8GetDatum(total_sec > 0 ? (double) items * iterations / total_sec : 0);
+	values[6] = Int64GetDatum(retained_total / iterations);
+	values[7] = Int64GetDatum(peak_bytes);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
@@ -21,6 +21,7 @@
 
 #include "access/xact.h"
 #include "lib/stringinfo.h"
+#include "portability/instr_time.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/errcodes.h"
@@ -685,6 +686,8 @@ pgedge_vectorizer_bm25_query_vector(PG_FUNCTION_ARGS)
 	int         ntokens;
 	float8      avg_doc_len;
 	Datum       result;
+	instr_time  idf_start;
+	instr_time  idf_duration;
 
 	if (PG_ARGISNULL(0) || PG_ARGISNULL(1))
 		ereport(ERROR,
@@ -701,7 +704,14 @@ pgedge_vectorizer_bm25_query_vector(PG_FUNCTION_ARGS)
 	SPI_connect();
 
 	tokens      = bm25_tokenize(query, &ntokens);
+
+	/* Timed for hybrid_search()'s profile; see search_stats.c */
+	INSTR_TIME_SET_CURRENT(idf_start);
 	idf_htab    = bm25_load_idf_stats(chunk_table);
+	INSTR_TIME_SET_CURRENT(idf_duration);
+	INSTR_TIME_SUBTRACT(idf_duration, idf_start);
+	search_stats_note_idf_load(INSTR_TIME_GET_DOUBLE(idf_duration));
+
 	avg_doc_len = bm25_avg_doc_len_internal(chunk_table);
 
 	result = bm25_compute_sparse_vector(
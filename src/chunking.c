@@ -10,13 +10,72 @@
  *-------------------------------------------------------------------------
  */
 #include "pgedge_vectorizer.h"
+
+#include <ctype.h>
+
+#include "access/htup_details.h"
 #include "catalog/pg_type.h"
+#include "funcapi.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
 
+/*
+ * Boundary strength used by the sentence and recursive strategies, from
+ * the strongest (blank line) to the weakest (any whitespace).  Text with
+ * no usable boundary at all is cut by token count.
+ */
+typedef enum
+{
+	BOUNDARY_PARAGRAPH,
+	BOUNDARY_LINE,
+	BOUNDARY_SENTENCE,
+	BOUNDARY_WORD,
+	BOUNDARY_NONE
+} BoundaryLevel;
+
+/*
+ * A run of whitespace between two segments: the previous segment ends at
+ * 'end' and the next one starts at 'next'.
+ */
+typedef struct TextBoundary
+{
+	int end;
+	int next;
+	BoundaryLevel level;
+} TextBoundary;
+
+/*
+ * A segment of text that fits in one chunk and is never split further
+ */
+typedef struct TextPiece
+{
+	int start;
+	int end;
+	int chars;
+} TextPiece;
+
+/*
+ * State shared while splitting one document into pieces
+ */
+typedef struct PieceBuilder
+{
+	const char *text;
+	TextBoundary *boundaries;
+	int nboundaries;
+	int chunk_size;
+	TextPiece *pieces;
+	int npieces;
+	int pieces_cap;
+} PieceBuilder;
+
 /* Forward declarations */
 /* chunk_by_tokens is declared in header for use by hybrid_chunking.c fallback */
+static char *prepare_chunk_content(const char *content, int *content_len,
+								   bool *should_free);
+static ArrayType *text_list_to_array(List *chunks);
+static ArrayType *chunk_by_boundaries(const char *content, ChunkConfig *config,
+									  BoundaryLevel first_level);
 
 /*
  * Parse chunk strategy string
@@ -72,9 +131,13 @@ chunk_text(const char *content, ChunkConfig *config)
 		case CHUNK_STRATEGY_MARKDOWN:
 			return chunk_markdown(content, config);
 
-		case CHUNK_STRATEGY_SEMANTIC:
 		case CHUNK_STRATEGY_SENTENCE:
+			return chunk_by_sentences(content, config);
+
 		case CHUNK_STRATEGY_RECURSIVE:
+			return chunk_recursive(content, config);
+
+		case CHUNK_STRATEGY_SEMANTIC:
 			/* Not yet implemented - fall back to token-based */
 			elog(WARNING, "Chunking strategy not yet implemented, using token_based");
 			return chunk_by_tokens(content, config);
@@ -89,14 +152,14 @@ chunk_text(const char *content, ChunkConfig *config)
  * Strip non-ASCII characters from text
  *
  * Replaces non-ASCII characters with spaces to avoid API issues.
+ * The length of the result is returned in *result_len so callers do
+ * not have to measure it again.
  */
 static char *
-strip_non_ascii(const char *text)
+strip_non_ascii(const char *text, int *result_len)
 {
 	int len;
 	char *result;
-	int i;
-	int j;
 
 	if (text == NULL)
 		return NULL;
@@ -104,27 +167,60 @@ strip_non_ascii(const char *text)
 	/* flawfinder: ignore - text from PostgreSQL text datum is null-terminated */
 	len = strlen(text);
 	result = palloc(len + 1);
-	j = 0;
 
-	for (i = 0; i < len; i++)
+	/* Runs of non-ASCII bytes collapse to a single space (vectorized) */
+	*result_len = (int) text_strip_non_ascii(result, text, len);
+
+	return result;
+}
+
+/*
+ * Apply the strip_non_ascii setting to content before chunking
+ *
+ * Returns the text to chunk and its length; *should_free is set when the
+ * result is a new allocation the caller must pfree().
+ */
+static char *
+prepare_chunk_content(const char *content, int *content_len, bool *should_free)
+{
+	if (pgedge_vectorizer_strip_non_ascii)
 	{
-		unsigned char c = (unsigned char) text[i];
+		*should_free = true;
+		return strip_non_ascii(content, content_len);
+	}
 
-		if (c < 128)
-		{
-			/* ASCII character - keep it */
-			result[j++] = text[i];
-		}
-		else
-		{
-			/* Non-ASCII character - replace with space */
-			/* Skip consecutive non-ASCII to avoid multiple spaces */
-			if (j > 0 && result[j - 1] != ' ')
-				result[j++] = ' ';
-		}
+	*should_free = false;
+	/* flawfinder: ignore - content is null-terminated (from PG) */
+	*content_len = strlen(content);
+	return (char *) content;
+}
+
+/*
+ * Convert a list of text chunks into a PostgreSQL text array
+ */
+static ArrayType *
+text_list_to_array(List *chunks)
+{
+	int n_chunks = list_length(chunks);
+	Datum *chunk_datums;
+	ArrayType *result;
+	ListCell *lc;
+	int i = 0;
+
+	if (n_chunks == 0)
+		return construct_empty_array(TEXTOID);
+
+	chunk_datums = (Datum *) palloc(n_chunks * sizeof(Datum));
+
+	foreach(lc, chunks)
+	{
+		chunk_datums[i++] = PointerGetDatum(lfirst(lc));
 	}
 
-	result[j] = '\0';
+	result = construct_array(chunk_datums, n_chunks, TEXTOID, -1, false, TYPALIGN_INT);
+
+	pfree(chunk_datums);
+
 	return result;
 }
 
@@ -145,30 +241,18 @@ chunk_by_tokens(const char *content, ChunkConfig *config)
 	List *chunks = NIL;
 	int start_offset = 0;
 	int chunk_num = 0;
-	Datum *chunk_datums;
 	int n_chunks;
 	ArrayType *result;
-	ListCell *lc;
-	int i;
 	char *processed_content;
-	bool should_free = false;
+	bool should_free;
 
 	if (content == NULL || content[0] == '\0')
 		return construct_empty_array(TEXTOID);
 
 	/* Strip non-ASCII characters if configured */
-	if (pgedge_vectorizer_strip_non_ascii)
-	{
-		processed_content = strip_non_ascii(content);
-		should_free = true;
-	}
-	else
-	{
-		processed_content = (char *) content;
-	}
+	processed_content = prepare_chunk_content(content, &content_len,
+											  &should_free);
 
-	/* flawfinder: ignore - processed_content is null-terminated (from PG or strip_non_ascii) */
-	content_len = strlen(processed_content);
 	if (content_len == 0)
 	{
 		if (should_free)
@@ -177,7 +261,8 @@ chunk_by_tokens(const char *content, ChunkConfig *config)
 	}
 
 	/* Count total tokens */
-	total_tokens = count_tokens(processed_content, pgedge_vectorizer_model);
+	total_tokens = count_tokens_len(processed_content, content_len,
+									pgedge_vectorizer_model);
 
 	elog(DEBUG1, "Chunking text: %d chars, ~%d tokens, chunk_size=%d, overlap=%d",
 		 content_len, total_tokens, config->chunk_size, config->overlap);
@@ -185,7 +270,8 @@ chunk_by_tokens(const char *content, ChunkConfig *config)
 	/* If content is smaller than chunk size, return as single chunk */
 	if (total_tokens <= config->chunk_size)
 	{
-		text *chunk_text = cstring_to_text(processed_content);
+		text *chunk_text = cstring_to_text_with_len(processed_content,
+													content_len);
 		chunks = lappend(chunks, chunk_text);
 	}
 	else
@@ -196,11 +282,12 @@ chunk_by_tokens(const char *content, ChunkConfig *config)
 			int target_offset, end_offset;
 			int chunk_tokens;
 			text *chunk_text;
-			char *chunk_str;
+			const char *chunk_str;
 
 			/* Calculate target end offset for this chunk */
-			target_offset = get_char_offset_for_tokens(
+			target_offset = get_char_offset_for_tokens_len(
 				processed_content + start_offset,
+				content_len - start_offset,
 				config->chunk_size,
 				pgedge_vectorizer_model
 			);
@@ -216,22 +303,24 @@ chunk_by_tokens(const char *content, ChunkConfig *config)
 			if (end_offset <= 0)
 				end_offset = target_offset > 0 ? target_offset : content_len - start_offset;
 
-			/* Extract chunk */
-			chunk_str = pnstrdup(processed_content + start_offset, end_offset);
-			chunk_tokens = count_tokens(chunk_str, pgedge_vectorizer_model);
+			/* Extract chunk directly from the source buffer (no copy) */
+			chunk_str = processed_content + start_offset;
+			chunk_tokens = count_tokens_len(chunk_str, end_offset,
+											pgedge_vectorizer_model);
 
 			elog(DEBUG2, "Chunk %d: offset=%d, length=%d, ~%d tokens",
 				 chunk_num, start_offset, end_offset, chunk_tokens);
 
-			chunk_text = cstring_to_text(chunk_str);
+			chunk_text = cstring_to_text_with_len(chunk_str, end_offset);
 			chunks = lappend(chunks, chunk_text);
 
 			/* Move to next chunk, accounting for overlap */
-			/* Calculate overlap offset BEFORE freeing chunk_str */
 			if (config->overlap > 0 && config->overlap < chunk_tokens)
 			{
-				int overlap_offset = get_char_offset_for_tokens(
+				const char *ws;
+				int overlap_offset = get_char_offset_for_tokens_len(
 					chunk_str,  /* Use chunk text, not full remaining text */
+					end_offset,
 					chunk_tokens - config->overlap,
 					pgedge_vectorizer_model
 				);
@@ -241,23 +330,16 @@ chunk_by_tokens(const char *content, ChunkConfig *config)
 				 * the next chunk mid-word. Search forward for a space within
 				 * the chunk, as going backward could result in too much overlap
 				 * and tiny subsequent chunks.
-				 */
-				while (overlap_offset < end_offset &&
-					   chunk_str[overlap_offset] != ' ' &&
-					   chunk_str[overlap_offset] != '\n' &&
-					   chunk_str[overlap_offset] != '\t')
-				{
-					overlap_offset++;
-				}
-
-				/*
-				 * If we reached the end of chunk without finding a space,
+				 *
+				 * If we reach the end of chunk without finding a space,
 				 * use end_offset (no overlap for this chunk).
 				 */
-				if (overlap_offset >= end_offset)
-				{
-					overlap_offset = end_offset;
-				}
+				ws = (overlap_offset < end_offset) ?
+					text_find_any(chunk_str + overlap_offset,
+								  end_offset - overlap_offset, " \n\t", 3) :
+					NULL;
+
+				overlap_offset = (ws != NULL) ? (int) (ws - chunk_str) : end_offset;
 
 				start_offset += overlap_offset;
 			}
@@ -266,7 +348,6 @@ chunk_by_tokens(const char *content, ChunkConfig *config)
 				start_offset += end_offset;
 			}
 
-			pfree(chunk_str);
 			chunk_num++;
 
 			/* Safety check to prevent infinite loop */
@@ -287,28 +368,407 @@ chunk_by_tokens(const char *content, ChunkConfig *config)
 
 	/* Convert list to array */
 	n_chunks = list_length(chunks);
-	chunk_datums = (Datum *) palloc(n_chunks * sizeof(Datum));
+	result = text_list_to_array(chunks);
+	list_free(chunks);
+
+	/* Free processed_content if we allocated it */
+	if (should_free)
+		pfree(processed_content);
+
+	elog(DEBUG1, "Created %d chunks from text", n_chunks);
+
+	return result;
+}
+
+/*
+ * Classify a whitespace run starting at 'start'
+ *
+ * A blank line is a paragraph break and a single newline a line break.
+ * Otherwise the run ends a sentence when it follows terminal punctuation,
+ * optionally followed by a closing quote or bracket.
+ */
+static BoundaryLevel
+classify_boundary(const char *text, int start, int newlines)
+{
+	char prev;
+
+	if (newlines >= 2)
+		return BOUNDARY_PARAGRAPH;
+	if (newlines == 1)
+		return BOUNDARY_LINE;
+
+	prev = text[start - 1];
+	if ((prev == '"' || prev == '\'' || prev == ')') && start >= 2)
+		prev = text[start - 2];
+
+	if (prev == '.' || prev == '?' || prev == '!')
+		return BOUNDARY_SENTENCE;
+
+	return BOUNDARY_WORD;
+}
+
+/*
+ * Find every whitespace run in the text in a single pass
+ *
+ * Leading and trailing whitespace is not a boundary.  Each run is
+ * classified once, so later splitting never rescans the text.
+ */
+static TextBoundary *
+find_text_boundaries(const char *text, int len, int *nboundaries)
+{
+	int cap = 64;
+	int n = 0;
+	int pos = 0;
+	TextBoundary *boundaries = palloc(cap * sizeof(TextBoundary));
+
+	while (pos < len)
+	{
+		const char *ws = text_find_any(text + pos, len - pos, " \n\t", 3);
+		int start;
+		int end;
+		int newlines = 0;
+
+		if (ws == NULL)
+			break;
+
+		start = ws - text;
+		end = start;
+		while (end < len &&
+			   (text[end] == ' ' || text[end] == '\n' ||
+				text[end] == '\t' || text[end] == '\r'))
+		{
+			if (text[end] == '\n')
+				newlines++;
+			end++;
+		}
+
+		/* A carriage return before the newline belongs to the run */
+		while (start > pos && text[start - 1] == '\r')
+			start--;
+
+		if (start > 0 && end < len)
+		{
+			if (n >= cap)
+			{
+				cap *= 2;
+				boundaries = repalloc(boundaries, cap * sizeof(TextBoundary));
+			}
+			boundaries[n].end = start;
+			boundaries[n].next = end;
+			boundaries[n].level = classify_boundary(text, start, newlines);
+			n++;
+		}
+
+		pos = end;
+	}
+
+	*nboundaries = n;
+	return boundaries;
+}
+
+static void
+add_piece(PieceBuilder *pb, int start, int end, int chars)
+{
+	if (pb->npieces >= pb->pieces_cap)
+	{
+		pb->pieces_cap *= 2;
+		pb->pieces = repalloc(pb->pieces, pb->pieces_cap * sizeof(TextPiece));
+	}
+	pb->pieces[pb->npieces].start = start;
+	pb->pieces[pb->npieces].end = end;
+	pb->pieces[pb->npieces].chars = chars;
+	pb->npieces++;
+}
+
+/*
+ * Split text[start, end) into pieces of at most chunk_size tokens
+ *
+ * The range is kept whole when it fits.  Otherwise it is split at every
+ * boundary of the given level or stronger, and segments that are still
+ * too large are split again at the next weaker level.  Text without any
+ * whitespace is finally cut by token count.
+ */
+static void
+split_into_pieces(PieceBuilder *pb, int start, int end, BoundaryLevel level)
+{
+	int chars = (int) utf8_count_chars(pb->text + start, end - start);
+	int lo;
+	int hi;
+	int seg_start;
+
+	if (count_tokens_for_chars(chars, pgedge_vectorizer_model) <= pb->chunk_size)
+	{
+		add_piece(pb, start, end, chars);
+		return;
+	}
+
+	if (level == BOUNDARY_NONE)
+	{
+		while (start < end)
+		{
+			int len = get_char_offset_for_tokens_len(pb->text + start,
+													 end - start,
+													 pb->chunk_size,
+													 pgedge_vectorizer_model);
+
+			if (len <= 0)
+				len = end - start;
+
+			add_piece(pb, start, start + len,
+					  (int) utf8_count_chars(pb->text + start, len));
+			start += len;
+		}
+		return;
+	}
+
+	/* Binary search for the first boundary inside the range */
+	lo = 0;
+	hi = pb->nboundaries;
+	while (lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+
+		if (pb->boundaries[mid].end <= start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	seg_start = start;
+	for (int i = lo; i < pb->nboundaries && pb->boundaries[i].end < end; i++)
+	{
+		TextBoundary *b = &pb->boundaries[i];
+
+		if (b->level > level)
+			continue;
+
+		split_into_pieces(pb, seg_start, b->end, level + 1);
+		seg_start = b->next;
+	}
+
+	if (seg_start == start)
+	{
+		/* No boundary at this level; try the next weaker one */
+		split_into_pieces(pb, start, end, level + 1);
+		return;
+	}
+
+	split_into_pieces(pb, seg_start, end, level + 1);
+}
+
+/*
+ * Characters of the whitespace between piece k and piece k + 1
+ *
+ * Token estimates are not additive, but character counts are: the packing
+ * loop keeps the character count of its span of pieces up to date as
+ * pieces join it, and estimates the span's tokens from that, instead of
+ * measuring the joined text again for every candidate span.  The
+ * whitespace is ASCII, so its length in bytes is its length in characters.
+ */
+static inline int
+gap_chars(PieceBuilder *pb, int k)
+{
+	return pb->pieces[k + 1].start - pb->pieces[k].end;
+}
+
+static inline int
+window_tokens(int64 chars)
+{
+	return count_tokens_for_chars(chars, pgedge_vectorizer_model);
+}
+
+/*
+ * Chunk text at natural boundaries
+ *
+ * Boundaries are found in one pass, the text is split into pieces that
+ * each fit the chunk size (whole paragraphs, lines or sentences where
+ * possible, depending on first_level), and the pieces are packed greedily
+ * into chunks.  Overlap is made of whole trailing pieces of the previous
+ * chunk, so chunks never start or end mid-sentence unless a single
+ * sentence exceeds the chunk size.
+ */
+static ArrayType *
+chunk_by_boundaries(const char *content, ChunkConfig *config,
+					BoundaryLevel first_level)
+{
+	PieceBuilder pb;
+	List *chunks = NIL;
+	ArrayType *result;
+	char *processed_content;
+	int content_len;
+	bool should_free;
+	int overlap;
+	int i;
+	int j;
+	int64 window_chars;
+
+	if (content == NULL || content[0] == '\0')
+		return construct_empty_array(TEXTOID);
+
+	processed_content = prepare_chunk_content(content, &content_len,
+											  &should_free);
 
+	/* Skip surrounding whitespace */
 	i = 0;
-	foreach(lc, chunks)
+	while (i < content_len && isspace((unsigned char) processed_content[i]))
+		i++;
+	while (content_len > i &&
+		   isspace((unsigned char) processed_content[content_len - 1]))
+		content_len--;
+
+	if (content_len <= i)
 	{
-		chunk_datums[i++] = PointerGetDatum(lfirst(lc));
+		if (should_free)
+			pfree(processed_content);
+		return construct_empty_array(TEXTOID);
 	}
 
-	result = construct_array(chunk_datums, n_chunks, TEXTOID, -1, false, TYPALIGN_INT);
+	memset(&pb, 0, sizeof(pb));
+	pb.text = processed_content;
+	pb.chunk_size = Max(config->chunk_size, 1);
+	pb.pieces_cap = 64;
+	pb.pieces = palloc(pb.pieces_cap * sizeof(TextPiece));
+	pb.boundaries = find_text_boundaries(processed_content, content_len,
+										 &pb.nboundaries);
 
-	pfree(chunk_datums);
-	list_free(chunks);
+	split_into_pieces(&pb, i, content_len, first_level);
 
-	/* Free processed_content if we allocated it */
+	overlap = Max(config->overlap, 0);
+
+	/*
+	 * Greedily pack consecutive pieces into chunks.  The window i..j holds
+	 * window_chars characters.  Each chunk starts from the overlap carried
+	 * over from the previous one, so every piece enters the window once
+	 * and no text is counted again.
+	 */
+	i = 0;
+	j = 0;
+	window_chars = pb.pieces[0].chars;
+	while (i < pb.npieces)
+	{
+		int k;
+		int64 overlap_chars;
+
+		while (j + 1 < pb.npieces)
+		{
+			int64 next_chars = window_chars + gap_chars(&pb, j) +
+				pb.pieces[j + 1].chars;
+
+			if (window_tokens(next_chars) > pb.chunk_size)
+				break;
+			j++;
+			window_chars = next_chars;
+		}
+
+		chunks = lappend(chunks,
+						 cstring_to_text_with_len(processed_content + pb.pieces[i].start,
+												  pb.pieces[j].end - pb.pieces[i].start));
+
+		elog(DEBUG2, "Chunk %d: pieces %d-%d, ~%d tokens",
+			 list_length(chunks) - 1, i, j, window_tokens(window_chars));
+
+		if (j + 1 >= pb.npieces)
+			break;
+
+		/*
+		 * Carry whole trailing pieces into the next chunk as overlap, as
+		 * long as they leave room for the next new piece so every chunk
+		 * makes progress.  overlap_chars is the span k..j.
+		 */
+		k = j + 1;
+		overlap_chars = 0;
+		while (k - 1 > i)
+		{
+			int64 wider = overlap_chars + pb.pieces[k - 1].chars +
+				(k - 1 < j ? gap_chars(&pb, k - 1) : 0);
+
+			if (window_tokens(wider) > overlap ||
+				window_tokens(wider + gap_chars(&pb, j) +
+							  pb.pieces[j + 1].chars) > pb.chunk_size)
+				break;
+			overlap_chars = wider;
+			k--;
+		}
+
+		/* The next window starts as the overlap, or as the next piece alone */
+		i = k;
+		if (k > j)
+		{
+			j = k;
+			window_chars = pb.pieces[k].chars;
+		}
+		else
+			window_chars = overlap_chars;
+	}
+
+	result = text_list_to_array(chunks);
+
+	elog(DEBUG1, "Created %d chunks from %d pieces", list_length(chunks),
+		 pb.npieces);
+
+	list_free(chunks);
+	pfree(pb.pieces);
+	pfree(pb.boundaries);
 	if (should_free)
 		pfree(processed_content);
 
-	elog(DEBUG1, "Created %d chunks from text", n_chunks);
-
 	return result;
 }
 
+/*
+ * Sentence-based chunking
+ *
+ * Packs whole sentences (line and paragraph breaks also end a sentence)
+ * into chunks of up to chunk_size tokens.  Sentences longer than a chunk
+ * are split between words.
+ */
+ArrayType *
+chunk_by_sentences(const char *content, ChunkConfig *config)
+{
+	return chunk_by_boundaries(content, config, BOUNDARY_SENTENCE);
+}
+
+/*
+ * Recursive chunking
+ *
+ * Keeps whole paragraphs together where they fit, otherwise whole lines,
+ * then sentences, then words, and packs the result into chunks of up to
+ * chunk_size tokens.
+ */
+ArrayType *
+chunk_recursive(const char *content, ChunkConfig *config)
+{
+	return chunk_by_boundaries(content, config, BOUNDARY_PARAGRAPH);
+}
+
+/*
+ * Read the optional strategy, chunk_size and overlap arguments (1-3) of a
+ * SQL-callable chunking function, using the configured defaults for NULLs
+ */
+static void
+chunk_config_from_args(FunctionCallInfo fcinfo, ChunkConfig *config)
+{
+	char *strategy_str;
+
+	/* Get strategy (default to configured default) */
+	if (PG_ARGISNULL(1))
+		strategy_str = pgedge_vectorizer_default_chunk_strategy;
+	else
+		strategy_str = text_to_cstring(PG_GETARG_TEXT_PP(1));
+
+	config->strategy = parse_chunk_strategy(strategy_str);
+
+	/* Get chunk size (default to configured default) */
+	config->chunk_size = PG_ARGISNULL(2) ?
+		pgedge_vectorizer_default_chunk_size : PG_GETARG_INT32(2);
+
+	/* Get overlap (default to configured default) */
+	config->overlap = PG_ARGISNULL(3) ?
+		pgedge_vectorizer_default_chunk_overlap : PG_GETARG_INT32(3);
+
+	config->separators = NULL;
+}
+
 /*
  * SQL-callable function to chunk text
  */
@@ -317,12 +777,7 @@ PG_FUNCTION_INFO_V1(pgedge_vectorizer_chunk_text_sql);
 Datum
 pgedge_vectorizer_chunk_text_sql(PG_FUNCTION_ARGS)
 {
-	text *content_text;
 	char *content;
-	text *strategy_text;
-	char *strategy_str;
-	int chunk_size;
-	int overlap;
 	ChunkConfig config;
 	ArrayType *result;
 
@@ -330,34 +785,156 @@ pgedge_vectorizer_chunk_text_sql(PG_FUNCTION_ARGS)
 	if (PG_ARGISNULL(0))
 		PG_RETURN_NULL();
 
-	content_text = PG_GETARG_TEXT_PP(0);
-	content = text_to_cstring(content_text);
+	content = text_to_cstring(PG_GETARG_TEXT_PP(0));
 
-	/* Get strategy (default to configured default) */
-	if (PG_ARGISNULL(1))
-		strategy_str = pgedge_vectorizer_default_chunk_strategy;
+	/* Build configuration */
+	chunk_config_from_args(fcinfo, &config);
+
+	/* Perform chunking */
+	result = chunk_text(content, &config);
+
+	PG_RETURN_ARRAYTYPE_P(result);
+}
+
+/*
+ * Find the first occurrence of needle in haystack, or -1
+ */
+static int
+find_bytes(const char *haystack, int hlen, const char *needle, int nlen)
+{
+	const char *p = haystack;
+	const char *last = haystack + hlen - nlen;
+
+	if (nlen == 0 || nlen > hlen)
+		return -1;
+
+	while (p <= last)
+	{
+		p = memchr(p, needle[0], last - p + 1);
+		if (p == NULL)
+			return -1;
+		if (memcmp(p, needle, nlen) == 0)
+			return (int) (p - haystack);
+		p++;
+	}
+
+	return -1;
+}
+
+/*
+ * SQL-callable function to chunk text and locate every chunk in the source
+ *
+ * The content is trimmed of surrounding spaces and chunked exactly like
+ * chunk_text() does in the vectorization trigger.  Each chunk is then
+ * searched for in the original content, starting after the previous
+ * chunk's start, and its byte offset and byte length are returned.
+ * Chunks that do not occur verbatim (non-ASCII stripping, markdown
+ * heading context) get NULL offsets and must be stored as text.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_chunk_text_offsets_sql);
+
+Datum
+pgedge_vectorizer_chunk_text_offsets_sql(PG_FUNCTION_ARGS)
+{
+	text *content_text = PG_GETARG_TEXT_PP(0);
+	const char *raw = VARDATA_ANY(content_text);
+	int raw_len = VARSIZE_ANY_EXHDR(content_text);
+	int lead = 0;
+	int trimmed_len = raw_len;
+	ChunkConfig config;
+	ArrayType *chunks;
+	Datum *chunk_datums;
+	bool *chunk_nulls;
+	int n_chunks;
+	Datum *start_datums;
+	Datum *length_datums;
+	bool *offset_nulls;
+	int dims[1];
+	int lbs[1] = {1};
+	int search_from;
+	TupleDesc tupdesc;
+	Datum values[3];
+	bool nulls[3] = {false, false, false};
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	/* Same trimming as trim() in the vectorization trigger */
+	while (lead < raw_len && raw[lead] == ' ')
+		lead++;
+	while (trimmed_len > lead && raw[trimmed_len - 1] == ' ')
+		trimmed_len--;
+
+	chunk_config_from_args(fcinfo, &config);
+	chunks = chunk_text(pnstrdup(raw + lead, trimmed_len - lead), &config);
+
+	deconstruct_array(chunks, TEXTOID, -1, false, TYPALIGN_INT,
+					  &chunk_datums, &chunk_nulls, &n_chunks);
+
+	start_datums = palloc0(Max(n_chunks, 1) * sizeof(Datum));
+	length_datums = palloc0(Max(n_chunks, 1) * sizeof(Datum));
+	offset_nulls = palloc0(Max(n_chunks, 1) * sizeof(bool));
+
+	search_from = lead;
+	for (int i = 0; i < n_chunks; i++)
+	{
+		text *chunk = DatumGetTextPP(chunk_datums[i]);
+		int chunk_len = VARSIZE_ANY_EXHDR(chunk);
+		int pos = find_bytes(raw + search_from, raw_len - search_from,
+							 VARDATA_ANY(chunk), chunk_len);
+
+		if (pos < 0)
+		{
+			offset_nulls[i] = true;
+			continue;
+		}
+
+		start_datums[i] = Int32GetDatum(search_from + pos);
+		length_datums[i] = Int32GetDatum(chunk_len);
+		search_from += pos + 1;
+	}
+
+	dims[0] = n_chunks;
+	values[0] = PointerGetDatum(chunks);
+	if (n_chunks == 0)
+	{
+		values[1] = PointerGetDatum(construct_empty_array(INT4OID));
+		values[2] = PointerGetDatum(construct_empty_array(INT4OID));
+	}
 	else
 	{
-		strategy_text = PG_GETARG_TEXT_PP(1);
-		strategy_str = text_to_cstring(strategy_text);
+		values[1] = PointerGetDatum(construct_md_array(start_datums, offset_nulls,
+													   1, dims, lbs, INT4OID,
+													   sizeof(int32), true,
+													   TYPALIGN_INT));
+		values[2] = PointerGetDatum(construct_md_array(length_datums, offset_nulls,
+													   1, dims, lbs, INT4OID,
+													   sizeof(int32), true,
+													   TYPALIGN_INT));
 	}
 
-	/* Get chunk size (default to configured default) */
-	chunk_size = PG_ARGISNULL(2) ?
-		pgedge_vectorizer_default_chunk_size : PG_GETARG_INT32(2);
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
 
-	/* Get overlap (default to configured default) */
-	overlap = PG_ARGISNULL(3) ?
-		pgedge_vectorizer_default_chunk_overlap : PG_GETARG_INT32(3);
+/*
+ * SQL-callable function returning a byte range of a source document
+ *
+ * Used to rebuild the text of chunks stored as offsets.  Only the slice is
+ * fetched from TOAST, so reading a chunk from the start of a large
+ * document does not detoast or decompress the whole value.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_chunk_slice);
 
-	/* Build configuration */
-	config.strategy = parse_chunk_strategy(strategy_str);
-	config.chunk_size = chunk_size;
-	config.overlap = overlap;
-	config.separators = NULL;
+Datum
+pgedge_vectorizer_chunk_slice(PG_FUNCTION_ARGS)
+{
+	int32 start_offset = PG_GETARG_INT32(1);
+	int32 length = PG_GETARG_INT32(2);
 
-	/* Perform chunking */
-	result = chunk_text(content, &config);
+	if (start_offset < 0 || length < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("chunk offset and length must not be negative")));
 
-	PG_RETURN_ARRAYTYPE_P(result);
+	PG_RETURN_TEXT_P(PG_GETARG_TEXT_P_SLICE(0, start_offset, length));
 }
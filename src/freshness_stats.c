@@ -0,0 +1,539 @@
+/*-------------------------------------------------------------------------
+ *
+ * freshness_stats.c
+ *		How long written chunks take to get their embeddings
+ *
+ * The freshness of a chunk is the time from the transaction that queued
+ * it, the created_at of its queue row or the start of the transaction
+ * that put it on the hot queue, to the commit of the worker transaction
+ * that stored its embeddings, when it becomes searchable.  Workers note
+ * each chunk they store with freshness_stats_note(); the notes are added
+ * to log-scale histograms per chunk table in shared memory when the
+ * transaction commits, and dropped if it aborts.
+ *
+ * freshness_stats() also reports the current lag of each chunk table's
+ * pending work: the age of its oldest chunk still waiting on the hot queue
+ * or in the queue table.
+ *
+ * Without shared_preload_libraries nothing is recorded.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "nodes/pg_list.h"
+#include "utils/float.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+/* Chunk tables tracked over all databases; chunks of others are not */
+#define FRESHNESS_MAX_TABLES 256
+
+/*
+ * Lag buckets: bucket i counts chunks that took at most 2^(i + 4)
+ * milliseconds (16 ms up to 18.6 hours); the last one counts the rest
+ */
+#define LAG_BUCKETS 24
+#define LAG_FIRST_BOUND_LOG2 4
+
+typedef struct FreshnessTableStats
+{
+	Oid			dboid;
+	char		chunk_table[NAMEDATALEN];
+	int64		embedded;
+	int64		lag_sum_ms;
+	int64		lag_max_ms;
+	int64		lag[LAG_BUCKETS];
+} FreshnessTableStats;
+
+typedef struct FreshnessStatsShared
+{
+	LWLock	   *lock;
+	int			ntables;
+	FreshnessTableStats tables[FRESHNESS_MAX_TABLES];
+} FreshnessStatsShared;
+
+/* A chunk stored by the current transaction */
+typedef struct FreshnessNote
+{
+	char		chunk_table[NAMEDATALEN];
+	TimestampTz queued_at;
+} FreshnessNote;
+
+/* A row of freshness_stats() */
+typedef struct FreshnessRow
+{
+	char		chunk_table[NAMEDATALEN];
+	FreshnessTableStats *stats;	/* NULL if nothing embedded yet */
+	TimestampTz oldest_pending; /* 0 if nothing pending */
+} FreshnessRow;
+
+static FreshnessStatsShared *freshness_stats = NULL;
+
+/* Chunks stored by the current transaction, in TopTransactionContext */
+static List *freshness_notes = NIL;
+static bool callbacks_registered = false;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void freshness_stats_shmem_request(void);
+static void freshness_stats_shmem_startup(void);
+static void freshness_stats_xact_callback(XactEvent event, void *arg);
+static void record_notes(void);
+static int	lag_bucket(int64 ms);
+static double bucket_bound_secs(int bucket);
+static double lag_percentile(const int64 *buckets, double fraction);
+static Tuplestorestate *begin_materialized_srf(FunctionCallInfo fcinfo, TupleDesc *tupdesc);
+static FreshnessTableStats *copy_tables(Oid dboid, int *n);
+static FreshnessRow *find_row(FreshnessRow *rows, int *nrows, const char *chunk_table);
+
+/*
+ * Request shared memory and the lock for the freshness statistics
+ *
+ * Called during _PG_init when shared_preload_libraries is processed.
+ */
+void
+freshness_stats_init(void)
+{
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = freshness_stats_shmem_request;
+#else
+	freshness_stats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = freshness_stats_shmem_startup;
+}
+
+static void
+freshness_stats_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(sizeof(FreshnessStatsShared));
+	RequestNamedLWLockTranche("pgedge_vectorizer_freshness_stats", 1);
+}
+
+static void
+freshness_stats_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	freshness_stats = ShmemInitStruct("pgedge_vectorizer freshness stats",
+									  sizeof(FreshnessStatsShared), &found);
+	if (!found)
+	{
+		memset(freshness_stats, 0, sizeof(FreshnessStatsShared));
+		freshness_stats->lock = &(GetNamedLWLockTranche("pgedge_vectorizer_freshness_stats"))->lock;
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static int
+lag_bucket(int64 ms)
+{
+	int			bucket = 0;
+
+	while (bucket < LAG_BUCKETS - 1 &&
+		   ms > ((int64) 1 << (bucket + LAG_FIRST_BOUND_LOG2)))
+		bucket++;
+	return bucket;
+}
+
+/*
+ * Upper bound of a lag bucket in seconds; infinite for the last
+ */
+static double
+bucket_bound_secs(int bucket)
+{
+	if (bucket >= LAG_BUCKETS - 1)
+		return get_float8_infinity();
+	return (double) ((int64) 1 << (bucket + LAG_FIRST_BOUND_LOG2)) / 1000.0;
+}
+
+/*
+ * Lag below which the given fraction of chunks fall, in seconds
+ *
+ * Interpolates linearly within the bucket; chunks in the last bucket are
+ * reported at its lower bound.
+ */
+static double
+lag_percentile(const int64 *buckets, double fraction)
+{
+	int64		total = 0;
+	int64		seen = 0;
+	double		target;
+
+	for (int i = 0; i < LAG_BUCKETS; i++)
+		total += buckets[i];
+	if (total == 0)
+		return 0.0;
+
+	target = fraction * total;
+
+	for (int i = 0; i < LAG_BUCKETS; i++)
+	{
+		double		lower = i == 0 ? 0.0 : bucket_bound_secs(i - 1);
+
+		if (buckets[i] == 0 || seen + buckets[i] < target)
+		{
+			seen += buckets[i];
+			continue;
+		}
+		if (i == LAG_BUCKETS - 1)
+			return lower;
+		return lower + (bucket_bound_secs(i) - lower) * (target - seen) / buckets[i];
+	}
+
+	return bucket_bound_secs(LAG_BUCKETS - 2);
+}
+
+/*
+ * Note a chunk whose embeddings the current transaction stores
+ *
+ * queued_at is when the chunk was queued; the chunk counts once the
+ * transaction commits.
+ */
+void
+freshness_stats_note(const char *chunk_table, TimestampTz queued_at)
+{
+	FreshnessNote *note;
+	MemoryContext oldcontext;
+
+	if (freshness_stats == NULL || queued_at == 0)
+		return;
+
+	if (!callbacks_registered)
+	{
+		RegisterXactCallback(freshness_stats_xact_callback, NULL);
+		callbacks_registered = true;
+	}
+
+	oldcontext = MemoryContextSwitchTo(TopTransactionContext);
+	note = palloc(sizeof(FreshnessNote));
+	strlcpy(note->chunk_table, chunk_table, NAMEDATALEN);
+	note->queued_at = queued_at;
+	freshness_notes = lappend(freshness_notes, note);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Add the chunks of a committed transaction to the histograms
+ */
+static void
+freshness_stats_xact_callback(XactEvent event, void *arg)
+{
+	if (freshness_notes == NIL)
+		return;
+
+	switch (event)
+	{
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+			record_notes();
+			freshness_notes = NIL;
+			break;
+
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+		case XACT_EVENT_PREPARE:
+			/* Freed with TopTransactionContext */
+			freshness_notes = NIL;
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void
+record_notes(void)
+{
+	TimestampTz now = GetCurrentTimestamp();
+	FreshnessTableStats *t = NULL;
+	ListCell   *lc;
+
+	LWLockAcquire(freshness_stats->lock, LW_EXCLUSIVE);
+
+	foreach(lc, freshness_notes)
+	{
+		FreshnessNote *note = (FreshnessNote *) lfirst(lc);
+		int64		lag_ms = Max(now - note->queued_at, 0) / 1000;
+
+		/* Notes come grouped by chunk table */
+		if (t == NULL || strcmp(t->chunk_table, note->chunk_table) != 0)
+		{
+			t = NULL;
+			for (int i = 0; i < freshness_stats->ntables; i++)
+			{
+				FreshnessTableStats *e = &freshness_stats->tables[i];
+
+				if (e->dboid == MyDatabaseId &&
+					strcmp(e->chunk_table, note->chunk_table) == 0)
+				{
+					t = e;
+					break;
+				}
+			}
+
+			if (t == NULL)
+			{
+				if (freshness_stats->ntables >= FRESHNESS_MAX_TABLES)
+					continue;
+				t = &freshness_stats->tables[freshness_stats->ntables++];
+				memset(t, 0, sizeof(FreshnessTableStats));
+				t->dboid = MyDatabaseId;
+				strlcpy(t->chunk_table, note->chunk_table, NAMEDATALEN);
+			}
+		}
+
+		t->embedded++;
+		t->lag_sum_ms += lag_ms;
+		t->lag_max_ms = Max(t->lag_max_ms, lag_ms);
+		t->lag[lag_bucket(lag_ms)]++;
+	}
+
+	LWLockRelease(freshness_stats->lock);
+}
+
+/*
+ * Set up a set-returning function that returns its rows in a tuplestore
+ */
+static Tuplestorestate *
+begin_materialized_srf(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+		!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "set-valued function called in a context that cannot accept a set");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = *tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
+
+/*
+ * Copy the statistics of the chunk tables of a database out of shared
+ * memory
+ */
+static FreshnessTableStats *
+copy_tables(Oid dboid, int *n)
+{
+	FreshnessTableStats *copy;
+
+	*n = 0;
+	if (freshness_stats == NULL)
+		return NULL;
+
+	copy = palloc(sizeof(FreshnessTableStats) * FRESHNESS_MAX_TABLES);
+
+	LWLockAcquire(freshness_stats->lock, LW_SHARED);
+	for (int i = 0; i < freshness_stats->ntables; i++)
+	{
+		if (freshness_stats->tables[i].dboid == dboid)
+			copy[(*n)++] = freshness_stats->tables[i];
+	}
+	LWLockRelease(freshness_stats->lock);
+
+	return copy;
+}
+
+static FreshnessRow *
+find_row(FreshnessRow *rows, int *nrows, const char *chunk_table)
+{
+	FreshnessRow *row;
+
+	for (int i = 0; i < *nrows; i++)
+	{
+		if (strcmp(rows[i].chunk_table, chunk_table) == 0)
+			return &rows[i];
+	}
+
+	row = &rows[(*nrows)++];
+	memset(row, 0, sizeof(FreshnessRow));
+	strlcpy(row->chunk_table, chunk_table, NAMEDATALEN);
+	return row;
+}
+
+/*
+ * Freshness percentiles and current pending lag per chunk table of the
+ * current database
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_freshness_stats);
+
+Datum
+pgedge_vectorizer_freshness_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+	FreshnessTableStats *tables;
+	HotQueueEntry *hot_oldest;
+	FreshnessRow *rows;
+	int			ntables;
+	int			nhot;
+	int			npending = 0;
+	int			nrows = 0;
+	TimestampTz now = GetCurrentTimestamp();
+	int			ret;
+
+	tables = copy_tables(MyDatabaseId, &ntables);
+
+	hot_oldest = palloc(sizeof(HotQueueEntry) * FRESHNESS_MAX_TABLES);
+	nhot = hot_queue_oldest_entries(MyDatabaseId, hot_oldest, FRESHNESS_MAX_TABLES);
+
+	/* Oldest pending item per chunk table, from the queue counters */
+	SPI_connect();
+	ret = SPI_execute("SELECT chunk_table, oldest FROM pgedge_vectorizer.queue_stats() "
+					  "WHERE status = 'pending' AND oldest IS NOT NULL",
+					  true, 0);
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "Failed to read the pending queue items");
+	npending = (int) SPI_processed;
+
+	rows = SPI_palloc((ntables + nhot + npending) * sizeof(FreshnessRow));
+	for (int i = 0; i < ntables; i++)
+		find_row(rows, &nrows, tables[i].chunk_table)->stats = &tables[i];
+
+	for (int i = 0; i < npending; i++)
+	{
+		bool		isnull;
+		char	   *chunk_table = SPI_getvalue(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 1);
+		TimestampTz oldest = DatumGetTimestampTz(SPI_getbinval(SPI_tuptable->vals[i],
+															   SPI_tuptable->tupdesc, 2,
+															   &isnull));
+
+		if (chunk_table == NULL || strlen(chunk_table) >= NAMEDATALEN)
+			continue;
+		find_row(rows, &nrows, chunk_table)->oldest_pending = oldest;
+	}
+	SPI_finish();
+
+	for (int i = 0; i < nhot; i++)
+	{
+		FreshnessRow *row = find_row(rows, &nrows, hot_oldest[i].chunk_table);
+
+		if (row->oldest_pending == 0 || hot_oldest[i].queued_at < row->oldest_pending)
+			row->oldest_pending = hot_oldest[i].queued_at;
+	}
+
+	for (int i = 0; i < nrows; i++)
+	{
+		FreshnessTableStats *t = rows[i].stats;
+		Datum		values[8];
+		bool		nulls[8];
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = CStringGetTextDatum(rows[i].chunk_table);
+		values[1] = Int64GetDatum(t != NULL ? t->embedded : 0);
+		if (t != NULL && t->embedded > 0)
+		{
+			values[2] = Float8GetDatum(t->lag_sum_ms / 1000.0 / t->embedded);
+			values[3] = Float8GetDatum(lag_percentile(t->lag, 0.5));
+			values[4] = Float8GetDatum(lag_percentile(t->lag, 0.9));
+			values[5] = Float8GetDatum(lag_percentile(t->lag, 0.99));
+			values[6] = Float8GetDatum(t->lag_max_ms / 1000.0);
+		}
+		else
+			nulls[2] = nulls[3] = nulls[4] = nulls[5] = nulls[6] = true;
+		if (rows[i].oldest_pending != 0)
+			values[7] = Float8GetDatum(Max(now - rows[i].oldest_pending, 0) / 1000000.0);
+		else
+			nulls[7] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Freshness histograms per chunk table of the current database, one row
+ * per bucket
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_freshness_histogram);
+
+Datum
+pgedge_vectorizer_freshness_histogram(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+	FreshnessTableStats *tables;
+	int			n;
+
+	tables = copy_tables(MyDatabaseId, &n);
+
+	for (int i = 0; i < n; i++)
+	{
+		for (int b = 0; b < LAG_BUCKETS; b++)
+		{
+			Datum		values[3];
+			bool		nulls[3];
+
+			memset(nulls, 0, sizeof(nulls));
+			values[0] = CStringGetTextDatum(tables[i].chunk_table);
+			values[1] = Float8GetDatum(bucket_bound_secs(b));
+			values[2] = Int64GetDatum(tables[i].lag[b]);
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Forget the freshness histograms of the current database
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_reset_freshness_stats);
+
+Datum
+pgedge_vectorizer_reset_freshness_stats(PG_FUNCTION_ARGS)
+{
+	if (freshness_stats != NULL)
+	{
+		int			kept = 0;
+
+		LWLockAcquire(freshness_stats->lock, LW_EXCLUSIVE);
+		for (int i = 0; i < freshness_stats->ntables; i++)
+		{
+			if (freshness_stats->tables[i].dboid == MyDatabaseId)
+				continue;
+			if (kept != i)
+				freshness_stats->tables[kept] = freshness_stats->tables[i];
+			kept++;
+		}
+		freshness_stats->ntables = kept;
+		LWLockRelease(freshness_stats->lock);
+	}
+
+	PG_RETURN_VOID();
+}
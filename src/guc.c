@@ -43,6 +43,20 @@ bool pgedge_vectorizer_strip_non_ascii = true;
  * GUC Variables - Queue Management
  */
 int pgedge_vectorizer_auto_cleanup_hours = 24;
+int pgedge_vectorizer_index_build_workers = 2;
+int pgedge_vectorizer_hot_queue_size = 0;
+int pgedge_vectorizer_migration_batch_size = 10;
+
+/*
+ * GUC Variables - Monitoring
+ */
+int pgedge_vectorizer_metrics_port = 0;
+double pgedge_vectorizer_trace_sample_rate = 0.0;
+char *pgedge_vectorizer_trace_tables = NULL;
+int pgedge_vectorizer_trace_max_rows = 10000;
+bool pgedge_vectorizer_profile_search = false;
+int pgedge_vectorizer_history_interval = 300;
+int pgedge_vectorizer_history_size = 2016;
 
 /*
  * GUC Variables - Hybrid search (BM25 + dense RRF)
@@ -51,6 +65,27 @@ bool   pgedge_vectorizer_enable_hybrid = false;
 double pgedge_vectorizer_bm25_k1       = 1.2;
 double pgedge_vectorizer_bm25_b        = 0.75;
 
+/*
+ * Shortest history_interval.  Workers add their usage counts to the
+ * usage_stats table about once a minute, so the rates of a snapshot are
+ * only as good as the number of these writes its interval spans.
+ */
+#define HISTORY_MIN_INTERVAL 300
+
+/*
+ * history_interval is 0 (disabled) or at least HISTORY_MIN_INTERVAL
+ */
+static bool
+check_history_interval(int *newval, void **extra, GucSource source)
+{
+	if (*newval == 0 || *newval >= HISTORY_MIN_INTERVAL)
+		return true;
+
+	GUC_check_errdetail("pgedge_vectorizer.history_interval must be 0 or at least %d seconds.",
+						HISTORY_MIN_INTERVAL);
+	return false;
+}
+
 /*
  * Initialize all GUC variables
  */
@@ -169,7 +204,7 @@ pgedge_vectorizer_init_guc(void)
 
 	DefineCustomStringVariable("pgedge_vectorizer.default_chunk_strategy",
 								"Default chunking strategy",
-								"Strategy to use for chunking: token_based, semantic, markdown, sentence.",
+								"Strategy to use for chunking: token_based, markdown, hybrid, sentence, recursive.",
 								&pgedge_vectorizer_default_chunk_strategy,
 								"token_based",
 								PGC_SIGHUP,
@@ -220,6 +255,135 @@ pgedge_vectorizer_init_guc(void)
 							0,
 							NULL, NULL, NULL);
 
+	DefineCustomIntVariable("pgedge_vectorizer.index_build_workers",
+							"Parallel maintenance workers for deferred index builds",
+							"Value of max_parallel_maintenance_workers used when the "
+							"vector indexes of a chunk table enabled with defer_indexes "
+							"are built after its initial backfill.",
+							&pgedge_vectorizer_index_build_workers,
+							2,      /* default */
+							0,      /* min: 0 = no parallel workers */
+							64,     /* max */
+							PGC_SIGHUP,
+							0,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pgedge_vectorizer.hot_queue_size",
+							"Capacity of the in-memory hot queue",
+							"Number of chunks the shared-memory hot queue can hold. "
+							"Chunks queued by the vectorization trigger go to the hot "
+							"queue while it has room and to the queue table otherwise. "
+							"Set to 0 to disable. Requires PostgreSQL restart to change.",
+							&pgedge_vectorizer_hot_queue_size,
+							0,      /* default: 0 = disabled */
+							0,      /* min */
+							1048576, /* max */
+							PGC_POSTMASTER,
+							0,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pgedge_vectorizer.migration_batch_size",
+							"Chunks re-embedded per pass of a model migration",
+							"Workers re-embed this many chunks for a model migration "
+							"each time they find the queue empty, at most once per "
+							"poll interval. Set to 0 to pause migrations.",
+							&pgedge_vectorizer_migration_batch_size,
+							10,     /* default */
+							0,      /* min: 0 = paused */
+							1000,   /* max */
+							PGC_SIGHUP,
+							0,
+							NULL, NULL, NULL);
+
+	/* Monitoring configuration */
+	DefineCustomIntVariable("pgedge_vectorizer.metrics_port",
+							"Port of the HTTP metrics server",
+							"A background worker serves metrics() in the OpenMetrics "
+							"text format at /metrics on this port of the loopback "
+							"interface. Set to 0 to disable it.",
+							&pgedge_vectorizer_metrics_port,
+							0,      /* default: disabled */
+							0,      /* min */
+							65535,  /* max */
+							PGC_POSTMASTER,
+							0,
+							NULL, NULL, NULL);
+
+	DefineCustomRealVariable("pgedge_vectorizer.trace_sample_rate",
+							 "Fraction of the documents traced through the pipeline",
+							 "The vectorization trigger records the stages of this "
+							 "fraction of the documents it chunks in the ingest_trace "
+							 "table; see trace_document(). Set to 0 to disable tracing.",
+							 &pgedge_vectorizer_trace_sample_rate,
+							 0.0,    /* default: disabled */
+							 0.0,    /* min */
+							 1.0,    /* max */
+							 PGC_USERSET,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomStringVariable("pgedge_vectorizer.trace_tables",
+							   "Source tables whose documents may be traced",
+							   "Comma-separated list of source tables, with or without "
+							   "schema, sampled by pgedge_vectorizer.trace_sample_rate. "
+							   "If not set, documents of all tables are sampled.",
+							   &pgedge_vectorizer_trace_tables,
+							   "",
+							   PGC_USERSET,
+							   0,
+							   NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pgedge_vectorizer.trace_max_rows",
+							"Rows kept in the ingest_trace table",
+							"Workers delete the oldest trace events beyond this many "
+							"about once a minute.",
+							&pgedge_vectorizer_trace_max_rows,
+							10000,  /* default */
+							100,    /* min */
+							10000000, /* max */
+							PGC_SIGHUP,
+							0,
+							NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("pgedge_vectorizer.profile_search",
+							 "Report the phases of each hybrid_search() call",
+							 "Each hybrid_search() call reports the time of its "
+							 "phases and the candidates of its ranked lists in a "
+							 "NOTICE.",
+							 &pgedge_vectorizer_profile_search,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomIntVariable("pgedge_vectorizer.history_interval",
+							"Seconds between throughput history snapshots",
+							"The first worker of each database adds a snapshot of "
+							"throughput, queue depth, errors and provider latency to "
+							"the throughput_history table this often. Set to 0 to "
+							"disable; otherwise at least 300, as usage counts are "
+							"saved about once a minute.",
+							&pgedge_vectorizer_history_interval,
+							300,    /* default: 5 minutes */
+							0,      /* min: disabled */
+							86400,  /* max: 1 day */
+							PGC_SIGHUP,
+							0,
+							check_history_interval, NULL, NULL);
+
+	DefineCustomIntVariable("pgedge_vectorizer.history_size",
+							"Snapshots kept in the throughput_history table",
+							"A new snapshot overwrites the oldest one beyond this "
+							"many; with the default interval, 2016 snapshots cover "
+							"a week.",
+							&pgedge_vectorizer_history_size,
+							2016,   /* default: a week of 5-minute snapshots */
+							10,     /* min */
+							1000000, /* max */
+							PGC_SIGHUP,
+							0,
+							NULL, NULL, NULL);
+
 	/* Hybrid search configuration */
 	DefineCustomBoolVariable(
 		"pgedge_vectorizer.enable_hybrid",
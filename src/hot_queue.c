@@ -0,0 +1,593 @@
+/*-------------------------------------------------------------------------
+ *
+ * hot_queue.c
+ *		Shared-memory hot queue for freshly written chunks
+ *
+ * The vectorization trigger hands new chunks to hot_enqueue().  Each call
+ * reserves a slot in a ring buffer in shared memory and remembers the
+ * chunk in backend-local memory; the chunks are published to the ring when
+ * the transaction commits and the workers of the database are woken up
+ * through their latches.  Aborted transactions and subtransactions release
+ * their reservations.  Workers drain the ring directly, without touching
+ * the queue table, so fresh chunks reach the provider without a queue row
+ * insert, index scan, row lock or status updates.
+ *
+ * The queue table remains the overflow and the crash-recovery source: when
+ * the ring is full hot_enqueue() returns false and the trigger inserts a
+ * queue row as before.  At a clean shutdown the workers move what is left
+ * in the ring to the queue table; after a crash the contents of the ring
+ * are rebuilt from the chunk tables by recover_queue().
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "utils/memutils.h"
+#include "utils/tuplestore.h"
+
+/*
+ * A background worker as seen by committing backends
+ */
+typedef struct HotQueueWorker
+{
+	Oid			dboid;			/* Database the worker serves */
+	Latch	   *latch;			/* Set to wake the worker up */
+} HotQueueWorker;
+
+/*
+ * Shared state: a ring buffer of capacity entries that follows the worker
+ * array.  reserved counts slots promised to in-progress transactions, so
+ * that count + reserved never exceeds capacity and publishing at commit
+ * cannot fail.
+ */
+typedef struct HotQueueShared
+{
+	LWLock	   *lock;
+	int			capacity;
+	int			head;
+	int			count;
+	int			reserved;
+	int			nworkers;
+	HotQueueWorker workers[FLEXIBLE_ARRAY_MEMBER];
+} HotQueueShared;
+
+/*
+ * A chunk queued by the current transaction, published at commit
+ */
+typedef struct HotQueuePending
+{
+	HotQueueEntry entry;
+	SubTransactionId subid;		/* Subtransaction that queued it */
+} HotQueuePending;
+
+static HotQueueShared *hot_queue = NULL;
+static HotQueueEntry *hot_entries = NULL;
+
+/* Chunks queued by the current transaction, in TopTransactionContext */
+static List *hot_pending = NIL;
+static bool callbacks_registered = false;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static Size hot_queue_shmem_size(void);
+static void hot_queue_shmem_request(void);
+static void hot_queue_shmem_startup(void);
+static void hot_queue_xact_callback(XactEvent event, void *arg);
+static void hot_queue_subxact_callback(SubXactEvent event,
+									   SubTransactionId mySubid,
+									   SubTransactionId parentSubid,
+									   void *arg);
+static void release_reservations(int n);
+static void spill_pending_to_table(void);
+
+/*
+ * Size of the shared state
+ */
+static Size
+hot_queue_shmem_size(void)
+{
+	Size		size;
+
+	size = MAXALIGN(add_size(offsetof(HotQueueShared, workers),
+							 mul_size(pgedge_vectorizer_num_workers,
+									  sizeof(HotQueueWorker))));
+	return add_size(size, mul_size(pgedge_vectorizer_hot_queue_size,
+								   sizeof(HotQueueEntry)));
+}
+
+/*
+ * Request shared memory and the lock for the hot queue
+ *
+ * Called during _PG_init when shared_preload_libraries is processed.  A
+ * hot_queue_size of 0 leaves the hot queue out entirely.
+ */
+void
+hot_queue_init(void)
+{
+	if (pgedge_vectorizer_hot_queue_size <= 0)
+		return;
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = hot_queue_shmem_request;
+#else
+	hot_queue_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = hot_queue_shmem_startup;
+}
+
+static void
+hot_queue_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(hot_queue_shmem_size());
+	RequestNamedLWLockTranche("pgedge_vectorizer_hot_queue", 1);
+}
+
+static void
+hot_queue_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	hot_queue = ShmemInitStruct("pgedge_vectorizer hot queue",
+								hot_queue_shmem_size(), &found);
+	if (!found)
+	{
+		memset(hot_queue, 0, hot_queue_shmem_size());
+		hot_queue->lock = &(GetNamedLWLockTranche("pgedge_vectorizer_hot_queue"))->lock;
+		hot_queue->capacity = pgedge_vectorizer_hot_queue_size;
+		hot_queue->nworkers = pgedge_vectorizer_num_workers;
+	}
+
+	hot_entries = (HotQueueEntry *)
+		((char *) hot_queue +
+		 MAXALIGN(offsetof(HotQueueShared, workers) +
+				  hot_queue->nworkers * sizeof(HotQueueWorker)));
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Is the hot queue available in this server?
+ */
+bool
+hot_queue_enabled(void)
+{
+	return hot_queue != NULL;
+}
+
+/*
+ * Record the database and latch of a worker so commits can wake it up
+ */
+void
+hot_queue_register_worker(int worker_id)
+{
+	if (hot_queue == NULL || worker_id >= hot_queue->nworkers)
+		return;
+
+	LWLockAcquire(hot_queue->lock, LW_EXCLUSIVE);
+	hot_queue->workers[worker_id].dboid = MyDatabaseId;
+	hot_queue->workers[worker_id].latch = MyLatch;
+	LWLockRelease(hot_queue->lock);
+}
+
+/*
+ * Take up to max_entries chunks of one database off the hot queue
+ *
+ * Entries are taken oldest first.  Entries of other databases stay in the
+ * ring in their original order.
+ */
+int
+hot_queue_pop(Oid dboid, HotQueueEntry *entries, int max_entries)
+{
+	int			taken = 0;
+	int			prefix = 0;
+	int			cap;
+
+	if (hot_queue == NULL || max_entries <= 0)
+		return 0;
+
+	LWLockAcquire(hot_queue->lock, LW_EXCLUSIVE);
+
+	cap = hot_queue->capacity;
+
+	for (int k = 0; k < hot_queue->count && taken < max_entries; k++)
+	{
+		HotQueueEntry *e = &hot_entries[(hot_queue->head + k) % cap];
+
+		if (e->dboid != dboid)
+			continue;
+
+		entries[taken++] = *e;
+		e->dboid = InvalidOid;
+		if (prefix == k)
+			prefix++;
+	}
+
+	/* Entries taken from the front: just move the head */
+	hot_queue->head = (hot_queue->head + prefix) % cap;
+	hot_queue->count -= prefix;
+
+	/* Entries taken from between other databases' entries: close the gaps */
+	if (taken > prefix)
+	{
+		int			kept = 0;
+
+		for (int k = 0; k < hot_queue->count; k++)
+		{
+			HotQueueEntry *e = &hot_entries[(hot_queue->head + k) % cap];
+
+			if (e->dboid == InvalidOid)
+				continue;
+			if (kept != k)
+				hot_entries[(hot_queue->head + kept) % cap] = *e;
+			kept++;
+		}
+		hot_queue->count = kept;
+	}
+
+	LWLockRelease(hot_queue->lock);
+
+	return taken;
+}
+
+/*
+ * Find the oldest entry of each chunk table of a database on the hot queue
+ *
+ * Fills oldest[] with one entry per chunk table, up to max_tables, and
+ * returns their number.
+ */
+int
+hot_queue_oldest_entries(Oid dboid, HotQueueEntry *oldest, int max_tables)
+{
+	int			n = 0;
+
+	if (hot_queue == NULL)
+		return 0;
+
+	LWLockAcquire(hot_queue->lock, LW_SHARED);
+
+	for (int k = 0; k < hot_queue->count; k++)
+	{
+		HotQueueEntry *e = &hot_entries[(hot_queue->head + k) % hot_queue->capacity];
+		int			i;
+
+		if (e->dboid != dboid)
+			continue;
+
+		for (i = 0; i < n; i++)
+		{
+			if (strcmp(oldest[i].chunk_table, e->chunk_table) == 0)
+				break;
+		}
+
+		if (i == n)
+		{
+			if (n >= max_tables)
+				continue;
+			oldest[n++] = *e;
+		}
+		else if (e->queued_at < oldest[i].queued_at)
+			oldest[i] = *e;
+	}
+
+	LWLockRelease(hot_queue->lock);
+
+	return n;
+}
+
+/*
+ * Give back slots reserved by the current transaction
+ */
+static void
+release_reservations(int n)
+{
+	if (n <= 0)
+		return;
+
+	LWLockAcquire(hot_queue->lock, LW_EXCLUSIVE);
+	hot_queue->reserved -= n;
+	LWLockRelease(hot_queue->lock);
+}
+
+/*
+ * Move the chunks queued by the current transaction to the queue table
+ *
+ * Used when the transaction is prepared: it may be committed by another
+ * backend, so its chunks cannot wait in this backend's memory.
+ */
+static void
+spill_pending_to_table(void)
+{
+	StringInfoData sql;
+	ListCell   *lc;
+
+	initStringInfo(&sql);
+	appendStringInfoString(&sql,
+						   "INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table) VALUES ");
+	foreach(lc, hot_pending)
+	{
+		HotQueuePending *p = (HotQueuePending *) lfirst(lc);
+
+		appendStringInfo(&sql, "%s(%ld, %s)",
+						 foreach_current_index(lc) > 0 ? ", " : "",
+						 p->entry.chunk_id,
+						 quote_literal_cstr(p->entry.chunk_table));
+	}
+
+	SPI_connect();
+	if (SPI_execute(sql.data, false, 0) != SPI_OK_INSERT)
+		elog(ERROR, "Failed to move hot queue entries to the queue table");
+	SPI_finish();
+
+	pfree(sql.data);
+}
+
+/*
+ * Publish the chunks queued by a committed transaction
+ */
+static void
+hot_queue_xact_callback(XactEvent event, void *arg)
+{
+	ListCell   *lc;
+	int			n = list_length(hot_pending);
+
+	if (n == 0)
+		return;
+
+	switch (event)
+	{
+		case XACT_EVENT_PRE_PREPARE:
+			spill_pending_to_table();
+			release_reservations(n);
+			hot_pending = NIL;
+			break;
+
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+			LWLockAcquire(hot_queue->lock, LW_EXCLUSIVE);
+			foreach(lc, hot_pending)
+			{
+				HotQueuePending *p = (HotQueuePending *) lfirst(lc);
+
+				hot_entries[(hot_queue->head + hot_queue->count) % hot_queue->capacity] = p->entry;
+				hot_queue->count++;
+			}
+			hot_queue->reserved -= n;
+
+			for (int i = 0; i < hot_queue->nworkers; i++)
+			{
+				if (hot_queue->workers[i].dboid == MyDatabaseId &&
+					hot_queue->workers[i].latch != NULL)
+					SetLatch(hot_queue->workers[i].latch);
+			}
+			LWLockRelease(hot_queue->lock);
+			hot_pending = NIL;
+			break;
+
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+			release_reservations(n);
+			hot_pending = NIL;
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Hand chunks of a committed subtransaction to its parent, and drop those
+ * of an aborted one
+ */
+static void
+hot_queue_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+						   SubTransactionId parentSubid, void *arg)
+{
+	ListCell   *lc;
+	int			dropped = 0;
+
+	if (hot_pending == NIL)
+		return;
+
+	switch (event)
+	{
+		case SUBXACT_EVENT_COMMIT_SUB:
+			foreach(lc, hot_pending)
+			{
+				HotQueuePending *p = (HotQueuePending *) lfirst(lc);
+
+				if (p->subid == mySubid)
+					p->subid = parentSubid;
+			}
+			break;
+
+		case SUBXACT_EVENT_ABORT_SUB:
+			foreach(lc, hot_pending)
+			{
+				HotQueuePending *p = (HotQueuePending *) lfirst(lc);
+
+				if (p->subid == mySubid)
+				{
+					hot_pending = foreach_delete_current(hot_pending, lc);
+					dropped++;
+				}
+			}
+			release_reservations(dropped);
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Queue a chunk on the hot queue
+ *
+ * Returns false when the hot queue is disabled or full; the caller then
+ * queues the chunk in the queue table instead.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_hot_enqueue);
+
+Datum
+pgedge_vectorizer_hot_enqueue(PG_FUNCTION_ARGS)
+{
+	char	   *chunk_table = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	int64		chunk_id = PG_GETARG_INT64(1);
+	HotQueuePending *p;
+	MemoryContext oldcontext;
+	bool		reserved = false;
+
+	if (hot_queue == NULL || strlen(chunk_table) >= NAMEDATALEN)
+		PG_RETURN_BOOL(false);
+
+	if (!callbacks_registered)
+	{
+		RegisterXactCallback(hot_queue_xact_callback, NULL);
+		RegisterSubXactCallback(hot_queue_subxact_callback, NULL);
+		callbacks_registered = true;
+	}
+
+	oldcontext = MemoryContextSwitchTo(TopTransactionContext);
+	p = palloc(sizeof(HotQueuePending));
+	MemoryContextSwitchTo(oldcontext);
+
+	p->entry.dboid = MyDatabaseId;
+	p->entry.chunk_id = chunk_id;
+	strlcpy(p->entry.chunk_table, chunk_table, NAMEDATALEN);
+	p->entry.queued_at = GetCurrentTransactionStartTimestamp();
+	p->entry.traced = PG_GETARG_BOOL(2);
+	p->subid = GetCurrentSubTransactionId();
+
+	LWLockAcquire(hot_queue->lock, LW_EXCLUSIVE);
+	if (hot_queue->count + hot_queue->reserved < hot_queue->capacity)
+	{
+		hot_queue->reserved++;
+		reserved = true;
+	}
+	LWLockRelease(hot_queue->lock);
+
+	if (!reserved)
+	{
+		pfree(p);
+		PG_RETURN_BOOL(false);
+	}
+
+	oldcontext = MemoryContextSwitchTo(TopTransactionContext);
+	hot_pending = lappend(hot_pending, p);
+	MemoryContextSwitchTo(oldcontext);
+
+	PG_RETURN_BOOL(true);
+}
+
+/*
+ * Report the capacity and occupancy of the hot queue
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_hot_queue_status);
+
+Datum
+pgedge_vectorizer_hot_queue_status(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3];
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	memset(values, 0, sizeof(values));
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = Int32GetDatum(0);
+	values[1] = Int32GetDatum(0);
+	values[2] = Int32GetDatum(0);
+
+	if (hot_queue != NULL)
+	{
+		LWLockAcquire(hot_queue->lock, LW_SHARED);
+		values[0] = Int32GetDatum(hot_queue->capacity);
+		values[1] = Int32GetDatum(hot_queue->count);
+		values[2] = Int32GetDatum(hot_queue->reserved);
+		LWLockRelease(hot_queue->lock);
+	}
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * The chunks of the current database waiting on the hot queue, oldest
+ * first
+ *
+ * Chunks of open transactions are not published yet and are not listed.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_hot_queue_entries);
+
+Datum
+pgedge_vectorizer_hot_queue_entries(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	HotQueueEntry *entries = NULL;
+	int			n = 0;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+		!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "set-valued function called in a context that cannot accept a set");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (hot_queue != NULL)
+	{
+		LWLockAcquire(hot_queue->lock, LW_SHARED);
+		entries = palloc(Max(hot_queue->count, 1) * sizeof(HotQueueEntry));
+		for (int k = 0; k < hot_queue->count; k++)
+		{
+			HotQueueEntry *e = &hot_entries[(hot_queue->head + k) % hot_queue->capacity];
+
+			if (e->dboid == MyDatabaseId)
+				entries[n++] = *e;
+		}
+		LWLockRelease(hot_queue->lock);
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		Datum		values[3];
+		bool		nulls[3] = {false, false, false};
+
+		values[0] = CStringGetTextDatum(entries[i].chunk_table);
+		values[1] = Int64GetDatum(entries[i].chunk_id);
+		values[2] = TimestampTzGetDatum(entries[i].queued_at);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
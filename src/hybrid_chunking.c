@@ -25,7 +25,8 @@
 /* Forward declarations */
 static List *split_oversized_chunks(List *chunks, int max_tokens);
 static List *merge_undersized_chunks(List *chunks, int min_tokens, int max_tokens);
-static HybridChunk *create_hybrid_chunk(const char *content, const char *heading_context);
+static HybridChunk *create_hybrid_chunk(const char *content, int content_len,
+										const char *heading_context);
 static void free_hybrid_chunk(HybridChunk *chunk);
 static char *build_heading_context(char **heading_stack, int stack_depth);
 static bool is_blank_line(const char *line, int len);
@@ -164,12 +165,13 @@ create_markdown_element(MarkdownElementType type, int heading_level,
 	elem->type = type;
 	elem->heading_level = heading_level;
 
-	if (content_len > 0)
-		elem->content = pnstrdup(content, content_len);
-	else
-		elem->content = pstrdup(content);
+	if (content_len <= 0)
+		/* flawfinder: ignore - content is null-terminated when no length given */
+		content_len = strlen(content);
 
-	elem->token_count = count_tokens(elem->content, pgedge_vectorizer_model);
+	elem->content = pnstrdup(content, content_len);
+	elem->token_count = count_tokens_len(elem->content, content_len,
+										 pgedge_vectorizer_model);
 	elem->heading_context = heading_context ? pstrdup(heading_context) : NULL;
 
 	return elem;
@@ -195,6 +197,7 @@ is_likely_markdown(const char *content)
 {
 	int indicators = 0;
 	const char *pos = content;
+	const char *content_end;
 	const char *line_end;
 	bool has_heading = false;
 	bool has_code_fence = false;
@@ -202,13 +205,16 @@ is_likely_markdown(const char *content)
 	if (content == NULL || content[0] == '\0')
 		return false;
 
+	/* flawfinder: ignore - content is null-terminated */
+	content_end = content + strlen(content);
+
 	/* Scan content line by line */
 	while (*pos != '\0')
 	{
-		/* Find end of current line */
-		line_end = pos;
-		while (*line_end != '\0' && *line_end != '\n')
-			line_end++;
+		/* Find end of current line (libc memchr is vectorized) */
+		line_end = memchr(pos, '\n', content_end - pos);
+		if (line_end == NULL)
+			line_end = content_end;
 
 		/* Skip leading whitespace (up to 3 spaces for markdown) */
 		while (*pos == ' ' && pos < line_end && (pos - content) < 4)
@@ -233,8 +239,10 @@ is_likely_markdown(const char *content)
 		if (*pos == '>')
 			indicators++;
 
-		/* Check inline patterns within the line */
-		for (const char *p = pos; p < line_end; p++)
+		/* Check inline patterns within the line, jumping between candidates */
+		for (const char *p = pos;
+			 p < line_end && (p = text_find_any(p, line_end - p, "|[", 2)) != NULL;
+			 p++)
 		{
 			if (*p == '|' && check_table_indicator(p, line_end))
 			{
@@ -277,6 +285,7 @@ parse_markdown_structure(const char *content)
 {
 	List *elements = NIL;
 	const char *pos = content;
+	const char *content_end;
 	const char *line_start;
 	int line_len;
 	bool in_code_block = false;
@@ -290,14 +299,18 @@ parse_markdown_structure(const char *content)
 
 	initStringInfo(&current_block);
 
+	/* flawfinder: ignore - content is null-terminated */
+	content_end = content + strlen(content);
+
 	while (*pos != '\0')
 	{
 		int heading_level;
 
-		/* Find end of current line */
+		/* Find end of current line (libc memchr is vectorized) */
 		line_start = pos;
-		while (*pos != '\0' && *pos != '\n')
-			pos++;
+		pos = memchr(line_start, '\n', content_end - line_start);
+		if (pos == NULL)
+			pos = content_end;
 		line_len = pos - line_start;
 
 		/* Handle code block toggle */
@@ -316,7 +329,8 @@ parse_markdown_structure(const char *content)
 				if (current_block.len > 0)
 				elements = lappend(elements,
 					create_markdown_element(MD_ELEMENT_CODE_BLOCK, 0,
-						current_block.data, 0, current_heading_context));
+						current_block.data, current_block.len,
+						current_heading_context));
 
 				resetStringInfo(&current_block);
 				in_code_block = false;
@@ -330,7 +344,8 @@ parse_markdown_structure(const char *content)
 				{
 					elements = lappend(elements,
 						create_markdown_element(current_type, 0,
-							current_block.data, 0, current_heading_context));
+							current_block.data, current_block.len,
+							current_heading_context));
 					resetStringInfo(&current_block);
 				}
 
@@ -358,7 +373,8 @@ parse_markdown_structure(const char *content)
 			{
 				elements = lappend(elements,
 					create_markdown_element(current_type, 0,
-						current_block.data, 0, current_heading_context));
+						current_block.data, current_block.len,
+						current_heading_context));
 				resetStringInfo(&current_block);
 			}
 			current_type = MD_ELEMENT_PARAGRAPH;
@@ -380,7 +396,8 @@ parse_markdown_structure(const char *content)
 			{
 				elements = lappend(elements,
 					create_markdown_element(current_type, 0,
-						current_block.data, 0, current_heading_context));
+						current_block.data, current_block.len,
+						current_heading_context));
 				resetStringInfo(&current_block);
 			}
 
@@ -428,7 +445,8 @@ parse_markdown_structure(const char *content)
 			{
 				elements = lappend(elements,
 					create_markdown_element(current_type, 0,
-						current_block.data, 0, current_heading_context));
+						current_block.data, current_block.len,
+						current_heading_context));
 				resetStringInfo(&current_block);
 			}
 
@@ -450,7 +468,8 @@ parse_markdown_structure(const char *content)
 			{
 				elements = lappend(elements,
 					create_markdown_element(current_type, 0,
-						current_block.data, 0, current_heading_context));
+						current_block.data, current_block.len,
+						current_heading_context));
 				resetStringInfo(&current_block);
 			}
 
@@ -464,7 +483,8 @@ parse_markdown_structure(const char *content)
 			{
 				elements = lappend(elements,
 					create_markdown_element(current_type, 0,
-						current_block.data, 0, current_heading_context));
+						current_block.data, current_block.len,
+						current_heading_context));
 				resetStringInfo(&current_block);
 			}
 
@@ -478,7 +498,8 @@ parse_markdown_structure(const char *content)
 			{
 				elements = lappend(elements,
 					create_markdown_element(current_type, 0,
-						current_block.data, 0, current_heading_context));
+						current_block.data, current_block.len,
+						current_heading_context));
 				resetStringInfo(&current_block);
 			}
 
@@ -498,7 +519,8 @@ parse_markdown_structure(const char *content)
 	if (current_block.len > 0)
 		elements = lappend(elements,
 			create_markdown_element(current_type, 0,
-				current_block.data, 0, current_heading_context));
+				current_block.data, current_block.len,
+				current_heading_context));
 
 	/* Cleanup */
 	pfree(current_block.data);
@@ -574,11 +596,13 @@ build_heading_context(char **heading_stack, int stack_size)
  * Create a hybrid chunk with content and heading context
  */
 static HybridChunk *
-create_hybrid_chunk(const char *content, const char *heading_context)
+create_hybrid_chunk(const char *content, int content_len,
+					const char *heading_context)
 {
 	HybridChunk *chunk = palloc0(sizeof(HybridChunk));
-	chunk->content = pstrdup(content);
-	chunk->token_count = count_tokens(content, pgedge_vectorizer_model);
+	chunk->content = pnstrdup(content, content_len);
+	chunk->token_count = count_tokens_len(chunk->content, content_len,
+										  pgedge_vectorizer_model);
 	chunk->heading_context = heading_context ? pstrdup(heading_context) : NULL;
 	chunk->chunk_index = 0;
 	return chunk;
@@ -757,16 +781,8 @@ is_horizontal_rule(const char *line, int len)
 static bool
 is_table_row(const char *line, int len)
 {
-	bool has_pipe = false;
-
-	for (int i = 0; i < len; i++)
-	{
-		if (line[i] == '|')
-			has_pipe = true;
-	}
-
 	/* Simple heuristic: line contains | character */
-	return has_pipe;
+	return memchr(line, '|', len) != NULL;
 }
 
 /*
@@ -801,12 +817,12 @@ split_oversized_chunks(List *chunks, int max_tokens)
 			{
 				int target_offset;
 				int end_offset;
-				char *sub_content;
 				HybridChunk *sub_chunk;
 
 				/* Find target end position based on token count */
-				target_offset = get_char_offset_for_tokens(
+				target_offset = get_char_offset_for_tokens_len(
 					content + start_offset,
+					content_len - start_offset,
 					max_tokens,
 					pgedge_vectorizer_model
 				);
@@ -823,9 +839,8 @@ split_oversized_chunks(List *chunks, int max_tokens)
 					end_offset = target_offset > 0 ? target_offset : content_len - start_offset;
 
 				/* Extract sub-chunk */
-				sub_content = pnstrdup(content + start_offset, end_offset);
-				sub_chunk = create_hybrid_chunk(sub_content, chunk->heading_context);
-				pfree(sub_content);
+				sub_chunk = create_hybrid_chunk(content + start_offset, end_offset,
+												chunk->heading_context);
 
 				result = lappend(result, sub_chunk);
 
@@ -906,7 +921,8 @@ merge_undersized_chunks(List *chunks, int min_tokens, int max_tokens)
 				/* Update pending chunk */
 				pfree(pending->content);
 				pending->content = merged.data;
-				pending->token_count = count_tokens(pending->content, pgedge_vectorizer_model);
+				pending->token_count = count_tokens_len(merged.data, merged.len,
+														pgedge_vectorizer_model);
 
 				/* Free merged chunk */
 				free_hybrid_chunk(chunk);
@@ -977,11 +993,11 @@ elements_to_chunks_simple(List *elements, ChunkConfig *config)
 			{
 				int target_offset;
 				int end_offset;
-				char *sub_content;
 				HybridChunk *chunk;
 
-				target_offset = get_char_offset_for_tokens(
+				target_offset = get_char_offset_for_tokens_len(
 					content + start_offset,
+					content_len - start_offset,
 					config->chunk_size,
 					pgedge_vectorizer_model
 				);
@@ -995,9 +1011,8 @@ elements_to_chunks_simple(List *elements, ChunkConfig *config)
 				if (end_offset <= 0)
 					end_offset = target_offset > 0 ? target_offset : content_len - start_offset;
 
-				sub_content = pnstrdup(content + start_offset, end_offset);
-				chunk = create_hybrid_chunk(sub_content, elem->heading_context);
-				pfree(sub_content);
+				chunk = create_hybrid_chunk(content + start_offset, end_offset,
+											elem->heading_context);
 
 				chunks = lappend(chunks, chunk);
 
@@ -1014,7 +1029,10 @@ elements_to_chunks_simple(List *elements, ChunkConfig *config)
 		else
 		{
 			/* Element fits in one chunk */
-			HybridChunk *chunk = create_hybrid_chunk(elem->content, elem->heading_context);
+			/* flawfinder: ignore - elem->content is palloc'd, null-terminated */
+			HybridChunk *chunk = create_hybrid_chunk(elem->content,
+													 strlen(elem->content),
+													 elem->heading_context);
 			chunks = lappend(chunks, chunk);
 		}
 	}
@@ -1160,7 +1178,9 @@ chunk_hybrid(const char *content, ChunkConfig *config)
 		if (elem->type == MD_ELEMENT_HORIZONTAL_RULE)
 			continue;
 
-		chunk = create_hybrid_chunk(elem->content, elem->heading_context);
+		/* flawfinder: ignore - elem->content is palloc'd, null-terminated */
+		chunk = create_hybrid_chunk(elem->content, strlen(elem->content),
+									elem->heading_context);
 		chunks = lappend(chunks, chunk);
 	}
 
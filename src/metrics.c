@@ -0,0 +1,733 @@
+/*-------------------------------------------------------------------------
+ *
+ * metrics.c
+ *		Vectorizer metrics in the OpenMetrics text format
+ *
+ * metrics() renders the figures of the other monitoring functions in the
+ * OpenMetrics text format read by Prometheus: queue depth, the hot queue,
+ * worker batch counters and stage times, provider requests and latency
+ * histograms, freshness histograms, hybrid_search() phase times and the
+ * provider usage per chunk table.  Queue, freshness and usage figures are
+ * those of the current database; the others cover the whole server.
+ *
+ * With pgedge_vectorizer.metrics_port set, a background worker serves
+ * metrics() over HTTP on that port of the loopback interface, from the
+ * first database in pgedge_vectorizer.databases.  It answers one request
+ * at a time; scrapes are expected every few seconds at most.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "pgstat.h"
+#include "utils/memutils.h"
+
+/* Time allowed to read a request or write a response, in seconds */
+#define METRICS_SOCKET_TIMEOUT 5
+
+/* Longest request read; the rest of a longer one is ignored */
+#define METRICS_REQUEST_MAX 4096
+
+#define OPENMETRICS_CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/*
+ * A metric family whose samples are one column of a query
+ */
+typedef struct MetricDef
+{
+	const char *name;			/* Family name, without _total */
+	const char *type;			/* "counter" or "gauge" */
+	const char *help;
+	const char *column;			/* Query column holding the value */
+} MetricDef;
+
+static volatile sig_atomic_t got_sigterm = false;
+static volatile sig_atomic_t got_sighup = false;
+
+static void append_label_value(StringInfo buf, const char *value);
+static void append_labels(StringInfo buf, HeapTuple tuple, TupleDesc tupdesc,
+						  int nlabels, const char *const *labels,
+						  const char *le);
+static void append_metrics(StringInfo buf, const char *query, int nlabels,
+						   const char *const *labels, const MetricDef *defs,
+						   int ndefs);
+static void append_histogram(StringInfo buf, const char *query,
+							 const char *name, const char *help, int nlabels,
+							 const char *const *labels);
+static void metrics_sigterm(SIGNAL_ARGS);
+static void metrics_sighup(SIGNAL_ARGS);
+static pgsocket metrics_listen(int port);
+static void serve_client(pgsocket sock);
+static char *render_metrics(int *status);
+static void send_response(pgsocket sock, const char *status,
+						  const char *content_type, const char *body);
+
+/*
+ * Append a label value, escaped as OpenMetrics requires
+ */
+static void
+append_label_value(StringInfo buf, const char *value)
+{
+	appendStringInfoChar(buf, '"');
+	for (const char *p = value; *p; p++)
+	{
+		if (*p == '\\')
+			appendStringInfoString(buf, "\\\\");
+		else if (*p == '"')
+			appendStringInfoString(buf, "\\\"");
+		else if (*p == '\n')
+			appendStringInfoString(buf, "\\n");
+		else
+			appendStringInfoChar(buf, *p);
+	}
+	appendStringInfoChar(buf, '"');
+}
+
+/*
+ * Append the label set of a sample: the first nlabels columns of the row,
+ * and the bucket bound if le is given
+ */
+static void
+append_labels(StringInfo buf, HeapTuple tuple, TupleDesc tupdesc,
+			  int nlabels, const char *const *labels, const char *le)
+{
+	if (nlabels == 0 && le == NULL)
+		return;
+
+	appendStringInfoChar(buf, '{');
+	for (int i = 0; i < nlabels; i++)
+	{
+		char	   *value = SPI_getvalue(tuple, tupdesc, i + 1);
+
+		appendStringInfo(buf, "%s%s=", i > 0 ? "," : "", labels[i]);
+		append_label_value(buf, value ? value : "");
+	}
+	if (le != NULL)
+	{
+		appendStringInfo(buf, "%sle=", nlabels > 0 ? "," : "");
+		append_label_value(buf, le);
+	}
+	appendStringInfoChar(buf, '}');
+}
+
+/*
+ * Append metric families read from one query
+ *
+ * The first nlabels columns of the query are the labels of the samples;
+ * each family takes its values from a column of its own.  Rows where that
+ * column is NULL have no sample.
+ */
+static void
+append_metrics(StringInfo buf, const char *query, int nlabels,
+			   const char *const *labels, const MetricDef *defs, int ndefs)
+{
+	SPITupleTable *tuptable;
+	TupleDesc	tupdesc;
+
+	if (SPI_execute(query, true, 0) != SPI_OK_SELECT)
+		elog(ERROR, "Failed to read metrics: %s", query);
+
+	tuptable = SPI_tuptable;
+	tupdesc = tuptable->tupdesc;
+
+	for (int d = 0; d < ndefs; d++)
+	{
+		bool		counter = strcmp(defs[d].type, "counter") == 0;
+		int			column = SPI_fnumber(tupdesc, defs[d].column);
+
+		if (column <= 0)
+			elog(ERROR, "metrics query has no column \"%s\"", defs[d].column);
+
+		appendStringInfo(buf, "# TYPE %s %s\n# HELP %s %s\n",
+						 defs[d].name, defs[d].type, defs[d].name, defs[d].help);
+
+		for (uint64 r = 0; r < SPI_processed; r++)
+		{
+			HeapTuple	tuple = tuptable->vals[r];
+			char	   *value = SPI_getvalue(tuple, tupdesc, column);
+
+			if (value == NULL)
+				continue;
+
+			appendStringInfo(buf, "%s%s", defs[d].name, counter ? "_total" : "");
+			append_labels(buf, tuple, tupdesc, nlabels, labels, NULL);
+			appendStringInfo(buf, " %s\n", value);
+		}
+	}
+}
+
+/*
+ * Append a histogram family read from one query
+ *
+ * The query returns the labels, then the upper bound and count of each
+ * bucket, in order of labels and bound.  The buckets are not cumulative
+ * and the last bound of each label set is infinite, as returned by
+ * provider_latency_histogram() and freshness_histogram().
+ */
+static void
+append_histogram(StringInfo buf, const char *query, const char *name,
+				 const char *help, int nlabels, const char *const *labels)
+{
+	SPITupleTable *tuptable;
+	TupleDesc	tupdesc;
+	int64		cumulative = 0;
+
+	if (SPI_execute(query, true, 0) != SPI_OK_SELECT)
+		elog(ERROR, "Failed to read metrics: %s", query);
+
+	tuptable = SPI_tuptable;
+	tupdesc = tuptable->tupdesc;
+
+	appendStringInfo(buf, "# TYPE %s histogram\n# HELP %s %s\n", name, name, help);
+
+	for (uint64 r = 0; r < SPI_processed; r++)
+	{
+		HeapTuple	tuple = tuptable->vals[r];
+		char	   *le = SPI_getvalue(tuple, tupdesc, nlabels + 1);
+		char	   *count = SPI_getvalue(tuple, tupdesc, nlabels + 2);
+		bool		last = strcmp(le, "Infinity") == 0;
+
+		cumulative += strtoi64(count, NULL, 10);
+
+		appendStringInfo(buf, "%s_bucket", name);
+		append_labels(buf, tuple, tupdesc, nlabels, labels, last ? "+Inf" : le);
+		appendStringInfo(buf, " " INT64_FORMAT "\n", cumulative);
+
+		if (last)
+		{
+			appendStringInfo(buf, "%s_count", name);
+			append_labels(buf, tuple, tupdesc, nlabels, labels, NULL);
+			appendStringInfo(buf, " " INT64_FORMAT "\n", cumulative);
+			cumulative = 0;
+		}
+	}
+}
+
+/*
+ * Render all vectorizer metrics in the OpenMetrics text format
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_metrics);
+
+Datum
+pgedge_vectorizer_metrics(PG_FUNCTION_ARGS)
+{
+	static const char *const queue_labels[] = {"chunk_table", "status"};
+	static const char *const endpoint_labels[] = {"provider", "model", "endpoint"};
+	static const char *const phase_labels[] = {"provider", "model", "endpoint", "phase"};
+	static const char *const stage_labels[] = {"stage"};
+	static const char *const search_phase_labels[] = {"phase"};
+	static const char *const table_labels[] = {"chunk_table"};
+	static const MetricDef queue_metrics[] = {
+		{"pgedge_vectorizer_queue_items", "gauge",
+		 "Queue items per chunk table and status", "count"},
+	};
+	static const MetricDef hot_queue_metrics[] = {
+		{"pgedge_vectorizer_hot_queue_capacity", "gauge",
+		 "Capacity of the hot queue in chunks", "capacity"},
+		{"pgedge_vectorizer_hot_queue_queued", "gauge",
+		 "Chunks waiting in the hot queue", "queued"},
+		{"pgedge_vectorizer_hot_queue_reserved", "gauge",
+		 "Hot queue slots reserved by open transactions", "reserved"},
+	};
+	static const MetricDef worker_metrics[] = {
+		{"pgedge_vectorizer_workers", "gauge",
+		 "Running vectorizer workers", "workers"},
+	};
+	static const MetricDef batch_metrics[] = {
+		{"pgedge_vectorizer_batches", "counter",
+		 "Batches processed by the workers", "batches"},
+		{"pgedge_vectorizer_batch_items", "counter",
+		 "Items in the batches processed by the workers", "items"},
+		{"pgedge_vectorizer_batch_failed_items", "counter",
+		 "Items of worker batches that failed", "failed"},
+	};
+	static const MetricDef stage_metrics[] = {
+		{"pgedge_vectorizer_batch_stage_seconds", "counter",
+		 "Time spent by worker batches per pipeline stage", "seconds"},
+	};
+	static const MetricDef provider_metrics[] = {
+		{"pgedge_vectorizer_provider_requests", "counter",
+		 "HTTP requests to the embedding provider", "requests"},
+		{"pgedge_vectorizer_provider_failures", "counter",
+		 "Failed HTTP requests to the embedding provider", "failures"},
+		{"pgedge_vectorizer_provider_items", "counter",
+		 "Texts sent to the embedding provider", "items"},
+		{"pgedge_vectorizer_provider_tokens", "counter",
+		 "Tokens of the texts sent to the embedding provider", "tokens"},
+		{"pgedge_vectorizer_provider_request_bytes", "counter",
+		 "Bytes sent to the embedding provider", "request_bytes"},
+		{"pgedge_vectorizer_provider_response_bytes", "counter",
+		 "Bytes received from the embedding provider", "response_bytes"},
+	};
+	static const MetricDef freshness_metrics[] = {
+		{"pgedge_vectorizer_pending_lag_seconds", "gauge",
+		 "Age of the oldest chunk waiting for its embedding", "pending_lag_secs"},
+	};
+	static const MetricDef search_metrics[] = {
+		{"pgedge_vectorizer_searches", "counter",
+		 "Calls of hybrid_search()", "searches"},
+	};
+	static const MetricDef search_phase_metrics[] = {
+		{"pgedge_vectorizer_search_phase_seconds", "counter",
+		 "Time spent by hybrid_search() per phase", "seconds"},
+	};
+	static const MetricDef usage_metrics[] = {
+		{"pgedge_vectorizer_usage_tokens", "counter",
+		 "Provider tokens spent per chunk table", "tokens"},
+		{"pgedge_vectorizer_usage_requests", "counter",
+		 "Provider requests made per chunk table", "requests"},
+		{"pgedge_vectorizer_usage_items", "counter",
+		 "Texts embedded per chunk table", "items"},
+		{"pgedge_vectorizer_usage_cache_hits", "counter",
+		 "Chunks that reused their stored dense embedding", "cache_hits"},
+		{"pgedge_vectorizer_usage_retries", "counter",
+		 "Queue items retried per chunk table", "retries"},
+	};
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	append_metrics(&buf,
+				   "SELECT chunk_table, status, count "
+				   "FROM pgedge_vectorizer.queue_stats() "
+				   "ORDER BY chunk_table, status",
+				   2, queue_labels, queue_metrics, lengthof(queue_metrics));
+
+	append_metrics(&buf,
+				   "SELECT capacity, queued, reserved "
+				   "FROM pgedge_vectorizer.hot_queue_status()",
+				   0, NULL, hot_queue_metrics, lengthof(hot_queue_metrics));
+
+	append_metrics(&buf,
+				   "SELECT count(*) AS workers FROM pg_stat_activity "
+				   "WHERE backend_type = 'pgedge_vectorizer'",
+				   0, NULL, worker_metrics, lengthof(worker_metrics));
+
+	append_metrics(&buf,
+				   "SELECT batches, items, failed "
+				   "FROM pgedge_vectorizer.batch_stats()",
+				   0, NULL, batch_metrics, lengthof(batch_metrics));
+
+	append_metrics(&buf,
+				   "SELECT s.stage, s.ms / 1000 AS seconds "
+				   "FROM pgedge_vectorizer.batch_stats() b, LATERAL (VALUES "
+				   "('claim', b.claim_ms), ('probe', b.probe_ms), "
+				   "('request_build', b.request_build_ms), ('http', b.http_ms), "
+				   "('parse', b.parse_ms), ('write', b.write_ms), "
+				   "('bm25_tokenize', b.bm25_tokenize_ms), "
+				   "('bm25_score', b.bm25_score_ms), ('bm25_idf', b.bm25_idf_ms), "
+				   "('commit', b.commit_ms), ('other', b.other_ms)) s(stage, ms)",
+				   1, stage_labels, stage_metrics, lengthof(stage_metrics));
+
+	append_metrics(&buf,
+				   "SELECT provider, model, endpoint, requests, failures, items, "
+				   "tokens, request_bytes, response_bytes "
+				   "FROM pgedge_vectorizer.provider_stats()",
+				   3, endpoint_labels, provider_metrics, lengthof(provider_metrics));
+
+	append_histogram(&buf,
+					 "SELECT provider, model, endpoint, phase, le_ms / 1000, count "
+					 "FROM pgedge_vectorizer.provider_latency_histogram()",
+					 "pgedge_vectorizer_provider_latency_seconds",
+					 "Latency of the HTTP requests to the embedding provider per phase",
+					 4, phase_labels);
+
+	append_metrics(&buf,
+				   "SELECT chunk_table, pending_lag_secs "
+				   "FROM pgedge_vectorizer.freshness_stats()",
+				   1, table_labels, freshness_metrics, lengthof(freshness_metrics));
+
+	append_histogram(&buf,
+					 "SELECT chunk_table, le_secs, count "
+					 "FROM pgedge_vectorizer.freshness_histogram()",
+					 "pgedge_vectorizer_freshness_seconds",
+					 "Time from queuing a chunk to its searchable embedding",
+					 1, table_labels);
+
+	append_metrics(&buf,
+				   "SELECT searches FROM pgedge_vectorizer.search_stats()",
+				   0, NULL, search_metrics, lengthof(search_metrics));
+
+	append_metrics(&buf,
+				   "SELECT p.phase, p.ms / 1000 AS seconds "
+				   "FROM pgedge_vectorizer.search_stats() s, LATERAL (VALUES "
+				   "('lookup', s.lookup_ms), ('embed', s.embed_ms), "
+				   "('bm25_query', s.bm25_query_ms), ('idf_load', s.idf_load_ms), "
+				   "('dense_scan', s.dense_scan_ms), ('sparse_scan', s.sparse_scan_ms), "
+				   "('merge', s.merge_ms)) p(phase, ms)",
+				   1, search_phase_labels, search_phase_metrics,
+				   lengthof(search_phase_metrics));
+
+	append_metrics(&buf,
+				   "SELECT chunk_table, tokens, requests, items, cache_hits, retries "
+				   "FROM pgedge_vectorizer.usage_stats ORDER BY chunk_table",
+				   1, table_labels, usage_metrics, lengthof(usage_metrics));
+
+	appendStringInfoString(&buf, "# EOF\n");
+
+	SPI_finish();
+
+	PG_RETURN_TEXT_P(cstring_to_text_with_len(buf.data, buf.len));
+}
+
+/*
+ * Signal handler for SIGTERM
+ */
+static void
+metrics_sigterm(SIGNAL_ARGS)
+{
+	int save_errno = errno;
+	got_sigterm = true;
+	SetLatch(MyLatch);
+	errno = save_errno;
+}
+
+/*
+ * Signal handler for SIGHUP
+ */
+static void
+metrics_sighup(SIGNAL_ARGS)
+{
+	int save_errno = errno;
+	got_sighup = true;
+	SetLatch(MyLatch);
+	errno = save_errno;
+}
+
+/*
+ * Register the metrics server
+ *
+ * Called during _PG_init, after the vectorizer workers are registered.
+ */
+void
+register_metrics_worker(void)
+{
+	BackgroundWorker worker;
+
+	if (pgedge_vectorizer_metrics_port <= 0)
+		return;
+
+	memset(&worker, 0, sizeof(BackgroundWorker));
+
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS |
+					   BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = 60;	/* e.g. while the port is taken */
+
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "pgedge_vectorizer");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "pgedge_vectorizer_metrics_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "pgedge_vectorizer metrics server");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "pgedge_vectorizer metrics");
+
+	worker.bgw_main_arg = (Datum) 0;
+	worker.bgw_notify_pid = 0;
+
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * Open the listening socket on the loopback interface
+ */
+static pgsocket
+metrics_listen(int port)
+{
+	struct sockaddr_in addr;
+	pgsocket	sock;
+	int			one = 1;
+
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock == PGINVALID_SOCKET)
+		elog(ERROR, "pgedge_vectorizer metrics server: could not create socket: %m");
+
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char *) &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16) port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+		elog(ERROR, "pgedge_vectorizer metrics server: could not bind to port %d: %m",
+			 port);
+
+	if (listen(sock, 16) < 0)
+		elog(ERROR, "pgedge_vectorizer metrics server: could not listen on port %d: %m",
+			 port);
+
+	if (!pg_set_noblock(sock))
+		elog(ERROR, "pgedge_vectorizer metrics server: could not set socket to non-blocking mode: %m");
+
+	return sock;
+}
+
+/*
+ * Run metrics() in a transaction of its own
+ *
+ * Returns the rendered metrics, or the error message with status 503 if
+ * they could not be read, e.g. before CREATE EXTENSION.
+ */
+static char *
+render_metrics(int *status)
+{
+	MemoryContext request_context = CurrentMemoryContext;
+	char	   *volatile result = NULL;
+
+	*status = 200;
+
+	PG_TRY();
+	{
+		SetCurrentStatementStartTimestamp();
+		StartTransactionCommand();
+		SPI_connect();
+		PushActiveSnapshot(GetTransactionSnapshot());
+		pgstat_report_activity(STATE_RUNNING, "SELECT pgedge_vectorizer.metrics()");
+
+		if (SPI_execute("SELECT pgedge_vectorizer.metrics()", true, 1) != SPI_OK_SELECT ||
+			SPI_processed != 1)
+			elog(ERROR, "Failed to read the vectorizer metrics");
+
+		result = MemoryContextStrdup(request_context,
+									 SPI_getvalue(SPI_tuptable->vals[0],
+												  SPI_tuptable->tupdesc, 1));
+
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(request_context);
+		edata = CopyErrorData();
+		FlushErrorState();
+		AbortCurrentTransaction();
+
+		elog(LOG, "pgedge_vectorizer metrics server: %s", edata->message);
+		result = psprintf("%s\n", edata->message);
+		*status = 503;
+	}
+	PG_END_TRY();
+
+	MemoryContextSwitchTo(request_context);
+	pgstat_report_activity(STATE_IDLE, NULL);
+
+	return result;
+}
+
+/*
+ * Write an HTTP/1.0 response and its body
+ */
+static void
+send_response(pgsocket sock, const char *status, const char *content_type,
+			  const char *body)
+{
+	StringInfoData response;
+	size_t		sent = 0;
+
+	initStringInfo(&response);
+	appendStringInfo(&response,
+					 "HTTP/1.0 %s\r\n"
+					 "Content-Type: %s\r\n"
+					 "Content-Length: %zu\r\n"
+					 "Connection: close\r\n"
+					 "\r\n%s",
+					 status, content_type, strlen(body), body);
+
+	while (sent < response.len)
+	{
+		ssize_t		n = send(sock, response.data + sent, response.len - sent, 0);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		sent += n;
+	}
+
+	pfree(response.data);
+}
+
+/*
+ * Answer one HTTP request
+ *
+ * Only GET /metrics is served.  The socket is blocking with a timeout, so
+ * a client that stalls holds the server for METRICS_SOCKET_TIMEOUT at most.
+ */
+static void
+serve_client(pgsocket sock)
+{
+	struct timeval timeout;
+	char		request[METRICS_REQUEST_MAX + 1];
+	size_t		len = 0;
+	char	   *path;
+	char	   *end;
+
+	pg_set_block(sock);
+
+	timeout.tv_sec = METRICS_SOCKET_TIMEOUT;
+	timeout.tv_usec = 0;
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *) &timeout, sizeof(timeout));
+	setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (char *) &timeout, sizeof(timeout));
+
+	/* Read up to the end of the request line */
+	while (len < METRICS_REQUEST_MAX)
+	{
+		ssize_t		n = recv(sock, request + len, METRICS_REQUEST_MAX - len, 0);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		len += n;
+		request[len] = '\0';
+		if (strchr(request, '\n') != NULL)
+			break;
+	}
+	request[len] = '\0';
+
+	if (strncmp(request, "GET ", 4) != 0)
+	{
+		send_response(sock, "405 Method Not Allowed", "text/plain",
+					  "Only GET is supported\n");
+		return;
+	}
+
+	path = request + 4;
+	end = path + strcspn(path, " ?\r\n");
+	*end = '\0';
+
+	if (strcmp(path, "/metrics") != 0)
+	{
+		send_response(sock, "404 Not Found", "text/plain",
+					  "Metrics are served at /metrics\n");
+		return;
+	}
+
+	{
+		int			status;
+		char	   *body = render_metrics(&status);
+
+		if (status == 200)
+			send_response(sock, "200 OK", OPENMETRICS_CONTENT_TYPE, body);
+		else
+			send_response(sock, "503 Service Unavailable", "text/plain", body);
+	}
+}
+
+/*
+ * Metrics server main entry point
+ */
+PGDLLEXPORT void
+pgedge_vectorizer_metrics_main(Datum main_arg)
+{
+	char		dbname[NAMEDATALEN];
+	char	   *db_list;
+	char	   *db_name;
+	pgsocket	listen_sock;
+	MemoryContext request_context;
+
+	pqsignal(SIGTERM, metrics_sigterm);
+	pqsignal(SIGHUP, metrics_sighup);
+	BackgroundWorkerUnblockSignals();
+
+	/* Wait for a database to serve the metrics of */
+	while (pgedge_vectorizer_databases == NULL || pgedge_vectorizer_databases[0] == '\0')
+	{
+		int			rc;
+
+		if (got_sigterm)
+			proc_exit(0);
+
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+			continue;
+		}
+
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   60000L,
+					   vectorizer_wait_event(VECTORIZER_WAIT_FOR_EXTENSION));
+		ResetLatch(MyLatch);
+
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+	}
+
+	/* Serve from the first database of the list */
+	db_list = pstrdup(pgedge_vectorizer_databases);
+	db_name = strtok(db_list, ",");
+	if (db_name == NULL)
+	{
+		elog(LOG, "pgedge_vectorizer metrics server: empty database list, exiting");
+		proc_exit(0);
+	}
+
+	while (*db_name == ' ' || *db_name == '\t')
+		db_name++;
+	strlcpy(dbname, db_name, NAMEDATALEN);
+	for (int i = strlen(dbname) - 1; i >= 0 && (dbname[i] == ' ' || dbname[i] == '\t'); i--)
+		dbname[i] = '\0';
+	pfree(db_list);
+
+	BackgroundWorkerInitializeConnection(dbname, NULL, 0);
+
+	listen_sock = metrics_listen(pgedge_vectorizer_metrics_port);
+
+	elog(LOG, "pgedge_vectorizer metrics server listening on 127.0.0.1:%d (database: %s)",
+		 pgedge_vectorizer_metrics_port, dbname);
+
+	pgstat_report_appname("pgedge_vectorizer metrics server");
+
+	request_context = AllocSetContextCreate(TopMemoryContext,
+											"pgedge_vectorizer metrics request",
+											ALLOCSET_DEFAULT_SIZES);
+
+	while (!got_sigterm)
+	{
+		int			rc;
+
+		rc = WaitLatchOrSocket(MyLatch,
+							   WL_LATCH_SET | WL_SOCKET_READABLE | WL_POSTMASTER_DEATH,
+							   listen_sock, -1L,
+							   vectorizer_wait_event(VECTORIZER_WAIT_METRICS_LISTEN));
+		ResetLatch(MyLatch);
+
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (rc & WL_SOCKET_READABLE)
+		{
+			pgsocket	client = accept(listen_sock, NULL, NULL);
+
+			if (client == PGINVALID_SOCKET)
+				continue;
+
+			MemoryContextSwitchTo(request_context);
+			serve_client(client);
+			closesocket(client);
+			MemoryContextSwitchTo(TopMemoryContext);
+			MemoryContextReset(request_context);
+		}
+	}
+
+	closesocket(listen_sock);
+	proc_exit(0);
+}
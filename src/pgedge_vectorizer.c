@@ -30,7 +30,14 @@ _PG_init(void)
 	/* Register background workers if we're in the postmaster */
 	if (process_shared_preload_libraries_in_progress)
 	{
+		hot_queue_init();
+		queue_stats_init();
+		provider_stats_init();
+		batch_stats_init();
+		freshness_stats_init();
+		search_stats_init();
 		register_background_workers();
+		register_metrics_worker();
 		elog(LOG, "pgedge_vectorizer: %d background worker(s) registered",
 			 pgedge_vectorizer_num_workers);
 	}
@@ -28,6 +28,7 @@
 #include "utils/builtins.h"
 #include "utils/guc.h"
 #include "utils/snapmgr.h"
+#include "utils/timestamp.h"
 
 /* Version compatibility */
 #if PG_VERSION_NUM < 140000
@@ -64,6 +65,16 @@ extern int pgedge_vectorizer_default_chunk_size;
 extern int pgedge_vectorizer_default_chunk_overlap;
 extern bool pgedge_vectorizer_strip_non_ascii;
 extern int pgedge_vectorizer_auto_cleanup_hours;
+extern int pgedge_vectorizer_index_build_workers;
+extern int pgedge_vectorizer_hot_queue_size;
+extern int pgedge_vectorizer_migration_batch_size;
+extern int pgedge_vectorizer_metrics_port;
+extern double pgedge_vectorizer_trace_sample_rate;
+extern char *pgedge_vectorizer_trace_tables;
+extern int pgedge_vectorizer_trace_max_rows;
+extern bool pgedge_vectorizer_profile_search;
+extern int pgedge_vectorizer_history_interval;
+extern int pgedge_vectorizer_history_size;
 
 /*
  * GUC Variables - Hybrid search configuration
@@ -80,8 +91,8 @@ typedef enum
 	CHUNK_STRATEGY_TOKEN,      /* Fixed token count */
 	CHUNK_STRATEGY_SEMANTIC,   /* Semantic boundaries (future) */
 	CHUNK_STRATEGY_MARKDOWN,   /* Respect markdown structure (future) */
-	CHUNK_STRATEGY_SENTENCE,   /* Sentence-based (future) */
-	CHUNK_STRATEGY_RECURSIVE,  /* Recursive character splitting (future) */
+	CHUNK_STRATEGY_SENTENCE,   /* Whole sentences packed to the token target */
+	CHUNK_STRATEGY_RECURSIVE,  /* Paragraph > line > sentence > word splitting */
 	CHUNK_STRATEGY_HYBRID      /* Hierarchical + tokenization-aware refinement */
 } ChunkStrategy;
 
@@ -133,6 +144,70 @@ typedef struct ChunkConfig
 	char *separators;      /* For semantic chunking (future) */
 } ChunkConfig;
 
+/*
+ * Hot queue entry: a committed chunk waiting for its embedding
+ */
+typedef struct HotQueueEntry
+{
+	Oid dboid;                      /* Database of the chunk table */
+	int64 chunk_id;                 /* ID of the chunk in the chunk table */
+	char chunk_table[NAMEDATALEN];  /* Name of the chunk table */
+	TimestampTz queued_at;          /* Start of the transaction that queued it */
+	bool traced;                    /* Document sampled for ingest_trace */
+} HotQueueEntry;
+
+/*
+ * Waits reported as named wait events (see wait_events.c)
+ */
+typedef enum
+{
+	VECTORIZER_WAIT_PROVIDER_REQUEST,	/* HTTP request to the embedding provider */
+	VECTORIZER_WAIT_QUEUE_POLL,		/* Worker waiting for queued work */
+	VECTORIZER_WAIT_FOR_EXTENSION,	/* Worker waiting for a database or CREATE EXTENSION */
+	VECTORIZER_WAIT_METRICS_LISTEN,	/* Metrics server waiting for a scrape */
+	VECTORIZER_WAIT_COUNT
+} VectorizerWaitEvent;
+
+/*
+ * Stages of a worker batch timed by batch_stats.c
+ *
+ * The stages do not overlap: request_build excludes the HTTP and parse
+ * time of the provider requests, and write excludes the BM25 stages.
+ */
+typedef enum
+{
+	BATCH_STAGE_CLAIM,				/* Claim items, mark them processing */
+	BATCH_STAGE_PROBE,				/* Read chunk text, targets, existing embeddings */
+	BATCH_STAGE_REQUEST_BUILD,		/* Provider call less HTTP and parse */
+	BATCH_STAGE_HTTP,				/* HTTP exchanges with the provider */
+	BATCH_STAGE_PARSE,				/* Parsing provider responses */
+	BATCH_STAGE_WRITE,				/* Writing embeddings, completing items */
+	BATCH_STAGE_BM25_TOKENIZE,
+	BATCH_STAGE_BM25_SCORE,
+	BATCH_STAGE_BM25_IDF,			/* Loading and updating IDF statistics */
+	BATCH_STAGE_COMMIT,
+	BATCH_STAGE_OTHER,				/* Rest of the batch's time */
+	BATCH_NSTAGES
+} BatchStage;
+
+/*
+ * One HTTP request of a provider, as reported to provider_stats_record()
+ */
+typedef struct ProviderRequestStats
+{
+	const char *provider;
+	const char *model;
+	const char *endpoint;           /* URL the request was sent to */
+	int items;                      /* Texts in the request */
+	int64 tokens;                   /* Tokens of the texts: reported by the provider, else estimated */
+	int64 request_bytes;
+	int64 response_bytes;
+	double ttfb_secs;               /* Until the first byte of the response */
+	double total_secs;              /* Whole HTTP exchange */
+	double parse_secs;              /* Parsing the response; 0 if not parsed */
+	bool failed;
+} ProviderRequestStats;
+
 /*
  * Provider interface
  */
@@ -156,26 +231,46 @@ void pgedge_vectorizer_init_guc(void);
 EmbeddingProvider *get_embedding_provider(const char *name);
 EmbeddingProvider *get_current_provider(void);
 void register_embedding_providers(void);
+int64 parse_usage_total_tokens(const char *json_response);
 
 /* provider_openai.c */
 extern EmbeddingProvider OpenAIProvider;
+float **openai_parse_embedding_response(const char *json_response, int count,
+										int *dim, char **error_msg);
 
 /* provider_voyage.c */
 extern EmbeddingProvider VoyageProvider;
 
 /* provider_ollama.c */
 extern EmbeddingProvider OllamaProvider;
+float *ollama_parse_embedding_response(const char *json_response, int *dim,
+									   char **error_msg);
 
 /* tokenizer.c */
 int count_tokens(const char *text, const char *model);
+int count_tokens_len(const char *text, size_t len, const char *model);
+int count_tokens_for_chars(int64 char_count, const char *model);
 int *tokenize_text(const char *text, const char *model, int *token_count);
 char *detokenize_tokens(const int *tokens, int token_count, const char *model);
 int get_char_offset_for_tokens(const char *text, int target_tokens, const char *model);
+int get_char_offset_for_tokens_len(const char *text, size_t len,
+								   int target_tokens, const char *model);
 int find_good_break_point(const char *text, int target_offset, int max_offset);
 
+/* text_scan.c */
+extern int64 (*utf8_count_chars) (const char *s, size_t len);
+extern size_t (*utf8_offset_for_chars) (const char *s, size_t len, int64 nchars);
+extern size_t (*ascii_prefix_len) (const char *s, size_t len);
+extern const char *(*text_find_any) (const char *s, size_t len,
+									 const char *set, int nset);
+size_t text_strip_non_ascii(char *dst, const char *src, size_t len);
+const char *text_scan_implementation(void);
+
 /* chunking.c */
 ArrayType *chunk_text(const char *content, ChunkConfig *config);
 ArrayType *chunk_by_tokens(const char *content, ChunkConfig *config);
+ArrayType *chunk_by_sentences(const char *content, ChunkConfig *config);
+ArrayType *chunk_recursive(const char *content, ChunkConfig *config);
 ChunkStrategy parse_chunk_strategy(const char *strategy_str);
 
 /* hybrid_chunking.c */
@@ -188,6 +283,78 @@ void free_markdown_elements(List *elements);
 extern PGDLLEXPORT PGEDGE_NORETURN void pgedge_vectorizer_worker_main(Datum main_arg) PGEDGE_NORETURN_SUFFIX;
 void register_background_workers(void);
 
+/* hot_queue.c */
+void hot_queue_init(void);
+bool hot_queue_enabled(void);
+void hot_queue_register_worker(int worker_id);
+int hot_queue_pop(Oid dboid, HotQueueEntry *entries, int max_entries);
+int hot_queue_oldest_entries(Oid dboid, HotQueueEntry *oldest, int max_tables);
+Datum pgedge_vectorizer_hot_enqueue(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_hot_queue_status(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_hot_queue_entries(PG_FUNCTION_ARGS);
+
+/* provider_stats.c */
+void provider_stats_init(void);
+void provider_stats_record(const ProviderRequestStats *stats);
+Datum pgedge_vectorizer_provider_stats(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_provider_latency_histogram(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_reset_provider_stats(PG_FUNCTION_ARGS);
+
+/* batch_stats.c */
+void batch_stats_init(void);
+void batch_stats_begin(bool hot);
+void batch_stats_stage_begin(BatchStage stage);
+void batch_stats_stage_end(BatchStage stage);
+void batch_stats_add(BatchStage stage, double secs);
+double batch_stats_stage_secs(BatchStage stage);
+void batch_stats_finish(int worker_id, int items, int failed);
+Datum pgedge_vectorizer_batch_stats(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_recent_batches(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_reset_batch_stats(PG_FUNCTION_ARGS);
+
+/* freshness_stats.c */
+void freshness_stats_init(void);
+void freshness_stats_note(const char *chunk_table, TimestampTz queued_at);
+Datum pgedge_vectorizer_freshness_stats(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_freshness_histogram(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_reset_freshness_stats(PG_FUNCTION_ARGS);
+
+/* search_stats.c */
+void search_stats_init(void);
+void search_stats_note_idf_load(double secs);
+Datum pgedge_vectorizer_record_search_profile(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_search_stats(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_reset_search_stats(PG_FUNCTION_ARGS);
+
+/* usage_stats.c */
+void usage_stats_begin_call(void);
+void usage_stats_record_request(const ProviderRequestStats *stats);
+void usage_stats_end_call(int n, char **chunk_tables, const char **contents);
+void usage_stats_count(const char *chunk_table, int cache_hits, int retries);
+void usage_stats_write(void);
+void usage_stats_reset(void);
+Datum pgedge_vectorizer_record_usage(PG_FUNCTION_ARGS);
+
+/* wait_events.c */
+uint32 vectorizer_wait_event(VectorizerWaitEvent event);
+
+/* trace.c */
+Datum pgedge_vectorizer_trace_sampled(PG_FUNCTION_ARGS);
+void trace_event(const char *chunk_table, int64 chunk_id, const char *stage,
+				 double duration_ms, int size, const char *detail);
+
+/* metrics.c */
+extern PGDLLEXPORT PGEDGE_NORETURN void pgedge_vectorizer_metrics_main(Datum main_arg) PGEDGE_NORETURN_SUFFIX;
+void register_metrics_worker(void);
+Datum pgedge_vectorizer_metrics(PG_FUNCTION_ARGS);
+
+/* queue_stats.c */
+void queue_stats_init(void);
+bool queue_stats_needs_seed(void);
+Datum pgedge_vectorizer_queue_stats(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_queue_stats_trigger(PG_FUNCTION_ARGS);
+Datum pgedge_vectorizer_refresh_queue_stats(PG_FUNCTION_ARGS);
+
 /* queue.c */
 Datum pgedge_vectorizer_queue_status(PG_FUNCTION_ARGS);
 Datum pgedge_vectorizer_worker_stats(PG_FUNCTION_ARGS);
@@ -85,3 +85,48 @@ get_current_provider(void)
 
 	return provider;
 }
+
+/*
+ * Token count reported in a provider response
+ *
+ * OpenAI and Voyage AI responses end with "usage":{..."total_tokens":n}.
+ * The object is looked for from the end, after the embeddings.  Returns
+ * -1 when the response does not report the count.
+ */
+int64
+parse_usage_total_tokens(const char *json_response)
+{
+	static const char usage_key[] = "\"usage\"";
+	static const char total_key[] = "\"total_tokens\"";
+	size_t		len = strlen(json_response);
+	const char *p = NULL;
+	char	   *end;
+	int64		tokens;
+
+	for (size_t i = len; i >= sizeof(usage_key) - 1; i--)
+	{
+		if (memcmp(json_response + i - (sizeof(usage_key) - 1), usage_key,
+				   sizeof(usage_key) - 1) == 0)
+		{
+			p = json_response + i;
+			break;
+		}
+	}
+	if (p == NULL)
+		return -1;
+
+	p = strstr(p, total_key);
+	if (p == NULL)
+		return -1;
+	p += sizeof(total_key) - 1;
+
+	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ':')
+		p++;
+
+	errno = 0;
+	tokens = strtoll(p, &end, 10);
+	if (end == p || errno != 0 || tokens < 0)
+		return -1;
+
+	return tokens;
+}
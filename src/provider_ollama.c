@@ -14,7 +14,9 @@
 
 #include <curl/curl.h>
 
+#include "portability/instr_time.h"
 #include "utils/memutils.h"
+#include "utils/wait_event.h"
 
 /*
  * Response buffer for libcurl
@@ -41,7 +43,6 @@ static float **ollama_generate_batch(const char **texts, int count, int *dim, ch
 /* Helper functions */
 static char *escape_json_string(const char *str);
 static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp);
-static float *parse_ollama_embedding_response(const char *json_response, int *dim, char **error_msg);
 
 /*
  * Ollama Provider struct
@@ -102,6 +103,9 @@ ollama_generate(const char *text, int *dim, char **error_msg)
 	float *embedding = NULL;
 	long response_code;
 	char *escaped;
+	ProviderRequestStats stats;
+	instr_time parse_start;
+	instr_time parse_time;
 
 	if (!provider_initialized)
 	{
@@ -114,6 +118,12 @@ ollama_generate(const char *text, int *dim, char **error_msg)
 	response.data[0] = '\0';
 	response.size = 0;
 
+	memset(&stats, 0, sizeof(stats));
+	stats.provider = "ollama";
+	stats.model = pgedge_vectorizer_model;
+	stats.items = 1;
+	stats.tokens = count_tokens(text, pgedge_vectorizer_model);
+
 	/* Build JSON request - Ollama API format */
 	initStringInfo(&request_buf);
 	escaped = escape_json_string(text);
@@ -148,7 +158,16 @@ ollama_generate(const char *text, int *dim, char **error_msg)
 	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L);  /* 5 minute timeout */
 
 	/* Perform the request */
+	pgstat_report_wait_start(vectorizer_wait_event(VECTORIZER_WAIT_PROVIDER_REQUEST));
 	res = curl_easy_perform(curl);
+	pgstat_report_wait_end();
+
+	stats.endpoint = url;
+	stats.request_bytes = request_buf.len;
+	stats.response_bytes = response.size;
+	stats.failed = true;
+	curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &stats.ttfb_secs);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &stats.total_secs);
 
 	if (res != CURLE_OK)
 	{
@@ -166,9 +185,15 @@ ollama_generate(const char *text, int *dim, char **error_msg)
 	}
 
 	/* Parse the response */
-	embedding = parse_ollama_embedding_response(response.data, dim, error_msg);
+	INSTR_TIME_SET_CURRENT(parse_start);
+	embedding = ollama_parse_embedding_response(response.data, dim, error_msg);
+	INSTR_TIME_SET_CURRENT(parse_time);
+	INSTR_TIME_SUBTRACT(parse_time, parse_start);
+	stats.parse_secs = INSTR_TIME_GET_DOUBLE(parse_time);
+	stats.failed = embedding == NULL;
 
 cleanup:
+	provider_stats_record(&stats);
 	curl_slist_free_all(headers);
 	curl_easy_cleanup(curl);
 	pfree(json_request);
@@ -294,8 +319,8 @@ escape_json_string(const char *str)
  * Expected format:
  * {"embedding":[0.1,0.2,0.3,...]}
  */
-static float *
-parse_ollama_embedding_response(const char *json_response, int *dim, char **error_msg)
+float *
+ollama_parse_embedding_response(const char *json_response, int *dim, char **error_msg)
 {
 	const char *p;
 	float *embedding = NULL;
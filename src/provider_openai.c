@@ -17,7 +17,9 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "portability/instr_time.h"
 #include "utils/memutils.h"
+#include "utils/wait_event.h"
 
 /* For JSON parsing - we'll use a simple manual parser */
 
@@ -49,7 +51,6 @@ static char *load_api_key(const char *filepath, char **error_msg);
 static char *expand_tilde(const char *path);
 static char *escape_json_string(const char *str);
 static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp);
-static float **parse_batch_embedding_response(const char *json_response, int count, int *dim, char **error_msg);
 
 /*
  * OpenAI Provider struct
@@ -147,6 +148,9 @@ openai_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 	char auth_header[512];
 	float **embeddings = NULL;
 	long response_code;
+	ProviderRequestStats stats;
+	instr_time parse_start;
+	instr_time parse_time;
 
 	if (!provider_initialized)
 	{
@@ -159,6 +163,11 @@ openai_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 	response.data[0] = '\0';
 	response.size = 0;
 
+	memset(&stats, 0, sizeof(stats));
+	stats.provider = "openai";
+	stats.model = pgedge_vectorizer_model;
+	stats.items = count;
+
 	/* Build JSON request */
 	initStringInfo(&request_buf);
 	appendStringInfo(&request_buf, "{\"input\":[");
@@ -169,6 +178,7 @@ openai_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 			appendStringInfoChar(&request_buf, ',');
 		appendStringInfo(&request_buf, "\"%s\"", escaped);
 		pfree(escaped);
+		stats.tokens += count_tokens(texts[i], pgedge_vectorizer_model);
 	}
 	appendStringInfo(&request_buf, "],\"model\":\"%s\"}", pgedge_vectorizer_model);
 	json_request = request_buf.data;
@@ -201,7 +211,16 @@ openai_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L);  /* 5 minute timeout */
 
 	/* Perform the request */
+	pgstat_report_wait_start(vectorizer_wait_event(VECTORIZER_WAIT_PROVIDER_REQUEST));
 	res = curl_easy_perform(curl);
+	pgstat_report_wait_end();
+
+	stats.endpoint = url;
+	stats.request_bytes = request_buf.len;
+	stats.response_bytes = response.size;
+	stats.failed = true;
+	curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &stats.ttfb_secs);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &stats.total_secs);
 
 	if (res != CURLE_OK)
 	{
@@ -219,9 +238,24 @@ openai_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 	}
 
 	/* Parse the response */
-	embeddings = parse_batch_embedding_response(response.data, count, dim, error_msg);
+	INSTR_TIME_SET_CURRENT(parse_start);
+	embeddings = openai_parse_embedding_response(response.data, count, dim, error_msg);
+	INSTR_TIME_SET_CURRENT(parse_time);
+	INSTR_TIME_SUBTRACT(parse_time, parse_start);
+	stats.parse_secs = INSTR_TIME_GET_DOUBLE(parse_time);
+	stats.failed = embeddings == NULL;
+
+	/* Count the tokens the provider bills rather than the estimate */
+	if (embeddings != NULL)
+	{
+		int64		billed = parse_usage_total_tokens(response.data);
+
+		if (billed >= 0)
+			stats.tokens = billed;
+	}
 
 cleanup:
+	provider_stats_record(&stats);
 	curl_slist_free_all(headers);
 	curl_easy_cleanup(curl);
 	pfree(json_request);
@@ -463,8 +497,8 @@ escape_json_string(const char *str)
  *
  * This is a simplified parser. For production, consider using a robust JSON library.
  */
-static float **
-parse_batch_embedding_response(const char *json_response, int count, int *dim, char **error_msg)
+float **
+openai_parse_embedding_response(const char *json_response, int count, int *dim, char **error_msg)
 {
 	const char *p;
 	float **embeddings = NULL;
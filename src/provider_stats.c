@@ -0,0 +1,473 @@
+/*-------------------------------------------------------------------------
+ *
+ * provider_stats.c
+ *		Latency histograms and request rates of the embedding providers
+ *
+ * Each provider reports every HTTP request it makes with
+ * provider_stats_record(): the time until the first byte of the response
+ * arrived, the total time of the exchange, the time spent parsing the
+ * response, the number of texts, their estimated token count and the
+ * request and response sizes.  The figures are kept in shared memory per
+ * endpoint (provider, model and URL) as cumulative counters, log-scale
+ * latency histograms per phase, and per-second slots covering the last
+ * minute for the current request, item and token rates.
+ *
+ * Requests made by backends, e.g. for generate_embedding() in
+ * hybrid_search(), are recorded along with those of the workers.  Without
+ * shared_preload_libraries nothing is recorded.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "utils/float.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+/* Endpoints (provider, model, URL) tracked; requests to others are not */
+#define PROVIDER_STATS_MAX_ENDPOINTS 32
+
+#define PROVIDER_STATS_MODEL_LEN 128
+#define PROVIDER_STATS_ENDPOINT_LEN 256
+
+/*
+ * Latency buckets: bucket i counts requests that took at most
+ * 2^(i + 7) microseconds (128 us up to 268 s); the last one counts the rest
+ */
+#define LATENCY_BUCKETS 23
+#define LATENCY_FIRST_BOUND_LOG2 7
+
+/* Phases of a request with a histogram of their own */
+#define PHASE_TOTAL		0
+#define PHASE_TTFB		1
+#define PHASE_TRANSFER	2
+#define PHASE_PARSE		3
+#define NPHASES			4
+
+static const char *const phase_names[NPHASES] = {
+	"total", "ttfb", "transfer", "parse"
+};
+
+/* One-second slots covering the last minute */
+#define RATE_SLOTS 60
+
+typedef struct ProviderRateSlot
+{
+	int64		second;			/* Seconds since the PostgreSQL epoch */
+	int64		requests;
+	int64		failures;
+	int64		items;
+	int64		tokens;
+} ProviderRateSlot;
+
+typedef struct ProviderEndpointStats
+{
+	char		provider[NAMEDATALEN];
+	char		model[PROVIDER_STATS_MODEL_LEN];
+	char		endpoint[PROVIDER_STATS_ENDPOINT_LEN];
+	int64		requests;
+	int64		failures;
+	int64		items;
+	int64		tokens;
+	int64		request_bytes;
+	int64		response_bytes;
+	int64		latency[NPHASES][LATENCY_BUCKETS];
+	int64		latency_sum[NPHASES];	/* Microseconds */
+	ProviderRateSlot rate[RATE_SLOTS];
+} ProviderEndpointStats;
+
+typedef struct ProviderStatsShared
+{
+	LWLock	   *lock;
+	int			nendpoints;
+	ProviderEndpointStats endpoints[PROVIDER_STATS_MAX_ENDPOINTS];
+} ProviderStatsShared;
+
+static ProviderStatsShared *provider_stats = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void provider_stats_shmem_request(void);
+static void provider_stats_shmem_startup(void);
+static int	latency_bucket(int64 us);
+static double latency_percentile(const int64 *buckets, double fraction);
+static double bucket_bound_ms(int bucket);
+static Tuplestorestate *begin_materialized_srf(FunctionCallInfo fcinfo, TupleDesc *tupdesc);
+static ProviderEndpointStats *copy_endpoints(int *n);
+
+/*
+ * Request shared memory and the lock for the provider statistics
+ *
+ * Called during _PG_init when shared_preload_libraries is processed.
+ */
+void
+provider_stats_init(void)
+{
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = provider_stats_shmem_request;
+#else
+	provider_stats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = provider_stats_shmem_startup;
+}
+
+static void
+provider_stats_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(sizeof(ProviderStatsShared));
+	RequestNamedLWLockTranche("pgedge_vectorizer_provider_stats", 1);
+}
+
+static void
+provider_stats_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	provider_stats = ShmemInitStruct("pgedge_vectorizer provider stats",
+									 sizeof(ProviderStatsShared), &found);
+	if (!found)
+	{
+		memset(provider_stats, 0, sizeof(ProviderStatsShared));
+		provider_stats->lock = &(GetNamedLWLockTranche("pgedge_vectorizer_provider_stats"))->lock;
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static int
+latency_bucket(int64 us)
+{
+	int			bucket = 0;
+
+	while (bucket < LATENCY_BUCKETS - 1 &&
+		   us > ((int64) 1 << (bucket + LATENCY_FIRST_BOUND_LOG2)))
+		bucket++;
+	return bucket;
+}
+
+/*
+ * Upper bound of a latency bucket in milliseconds; infinite for the last
+ */
+static double
+bucket_bound_ms(int bucket)
+{
+	if (bucket >= LATENCY_BUCKETS - 1)
+		return get_float8_infinity();
+	return (double) ((int64) 1 << (bucket + LATENCY_FIRST_BOUND_LOG2)) / 1000.0;
+}
+
+/*
+ * Latency below which the given fraction of requests fall, in milliseconds
+ *
+ * Interpolates linearly within the bucket; requests in the last bucket are
+ * reported at its lower bound.
+ */
+static double
+latency_percentile(const int64 *buckets, double fraction)
+{
+	int64		total = 0;
+	int64		seen = 0;
+	double		target;
+
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+		total += buckets[i];
+	if (total == 0)
+		return 0.0;
+
+	target = fraction * total;
+
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		double		lower = i == 0 ? 0.0 : bucket_bound_ms(i - 1);
+
+		if (buckets[i] == 0 || seen + buckets[i] < target)
+		{
+			seen += buckets[i];
+			continue;
+		}
+		if (i == LATENCY_BUCKETS - 1)
+			return lower;
+		return lower + (bucket_bound_ms(i) - lower) * (target - seen) / buckets[i];
+	}
+
+	return bucket_bound_ms(LATENCY_BUCKETS - 2);
+}
+
+/*
+ * Record one HTTP request of a provider
+ */
+void
+provider_stats_record(const ProviderRequestStats *stats)
+{
+	ProviderEndpointStats *ep = NULL;
+	int64		phase_us[NPHASES];
+	int64		second;
+	ProviderRateSlot *slot;
+
+	/* Also counts towards the worker batch and provider call in progress */
+	batch_stats_add(BATCH_STAGE_HTTP, stats->total_secs);
+	batch_stats_add(BATCH_STAGE_PARSE, stats->parse_secs);
+	usage_stats_record_request(stats);
+
+	if (provider_stats == NULL)
+		return;
+
+	phase_us[PHASE_TOTAL] = (int64) (stats->total_secs * 1000000.0);
+	phase_us[PHASE_TTFB] = (int64) (stats->ttfb_secs * 1000000.0);
+	phase_us[PHASE_TRANSFER] = Max(phase_us[PHASE_TOTAL] - phase_us[PHASE_TTFB], 0);
+	phase_us[PHASE_PARSE] = (int64) (stats->parse_secs * 1000000.0);
+	second = GetCurrentTimestamp() / USECS_PER_SEC;
+
+	LWLockAcquire(provider_stats->lock, LW_EXCLUSIVE);
+
+	for (int i = 0; i < provider_stats->nendpoints; i++)
+	{
+		ProviderEndpointStats *e = &provider_stats->endpoints[i];
+
+		if (strncmp(e->provider, stats->provider, NAMEDATALEN - 1) == 0 &&
+			strncmp(e->model, stats->model, PROVIDER_STATS_MODEL_LEN - 1) == 0 &&
+			strncmp(e->endpoint, stats->endpoint, PROVIDER_STATS_ENDPOINT_LEN - 1) == 0)
+		{
+			ep = e;
+			break;
+		}
+	}
+
+	if (ep == NULL)
+	{
+		if (provider_stats->nendpoints >= PROVIDER_STATS_MAX_ENDPOINTS)
+		{
+			LWLockRelease(provider_stats->lock);
+			return;
+		}
+		ep = &provider_stats->endpoints[provider_stats->nendpoints++];
+		memset(ep, 0, sizeof(ProviderEndpointStats));
+		strlcpy(ep->provider, stats->provider, NAMEDATALEN);
+		strlcpy(ep->model, stats->model, PROVIDER_STATS_MODEL_LEN);
+		strlcpy(ep->endpoint, stats->endpoint, PROVIDER_STATS_ENDPOINT_LEN);
+	}
+
+	ep->requests++;
+	if (stats->failed)
+		ep->failures++;
+	else
+	{
+		ep->items += stats->items;
+		ep->tokens += stats->tokens;
+	}
+	ep->request_bytes += stats->request_bytes;
+	ep->response_bytes += stats->response_bytes;
+
+	for (int p = 0; p < NPHASES; p++)
+	{
+		/* Failed requests have no parse phase */
+		if (p == PHASE_PARSE && stats->parse_secs <= 0.0)
+			continue;
+		ep->latency[p][latency_bucket(phase_us[p])]++;
+		ep->latency_sum[p] += phase_us[p];
+	}
+
+	slot = &ep->rate[second % RATE_SLOTS];
+	if (slot->second != second)
+		memset(slot, 0, sizeof(ProviderRateSlot));
+	slot->second = second;
+	slot->requests++;
+	if (stats->failed)
+		slot->failures++;
+	else
+	{
+		slot->items += stats->items;
+		slot->tokens += stats->tokens;
+	}
+
+	LWLockRelease(provider_stats->lock);
+}
+
+/*
+ * Set up a set-returning function that returns its rows in a tuplestore
+ */
+static Tuplestorestate *
+begin_materialized_srf(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+		!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "set-valued function called in a context that cannot accept a set");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = *tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
+
+/*
+ * Copy the statistics of all endpoints out of shared memory
+ */
+static ProviderEndpointStats *
+copy_endpoints(int *n)
+{
+	ProviderEndpointStats *copy;
+
+	*n = 0;
+	if (provider_stats == NULL)
+		return NULL;
+
+	copy = palloc(sizeof(ProviderEndpointStats) * PROVIDER_STATS_MAX_ENDPOINTS);
+
+	LWLockAcquire(provider_stats->lock, LW_SHARED);
+	*n = provider_stats->nendpoints;
+	memcpy(copy, provider_stats->endpoints, sizeof(ProviderEndpointStats) * *n);
+	LWLockRelease(provider_stats->lock);
+
+	return copy;
+}
+
+/*
+ * Request counts, latency percentiles and current rates per endpoint
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_provider_stats);
+
+Datum
+pgedge_vectorizer_provider_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+	ProviderEndpointStats *endpoints;
+	int			n;
+	int64		now = GetCurrentTimestamp() / USECS_PER_SEC;
+
+	endpoints = copy_endpoints(&n);
+
+	for (int i = 0; i < n; i++)
+	{
+		ProviderEndpointStats *ep = &endpoints[i];
+		Datum		values[18];
+		bool		nulls[18];
+		int64		recent[4] = {0, 0, 0, 0};
+		int64		completed = ep->requests - ep->failures;
+		int			col = 0;
+
+		/* Slots older than a minute belong to an earlier minute */
+		for (int s = 0; s < RATE_SLOTS; s++)
+		{
+			if (ep->rate[s].second <= now - RATE_SLOTS)
+				continue;
+			recent[0] += ep->rate[s].requests;
+			recent[1] += ep->rate[s].failures;
+			recent[2] += ep->rate[s].items;
+			recent[3] += ep->rate[s].tokens;
+		}
+
+		memset(nulls, 0, sizeof(nulls));
+		values[col++] = CStringGetTextDatum(ep->provider);
+		values[col++] = CStringGetTextDatum(ep->model);
+		values[col++] = CStringGetTextDatum(ep->endpoint);
+		values[col++] = Int64GetDatum(ep->requests);
+		values[col++] = Int64GetDatum(ep->failures);
+		values[col++] = Int64GetDatum(ep->items);
+		values[col++] = Int64GetDatum(ep->tokens);
+		values[col++] = Int64GetDatum(ep->request_bytes);
+		values[col++] = Int64GetDatum(ep->response_bytes);
+		values[col++] = Float8GetDatum(latency_percentile(ep->latency[PHASE_TOTAL], 0.5));
+		values[col++] = Float8GetDatum(latency_percentile(ep->latency[PHASE_TOTAL], 0.9));
+		values[col++] = Float8GetDatum(latency_percentile(ep->latency[PHASE_TOTAL], 0.99));
+		values[col++] = Float8GetDatum(ep->requests > 0 ? ep->latency_sum[PHASE_TTFB] / 1000.0 / ep->requests : 0.0);
+		values[col++] = Float8GetDatum(ep->requests > 0 ? ep->latency_sum[PHASE_TRANSFER] / 1000.0 / ep->requests : 0.0);
+		values[col++] = Float8GetDatum(completed > 0 ? ep->latency_sum[PHASE_PARSE] / 1000.0 / completed : 0.0);
+		values[col++] = Int64GetDatum(recent[0]);
+		values[col++] = Float8GetDatum((double) recent[2] / RATE_SLOTS);
+		values[col++] = Float8GetDatum((double) recent[3] / RATE_SLOTS);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Latency histograms per endpoint and phase, one row per bucket
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_provider_latency_histogram);
+
+Datum
+pgedge_vectorizer_provider_latency_histogram(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+	ProviderEndpointStats *endpoints;
+	int			n;
+
+	endpoints = copy_endpoints(&n);
+
+	for (int i = 0; i < n; i++)
+	{
+		for (int p = 0; p < NPHASES; p++)
+		{
+			for (int b = 0; b < LATENCY_BUCKETS; b++)
+			{
+				Datum		values[6];
+				bool		nulls[6];
+
+				memset(nulls, 0, sizeof(nulls));
+				values[0] = CStringGetTextDatum(endpoints[i].provider);
+				values[1] = CStringGetTextDatum(endpoints[i].model);
+				values[2] = CStringGetTextDatum(endpoints[i].endpoint);
+				values[3] = CStringGetTextDatum(phase_names[p]);
+				values[4] = Float8GetDatum(bucket_bound_ms(b));
+				values[5] = Int64GetDatum(endpoints[i].latency[p][b]);
+
+				tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+			}
+		}
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Forget the statistics of all endpoints
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_reset_provider_stats);
+
+Datum
+pgedge_vectorizer_reset_provider_stats(PG_FUNCTION_ARGS)
+{
+	if (provider_stats != NULL)
+	{
+		LWLockAcquire(provider_stats->lock, LW_EXCLUSIVE);
+		provider_stats->nendpoints = 0;
+		LWLockRelease(provider_stats->lock);
+	}
+
+	PG_RETURN_VOID();
+}
@@ -18,7 +18,9 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "portability/instr_time.h"
 #include "utils/memutils.h"
+#include "utils/wait_event.h"
 
 
 /*
@@ -149,6 +151,9 @@ voyage_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 	char auth_header[512];
 	float **embeddings = NULL;
 	long response_code;
+	ProviderRequestStats stats;
+	instr_time parse_start;
+	instr_time parse_time;
 
 	if (!provider_initialized)
 	{
@@ -161,6 +166,11 @@ voyage_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 	response.data[0] = '\0';
 	response.size = 0;
 
+	memset(&stats, 0, sizeof(stats));
+	stats.provider = "voyage";
+	stats.model = pgedge_vectorizer_model;
+	stats.items = count;
+
 	/* Build JSON request */
 	initStringInfo(&request_buf);
 	appendStringInfo(&request_buf, "{\"input\":[");
@@ -171,6 +181,7 @@ voyage_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 			appendStringInfoChar(&request_buf, ',');
 		appendStringInfo(&request_buf, "\"%s\"", escaped);
 		pfree(escaped);
+		stats.tokens += count_tokens(texts[i], pgedge_vectorizer_model);
 	}
 	appendStringInfo(&request_buf, "],\"model\":\"%s\"}", pgedge_vectorizer_model);
 	json_request = request_buf.data;
@@ -203,7 +214,16 @@ voyage_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L);  /* 5 minute timeout */
 
 	/* Perform the request */
+	pgstat_report_wait_start(vectorizer_wait_event(VECTORIZER_WAIT_PROVIDER_REQUEST));
 	res = curl_easy_perform(curl);
+	pgstat_report_wait_end();
+
+	stats.endpoint = url;
+	stats.request_bytes = request_buf.len;
+	stats.response_bytes = response.size;
+	stats.failed = true;
+	curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &stats.ttfb_secs);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &stats.total_secs);
 
 	if (res != CURLE_OK)
 	{
@@ -221,9 +241,24 @@ voyage_generate_batch(const char **texts, int count, int *dim, char **error_msg)
 	}
 
 	/* Parse the response */
+	INSTR_TIME_SET_CURRENT(parse_start);
 	embeddings = parse_batch_embedding_response(response.data, count, dim, error_msg);
+	INSTR_TIME_SET_CURRENT(parse_time);
+	INSTR_TIME_SUBTRACT(parse_time, parse_start);
+	stats.parse_secs = INSTR_TIME_GET_DOUBLE(parse_time);
+	stats.failed = embeddings == NULL;
+
+	/* Count the tokens the provider bills rather than the estimate */
+	if (embeddings != NULL)
+	{
+		int64		billed = parse_usage_total_tokens(response.data);
+
+		if (billed >= 0)
+			stats.tokens = billed;
+	}
 
 cleanup:
+	provider_stats_record(&stats);
 	curl_slist_free_all(headers);
 	curl_easy_cleanup(curl);
 	pfree(json_request);
@@ -0,0 +1,1018 @@
+/*-------------------------------------------------------------------------
+ *
+ * queue_stats.c
+ *		Queue depth and lag counters kept in shared memory
+ *
+ * The monitoring views used to aggregate the whole queue table on every
+ * read, which costs a full scan of millions of rows during a backfill.
+ * Instead, a row trigger on the queue table records how each statement
+ * changes the per-(chunk table, status) counters in backend-local memory,
+ * and the changes are added to counters in shared memory when the
+ * transaction commits.  Aborted transactions and subtransactions drop
+ * theirs.  queue_stats() then reads the counters without touching the
+ * queue table.
+ *
+ * Each status of a chunk table keeps its item count, the bounds of the
+ * items' creation times and the sums needed for the average processing
+ * time.  The oldest pending item is exact: when it leaves the pending
+ * status the counter is marked stale and queue_stats() looks the new one
+ * up through the pending-items index.  For the other statuses oldest and
+ * newest only bound the creation times of the items.
+ *
+ * Counters start from a count of the queue table, taken once per database
+ * after a server start by the first worker of the database (or by
+ * refresh_queue_stats()).  Until then, and when the library is not in
+ * shared_preload_libraries, queue_stats() aggregates the queue table as
+ * the views did before.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "access/htup_details.h"
+#include "catalog/namespace.h"
+#include "commands/trigger.h"
+#include "funcapi.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+/* Databases and chunk tables the shared counters can track */
+#define QUEUE_STATS_MAX_ENTRIES 1024
+
+/* Longest chunk table name tracked, schema-qualified names included */
+#define QUEUE_STATS_TABLE_LEN (2 * NAMEDATALEN)
+
+/* Queue statuses, as allowed by the CHECK constraint of the queue table */
+#define QS_PENDING		0
+#define QS_PROCESSING	1
+#define QS_COMPLETED	2
+#define QS_FAILED		3
+#define QS_NSTATUS		4
+
+static const char *const queue_status_names[QS_NSTATUS] = {
+	"pending", "processing", "completed", "failed"
+};
+
+/*
+ * Counters of the items of one chunk table in one status
+ *
+ * Times are in milliseconds from QueueStatsShared.base, so that the sums
+ * stay exact and within range however many items they cover.
+ */
+typedef struct QueueStatusCounts
+{
+	int64		count;
+	int64		open;			/* Items without processed_at */
+	int64		open_created;	/* Sum of their created_at */
+	int64		closed_time;	/* Sum of processed_at - created_at of the rest */
+	TimestampTz oldest;
+	TimestampTz newest;
+	bool		oldest_stale;	/* Oldest item left; look the next one up */
+	uint64		changed;		/* Value of QueueStatsShared.changes when last changed */
+} QueueStatusCounts;
+
+/*
+ * A chunk table of a database, or with an empty chunk_table the database
+ * itself
+ */
+typedef struct QueueStatsKey
+{
+	Oid			dboid;
+	char		chunk_table[QUEUE_STATS_TABLE_LEN];
+} QueueStatsKey;
+
+typedef struct QueueStatsEntry
+{
+	QueueStatsKey key;
+	bool		seeded;			/* Database entry: counters are valid */
+	Oid			queue_relid;	/* Database entry: queue table they count */
+	QueueStatusCounts status[QS_NSTATUS];
+} QueueStatsEntry;
+
+typedef struct QueueStatsShared
+{
+	LWLock	   *lock;
+	TimestampTz base;
+	int			nentries;
+	uint64		changes;
+} QueueStatsShared;
+
+/*
+ * Change to the counters of a chunk table and status made by a
+ * subtransaction, added to the shared counters at commit
+ */
+typedef struct QueueStatsDeltaKey
+{
+	SubTransactionId subid;
+	int			status;
+	char		chunk_table[QUEUE_STATS_TABLE_LEN];
+} QueueStatsDeltaKey;
+
+typedef struct QueueStatsDelta
+{
+	QueueStatsDeltaKey key;
+	int64		added;
+	int64		removed;
+	int64		open;
+	int64		open_created;
+	int64		closed_time;
+	TimestampTz added_min;
+	TimestampTz added_max;
+	TimestampTz removed_min;
+} QueueStatsDelta;
+
+static QueueStatsShared *queue_stats = NULL;
+static HTAB *queue_stats_hash = NULL;
+
+/* Changes of the current transaction, in TopTransactionContext */
+static HTAB *queue_deltas = NULL;
+static Oid	deltas_relid = InvalidOid;
+static bool deltas_invalidate = false;
+static bool callbacks_registered = false;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static Size queue_stats_shmem_size(void);
+static void queue_stats_shmem_request(void);
+static void queue_stats_shmem_startup(void);
+static void queue_stats_xact_callback(XactEvent event, void *arg);
+static void queue_stats_subxact_callback(SubXactEvent event,
+										 SubTransactionId mySubid,
+										 SubTransactionId parentSubid,
+										 void *arg);
+static void reset_deltas(void);
+static void apply_deltas(void);
+static void merge_delta(QueueStatsDelta *into, const QueueStatsDelta *from);
+static void invalidate_database(Oid dboid);
+static void record_row(HeapTuple tuple, TupleDesc tupdesc, int sign);
+static bool counted_columns_equal(HeapTuple a, HeapTuple b, TupleDesc tupdesc);
+static int	queue_status_index(const char *status);
+static int64 time_ms(TimestampTz from, TimestampTz to);
+static Oid	queue_relid(void);
+static bool emit_shared_stats(Tuplestorestate *tupstore, TupleDesc tupdesc);
+static void emit_scanned_stats(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/*
+ * Size of the shared state
+ */
+static Size
+queue_stats_shmem_size(void)
+{
+	return add_size(MAXALIGN(sizeof(QueueStatsShared)),
+					hash_estimate_size(QUEUE_STATS_MAX_ENTRIES,
+									   sizeof(QueueStatsEntry)));
+}
+
+/*
+ * Request shared memory and the lock for the queue counters
+ *
+ * Called during _PG_init when shared_preload_libraries is processed.
+ */
+void
+queue_stats_init(void)
+{
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = queue_stats_shmem_request;
+#else
+	queue_stats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = queue_stats_shmem_startup;
+}
+
+static void
+queue_stats_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(queue_stats_shmem_size());
+	RequestNamedLWLockTranche("pgedge_vectorizer_queue_stats", 1);
+}
+
+static void
+queue_stats_shmem_startup(void)
+{
+	bool		found;
+	HASHCTL		info;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	queue_stats = ShmemInitStruct("pgedge_vectorizer queue stats",
+								  sizeof(QueueStatsShared), &found);
+	if (!found)
+	{
+		memset(queue_stats, 0, sizeof(QueueStatsShared));
+		queue_stats->lock = &(GetNamedLWLockTranche("pgedge_vectorizer_queue_stats"))->lock;
+		queue_stats->base = GetCurrentTimestamp();
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(QueueStatsKey);
+	info.entrysize = sizeof(QueueStatsEntry);
+	queue_stats_hash = ShmemInitHash("pgedge_vectorizer queue stats hash",
+									 QUEUE_STATS_MAX_ENTRIES,
+									 QUEUE_STATS_MAX_ENTRIES,
+									 &info,
+									 HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Do the counters of the current database need a count of the queue?
+ */
+bool
+queue_stats_needs_seed(void)
+{
+	QueueStatsKey key;
+	QueueStatsEntry *db;
+	bool		seeded;
+
+	if (queue_stats == NULL)
+		return false;
+
+	memset(&key, 0, sizeof(key));
+	key.dboid = MyDatabaseId;
+
+	LWLockAcquire(queue_stats->lock, LW_SHARED);
+	db = hash_search(queue_stats_hash, &key, HASH_FIND, NULL);
+	seeded = db != NULL && db->seeded;
+	LWLockRelease(queue_stats->lock);
+
+	return !seeded;
+}
+
+/*
+ * Milliseconds from one time to another, rounded down
+ */
+static int64
+time_ms(TimestampTz from, TimestampTz to)
+{
+	int64		us = to - from;
+
+	return us >= 0 ? us / 1000 : -((-us + 999) / 1000);
+}
+
+static int
+queue_status_index(const char *status)
+{
+	for (int s = 0; s < QS_NSTATUS; s++)
+	{
+		if (strcmp(status, queue_status_names[s]) == 0)
+			return s;
+	}
+	return -1;
+}
+
+/*
+ * OID of the queue table of the current database
+ */
+static Oid
+queue_relid(void)
+{
+	Oid			nspid = get_namespace_oid("pgedge_vectorizer", true);
+
+	if (!OidIsValid(nspid))
+		return InvalidOid;
+	return get_relname_relid("queue", nspid);
+}
+
+/*
+ * Drop the counters of a database; the caller holds the lock exclusively
+ */
+static void
+invalidate_database(Oid dboid)
+{
+	HASH_SEQ_STATUS scan;
+	QueueStatsEntry *entry;
+
+	hash_seq_init(&scan, queue_stats_hash);
+	while ((entry = hash_seq_search(&scan)) != NULL)
+	{
+		if (entry->key.dboid != dboid)
+			continue;
+		hash_search(queue_stats_hash, &entry->key, HASH_REMOVE, NULL);
+		queue_stats->nentries--;
+	}
+}
+
+static void
+reset_deltas(void)
+{
+	queue_deltas = NULL;
+	deltas_relid = InvalidOid;
+	deltas_invalidate = false;
+}
+
+static void
+merge_delta(QueueStatsDelta *into, const QueueStatsDelta *from)
+{
+	if (from->added > 0)
+	{
+		into->added_min = into->added > 0 ? Min(into->added_min, from->added_min) : from->added_min;
+		into->added_max = into->added > 0 ? Max(into->added_max, from->added_max) : from->added_max;
+	}
+	if (from->removed > 0)
+		into->removed_min = into->removed > 0 ? Min(into->removed_min, from->removed_min) : from->removed_min;
+
+	into->added += from->added;
+	into->removed += from->removed;
+	into->open += from->open;
+	into->open_created += from->open_created;
+	into->closed_time += from->closed_time;
+}
+
+/*
+ * Add the changes of a committed transaction to the shared counters
+ *
+ * Runs before the transaction's locks are released, so a count of the
+ * queue taken under a SHARE lock either includes the transaction and
+ * finds the counters not yet seeded, or starts after its changes were
+ * added.
+ */
+static void
+apply_deltas(void)
+{
+	QueueStatsKey key;
+	QueueStatsEntry *db;
+	HASH_SEQ_STATUS scan;
+	QueueStatsDelta *d;
+
+	memset(&key, 0, sizeof(key));
+	key.dboid = MyDatabaseId;
+
+	LWLockAcquire(queue_stats->lock, LW_EXCLUSIVE);
+
+	db = hash_search(queue_stats_hash, &key, HASH_FIND, NULL);
+	if (db == NULL || !db->seeded || db->queue_relid != deltas_relid)
+	{
+		LWLockRelease(queue_stats->lock);
+		return;
+	}
+
+	if (deltas_invalidate)
+	{
+		invalidate_database(MyDatabaseId);
+		LWLockRelease(queue_stats->lock);
+		return;
+	}
+
+	queue_stats->changes++;
+
+	hash_seq_init(&scan, queue_deltas);
+	while ((d = hash_seq_search(&scan)) != NULL)
+	{
+		QueueStatsEntry *entry;
+		QueueStatusCounts *c;
+
+		/* Keys are compared as bytes: clear what follows the name */
+		memset(key.chunk_table, 0, QUEUE_STATS_TABLE_LEN);
+		strlcpy(key.chunk_table, d->key.chunk_table, QUEUE_STATS_TABLE_LEN);
+		entry = hash_search(queue_stats_hash, &key, HASH_FIND, NULL);
+		if (entry == NULL)
+		{
+			if (d->added == 0)
+				continue;
+			if (queue_stats->nentries >= QUEUE_STATS_MAX_ENTRIES)
+			{
+				/* Out of room: back to counting the queue table */
+				hash_seq_term(&scan);
+				invalidate_database(MyDatabaseId);
+				break;
+			}
+			entry = hash_search(queue_stats_hash, &key, HASH_ENTER, NULL);
+			memset(entry->status, 0, sizeof(entry->status));
+			entry->seeded = false;
+			entry->queue_relid = InvalidOid;
+			queue_stats->nentries++;
+		}
+
+		c = &entry->status[d->key.status];
+		c->changed = queue_stats->changes;
+
+		if (c->count + d->added - d->removed <= 0)
+		{
+			memset(c, 0, offsetof(QueueStatusCounts, changed));
+			continue;
+		}
+
+		if (d->removed > 0 && d->key.status == QS_PENDING && d->removed_min <= c->oldest)
+			c->oldest_stale = true;
+
+		if (d->added > 0)
+		{
+			c->oldest = c->count > 0 ? Min(c->oldest, d->added_min) : d->added_min;
+			c->newest = c->count > 0 ? Max(c->newest, d->added_max) : d->added_max;
+		}
+
+		c->count += d->added - d->removed;
+		c->open += d->open;
+		c->open_created += d->open_created;
+		c->closed_time += d->closed_time;
+	}
+
+	LWLockRelease(queue_stats->lock);
+}
+
+/*
+ * Add the changes of a committed transaction to the shared counters
+ */
+static void
+queue_stats_xact_callback(XactEvent event, void *arg)
+{
+	if (queue_deltas == NULL && !deltas_invalidate)
+		return;
+
+	switch (event)
+	{
+		case XACT_EVENT_PRE_PREPARE:
+			/*
+			 * The transaction may be committed by another backend, which
+			 * does not have its changes: count the queue again instead.
+			 */
+			LWLockAcquire(queue_stats->lock, LW_EXCLUSIVE);
+			invalidate_database(MyDatabaseId);
+			LWLockRelease(queue_stats->lock);
+			reset_deltas();
+			break;
+
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+			apply_deltas();
+			reset_deltas();
+			break;
+
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+			reset_deltas();
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Hand the changes of a committed subtransaction to its parent, and drop
+ * those of an aborted one
+ */
+static void
+queue_stats_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+							 SubTransactionId parentSubid, void *arg)
+{
+	HASH_SEQ_STATUS scan;
+	QueueStatsDelta *d;
+	List	   *moved = NIL;
+	ListCell   *lc;
+
+	if (queue_deltas == NULL)
+		return;
+
+	switch (event)
+	{
+		case SUBXACT_EVENT_COMMIT_SUB:
+			hash_seq_init(&scan, queue_deltas);
+			while ((d = hash_seq_search(&scan)) != NULL)
+			{
+				if (d->key.subid != mySubid)
+					continue;
+				moved = lappend(moved, memcpy(palloc(sizeof(QueueStatsDelta)), d,
+											  sizeof(QueueStatsDelta)));
+				hash_search(queue_deltas, &d->key, HASH_REMOVE, NULL);
+			}
+
+			foreach(lc, moved)
+			{
+				QueueStatsDelta *from = (QueueStatsDelta *) lfirst(lc);
+				QueueStatsDelta *into;
+				bool		found;
+
+				from->key.subid = parentSubid;
+				into = hash_search(queue_deltas, &from->key, HASH_ENTER, &found);
+				if (found)
+					merge_delta(into, from);
+				else
+					memcpy(into, from, sizeof(QueueStatsDelta));
+			}
+			list_free_deep(moved);
+			break;
+
+		case SUBXACT_EVENT_ABORT_SUB:
+			hash_seq_init(&scan, queue_deltas);
+			while ((d = hash_seq_search(&scan)) != NULL)
+			{
+				if (d->key.subid == mySubid)
+					hash_search(queue_deltas, &d->key, HASH_REMOVE, NULL);
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Record a queue row entering (sign 1) or leaving (sign -1) its counters
+ */
+static void
+record_row(HeapTuple tuple, TupleDesc tupdesc, int sign)
+{
+	QueueStatsDeltaKey key;
+	QueueStatsDelta *d;
+	char	   *chunk_table;
+	char	   *status;
+	TimestampTz created_at;
+	Datum		processed_at;
+	bool		processed_null;
+	bool		isnull;
+	bool		found;
+	int			s;
+
+	chunk_table = TextDatumGetCString(heap_getattr(tuple, SPI_fnumber(tupdesc, "chunk_table"),
+												   tupdesc, &isnull));
+	status = TextDatumGetCString(heap_getattr(tuple, SPI_fnumber(tupdesc, "status"),
+											  tupdesc, &isnull));
+	created_at = DatumGetTimestampTz(heap_getattr(tuple, SPI_fnumber(tupdesc, "created_at"),
+												  tupdesc, &isnull));
+	processed_at = heap_getattr(tuple, SPI_fnumber(tupdesc, "processed_at"),
+								tupdesc, &processed_null);
+
+	s = queue_status_index(status);
+	if (s < 0)
+		return;
+
+	if (strlen(chunk_table) >= QUEUE_STATS_TABLE_LEN)
+	{
+		deltas_invalidate = true;
+		return;
+	}
+
+	if (queue_deltas == NULL)
+	{
+		HASHCTL		ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(QueueStatsDeltaKey);
+		ctl.entrysize = sizeof(QueueStatsDelta);
+		ctl.hcxt = TopTransactionContext;
+		queue_deltas = hash_create("pgedge_vectorizer queue stats deltas", 16,
+								   &ctl, HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.subid = GetCurrentSubTransactionId();
+	key.status = s;
+	strlcpy(key.chunk_table, chunk_table, QUEUE_STATS_TABLE_LEN);
+
+	d = hash_search(queue_deltas, &key, HASH_ENTER, &found);
+	if (!found)
+		memset((char *) d + sizeof(QueueStatsDeltaKey), 0,
+			   sizeof(QueueStatsDelta) - sizeof(QueueStatsDeltaKey));
+
+	if (sign > 0)
+	{
+		d->added_min = d->added > 0 ? Min(d->added_min, created_at) : created_at;
+		d->added_max = d->added > 0 ? Max(d->added_max, created_at) : created_at;
+		d->added++;
+	}
+	else
+	{
+		d->removed_min = d->removed > 0 ? Min(d->removed_min, created_at) : created_at;
+		d->removed++;
+	}
+
+	if (processed_null)
+	{
+		d->open += sign;
+		d->open_created += sign * time_ms(queue_stats->base, created_at);
+	}
+	else
+		d->closed_time += sign * time_ms(created_at, DatumGetTimestampTz(processed_at));
+}
+
+/*
+ * Does an update leave the columns the counters depend on unchanged?
+ */
+static bool
+counted_columns_equal(HeapTuple a, HeapTuple b, TupleDesc tupdesc)
+{
+	static const char *const columns[] = {
+		"chunk_table", "status", "created_at", "processed_at"
+	};
+
+	for (int i = 0; i < lengthof(columns); i++)
+	{
+		int			attnum = SPI_fnumber(tupdesc, columns[i]);
+		Form_pg_attribute att = TupleDescAttr(tupdesc, attnum - 1);
+		bool		a_null;
+		bool		b_null;
+		Datum		a_value = heap_getattr(a, attnum, tupdesc, &a_null);
+		Datum		b_value = heap_getattr(b, attnum, tupdesc, &b_null);
+
+		if (a_null != b_null)
+			return false;
+		if (!a_null && !datumIsEqual(a_value, b_value, att->attbyval, att->attlen))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Trigger on the queue table that records changes to the counters
+ *
+ * Fires after each inserted or deleted row, after updates of the counted
+ * columns, and after TRUNCATE, which makes the workers count the queue
+ * again.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_queue_stats_trigger);
+
+Datum
+pgedge_vectorizer_queue_stats_trigger(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+	TupleDesc	tupdesc;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "queue_stats_trigger: not called by trigger manager");
+
+	if (queue_stats == NULL)
+		return PointerGetDatum(NULL);
+
+	if (!callbacks_registered)
+	{
+		RegisterXactCallback(queue_stats_xact_callback, NULL);
+		RegisterSubXactCallback(queue_stats_subxact_callback, NULL);
+		callbacks_registered = true;
+	}
+
+	deltas_relid = RelationGetRelid(trigdata->tg_relation);
+
+	if (TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event))
+	{
+		deltas_invalidate = true;
+		return PointerGetDatum(NULL);
+	}
+
+	if (!TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
+		return PointerGetDatum(NULL);
+
+	tupdesc = RelationGetDescr(trigdata->tg_relation);
+
+	if (TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
+		record_row(trigdata->tg_trigtuple, tupdesc, 1);
+	else if (TRIGGER_FIRED_BY_DELETE(trigdata->tg_event))
+		record_row(trigdata->tg_trigtuple, tupdesc, -1);
+	else if (!counted_columns_equal(trigdata->tg_trigtuple, trigdata->tg_newtuple, tupdesc))
+	{
+		record_row(trigdata->tg_trigtuple, tupdesc, -1);
+		record_row(trigdata->tg_newtuple, tupdesc, 1);
+	}
+
+	return PointerGetDatum(NULL);
+}
+
+/*
+ * Return the shared counters of the current database
+ *
+ * Returns false when they are not seeded yet.
+ */
+static bool
+emit_shared_stats(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	QueueStatsKey key;
+	QueueStatsEntry *db;
+	QueueStatsEntry *entries;
+	QueueStatsEntry *entry;
+	HASH_SEQ_STATUS scan;
+	Oid			relid = queue_relid();
+	int			n = 0;
+	int64		now_ms;
+
+	if (queue_stats == NULL)
+		return false;
+
+	memset(&key, 0, sizeof(key));
+	key.dboid = MyDatabaseId;
+
+	entries = palloc(sizeof(QueueStatsEntry) * QUEUE_STATS_MAX_ENTRIES);
+
+	LWLockAcquire(queue_stats->lock, LW_SHARED);
+
+	db = hash_search(queue_stats_hash, &key, HASH_FIND, NULL);
+	if (db == NULL || !db->seeded || db->queue_relid != relid)
+	{
+		bool		dropped = db != NULL && db->queue_relid != relid;
+
+		LWLockRelease(queue_stats->lock);
+
+		/* The extension was dropped and created again since the count */
+		if (dropped)
+		{
+			LWLockAcquire(queue_stats->lock, LW_EXCLUSIVE);
+			invalidate_database(MyDatabaseId);
+			LWLockRelease(queue_stats->lock);
+		}
+		pfree(entries);
+		return false;
+	}
+
+	hash_seq_init(&scan, queue_stats_hash);
+	while ((entry = hash_seq_search(&scan)) != NULL)
+	{
+		if (entry->key.dboid == MyDatabaseId && entry->key.chunk_table[0] != '\0')
+			entries[n++] = *entry;
+	}
+
+	LWLockRelease(queue_stats->lock);
+
+	/*
+	 * Look up the oldest pending item of tables whose oldest item was
+	 * processed.  The result is stored unless the counters changed in the
+	 * meantime, in which case the next call looks again.
+	 */
+	for (int i = 0; i < n; i++)
+	{
+		QueueStatusCounts *c = &entries[i].status[QS_PENDING];
+		Oid			argtypes[1] = {TEXTOID};
+		Datum		args[1];
+		bool		isnull;
+		Datum		oldest;
+
+		if (c->count == 0 || !c->oldest_stale)
+			continue;
+
+		args[0] = CStringGetTextDatum(entries[i].key.chunk_table);
+
+		SPI_connect();
+		if (SPI_execute_with_args("SELECT MIN(created_at) FROM pgedge_vectorizer.queue "
+								  "WHERE status = 'pending' AND chunk_table = $1",
+								  1, argtypes, args, NULL, true, 1) != SPI_OK_SELECT)
+			elog(ERROR, "Failed to look up the oldest pending queue item");
+		oldest = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull);
+		SPI_finish();
+
+		if (isnull)
+			continue;
+
+		c->oldest = DatumGetTimestampTz(oldest);
+
+		LWLockAcquire(queue_stats->lock, LW_EXCLUSIVE);
+		entry = hash_search(queue_stats_hash, &entries[i].key, HASH_FIND, NULL);
+		if (entry != NULL && entry->status[QS_PENDING].changed == c->changed)
+		{
+			entry->status[QS_PENDING].oldest = c->oldest;
+			entry->status[QS_PENDING].oldest_stale = false;
+		}
+		LWLockRelease(queue_stats->lock);
+	}
+
+	now_ms = time_ms(queue_stats->base, GetCurrentTransactionStartTimestamp());
+
+	for (int i = 0; i < n; i++)
+	{
+		for (int s = 0; s < QS_NSTATUS; s++)
+		{
+			QueueStatusCounts *c = &entries[i].status[s];
+			Datum		values[6];
+			bool		nulls[6];
+			double		total_ms;
+
+			if (c->count <= 0)
+				continue;
+
+			total_ms = (double) c->closed_time +
+				(double) c->open * now_ms - (double) c->open_created;
+
+			memset(nulls, 0, sizeof(nulls));
+			values[0] = CStringGetTextDatum(entries[i].key.chunk_table);
+			values[1] = CStringGetTextDatum(queue_status_names[s]);
+			values[2] = Int64GetDatum(c->count);
+			values[3] = TimestampTzGetDatum(c->oldest);
+			values[4] = TimestampTzGetDatum(c->newest);
+			values[5] = Float8GetDatum(total_ms / c->count / 1000.0);
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	pfree(entries);
+	return true;
+}
+
+/*
+ * Aggregate the queue table, when there are no shared counters to read
+ */
+static void
+emit_scanned_stats(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	SPI_connect();
+
+	if (SPI_execute("SELECT chunk_table, status, COUNT(*), "
+					"       MIN(created_at), MAX(created_at), "
+					"       AVG(EXTRACT(EPOCH FROM (COALESCE(processed_at, NOW()) - created_at)))::float8 "
+					"FROM pgedge_vectorizer.queue "
+					"GROUP BY chunk_table, status",
+					true, 0) != SPI_OK_SELECT)
+		elog(ERROR, "Failed to aggregate the queue table");
+
+	for (uint64 i = 0; i < SPI_processed; i++)
+	{
+		Datum		values[6];
+		bool		nulls[6];
+
+		for (int col = 0; col < 6; col++)
+			values[col] = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc,
+										col + 1, &nulls[col]);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	SPI_finish();
+}
+
+/*
+ * Queue depth and lag per chunk table and status
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_queue_stats);
+
+Datum
+pgedge_vectorizer_queue_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+		!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "queue_stats() called in a context that cannot accept a set");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (!emit_shared_stats(tupstore, tupdesc))
+		emit_scanned_stats(tupstore, tupdesc);
+
+	return (Datum) 0;
+}
+
+/*
+ * Count the queue table into the shared counters of the current database
+ *
+ * Takes a SHARE lock on the queue table, so that no transaction changes it
+ * between the count and the point where the counters take over.  Does
+ * nothing when the library is not in shared_preload_libraries.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_refresh_queue_stats);
+
+Datum
+pgedge_vectorizer_refresh_queue_stats(PG_FUNCTION_ARGS)
+{
+	Oid			relid;
+	Oid			argtypes[1] = {TIMESTAMPTZOID};
+	Datum		args[1];
+	QueueStatsEntry *entries;
+	QueueStatsEntry *db;
+	QueueStatsKey key;
+	int			n;
+	bool		fits = true;
+
+	if (queue_stats == NULL)
+		PG_RETURN_VOID();
+
+	/* The count must see everything committed before the lock was taken */
+	if (IsolationUsesXactSnapshot())
+		elog(ERROR, "refresh_queue_stats() cannot run in a REPEATABLE READ or SERIALIZABLE transaction");
+
+	if (deltas_invalidate ||
+		(queue_deltas != NULL && hash_get_num_entries(queue_deltas) > 0))
+		elog(ERROR, "refresh_queue_stats() cannot run in a transaction that has changed the queue");
+
+	relid = queue_relid();
+	args[0] = TimestampTzGetDatum(queue_stats->base);
+
+	SPI_connect();
+
+	if (SPI_execute("LOCK TABLE pgedge_vectorizer.queue IN SHARE MODE", false, 0) != SPI_OK_UTILITY)
+		elog(ERROR, "Failed to lock the queue table");
+
+	if (SPI_execute_with_args(
+			"SELECT chunk_table, status, COUNT(*), "
+			"       MIN(created_at), MAX(created_at), "
+			"       COUNT(*) FILTER (WHERE processed_at IS NULL), "
+			"       COALESCE(SUM(FLOOR(EXTRACT(EPOCH FROM created_at - $1) * 1000)) "
+			"                FILTER (WHERE processed_at IS NULL), 0)::bigint, "
+			"       COALESCE(SUM(FLOOR(EXTRACT(EPOCH FROM processed_at - created_at) * 1000)), 0)::bigint "
+			"FROM pgedge_vectorizer.queue "
+			"GROUP BY chunk_table, status "
+			"ORDER BY chunk_table",
+			1, argtypes, args, NULL, false, 0) != SPI_OK_SELECT)
+		elog(ERROR, "Failed to count the queue table");
+
+	/* Outlives SPI_finish() */
+	entries = SPI_palloc(sizeof(QueueStatsEntry) * (SPI_processed + 1));
+	memset(entries, 0, sizeof(QueueStatsEntry) * (SPI_processed + 1));
+	n = 0;
+
+	for (uint64 i = 0; i < SPI_processed; i++)
+	{
+		HeapTuple	tuple = SPI_tuptable->vals[i];
+		TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+		char	   *chunk_table = SPI_getvalue(tuple, tupdesc, 1);
+		int			s = queue_status_index(SPI_getvalue(tuple, tupdesc, 2));
+		QueueStatusCounts *c;
+		bool		isnull;
+
+		if (s < 0)
+			continue;
+
+		if (strlen(chunk_table) >= QUEUE_STATS_TABLE_LEN)
+		{
+			fits = false;
+			break;
+		}
+
+		if (n == 0 || strcmp(entries[n - 1].key.chunk_table, chunk_table) != 0)
+		{
+			entries[n].key.dboid = MyDatabaseId;
+			strlcpy(entries[n].key.chunk_table, chunk_table, QUEUE_STATS_TABLE_LEN);
+			n++;
+		}
+
+		c = &entries[n - 1].status[s];
+		c->count = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 3, &isnull));
+		c->oldest = DatumGetTimestampTz(SPI_getbinval(tuple, tupdesc, 4, &isnull));
+		c->newest = DatumGetTimestampTz(SPI_getbinval(tuple, tupdesc, 5, &isnull));
+		c->open = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 6, &isnull));
+		c->open_created = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 7, &isnull));
+		c->closed_time = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 8, &isnull));
+	}
+
+	SPI_finish();
+
+	memset(&key, 0, sizeof(key));
+	key.dboid = MyDatabaseId;
+
+	LWLockAcquire(queue_stats->lock, LW_EXCLUSIVE);
+
+	invalidate_database(MyDatabaseId);
+
+	if (!fits || queue_stats->nentries + n + 1 > QUEUE_STATS_MAX_ENTRIES)
+	{
+		LWLockRelease(queue_stats->lock);
+		pfree(entries);
+		elog(WARNING, "Queue counters of this database do not fit in shared memory; "
+			 "queue_stats() will aggregate the queue table");
+		PG_RETURN_VOID();
+	}
+
+	queue_stats->changes++;
+
+	for (int i = 0; i < n; i++)
+	{
+		QueueStatsEntry *entry = hash_search(queue_stats_hash, &entries[i].key,
+											 HASH_ENTER, NULL);
+
+		memcpy(entry->status, entries[i].status, sizeof(entry->status));
+		for (int s = 0; s < QS_NSTATUS; s++)
+			entry->status[s].changed = queue_stats->changes;
+		entry->seeded = false;
+		entry->queue_relid = InvalidOid;
+		queue_stats->nentries++;
+	}
+
+	db = hash_search(queue_stats_hash, &key, HASH_ENTER, NULL);
+	memset(db->status, 0, sizeof(db->status));
+	db->seeded = true;
+	db->queue_relid = relid;
+	queue_stats->nentries++;
+
+	LWLockRelease(queue_stats->lock);
+
+	pfree(entries);
+
+	PG_RETURN_VOID();
+}
@@ -0,0 +1,305 @@
+/*-------------------------------------------------------------------------
+ *
+ * search_stats.c
+ *		Per-phase timing of hybrid_search()
+ *
+ * hybrid_search() times its phases with clock_timestamp() and reports
+ * them, with the number of candidates each ranked list returned, to
+ * record_search_profile() before it returns.  The BM25 query phase is
+ * split into the loading of the chunk table's IDF statistics, timed by
+ * bm25_query_vector() with search_stats_note_idf_load(), and the rest.
+ *
+ * Searches are added to cumulative counters in shared memory, read with
+ * search_stats().  With pgedge_vectorizer.profile_search on, each search
+ * also reports its phases in a NOTICE.  Searches that fail are not
+ * recorded.  Without shared_preload_libraries the counters are not kept,
+ * but the NOTICE still is.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "utils/array.h"
+#include "utils/timestamp.h"
+
+/* Phases reported by hybrid_search(), in the order of its phase_ms array */
+typedef enum SearchInputPhase
+{
+	INPUT_LOOKUP,
+	INPUT_EMBED,
+	INPUT_BM25_QUERY,			/* Includes the IDF load */
+	INPUT_DENSE_SCAN,
+	INPUT_SPARSE_SCAN,
+	INPUT_MERGE,
+	INPUT_NPHASES
+} SearchInputPhase;
+
+/* Phases kept in shared memory */
+typedef enum SearchPhase
+{
+	SEARCH_LOOKUP,
+	SEARCH_EMBED,
+	SEARCH_BM25_QUERY,			/* Without the IDF load */
+	SEARCH_IDF_LOAD,
+	SEARCH_DENSE_SCAN,
+	SEARCH_SPARSE_SCAN,
+	SEARCH_MERGE,
+	SEARCH_NPHASES
+} SearchPhase;
+
+static const char *const search_phase_names[SEARCH_NPHASES] = {
+	"lookup",
+	"embed",
+	"bm25 query",
+	"IDF load",
+	"dense scan",
+	"sparse scan",
+	"merge",
+};
+
+typedef struct SearchStatsShared
+{
+	LWLock	   *lock;
+	int64		searches;
+	int64		phase_us[SEARCH_NPHASES];
+	int64		total_us;
+	int64		max_total_us;
+	int64		dense_candidates;
+	int64		sparse_candidates;
+	int64		results;
+	TimestampTz stats_reset;
+} SearchStatsShared;
+
+static SearchStatsShared *search_stats = NULL;
+
+/* IDF load time of the last bm25_query_vector() call in this backend */
+static double idf_load_secs = 0.0;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void search_stats_shmem_request(void);
+static void search_stats_shmem_startup(void);
+
+/*
+ * Request shared memory and the lock for the search statistics
+ *
+ * Called during _PG_init when shared_preload_libraries is processed.
+ */
+void
+search_stats_init(void)
+{
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = search_stats_shmem_request;
+#else
+	search_stats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = search_stats_shmem_startup;
+}
+
+static void
+search_stats_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(sizeof(SearchStatsShared));
+	RequestNamedLWLockTranche("pgedge_vectorizer_search_stats", 1);
+}
+
+static void
+search_stats_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	search_stats = ShmemInitStruct("pgedge_vectorizer search stats",
+								   sizeof(SearchStatsShared), &found);
+	if (!found)
+	{
+		memset(search_stats, 0, sizeof(SearchStatsShared));
+		search_stats->lock = &(GetNamedLWLockTranche("pgedge_vectorizer_search_stats"))->lock;
+		search_stats->stats_reset = GetCurrentTimestamp();
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Note the time bm25_query_vector() spent loading IDF statistics
+ */
+void
+search_stats_note_idf_load(double secs)
+{
+	idf_load_secs = secs;
+}
+
+/*
+ * Record the phases of a hybrid_search() call
+ *
+ * Arguments: the chunk table searched, the milliseconds of the phases of
+ * SearchInputPhase, and the candidates of the dense and sparse lists and
+ * the rows returned.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_record_search_profile);
+
+Datum
+pgedge_vectorizer_record_search_profile(PG_FUNCTION_ARGS)
+{
+	text	   *chunk_table = PG_GETARG_TEXT_PP(0);
+	ArrayType  *phase_array = PG_GETARG_ARRAYTYPE_P(1);
+	int32		dense_candidates = PG_GETARG_INT32(2);
+	int32		sparse_candidates = PG_GETARG_INT32(3);
+	int32		results = PG_GETARG_INT32(4);
+	Datum	   *elems;
+	bool	   *elem_nulls;
+	int			nelems;
+	double		input_ms[INPUT_NPHASES];
+	int64		phase_us[SEARCH_NPHASES];
+	int64		total_us = 0;
+	double		idf_ms;
+
+	deconstruct_array(phase_array, FLOAT8OID, sizeof(float8), FLOAT8PASSBYVAL,
+					  TYPALIGN_DOUBLE, &elems, &elem_nulls, &nelems);
+	if (nelems != INPUT_NPHASES)
+		elog(ERROR, "record_search_profile expects %d phase timings, got %d",
+			 INPUT_NPHASES, nelems);
+
+	for (int i = 0; i < INPUT_NPHASES; i++)
+		input_ms[i] = elem_nulls[i] ? 0.0 : Max(DatumGetFloat8(elems[i]), 0.0);
+
+	/* The IDF load happened inside the BM25 query phase */
+	idf_ms = Min(idf_load_secs * 1000.0, input_ms[INPUT_BM25_QUERY]);
+	idf_load_secs = 0.0;
+
+	phase_us[SEARCH_LOOKUP] = (int64) (input_ms[INPUT_LOOKUP] * 1000.0);
+	phase_us[SEARCH_EMBED] = (int64) (input_ms[INPUT_EMBED] * 1000.0);
+	phase_us[SEARCH_BM25_QUERY] = (int64) ((input_ms[INPUT_BM25_QUERY] - idf_ms) * 1000.0);
+	phase_us[SEARCH_IDF_LOAD] = (int64) (idf_ms * 1000.0);
+	phase_us[SEARCH_DENSE_SCAN] = (int64) (input_ms[INPUT_DENSE_SCAN] * 1000.0);
+	phase_us[SEARCH_SPARSE_SCAN] = (int64) (input_ms[INPUT_SPARSE_SCAN] * 1000.0);
+	phase_us[SEARCH_MERGE] = (int64) (input_ms[INPUT_MERGE] * 1000.0);
+	for (int p = 0; p < SEARCH_NPHASES; p++)
+		total_us += phase_us[p];
+
+	if (pgedge_vectorizer_profile_search)
+	{
+		StringInfoData msg;
+
+		initStringInfo(&msg);
+		for (int p = 0; p < SEARCH_NPHASES; p++)
+		{
+			appendStringInfo(&msg, "%s%s %.3f ms", p > 0 ? ", " : "",
+							 search_phase_names[p], phase_us[p] / 1000.0);
+			if (p == SEARCH_DENSE_SCAN)
+				appendStringInfo(&msg, " (%d candidates)", dense_candidates);
+			else if (p == SEARCH_SPARSE_SCAN)
+				appendStringInfo(&msg, " (%d candidates)", sparse_candidates);
+			else if (p == SEARCH_MERGE)
+				appendStringInfo(&msg, " (%d results)", results);
+		}
+
+		ereport(NOTICE,
+				(errmsg("hybrid_search on %s took %.3f ms",
+						text_to_cstring(chunk_table), total_us / 1000.0),
+				 errdetail("%s.", msg.data)));
+		pfree(msg.data);
+	}
+
+	if (search_stats != NULL)
+	{
+		LWLockAcquire(search_stats->lock, LW_EXCLUSIVE);
+
+		search_stats->searches++;
+		for (int p = 0; p < SEARCH_NPHASES; p++)
+			search_stats->phase_us[p] += phase_us[p];
+		search_stats->total_us += total_us;
+		search_stats->max_total_us = Max(search_stats->max_total_us, total_us);
+		search_stats->dense_candidates += dense_candidates;
+		search_stats->sparse_candidates += sparse_candidates;
+		search_stats->results += results;
+
+		LWLockRelease(search_stats->lock);
+	}
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Cumulative search counts and time per phase since the last reset
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_search_stats);
+
+Datum
+pgedge_vectorizer_search_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	SearchStatsShared copy;
+	Datum		values[SEARCH_NPHASES + 7];
+	bool		nulls[SEARCH_NPHASES + 7];
+	int			col = 0;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	memset(nulls, 0, sizeof(nulls));
+	memset(&copy, 0, sizeof(copy));
+
+	if (search_stats != NULL)
+	{
+		LWLockAcquire(search_stats->lock, LW_SHARED);
+		memcpy(&copy, search_stats, sizeof(SearchStatsShared));
+		LWLockRelease(search_stats->lock);
+	}
+
+	values[col++] = Int64GetDatum(copy.searches);
+	for (int p = 0; p < SEARCH_NPHASES; p++)
+		values[col++] = Float8GetDatum(copy.phase_us[p] / 1000.0);
+	values[col++] = Float8GetDatum(copy.total_us / 1000.0);
+	values[col++] = Float8GetDatum(copy.max_total_us / 1000.0);
+	values[col++] = Float8GetDatum(copy.searches > 0 ? (double) copy.dense_candidates / copy.searches : 0.0);
+	values[col++] = Float8GetDatum(copy.searches > 0 ? (double) copy.sparse_candidates / copy.searches : 0.0);
+	values[col++] = Float8GetDatum(copy.searches > 0 ? (double) copy.results / copy.searches : 0.0);
+	if (search_stats != NULL)
+		values[col++] = TimestampTzGetDatum(copy.stats_reset);
+	else
+		nulls[col++] = true;
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * Zero the cumulative counters
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_reset_search_stats);
+
+Datum
+pgedge_vectorizer_reset_search_stats(PG_FUNCTION_ARGS)
+{
+	if (search_stats != NULL)
+	{
+		LWLock	   *lock = search_stats->lock;
+
+		LWLockAcquire(lock, LW_EXCLUSIVE);
+		memset(search_stats, 0, sizeof(SearchStatsShared));
+		search_stats->lock = lock;
+		search_stats->stats_reset = GetCurrentTimestamp();
+		LWLockRelease(lock);
+	}
+
+	PG_RETURN_VOID();
+}
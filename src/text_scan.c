@@ -0,0 +1,456 @@
+/*-------------------------------------------------------------------------
+ *
+ * text_scan.c
+ *		Vectorized byte-scanning kernels shared by the chunking strategies
+ *
+ * The chunkers spend most of their time walking text one byte at a time:
+ * counting UTF-8 code points for the token estimate, finding the byte
+ * offset of the Nth code point, stripping non-ASCII bytes and searching
+ * for separators.  This file provides SSE2 and AVX2 implementations of
+ * those loops with a portable scalar fallback.
+ *
+ * The implementation is selected on first use, following the same
+ * "choose" pattern as PostgreSQL's pg_popcount(): each entry point is a
+ * function pointer that initially points at a chooser, which probes the
+ * CPU, repoints all kernels and then forwards the call.  SSE2 is part of
+ * the x86-64 baseline so it needs no runtime check; AVX2 is only used if
+ * the CPU (and OS) report support for it.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "port/pg_bitutils.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define USE_SSE2
+#define USE_AVX2_WITH_RUNTIME_CHECK
+#include <immintrin.h>
+#endif
+
+/* A UTF-8 continuation byte has the bit pattern 10xxxxxx */
+#define IS_UTF8_START(b)	(((unsigned char) (b) & 0xC0) != 0x80)
+
+/* Bytes 0x80-0xBF are below -64 when reinterpreted as signed char */
+#define UTF8_CONT_MAX_SIGNED	(-65)
+
+static int64 utf8_count_chars_choose(const char *s, size_t len);
+static size_t utf8_offset_for_chars_choose(const char *s, size_t len,
+										   int64 nchars);
+static size_t ascii_prefix_len_choose(const char *s, size_t len);
+static const char *text_find_any_choose(const char *s, size_t len,
+										const char *set, int nset);
+
+int64		(*utf8_count_chars) (const char *s, size_t len) = utf8_count_chars_choose;
+size_t		(*utf8_offset_for_chars) (const char *s, size_t len, int64 nchars) = utf8_offset_for_chars_choose;
+size_t		(*ascii_prefix_len) (const char *s, size_t len) = ascii_prefix_len_choose;
+const char *(*text_find_any) (const char *s, size_t len, const char *set, int nset) = text_find_any_choose;
+
+static const char *text_scan_impl_name = "scalar";
+
+/* ----------------------------------------------------------------
+ * Scalar implementations
+ *
+ * These are used on non-x86 platforms and to finish the tail of a
+ * buffer that is shorter than one vector register.
+ * ----------------------------------------------------------------
+ */
+
+static int64
+utf8_count_chars_scalar(const char *s, size_t len)
+{
+	int64		count = 0;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		if (IS_UTF8_START(s[i]))
+			count++;
+	}
+
+	return count;
+}
+
+/*
+ * Return the byte offset of the first code point boundary after nchars
+ * code points, or len if the text is shorter than that.  Trailing
+ * continuation bytes of the last counted code point are skipped so that
+ * the offset never lands in the middle of a multibyte character.
+ */
+static size_t
+utf8_offset_for_chars_scalar(const char *s, size_t len, int64 nchars)
+{
+	int64		count = 0;
+	size_t		i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (IS_UTF8_START(s[i]))
+		{
+			if (count == nchars)
+				break;
+			count++;
+		}
+	}
+
+	return i;
+}
+
+static size_t
+ascii_prefix_len_scalar(const char *s, size_t len)
+{
+	size_t		i = 0;
+
+	/* Eight bytes at a time while the high bit of every byte is clear */
+	while (i + sizeof(uint64) <= len)
+	{
+		uint64		chunk;
+
+		memcpy(&chunk, s + i, sizeof(chunk));
+		if (chunk & UINT64CONST(0x8080808080808080))
+			break;
+		i += sizeof(uint64);
+	}
+
+	while (i < len && !IS_HIGHBIT_SET(s[i]))
+		i++;
+
+	return i;
+}
+
+static const char *
+text_find_any_scalar(const char *s, size_t len, const char *set, int nset)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		for (int j = 0; j < nset; j++)
+		{
+			if (s[i] == set[j])
+				return s + i;
+		}
+	}
+
+	return NULL;
+}
+
+#ifdef USE_SSE2
+
+/* ----------------------------------------------------------------
+ * SSE2 implementations (16 bytes per iteration)
+ * ----------------------------------------------------------------
+ */
+
+static inline uint32
+utf8_start_mask_sse2(const char *p)
+{
+	__m128i		v = _mm_loadu_si128((const __m128i *) p);
+
+	return (uint32) _mm_movemask_epi8(
+		_mm_cmpgt_epi8(v, _mm_set1_epi8(UTF8_CONT_MAX_SIGNED)));
+}
+
+static int64
+utf8_count_chars_sse2(const char *s, size_t len)
+{
+	int64		count = 0;
+	size_t		i = 0;
+
+	for (; i + 16 <= len; i += 16)
+		count += __builtin_popcount(utf8_start_mask_sse2(s + i));
+
+	return count + utf8_count_chars_scalar(s + i, len - i);
+}
+
+static size_t
+utf8_offset_for_chars_sse2(const char *s, size_t len, int64 nchars)
+{
+	int64		count = 0;
+	size_t		i = 0;
+
+	/*
+	 * Skip whole blocks while they cannot contain the boundary.  The block
+	 * that would take us to nchars is finished by the scalar loop, which
+	 * also steps over the continuation bytes of the last character.
+	 */
+	for (; i + 16 <= len; i += 16)
+	{
+		int			n = __builtin_popcount(utf8_start_mask_sse2(s + i));
+
+		if (count + n > nchars)
+			break;
+		count += n;
+	}
+
+	return i + utf8_offset_for_chars_scalar(s + i, len - i, nchars - count);
+}
+
+static size_t
+ascii_prefix_len_sse2(const char *s, size_t len)
+{
+	size_t		i = 0;
+
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i		v = _mm_loadu_si128((const __m128i *) (s + i));
+		uint32		mask = (uint32) _mm_movemask_epi8(v);
+
+		if (mask != 0)
+			return i + pg_rightmost_one_pos32(mask);
+	}
+
+	return i + ascii_prefix_len_scalar(s + i, len - i);
+}
+
+static const char *
+text_find_any_sse2(const char *s, size_t len, const char *set, int nset)
+{
+	size_t		i = 0;
+	__m128i		needles[4];
+
+	Assert(nset > 0 && nset <= 4);
+
+	for (int j = 0; j < nset; j++)
+		needles[j] = _mm_set1_epi8(set[j]);
+
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i		v = _mm_loadu_si128((const __m128i *) (s + i));
+		__m128i		hit = _mm_cmpeq_epi8(v, needles[0]);
+		uint32		mask;
+
+		for (int j = 1; j < nset; j++)
+			hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, needles[j]));
+
+		mask = (uint32) _mm_movemask_epi8(hit);
+		if (mask != 0)
+			return s + i + pg_rightmost_one_pos32(mask);
+	}
+
+	return text_find_any_scalar(s + i, len - i, set, nset);
+}
+
+#endif							/* USE_SSE2 */
+
+#ifdef USE_AVX2_WITH_RUNTIME_CHECK
+
+/* ----------------------------------------------------------------
+ * AVX2 implementations (32 bytes per iteration)
+ *
+ * Compiled with a per-function target attribute so that the rest of
+ * the extension does not require AVX2; only called after the runtime
+ * check in text_scan_choose() succeeds.  Every AVX2 CPU also has POPCNT,
+ * which lets the popcount builtin compile to a single instruction.
+ * ----------------------------------------------------------------
+ */
+
+__attribute__((target("avx2,popcnt")))
+static inline uint32
+utf8_start_mask_avx2(const char *p)
+{
+	__m256i		v = _mm256_loadu_si256((const __m256i *) p);
+
+	return (uint32) _mm256_movemask_epi8(
+		_mm256_cmpgt_epi8(v, _mm256_set1_epi8(UTF8_CONT_MAX_SIGNED)));
+}
+
+__attribute__((target("avx2,popcnt")))
+static int64
+utf8_count_chars_avx2(const char *s, size_t len)
+{
+	int64		count = 0;
+	size_t		i = 0;
+
+	for (; i + 32 <= len; i += 32)
+		count += __builtin_popcount(utf8_start_mask_avx2(s + i));
+
+	return count + utf8_count_chars_sse2(s + i, len - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t
+utf8_offset_for_chars_avx2(const char *s, size_t len, int64 nchars)
+{
+	int64		count = 0;
+	size_t		i = 0;
+
+	for (; i + 32 <= len; i += 32)
+	{
+		int			n = __builtin_popcount(utf8_start_mask_avx2(s + i));
+
+		if (count + n > nchars)
+			break;
+		count += n;
+	}
+
+	return i + utf8_offset_for_chars_sse2(s + i, len - i, nchars - count);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t
+ascii_prefix_len_avx2(const char *s, size_t len)
+{
+	size_t		i = 0;
+
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i		v = _mm256_loadu_si256((const __m256i *) (s + i));
+		uint32		mask = (uint32) _mm256_movemask_epi8(v);
+
+		if (mask != 0)
+			return i + pg_rightmost_one_pos32(mask);
+	}
+
+	return i + ascii_prefix_len_sse2(s + i, len - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static const char *
+text_find_any_avx2(const char *s, size_t len, const char *set, int nset)
+{
+	size_t		i = 0;
+	__m256i		needles[4];
+
+	Assert(nset > 0 && nset <= 4);
+
+	for (int j = 0; j < nset; j++)
+		needles[j] = _mm256_set1_epi8(set[j]);
+
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i		v = _mm256_loadu_si256((const __m256i *) (s + i));
+		__m256i		hit = _mm256_cmpeq_epi8(v, needles[0]);
+		uint32		mask;
+
+		for (int j = 1; j < nset; j++)
+			hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, needles[j]));
+
+		mask = (uint32) _mm256_movemask_epi8(hit);
+		if (mask != 0)
+			return s + i + pg_rightmost_one_pos32(mask);
+	}
+
+	return text_find_any_sse2(s + i, len - i, set, nset);
+}
+
+#endif							/* USE_AVX2_WITH_RUNTIME_CHECK */
+
+/* ----------------------------------------------------------------
+ * Runtime selection
+ * ----------------------------------------------------------------
+ */
+
+static void
+text_scan_choose(void)
+{
+#if defined(USE_AVX2_WITH_RUNTIME_CHECK)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+	{
+		utf8_count_chars = utf8_count_chars_avx2;
+		utf8_offset_for_chars = utf8_offset_for_chars_avx2;
+		ascii_prefix_len = ascii_prefix_len_avx2;
+		text_find_any = text_find_any_avx2;
+		text_scan_impl_name = "avx2";
+	}
+	else
+#endif
+	{
+#if defined(USE_SSE2)
+		utf8_count_chars = utf8_count_chars_sse2;
+		utf8_offset_for_chars = utf8_offset_for_chars_sse2;
+		ascii_prefix_len = ascii_prefix_len_sse2;
+		text_find_any = text_find_any_sse2;
+		text_scan_impl_name = "sse2";
+#else
+		utf8_count_chars = utf8_count_chars_scalar;
+		utf8_offset_for_chars = utf8_offset_for_chars_scalar;
+		ascii_prefix_len = ascii_prefix_len_scalar;
+		text_find_any = text_find_any_scalar;
+		text_scan_impl_name = "scalar";
+#endif
+	}
+
+	elog(DEBUG1, "pgedge_vectorizer: using %s text scanning kernels",
+		 text_scan_impl_name);
+}
+
+static int64
+utf8_count_chars_choose(const char *s, size_t len)
+{
+	text_scan_choose();
+	return utf8_count_chars(s, len);
+}
+
+static size_t
+utf8_offset_for_chars_choose(const char *s, size_t len, int64 nchars)
+{
+	text_scan_choose();
+	return utf8_offset_for_chars(s, len, nchars);
+}
+
+static size_t
+ascii_prefix_len_choose(const char *s, size_t len)
+{
+	text_scan_choose();
+	return ascii_prefix_len(s, len);
+}
+
+static const char *
+text_find_any_choose(const char *s, size_t len, const char *set, int nset)
+{
+	text_scan_choose();
+	return text_find_any(s, len, set, nset);
+}
+
+/*
+ * Name of the kernel family in use ("avx2", "sse2" or "scalar")
+ */
+const char *
+text_scan_implementation(void)
+{
+	if (utf8_count_chars == utf8_count_chars_choose)
+		text_scan_choose();
+
+	return text_scan_impl_name;
+}
+
+/*
+ * Replace every run of non-ASCII bytes with a single space
+ *
+ * Writes at most len bytes plus a terminating NUL into dst and returns
+ * the number of bytes written (excluding the NUL).  A run is not given
+ * a space if the output already ends with one, which matches the
+ * historical behaviour of strip_non_ascii() in chunking.c.  ASCII runs
+ * are located with ascii_prefix_len() and copied with memcpy().
+ */
+size_t
+text_strip_non_ascii(char *dst, const char *src, size_t len)
+{
+	size_t		i = 0;
+	size_t		j = 0;
+
+	while (i < len)
+	{
+		size_t		run = ascii_prefix_len(src + i, len - i);
+
+		if (run > 0)
+		{
+			memcpy(dst + j, src + i, run);
+			i += run;
+			j += run;
+		}
+
+		if (i >= len)
+			break;
+
+		/* Collapse the run of high-bit bytes into at most one space */
+		while (i < len && IS_HIGHBIT_SET(src[i]))
+			i++;
+
+		if (j > 0 && dst[j - 1] != ' ')
+			dst[j++] = ' ';
+	}
+
+	dst[j] = '\0';
+	return j;
+}
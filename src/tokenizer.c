@@ -19,6 +19,7 @@
  *-------------------------------------------------------------------------
  */
 #include "pgedge_vectorizer.h"
+#include "mb/pg_wchar.h"
 
 /*
  * Approximate token count
@@ -31,30 +32,52 @@
 int
 count_tokens(const char *text, const char *model)
 {
-	int char_count = 0;
+	if (text == NULL || text[0] == '\0')
+		return 0;
+
+	/* flawfinder: ignore - text is a null-terminated C string */
+	return count_tokens_len(text, strlen(text), model);
+}
+
+/*
+ * Approximate token count for a buffer of known length
+ *
+ * Same estimate as count_tokens(), for callers that already know the
+ * byte length and want to avoid another strlen() pass.
+ */
+int
+count_tokens_len(const char *text, size_t len, const char *model)
+{
+	int64 char_count;
 	int token_estimate;
-	const char *p;
 
-	if (text == NULL || text[0] == '\0')
+	if (text == NULL || len == 0)
 		return 0;
 
-	/* Count characters (UTF-8 aware) */
-	for (p = text; *p; p++)
-	{
-		/* Only count the start of each UTF-8 character */
-		if ((*p & 0xC0) != 0x80)
-			char_count++;
-	}
+	/* Count characters (UTF-8 aware, vectorized) */
+	char_count = utf8_count_chars(text, len);
 
-	/* Estimate tokens (4 chars per token is a reasonable approximation) */
-	token_estimate = (char_count + 3) / 4;
+	token_estimate = count_tokens_for_chars(char_count, model);
 
-	elog(DEBUG2, "Token count estimate: %d (from %d characters)",
+	elog(DEBUG2, "Token count estimate: %d (from " INT64_FORMAT " characters)",
 		 token_estimate, char_count);
 
 	return token_estimate;
 }
 
+/*
+ * Approximate token count of a text of char_count characters
+ *
+ * Lets callers that keep character counts of pieces of a text, such as the
+ * chunker, measure a span of pieces without recounting its characters.
+ */
+int
+count_tokens_for_chars(int64 char_count, const char *model)
+{
+	/* 4 chars per token is a reasonable approximation */
+	return (int) ((char_count + 3) / 4);
+}
+
 /*
  * Tokenize text into token IDs
  *
@@ -102,26 +125,36 @@ detokenize_tokens(const int *tokens, int token_count, const char *model)
 int
 get_char_offset_for_tokens(const char *text, int target_tokens, const char *model)
 {
-	int estimated_chars;
-	const char *p;
-	int actual_chars = 0;
+	size_t max_bytes;
 
 	if (text == NULL || target_tokens <= 0)
 		return 0;
 
-	/* Estimate character position (4 chars per token) */
-	estimated_chars = target_tokens * 4;
+	/*
+	 * Only the first target_tokens * 4 characters can matter, and a UTF-8
+	 * character is at most 4 bytes, so bound the length scan accordingly
+	 * rather than measuring the whole remaining text.
+	 */
+	max_bytes = (size_t) target_tokens * 4 * MAX_MULTIBYTE_CHAR_LEN;
 
-	/* Count actual characters (UTF-8 aware) */
-	for (p = text; *p && actual_chars < estimated_chars; p++)
-	{
-		/* Only count the start of each UTF-8 character */
-		if ((*p & 0xC0) != 0x80)
-			actual_chars++;
-	}
+	return get_char_offset_for_tokens_len(text, strnlen(text, max_bytes),
+										  target_tokens, model);
+}
+
+/*
+ * Get character offset for a given token count in a buffer of known length
+ *
+ * The returned offset is always on a character boundary.
+ */
+int
+get_char_offset_for_tokens_len(const char *text, size_t len,
+							   int target_tokens, const char *model)
+{
+	if (text == NULL || target_tokens <= 0)
+		return 0;
 
-	/* Return byte offset */
-	return p - text;
+	/* Estimate character position (4 chars per token), return byte offset */
+	return (int) utf8_offset_for_chars(text, len, (int64) target_tokens * 4);
 }
 
 /*
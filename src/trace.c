@@ -0,0 +1,128 @@
+/*-------------------------------------------------------------------------
+ *
+ * trace.c
+ *		Ingestion traces of sampled documents
+ *
+ * With pgedge_vectorizer.trace_sample_rate set, the vectorization trigger
+ * traces a sample of the documents it chunks, optionally only those of the
+ * source tables in pgedge_vectorizer.trace_tables.  It records the
+ * chunking and queuing of a traced document in the ingest_trace table and
+ * flags its chunks on the hot queue or in the queue table.  Workers add
+ * the claim, provider call, write and BM25 events of flagged chunks with
+ * trace_event(), in the transaction that stores their embeddings, so a
+ * document's timeline in trace_document() covers the whole pipeline.
+ *
+ * Workers keep the table to about pgedge_vectorizer.trace_max_rows rows.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "utils/lsyscache.h"
+#include "utils/varlena.h"
+
+#if PG_VERSION_NUM >= 150000
+#include "common/pg_prng.h"
+#endif
+
+static bool trace_table_listed(Oid relid);
+
+/*
+ * Whether relid is one of the tables in pgedge_vectorizer.trace_tables,
+ * given with or without its schema
+ */
+static bool
+trace_table_listed(Oid relid)
+{
+	char	   *relname = get_rel_name(relid);
+	char	   *qualified;
+	char	   *names;
+	List	   *namelist;
+	ListCell   *lc;
+	bool		listed = false;
+
+	if (relname == NULL)
+		return false;
+
+	qualified = psprintf("%s.%s", get_namespace_name(get_rel_namespace(relid)),
+						 relname);
+
+	names = pstrdup(pgedge_vectorizer_trace_tables);
+	if (!SplitIdentifierString(names, ',', &namelist))
+		elog(ERROR, "invalid list syntax in pgedge_vectorizer.trace_tables");
+
+	foreach(lc, namelist)
+	{
+		const char *name = (const char *) lfirst(lc);
+
+		if (strcmp(name, relname) == 0 || strcmp(name, qualified) == 0)
+		{
+			listed = true;
+			break;
+		}
+	}
+
+	list_free(namelist);
+	pfree(names);
+	pfree(qualified);
+
+	return listed;
+}
+
+/*
+ * Decide whether the vectorization trigger traces a document of a table
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_trace_sampled);
+
+Datum
+pgedge_vectorizer_trace_sampled(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	double		draw;
+
+	if (pgedge_vectorizer_trace_sample_rate <= 0.0)
+		PG_RETURN_BOOL(false);
+
+	if (pgedge_vectorizer_trace_tables != NULL &&
+		pgedge_vectorizer_trace_tables[0] != '\0' &&
+		!trace_table_listed(relid))
+		PG_RETURN_BOOL(false);
+
+#if PG_VERSION_NUM >= 150000
+	draw = pg_prng_double(&pg_global_prng_state);
+#else
+	draw = (double) random() / ((double) MAX_RANDOM_VALUE + 1);
+#endif
+
+	PG_RETURN_BOOL(draw < pgedge_vectorizer_trace_sample_rate);
+}
+
+/*
+ * Record an event of a traced chunk in the ingest_trace table
+ *
+ * The source document is read from the chunk table.  duration_ms and size
+ * are stored as NULL when negative.  Runs in the caller's transaction with
+ * SPI connected.
+ */
+void
+trace_event(const char *chunk_table, int64 chunk_id, const char *stage,
+			double duration_ms, int size, const char *detail)
+{
+	if (SPI_execute(psprintf(
+		"INSERT INTO pgedge_vectorizer.ingest_trace "
+		"(chunk_table, source_id, chunk_id, stage, duration_ms, size, detail) "
+		"SELECT %s, source_id::text, " INT64_FORMAT ", %s, %s, %s, %s "
+		"FROM %s WHERE id = " INT64_FORMAT,
+		quote_literal_cstr(chunk_table),
+		chunk_id,
+		quote_literal_cstr(stage),
+		duration_ms >= 0.0 ? psprintf("%.3f", duration_ms) : "NULL",
+		size >= 0 ? psprintf("%d", size) : "NULL",
+		detail ? quote_literal_cstr(detail) : "NULL",
+		quote_identifier(chunk_table),
+		chunk_id),
+		false, 0) != SPI_OK_INSERT)
+		elog(ERROR, "Failed to record a trace event for chunk " INT64_FORMAT
+			 " of %s", chunk_id, chunk_table);
+}
@@ -0,0 +1,306 @@
+/*-------------------------------------------------------------------------
+ *
+ * usage_stats.c
+ *		Provider tokens and requests spent per chunk table
+ *
+ * Workers count what each chunk table costs at the embedding provider:
+ * the tokens and requests of the provider calls made for its chunks, the
+ * texts sent, the chunks whose stored dense embedding was reused instead
+ * of a new request, and the retried queue items.  A provider call can
+ * embed chunks of several tables with the same model; its tokens and
+ * requests are split between them in proportion to the length of their
+ * texts.  Tokens are the provider's own count (usage.total_tokens) where
+ * its responses report it, and an estimate otherwise.
+ *
+ * The counts are kept in the worker's memory and added to the
+ * usage_stats table about once a minute by usage_stats_write().  Spent
+ * tokens are counted whether or not the batch that spent them commits.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "utils/array.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+typedef struct UsageCounts
+{
+	char		chunk_table[NAMEDATALEN];	/* Hash key */
+	int64		tokens;
+	int64		requests;
+	int64		items;
+	int64		cache_hits;
+	int64		retries;
+} UsageCounts;
+
+/* Counts since the last write, in TopMemoryContext */
+static HTAB *usage_counts = NULL;
+
+/* Provider requests made since usage_stats_begin_call() */
+static bool call_active = false;
+static int64 call_tokens = 0;
+static int64 call_requests = 0;
+
+static UsageCounts *usage_entry(const char *chunk_table);
+
+static UsageCounts *
+usage_entry(const char *chunk_table)
+{
+	char		key[NAMEDATALEN];
+	bool		found;
+	UsageCounts *counts;
+
+	if (usage_counts == NULL)
+	{
+		HASHCTL		ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = NAMEDATALEN;
+		ctl.entrysize = sizeof(UsageCounts);
+		ctl.hcxt = TopMemoryContext;
+		usage_counts = hash_create("pgedge_vectorizer usage counts", 64, &ctl,
+								   HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+	}
+
+	memset(key, 0, sizeof(key));
+	strlcpy(key, chunk_table, NAMEDATALEN);
+
+	counts = hash_search(usage_counts, key, HASH_ENTER, &found);
+	if (!found)
+	{
+		memset(counts, 0, sizeof(UsageCounts));
+		strlcpy(counts->chunk_table, key, NAMEDATALEN);
+	}
+	return counts;
+}
+
+/*
+ * Start counting the provider requests of a call to generate_batch()
+ */
+void
+usage_stats_begin_call(void)
+{
+	call_active = true;
+	call_tokens = 0;
+	call_requests = 0;
+}
+
+/*
+ * Count a provider request towards the current call, if any
+ *
+ * Only successful requests spend tokens.
+ */
+void
+usage_stats_record_request(const ProviderRequestStats *stats)
+{
+	if (!call_active)
+		return;
+
+	call_requests++;
+	if (!stats->failed)
+		call_tokens += stats->tokens;
+}
+
+/*
+ * Charge the requests of the current call to the chunk tables of the n
+ * texts it embedded, in proportion to the length of the texts
+ */
+void
+usage_stats_end_call(int n, char **chunk_tables, const char **contents)
+{
+	bool	   *charged;
+	int64		total_len = 0;
+	int64		charged_len = 0;
+	int64		charged_tokens = 0;
+	int64		charged_requests = 0;
+
+	if (!call_active)
+		return;
+	call_active = false;
+
+	charged = palloc0(n * sizeof(bool));
+
+	for (int i = 0; i < n; i++)
+		total_len += strlen(contents[i]);
+
+	for (int first = 0; first < n; first++)
+	{
+		UsageCounts *counts;
+		int64		len = 0;
+		int			items = 0;
+		int64		tokens;
+		int64		requests;
+
+		if (charged[first])
+			continue;
+
+		for (int i = first; i < n; i++)
+		{
+			if (charged[i] || strcmp(chunk_tables[i], chunk_tables[first]) != 0)
+				continue;
+			charged[i] = true;
+			len += strlen(contents[i]);
+			items++;
+		}
+		charged_len += len;
+
+		/* Round the running totals, so that the shares add up exactly */
+		if (charged_len >= total_len)
+		{
+			tokens = call_tokens - charged_tokens;
+			requests = call_requests - charged_requests;
+		}
+		else
+		{
+			tokens = (int64) ((double) call_tokens * charged_len / total_len + 0.5) - charged_tokens;
+			requests = (int64) ((double) call_requests * charged_len / total_len + 0.5) - charged_requests;
+		}
+		charged_tokens += tokens;
+		charged_requests += requests;
+
+		counts = usage_entry(chunk_tables[first]);
+		counts->tokens += tokens;
+		counts->requests += requests;
+		counts->items += items;
+	}
+
+	pfree(charged);
+}
+
+/*
+ * Count chunks of a table that reused their stored dense embedding, and
+ * queue items that were retried
+ */
+void
+usage_stats_count(const char *chunk_table, int cache_hits, int retries)
+{
+	UsageCounts *counts;
+
+	if (cache_hits == 0 && retries == 0)
+		return;
+
+	counts = usage_entry(chunk_table);
+	counts->cache_hits += cache_hits;
+	counts->retries += retries;
+}
+
+/*
+ * Add the counts since the last write to the usage_stats table
+ *
+ * Runs in the caller's transaction with SPI connected.  The caller forgets
+ * the counts with usage_stats_reset() once the transaction has committed.
+ */
+void
+usage_stats_write(void)
+{
+	StringInfoData sql;
+	HASH_SEQ_STATUS scan;
+	UsageCounts *counts;
+	int			n = 0;
+
+	if (usage_counts == NULL || hash_get_num_entries(usage_counts) == 0)
+		return;
+
+	initStringInfo(&sql);
+	appendStringInfoString(&sql,
+						   "INSERT INTO pgedge_vectorizer.usage_stats AS u "
+						   "(chunk_table, tokens, requests, items, cache_hits, retries) VALUES ");
+
+	hash_seq_init(&scan, usage_counts);
+	while ((counts = hash_seq_search(&scan)) != NULL)
+	{
+		appendStringInfo(&sql, "%s(%s, " INT64_FORMAT ", " INT64_FORMAT ", "
+						 INT64_FORMAT ", " INT64_FORMAT ", " INT64_FORMAT ")",
+						 n++ > 0 ? ", " : "",
+						 quote_literal_cstr(counts->chunk_table),
+						 counts->tokens, counts->requests, counts->items,
+						 counts->cache_hits, counts->retries);
+	}
+
+	appendStringInfoString(&sql,
+						   " ON CONFLICT (chunk_table) DO UPDATE SET "
+						   "tokens = u.tokens + EXCLUDED.tokens, "
+						   "requests = u.requests + EXCLUDED.requests, "
+						   "items = u.items + EXCLUDED.items, "
+						   "cache_hits = u.cache_hits + EXCLUDED.cache_hits, "
+						   "retries = u.retries + EXCLUDED.retries, "
+						   "updated_at = NOW()");
+
+	if (SPI_execute(sql.data, false, 0) != SPI_OK_INSERT)
+		elog(ERROR, "Failed to write the provider usage counts");
+
+	pfree(sql.data);
+}
+
+/*
+ * Forget the counts written by usage_stats_write()
+ */
+void
+usage_stats_reset(void)
+{
+	if (usage_counts != NULL)
+	{
+		hash_destroy(usage_counts);
+		usage_counts = NULL;
+	}
+}
+
+/*
+ * Charge a provider call to the chunk tables of its texts and save it
+ *
+ * Arguments: the chunk table and text of each item of the call, and the
+ * tokens and requests it spent.  Splits and writes the counts like a
+ * worker's batch, in the caller's transaction; exposed for testing.
+ */
+PG_FUNCTION_INFO_V1(pgedge_vectorizer_record_usage);
+
+Datum
+pgedge_vectorizer_record_usage(PG_FUNCTION_ARGS)
+{
+	ArrayType  *tables_array = PG_GETARG_ARRAYTYPE_P(0);
+	ArrayType  *contents_array = PG_GETARG_ARRAYTYPE_P(1);
+	int64		tokens = PG_GETARG_INT64(2);
+	int32		requests = PG_GETARG_INT32(3);
+	Datum	   *table_elems;
+	Datum	   *content_elems;
+	bool	   *table_nulls;
+	bool	   *content_nulls;
+	int			n;
+	int			n_contents;
+	char	  **chunk_tables;
+	const char **contents;
+
+	deconstruct_array(tables_array, TEXTOID, -1, false, TYPALIGN_INT,
+					  &table_elems, &table_nulls, &n);
+	deconstruct_array(contents_array, TEXTOID, -1, false, TYPALIGN_INT,
+					  &content_elems, &content_nulls, &n_contents);
+	if (n != n_contents)
+		elog(ERROR, "record_usage expects a text for each of the %d chunk tables, got %d",
+			 n, n_contents);
+	if (n == 0)
+		PG_RETURN_VOID();
+
+	chunk_tables = palloc(n * sizeof(char *));
+	contents = palloc(n * sizeof(char *));
+	for (int i = 0; i < n; i++)
+	{
+		if (table_nulls[i] || content_nulls[i])
+			elog(ERROR, "record_usage does not accept NULL chunk tables or texts");
+		chunk_tables[i] = TextDatumGetCString(table_elems[i]);
+		contents[i] = TextDatumGetCString(content_elems[i]);
+	}
+
+	usage_stats_begin_call();
+	call_tokens = tokens;
+	call_requests = requests;
+	usage_stats_end_call(n, chunk_tables, contents);
+
+	SPI_connect();
+	usage_stats_write();
+	SPI_finish();
+	usage_stats_reset();
+
+	PG_RETURN_VOID();
+}
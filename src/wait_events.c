@@ -0,0 +1,45 @@
+/*-------------------------------------------------------------------------
+ *
+ * wait_events.c
+ *		Named wait events for the vectorizer's waits
+ *
+ * Workers and backends report these while they wait on an embedding
+ * provider, for work or for metrics scrapes, so that pg_stat_activity and
+ * wait-event samplers can tell the waits apart.  PostgreSQL 17 and later
+ * register each name with WaitEventExtensionNew() on first use; older
+ * versions report all of them as the generic Extension wait event.
+ *
+ * Copyright (c) 2025 - 2026, pgEdge, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "pgedge_vectorizer.h"
+#include "utils/wait_event.h"
+
+static const char *const wait_event_names[VECTORIZER_WAIT_COUNT] = {
+	"VectorizerProviderRequest",
+	"VectorizerQueuePoll",
+	"VectorizerWaitForExtension",
+	"VectorizerMetricsListen"
+};
+
+#if PG_VERSION_NUM >= 170000
+/* Wait event IDs registered by this process, 0 until first use */
+static uint32 wait_event_ids[VECTORIZER_WAIT_COUNT];
+#endif
+
+/*
+ * Wait event to report for one of the vectorizer's waits
+ */
+uint32
+vectorizer_wait_event(VectorizerWaitEvent event)
+{
+#if PG_VERSION_NUM >= 170000
+	if (wait_event_ids[event] == 0)
+		wait_event_ids[event] = WaitEventExtensionNew(wait_event_names[event]);
+	return wait_event_ids[event];
+#else
+	(void) wait_event_names;
+	return PG_WAIT_EXTENSION;
+#endif
+}
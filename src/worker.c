@@ -13,13 +13,16 @@
 #include "pgedge_vectorizer.h"
 #include "bm25.h"
 
+#include <sys/stat.h>
 #include <time.h>
 
 #include "commands/dbcommands.h"
 #include "pgstat.h"
 #include "postmaster/interrupt.h"
+#include "storage/fd.h"
 #include "storage/proc.h"
 #include "tcop/tcopprot.h"
+#include "tcop/utility.h"
 #include "utils/memutils.h"
 #include "utils/ps_status.h"
 
@@ -30,13 +33,112 @@ static volatile sig_atomic_t got_sighup = false;
 /* Last cleanup timestamp */
 static time_t last_cleanup_time = 0;
 
+/*
+ * Queue claim buckets.  The queue's bucket column is chunk_id % QUEUE_BUCKETS
+ * (see the queue table definition); each worker of a database owns every
+ * claim_stride-th bucket starting at claim_slot, and polls those first.
+ */
+#define QUEUE_BUCKETS 64
+static char *own_buckets = NULL;	/* e.g. '{0,4,8,...}', NULL: all buckets */
+
+/*
+ * Where the vectors of a chunk table are written: the chunk table itself,
+ * the narrow table created with embedding_storage => 'table', or for a
+ * direct vectorizer a column of the source table; and the model they are
+ * generated with
+ */
+typedef struct VectorTarget
+{
+	char	   *embedding_table;	/* NULL: the chunk table itself */
+	char	   *source_table;	/* direct vectorizers only, else NULL */
+	char	   *source_pk;
+	char	   *embedding_column;
+	char	   *model;			/* set by a model migration, else the
+								 * configured pgedge_vectorizer.model */
+} VectorTarget;
+
+/* Last check for deferred vector indexes, and the interval between checks */
+static time_t last_index_check_time = 0;
+#define INDEX_CHECK_INTERVAL 10		/* seconds */
+
+/* Last check for model migrations to index, at the same interval */
+static time_t last_migration_index_time = 0;
+
+/* Last count of the queue into the shared counters, and the retry interval */
+static time_t last_seed_time = 0;
+#define SEED_RETRY_INTERVAL 60		/* seconds */
+
+/* Last write of the provider usage counts, and the interval between writes */
+static time_t last_usage_write_time = 0;
+#define USAGE_WRITE_INTERVAL 60		/* seconds */
+
+/* Trimming of the ingest_trace table */
+static time_t last_trace_trim_time = 0;
+#define TRACE_TRIM_INTERVAL 60		/* seconds */
+
+/* Last throughput history snapshot (pgedge_vectorizer.history_interval) */
+static time_t last_history_time = 0;
+
+/*
+ * Present while the workers of a database run, removed at a clean shutdown:
+ * finding it at start means the queue may have lost chunks
+ */
+#define RUNNING_FILE_FORMAT "pg_stat/pgedge_vectorizer.%u.running"
+
 /* Forward declarations */
 static void worker_sigterm(SIGNAL_ARGS);
 static void worker_sighup(SIGNAL_ARGS);
-static void process_queue_batch(int worker_id);
+static int	process_queue_batch(int worker_id);
+static void assign_claim_buckets(int worker_id, int db_index, int db_count);
 static void cleanup_completed_items(int worker_id);
-static void update_embedding(int64 chunk_id, const char *chunk_table,
-							 const float *embedding, int dim);
+static void build_deferred_indexes(int worker_id);
+static void run_toplevel_statement(const char *sql, MemoryContext context);
+static void recover_queue_at_start(int worker_id);
+static void save_queue_at_shutdown(int worker_id);
+static void seed_queue_stats(int worker_id);
+static void write_usage_stats(int worker_id, bool force);
+static void trim_ingest_trace(int worker_id);
+static void capture_throughput(int worker_id);
+static void trace_items(int n, const bool *traced, char **chunk_tables,
+						const int64 *chunk_ids, const char *stage,
+						double duration_ms, const char *detail);
+static double bm25_stage_secs(void);
+static void trace_write_items(int n, const bool *traced, char **chunk_tables,
+							  const int64 *chunk_ids, double write_secs,
+							  double bm25_secs);
+static void migrate_embeddings(int worker_id);
+static void migrate_chunk_batch(int worker_id, const char *chunk_table,
+								const char *model, int migration_dim,
+								int64 last_chunk_id, bool ready);
+static void build_migration_indexes(int worker_id);
+static int process_hot_batch(int worker_id);
+static void embed_hot_entries(int worker_id, const HotQueueEntry *entries,
+							  int n_entries);
+static void queue_hot_entries(const HotQueueEntry *entries, int n_entries,
+							  const char *error_msg);
+static VectorTarget *lookup_vector_target(const char *chunk_table);
+static bool chunk_has_dense_embedding(const char *chunk_table,
+									  const VectorTarget *target,
+									  int64 chunk_id);
+static void fetch_chunk_contents(int n, char **chunk_tables,
+								 const int64 *chunk_ids, const char **contents);
+static int	vector_column_dim(const char *chunk_table, const VectorTarget *target);
+static void store_batch_embeddings(int n, const int64 *chunk_ids,
+								   char **chunk_tables, VectorTarget **targets,
+								   const char **contents, const bool *sparse_only,
+								   float **embeddings, int dim);
+static void store_chunk_table_embeddings(const char *chunk_table,
+										 const char *embedding_table,
+										 int n, const int64 *chunk_ids,
+										 const char **contents,
+										 const bool *sparse_only,
+										 float **embeddings, int dim);
+static void store_direct_embeddings(const VectorTarget *target,
+									int n, const int64 *row_ids,
+									const bool *sparse_only,
+									float **embeddings, int dim);
+static char *format_vector(const float *embedding, int dim);
+static void set_embedding_model(const char *model);
 
 /*
  * Signal handler for SIGTERM
@@ -136,6 +238,7 @@ pgedge_vectorizer_worker_main(Datum main_arg)
 	bool extension_exists = false;
 	int ext_retry_interval = 5000;	/* Start at 5s, doubles up to max */
 	bool first_ext_check = true;
+	bool queue_checked = false;
 #define EXT_RETRY_MAX	300000		/* Cap at 5 minutes */
 
 	/* Setup signal handlers */
@@ -169,7 +272,7 @@ pgedge_vectorizer_worker_main(Datum main_arg)
 			rc = WaitLatch(MyLatch,
 						   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
 						   60000L, /* Check every minute */
-						   PG_WAIT_EXTENSION);
+						   vectorizer_wait_event(VECTORIZER_WAIT_FOR_EXTENSION));
 
 			ResetLatch(MyLatch);
 
@@ -228,6 +331,11 @@ pgedge_vectorizer_worker_main(Datum main_arg)
 	elog(LOG, "pgedge_vectorizer worker %d started (database: %s)",
 		 worker_id + 1, dbname);
 
+	/* Let commits that fill the hot queue wake this worker */
+	hot_queue_register_worker(worker_id);
+
+	assign_claim_buckets(worker_id, worker_id % db_count, db_count);
+
 	/* Set process display */
 	pgstat_report_appname(psprintf("pgedge_vectorizer worker %d", worker_id + 1));
 
@@ -236,6 +344,7 @@ pgedge_vectorizer_worker_main(Datum main_arg)
 	{
 		int rc;
 		int wait_time;
+		int n_claimed;
 
 		/* Reload configuration if SIGHUP received */
 		if (got_sighup)
@@ -297,7 +406,9 @@ pgedge_vectorizer_worker_main(Datum main_arg)
 		rc = WaitLatch(MyLatch,
 					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
 					   wait_time,
-					   PG_WAIT_EXTENSION);
+					   vectorizer_wait_event(extension_exists ?
+											 VECTORIZER_WAIT_QUEUE_POLL :
+											 VECTORIZER_WAIT_FOR_EXTENSION));
 
 		ResetLatch(MyLatch);
 
@@ -317,10 +428,49 @@ pgedge_vectorizer_worker_main(Datum main_arg)
 
 		PG_TRY();
 		{
-			process_queue_batch(worker_id);
+			/*
+			 * Once per worker start, the first worker of each database
+			 * rebuilds the queue if the previous run did not shut down
+			 * cleanly.
+			 */
+			if (!queue_checked && worker_id < db_count)
+				recover_queue_at_start(worker_id);
+			queue_checked = true;
+
+			/* The first worker of each database also starts the queue counters */
+			if (worker_id < db_count)
+				seed_queue_stats(worker_id);
+
+			/* Chunks on the hot queue first; come straight back if it was full */
+			n_claimed = process_hot_batch(worker_id);
+			if (n_claimed >= pgedge_vectorizer_batch_size)
+				SetLatch(MyLatch);
+
+			n_claimed += process_queue_batch(worker_id);
+
+			/* Model migrations only get the time left over by new chunks */
+			if (n_claimed == 0)
+				migrate_embeddings(worker_id);
 
 			/* Perform automatic cleanup if enabled */
 			cleanup_completed_items(worker_id);
+
+			/* Save the provider usage counted since the last write */
+			write_usage_stats(worker_id, false);
+
+			/*
+			 * The first worker of each database keeps the trace table
+			 * bounded, takes the throughput history snapshots and builds the
+			 * vector indexes of drained bulk loads and of re-embedded model
+			 * migrations, so that no two workers build the same index
+			 */
+			if (worker_id < db_count)
+			{
+				trim_ingest_trace(worker_id);
+				capture_throughput(worker_id);
+				build_deferred_indexes(worker_id);
+				build_migration_indexes(worker_id);
+			}
 		}
 		PG_CATCH();
 		{
@@ -340,400 +490,1260 @@ pgedge_vectorizer_worker_main(Datum main_arg)
 		PG_END_TRY();
 	}
 
+	/* Save the provider usage counted since the last write */
+	if (extension_exists)
+	{
+		PG_TRY();
+		{
+			write_usage_stats(worker_id, true);
+			if (queue_checked && worker_id < db_count)
+				save_queue_at_shutdown(worker_id);
+		}
+		PG_CATCH();
+		{
+			EmitErrorReport();
+			FlushErrorState();
+			AbortCurrentTransaction();
+		}
+		PG_END_TRY();
+	}
+
 	/* Cleanup before exit */
 	elog(LOG, "pgedge_vectorizer worker %d shutting down", worker_id + 1);
 	proc_exit(0);
 }
 
 /*
- * Process a batch of queue items
+ * Work out which queue buckets this worker owns
+ *
+ * Workers are assigned to databases round-robin, so the workers of a
+ * database are worker_id = db_index, db_index + db_count, ...  They split
+ * the buckets the same way, which spreads their claims over different
+ * parts of the bucket index.
  */
 static void
-process_queue_batch(int worker_id)
+assign_claim_buckets(int worker_id, int db_index, int db_count)
 {
-	int ret;
-	int batch_size = pgedge_vectorizer_batch_size;
-	EmbeddingProvider *provider = NULL;
-	char *error_msg = NULL;
+	int			claim_slot = worker_id / db_count;
+	int			claim_stride = (pgedge_vectorizer_num_workers - db_index + db_count - 1) / db_count;
+	StringInfoData buckets;
 
-	/* Start a transaction */
-	SetCurrentStatementStartTimestamp();
-	StartTransactionCommand();
-	PushActiveSnapshot(GetTransactionSnapshot());
-	SPI_connect();
+	if (claim_stride <= 1)
+		return;
 
-	/* Fetch pending items using FOR UPDATE SKIP LOCKED */
-	ret = SPI_execute(psprintf(
-		"SELECT id, chunk_id, chunk_table, content, attempts, max_attempts, "
-		"       COALESCE((metadata->>'sparse_only')::boolean, false) AS sparse_only "
-		"FROM pgedge_vectorizer.queue "
-		"WHERE status = 'pending' "
-		"AND (next_retry_at IS NULL OR next_retry_at <= NOW()) "
-		"ORDER BY attempts DESC, created_at "
-		"LIMIT %d "
-		"FOR UPDATE SKIP LOCKED",
-		batch_size),
-		false, batch_size);
+	initStringInfo(&buckets);
+	appendStringInfoChar(&buckets, '{');
+	for (int b = claim_slot; b < QUEUE_BUCKETS; b += claim_stride)
+		appendStringInfo(&buckets, "%s%d", b > claim_slot ? "," : "", b);
+	appendStringInfoChar(&buckets, '}');
 
-	if (ret == SPI_OK_SELECT && SPI_processed > 0)
+	own_buckets = buckets.data;
+
+	elog(DEBUG1, "pgedge_vectorizer worker %d: claiming queue buckets %s first",
+		 worker_id + 1, own_buckets);
+}
+
+/*
+ * Rebuild the queue when a crash has lost queued chunks
+ *
+ * Crash recovery resets unlogged tables to empty, and the hot queue does
+ * not survive a crash.  The first worker of each database keeps a running
+ * file from its start until a clean shutdown has saved the hot queue, so a
+ * running file left behind by the previous start means the queue is
+ * refilled from the chunks that still lack embeddings.  recover_queue()
+ * skips the chunks that are on the queue table or the hot queue already.
+ */
+static void
+recover_queue_at_start(int worker_id)
+{
+	char		path[MAXPGPATH];
+	struct stat st;
+	FILE	   *file;
+
+	snprintf(path, sizeof(path), RUNNING_FILE_FORMAT, MyDatabaseId);
+
+	if (stat(path, &st) == 0)
 	{
-		int n_items = SPI_processed;
-		int64 *queue_ids = palloc(n_items * sizeof(int64));
-		int64 *chunk_ids = palloc(n_items * sizeof(int64));
-		char **chunk_tables = palloc(n_items * sizeof(char *));
-		const char **contents = palloc(n_items * sizeof(char *));
-		int *content_lens = palloc(n_items * sizeof(int));
-		int *attempts = palloc(n_items * sizeof(int));
-		int *max_attempts = palloc(n_items * sizeof(int));
-		bool *sparse_only = palloc(n_items * sizeof(bool));
-		float **embeddings = NULL;
-		int dim = 0;
-		bool has_retries = false;
-		bool has_sparse_only = false;
-		int effective_batch_size = n_items;
+		int			ret;
+		bool		isnull;
+
+		SetCurrentStatementStartTimestamp();
+		StartTransactionCommand();
+		SPI_connect();
+		PushActiveSnapshot(GetTransactionSnapshot());
+
+		ret = SPI_execute("SELECT pgedge_vectorizer.recover_queue()", false, 1);
+		if (ret != SPI_OK_SELECT)
+			elog(ERROR, "Failed to recover embedding queue");
+
+		elog(LOG, "pgedge_vectorizer worker %d: previous run did not shut down cleanly, requeued %d chunks without embeddings",
+			 worker_id + 1,
+			 DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
+										 SPI_tuptable->tupdesc, 1, &isnull)));
+
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+	}
+	else if (errno != ENOENT)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not stat file \"%s\": %m", path)));
+
+	file = AllocateFile(path, PG_BINARY_W);
+	if (file == NULL || FreeFile(file) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", path)));
+}
 
-		elog(DEBUG1, "Worker %d processing %d queue items", worker_id + 1, n_items);
+/*
+ * Move the database's hot queue to the queue table at a clean shutdown
+ *
+ * Once the chunks left in the ring are on the queue table, nothing has
+ * been lost and the running file is removed, so the next start does not
+ * run recover_queue().  If saving fails the file stays behind.
+ */
+static void
+save_queue_at_shutdown(int worker_id)
+{
+	char		path[MAXPGPATH];
+	HotQueueEntry *entries;
+	int			n_entries;
+	int			n_saved = 0;
 
-		/* Extract data from result */
-		for (int i = 0; i < n_items; i++)
+	if (hot_queue_enabled())
+	{
+		entries = palloc(pgedge_vectorizer_batch_size * sizeof(HotQueueEntry));
+
+		SetCurrentStatementStartTimestamp();
+		StartTransactionCommand();
+		PushActiveSnapshot(GetTransactionSnapshot());
+		SPI_connect();
+		while ((n_entries = hot_queue_pop(MyDatabaseId, entries,
+										  pgedge_vectorizer_batch_size)) > 0)
 		{
-			bool isnull;
-			Datum val;
+			queue_hot_entries(entries, n_entries, NULL);
+			n_saved += n_entries;
+		}
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
 
-			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 1, &isnull);
-			queue_ids[i] = DatumGetInt64(val);
+		pfree(entries);
 
-			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 2, &isnull);
-			chunk_ids[i] = DatumGetInt64(val);
+		if (n_saved > 0)
+			elog(LOG, "pgedge_vectorizer worker %d: moved %d hot queue items to the queue table",
+				 worker_id + 1, n_saved);
+	}
 
-			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 3, &isnull);
-			chunk_tables[i] = TextDatumGetCString(val);
+	snprintf(path, sizeof(path), RUNNING_FILE_FORMAT, MyDatabaseId);
+	if (unlink(path) != 0 && errno != ENOENT)
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not remove file \"%s\": %m", path)));
+}
 
-			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 4, &isnull);
-			content_lens[i] = (int) VARSIZE_ANY_EXHDR(DatumGetTextPP(val));
-			contents[i] = TextDatumGetCString(val);
+/*
+ * Count the queue into the shared counters read by queue_stats()
+ *
+ * Needed after a server start, and again when the counters were dropped
+ * (TRUNCATE of the queue, a prepared transaction, or too many chunk
+ * tables).  The count holds a SHARE lock on the queue table, so it gives
+ * up after a few seconds on a busy queue and is retried a minute later.
+ */
+static void
+seed_queue_stats(int worker_id)
+{
+	time_t		now;
 
-			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 5, &isnull);
-			attempts[i] = DatumGetInt32(val);
+	if (!queue_stats_needs_seed())
+		return;
 
-			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 6, &isnull);
-			max_attempts[i] = DatumGetInt32(val);
+	now = time(NULL);
+	if (last_seed_time > 0 && (now - last_seed_time) < SEED_RETRY_INTERVAL)
+		return;
 
-			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 7, &isnull);
-			sparse_only[i] = (!isnull && DatumGetBool(val));
+	last_seed_time = now;
 
-			if (attempts[i] > 0)
-				has_retries = true;
-		}
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	SPI_connect();
+	PushActiveSnapshot(GetTransactionSnapshot());
 
-		/* Dense embedding already present means this item can be sparse-only. */
-		for (int i = 0; i < n_items; i++)
-		{
-			bool	isnull = false;
-			int		ret_dense;
-			Datum	val;
+	if (SPI_execute("SET LOCAL lock_timeout = '5s'", false, 0) != SPI_OK_UTILITY ||
+		SPI_execute("SELECT pgedge_vectorizer.refresh_queue_stats()", false, 1) != SPI_OK_SELECT)
+		elog(ERROR, "Failed to count the embedding queue");
 
-			ret_dense = SPI_execute(psprintf(
-				"SELECT embedding IS NOT NULL FROM %s WHERE id = %ld",
-				quote_identifier(chunk_tables[i]),
-				chunk_ids[i]),
-				true, 1);
+	SPI_finish();
+	PopActiveSnapshot();
+	CommitTransactionCommand();
 
-			if (ret_dense == SPI_OK_SELECT && SPI_processed == 1)
-			{
-				val = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull);
-				if (!isnull && DatumGetBool(val))
-					sparse_only[i] = true;
-			}
+	elog(DEBUG1, "pgedge_vectorizer worker %d: counted the embedding queue into shared memory",
+		 worker_id + 1);
+}
 
-			if (sparse_only[i])
-				has_sparse_only = true;
-		}
+/*
+ * Add the provider usage counted since the last write to the usage_stats
+ * table
+ *
+ * Writes about once a minute, and at shutdown with force.  The counts are
+ * kept for the next attempt if the write fails.
+ */
+static void
+write_usage_stats(int worker_id, bool force)
+{
+	time_t		now = time(NULL);
 
-		/* If any items have been retried, process individually to isolate failures */
-		if (has_retries && n_items > 1)
-		{
-			effective_batch_size = 1;
-			elog(DEBUG1, "Worker %d: found retried items, processing individually", worker_id + 1);
-		}
-		else if (has_sparse_only && n_items > 1)
-		{
-			effective_batch_size = 1;
-			elog(DEBUG1, "Worker %d: found sparse-only items, processing individually", worker_id + 1);
-		}
+	if (!force && (now - last_usage_write_time) < USAGE_WRITE_INTERVAL)
+		return;
 
-		/* Mark all as processing */
-		for (int i = 0; i < n_items; i++)
-		{
-			SPI_execute(psprintf(
-				"UPDATE pgedge_vectorizer.queue "
-				"SET status = 'processing', processing_started_at = NOW() "
-				"WHERE id = %ld",
-				queue_ids[i]),
-				false, 0);
-		}
+	last_usage_write_time = now;
 
-		/* Get the provider */
-		provider = get_current_provider();
-		if (provider == NULL)
-		{
-			elog(ERROR, "No provider configured");
-		}
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	SPI_connect();
+	PushActiveSnapshot(GetTransactionSnapshot());
 
-		/* Initialize provider if needed */
-		if (!provider->init(&error_msg))
-		{
-			elog(ERROR, "Failed to initialize provider: %s",
-				 error_msg ? error_msg : "unknown error");
-		}
+	usage_stats_write();
 
-		/* Process items in batches of effective_batch_size */
-		for (int batch_start = 0; batch_start < n_items; batch_start += effective_batch_size)
-		{
-			int batch_end;
-			int batch_count;
+	SPI_finish();
+	PopActiveSnapshot();
+	CommitTransactionCommand();
 
-			batch_end = batch_start + effective_batch_size;
-			if (batch_end > n_items)
-				batch_end = n_items;
-			batch_count = batch_end - batch_start;
+	usage_stats_reset();
 
-			/* Skip dense generation when every item in this batch is sparse-only. */
-			{
-				bool batch_sparse_only = true;
+	elog(DEBUG2, "pgedge_vectorizer worker %d: saved the provider usage counts",
+		 worker_id + 1);
+}
 
-				for (int i = 0; i < batch_count; i++)
-				{
-					int idx = batch_start + i;
-					if (!sparse_only[idx])
-					{
-						batch_sparse_only = false;
-						break;
-					}
-				}
+/*
+ * Delete the oldest ingest_trace events beyond trace_max_rows
+ *
+ * Runs about once a minute.  Event ids are sequential, so the newest
+ * trace_max_rows ids are kept; fewer rows remain where ids were skipped.
+ */
+static void
+trim_ingest_trace(int worker_id)
+{
+	time_t		now = time(NULL);
 
-				if (batch_sparse_only)
-				{
-					embeddings = palloc0(batch_count * sizeof(float *));
-					dim = 0;
-					error_msg = NULL;
-				}
-				else
-				{
-					/* Generate embeddings for this batch */
-					embeddings = provider->generate_batch(&contents[batch_start], batch_count, &dim, &error_msg);
-				}
-			}
+	if ((now - last_trace_trim_time) < TRACE_TRIM_INTERVAL)
+		return;
 
-			if (embeddings != NULL)
-			{
-				/*
-				 * Validate that the embedding dimension matches the chunk
-				 * table's vector column. Check once per batch.
-				 */
-				if (!sparse_only[batch_start])
-				{
-					int idx0 = batch_start;
-					int ret_dim;
-					bool isnull_dim;
-					Datum val_dim;
-
-					ret_dim = SPI_execute(psprintf(
-						"SELECT atttypmod FROM pg_attribute "
-						"WHERE attrelid = '%s'::regclass "
-						"AND attname = 'embedding'",
-						chunk_tables[idx0]),
-						true, 1);
-
-					if (ret_dim == SPI_OK_SELECT && SPI_processed == 1)
-					{
-						val_dim = SPI_getbinval(SPI_tuptable->vals[0],
-												SPI_tuptable->tupdesc, 1, &isnull_dim);
-						if (!isnull_dim)
-						{
-							int table_dim = DatumGetInt32(val_dim);
-							if (table_dim > 0 && table_dim != dim)
-							{
-								elog(WARNING, "Embedding dimension mismatch for table %s: "
-									 "model returned %d dimensions but table expects %d. "
-									 "Reconfigure pgedge_vectorizer.model or recreate the "
-									 "chunk table with the correct dimension.",
-									 chunk_tables[idx0], dim, table_dim);
-
-								/* Fail all items in this batch */
-								for (int i = 0; i < batch_count; i++)
-								{
-									int fidx = batch_start + i;
-									SPI_execute(psprintf(
-										"UPDATE pgedge_vectorizer.queue "
-										"SET status = 'failed', "
-										"    error_message = 'Dimension mismatch: model=%d, table=%d', "
-										"    next_retry_at = NULL "
-										"WHERE id = %ld",
-										dim, table_dim, queue_ids[fidx]),
-										false, 0);
-								}
-
-								/* Free embeddings and skip to next batch */
-								for (int i = 0; i < batch_count; i++)
-								{
-									if (embeddings[i] != NULL)
-										pfree(embeddings[i]);
-								}
-								pfree(embeddings);
-								embeddings = NULL;
-								continue;
-							}
-						}
-					}
-				}
+	last_trace_trim_time = now;
 
-				/* Update chunk tables and mark as completed */
-				for (int i = 0; i < batch_count; i++)
-				{
-					int idx = batch_start + i;
-					PG_TRY();
-					{
-						if (!sparse_only[idx])
-							update_embedding(chunk_ids[idx], chunk_tables[idx], embeddings[i], dim);
-						else if (!pgedge_vectorizer_enable_hybrid)
-							elog(ERROR, "cannot process sparse-only queue item while pgedge_vectorizer.enable_hybrid is disabled");
-
-						/*
-						 * BM25 sparse vector update (opt-in via
-						 * pgedge_vectorizer.enable_hybrid GUC).
-						 */
-						if (pgedge_vectorizer_enable_hybrid)
-						{
-							int			ntokens;
-							int			token_count = 0;
-							bool		is_first_process = true;
-							BM25Term   *tokens;
-							HTAB	   *idf_htab;
-							float8		avg_doc_len;
-							char	   *sparse_str;
-							int			ret_bm25;
-							char	   *chunk_sql;
-
-							/*
-							 * Fetch token_count and check whether
-							 * sparse_embedding is already set (for
-							 * idempotency — skip IDF update on retry).
-							 */
-							chunk_sql = psprintf(
-								"SELECT token_count, "
-								"sparse_embedding IS NOT NULL "
-								"FROM %s WHERE id = %ld",
-								quote_identifier(chunk_tables[idx]),
-								chunk_ids[idx]);
-							ret_bm25 = SPI_execute(chunk_sql,
-												   true, 1);
-							pfree(chunk_sql);
-
-							if (ret_bm25 == SPI_OK_SELECT &&
-								SPI_processed > 0)
-							{
-								bool   isnull;
-								Datum  v;
-
-								v = SPI_getbinval(
-									SPI_tuptable->vals[0],
-									SPI_tuptable->tupdesc,
-									1, &isnull);
-								if (!isnull)
-									token_count = DatumGetInt32(v);
-
-								v = SPI_getbinval(
-									SPI_tuptable->vals[0],
-									SPI_tuptable->tupdesc,
-									2, &isnull);
-								if (!isnull)
-									is_first_process =
-										!DatumGetBool(v);
-
-								/*
-								 * Chunk row exists — proceed with BM25
-								 * scoring and IDF stats update.
-								 * Keeping this inside the SPI_processed > 0
-								 * block ensures we bail out cleanly when
-								 * the chunk has been concurrently deleted.
-								 */
-								if (token_count <= 0)
-									token_count = 1;
-
-								tokens = bm25_tokenize(contents[idx],
-													   &ntokens);
-								idf_htab = bm25_load_idf_stats(
-										chunk_tables[idx]);
-								avg_doc_len = bm25_avg_doc_len_internal(
-										chunk_tables[idx]);
-								sparse_str = bm25_compute_sparse_str(
-										tokens, ntokens,
-										idf_htab,
-										pgedge_vectorizer_bm25_k1,
-										pgedge_vectorizer_bm25_b,
-										avg_doc_len,
-										token_count);
-
-								ret_bm25 = SPI_execute(
-									psprintf(
-										"UPDATE %s SET "
-										"sparse_embedding = "
-										"%s::sparsevec "
-										"WHERE id = %ld",
-										quote_identifier(chunk_tables[idx]),
-										quote_literal_cstr(sparse_str),
-										chunk_ids[idx]),
-									false, 0);
-
-								if (ret_bm25 != SPI_OK_UPDATE)
-									elog(WARNING,
-										 "Failed to update "
-										 "sparse_embedding for "
-										 "chunk " INT64_FORMAT,
-										 chunk_ids[idx]);
-
-								if (idf_htab != NULL)
-									hash_destroy(idf_htab);
-
-								/*
-								 * Only update IDF stats the first time
-								 * this chunk is processed — retries must
-								 * not increment doc_freq again.
-								 */
-								if (is_first_process)
-									bm25_update_idf_stats(
-										chunk_tables[idx],
-										tokens, ntokens);
-							}
-							/* else: chunk row gone (concurrent delete) —
-							 * skip BM25 entirely to avoid inflating
-							 * corpus stats for a nonexistent chunk.
-							 */
-						}
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	SPI_connect();
+	PushActiveSnapshot(GetTransactionSnapshot());
 
-						/* Mark as completed */
-						SPI_execute(psprintf(
-							"UPDATE pgedge_vectorizer.queue "
-							"SET status = 'completed', processed_at = NOW() "
-							"WHERE id = %ld",
-							queue_ids[idx]),
-							false, 0);
+	if (SPI_execute(psprintf(
+		"DELETE FROM pgedge_vectorizer.ingest_trace "
+		"WHERE id <= (SELECT max(id) FROM pgedge_vectorizer.ingest_trace) - %d",
+		pgedge_vectorizer_trace_max_rows),
+		false, 0) == SPI_OK_DELETE && SPI_processed > 0)
+		elog(DEBUG1, "pgedge_vectorizer worker %d: trimmed " UINT64_FORMAT " trace events",
+			 worker_id + 1, SPI_processed);
 
-						elog(DEBUG2, "Successfully processed queue item %ld", queue_ids[idx]);
-					}
-					PG_CATCH();
-					{
-						/* Check if retries remain */
-						if (attempts[idx] + 1 >= max_attempts[idx])
-						{
-							/* No retries left - mark as permanently failed */
-							SPI_execute(psprintf(
-								"UPDATE pgedge_vectorizer.queue "
-								"SET status = 'failed', "
-								"    attempts = attempts + 1, "
-								"    error_message = 'Failed to update embedding', "
-								"    next_retry_at = NULL "
+	SPI_finish();
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+}
+
+/*
+ * Add a snapshot to the throughput_history ring
+ *
+ * Runs every pgedge_vectorizer.history_interval seconds; capture_throughput()
+ * computes the rates since the previous snapshot.  The usage counts of this
+ * worker are saved first, so that they are up to date in the snapshot; the
+ * other workers' counts lag by up to USAGE_WRITE_INTERVAL, which is why the
+ * interval is at least five times that.
+ */
+static void
+capture_throughput(int worker_id)
+{
+	time_t		now = time(NULL);
+
+	if (pgedge_vectorizer_history_interval <= 0 ||
+		(now - last_history_time) < pgedge_vectorizer_history_interval)
+		return;
+
+	last_history_time = now;
+
+	write_usage_stats(worker_id, true);
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	SPI_connect();
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	if (SPI_execute("SELECT pgedge_vectorizer.capture_throughput()", false, 0) != SPI_OK_SELECT)
+		elog(ERROR, "Failed to capture a throughput history snapshot");
+
+	SPI_finish();
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+
+	elog(DEBUG2, "pgedge_vectorizer worker %d: captured a throughput history snapshot",
+		 worker_id + 1);
+}
+
+/*
+ * Record an event of the traced items among n in ingest_trace
+ */
+static void
+trace_items(int n, const bool *traced, char **chunk_tables,
+			const int64 *chunk_ids, const char *stage, double duration_ms,
+			const char *detail)
+{
+	for (int i = 0; i < n; i++)
+	{
+		if (traced[i])
+			trace_event(chunk_tables[i], chunk_ids[i], stage, duration_ms, -1,
+						detail);
+	}
+}
+
+/*
+ * Time spent in the BM25 stages of the current batch so far
+ */
+static double
+bm25_stage_secs(void)
+{
+	return batch_stats_stage_secs(BATCH_STAGE_BM25_TOKENIZE) +
+		batch_stats_stage_secs(BATCH_STAGE_BM25_SCORE) +
+		batch_stats_stage_secs(BATCH_STAGE_BM25_IDF);
+}
+
+/*
+ * Record the write and BM25 events of the traced items among n
+ *
+ * write_secs and bm25_secs are the stage times of the batch taken before
+ * the items were written.
+ */
+static void
+trace_write_items(int n, const bool *traced, char **chunk_tables,
+				  const int64 *chunk_ids, double write_secs, double bm25_secs)
+{
+	double		bm25 = bm25_stage_secs() - bm25_secs;
+	double		write = batch_stats_stage_secs(BATCH_STAGE_WRITE) - write_secs - bm25;
+
+	trace_items(n, traced, chunk_tables, chunk_ids, "write",
+				Max(write, 0.0) * 1000.0, NULL);
+	if (bm25 > 0.0)
+		trace_items(n, traced, chunk_tables, chunk_ids, "bm25", bm25 * 1000.0,
+					NULL);
+}
+
+/*
+ * Where the vectors of a chunk table are written, and with which model
+ *
+ * For a direct vectorizer the "chunk table" is only the name its rows are
+ * queued under; the vectors go to a column of the source table itself.
+ */
+static VectorTarget *
+lookup_vector_target(const char *chunk_table)
+{
+	VectorTarget *target = palloc0(sizeof(VectorTarget));
+	int			ret;
+
+	ret = SPI_execute(psprintf(
+		"SELECT embedding_table, source_table, source_pk, embedding_column, model "
+		"FROM pgedge_vectorizer.vectorizers "
+		"WHERE chunk_table = %s LIMIT 1",
+		quote_literal_cstr(chunk_table)),
+		true, 1);
+
+	if (ret == SPI_OK_SELECT && SPI_processed == 1)
+	{
+		HeapTuple	tuple = SPI_tuptable->vals[0];
+		TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+
+		target->embedding_table = SPI_getvalue(tuple, tupdesc, 1);
+		target->embedding_column = SPI_getvalue(tuple, tupdesc, 4);
+		if (target->embedding_column != NULL)
+		{
+			target->source_table = SPI_getvalue(tuple, tupdesc, 2);
+			target->source_pk = SPI_getvalue(tuple, tupdesc, 3);
+		}
+		target->model = SPI_getvalue(tuple, tupdesc, 5);
+	}
+
+	/* Resolved now: a batch may switch models for the rest of its transaction */
+	if (target->model == NULL)
+		target->model = pstrdup(pgedge_vectorizer_model);
+
+	return target;
+}
+
+/*
+ * Does the chunk (or for a direct vectorizer, the row) already have a
+ * dense embedding?
+ */
+static bool
+chunk_has_dense_embedding(const char *chunk_table, const VectorTarget *target,
+						  int64 chunk_id)
+{
+	int			ret;
+	bool		isnull = true;
+	Datum		val = (Datum) 0;
+
+	if (target->embedding_column != NULL)
+		ret = SPI_execute(psprintf(
+			"SELECT %s IS NOT NULL FROM %s WHERE %s = %ld",
+			quote_identifier(target->embedding_column),
+			target->source_table,
+			quote_identifier(target->source_pk),
+			chunk_id),
+			true, 1);
+	else if (target->embedding_table != NULL)
+		ret = SPI_execute(psprintf(
+			"SELECT embedding IS NOT NULL FROM %s WHERE chunk_id = %ld",
+			quote_identifier(target->embedding_table),
+			chunk_id),
+			true, 1);
+	else
+		ret = SPI_execute(psprintf(
+			"SELECT embedding IS NOT NULL FROM %s WHERE id = %ld",
+			quote_identifier(chunk_table),
+			chunk_id),
+			true, 1);
+
+	if (ret == SPI_OK_SELECT && SPI_processed == 1)
+		val = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull);
+
+	return !isnull && DatumGetBool(val);
+}
+
+/*
+ * Fill in the text of the chunks whose contents[] entry is NULL
+ *
+ * One chunk_contents() call reads all of them, with one query per chunk
+ * table that also rebuilds chunks stored as offsets from their source
+ * rows.  Entries whose chunk has since been deleted are left NULL.
+ */
+static void
+fetch_chunk_contents(int n, char **chunk_tables, const int64 *chunk_ids,
+					 const char **contents)
+{
+	StringInfoData tables;
+	StringInfoData ids;
+	int		   *fetched = palloc(n * sizeof(int));
+	int			n_fetched = 0;
+	int			ret;
+
+	initStringInfo(&tables);
+	initStringInfo(&ids);
+	for (int i = 0; i < n; i++)
+	{
+		if (contents[i] != NULL)
+			continue;
+
+		appendStringInfo(&tables, "%s%s", n_fetched > 0 ? ", " : "",
+						 quote_literal_cstr(chunk_tables[i]));
+		appendStringInfo(&ids, "%s%ld", n_fetched > 0 ? ", " : "",
+						 chunk_ids[i]);
+		fetched[n_fetched++] = i;
+	}
+
+	if (n_fetched > 0)
+	{
+		ret = SPI_execute(psprintf(
+			"SELECT item, content "
+			"FROM pgedge_vectorizer.chunk_contents(ARRAY[%s]::text[], ARRAY[%s]::bigint[])",
+			tables.data, ids.data),
+			true, 0);
+
+		if (ret != SPI_OK_SELECT)
+			elog(ERROR, "Failed to read the contents of %d chunks", n_fetched);
+
+		for (uint64 r = 0; r < SPI_processed; r++)
+		{
+			bool		isnull;
+			int			item;
+			Datum		val;
+
+			val = SPI_getbinval(SPI_tuptable->vals[r], SPI_tuptable->tupdesc, 1, &isnull);
+			item = DatumGetInt32(val);
+
+			val = SPI_getbinval(SPI_tuptable->vals[r], SPI_tuptable->tupdesc, 2, &isnull);
+			if (!isnull && item >= 1 && item <= n_fetched)
+				contents[fetched[item - 1]] = TextDatumGetCString(val);
+		}
+	}
+
+	pfree(tables.data);
+	pfree(ids.data);
+	pfree(fetched);
+}
+
+/*
+ * Dimension of the vector column the embeddings of a chunk table go to
+ *
+ * Returns -1 when the column is missing or has no fixed dimension.
+ */
+static int
+vector_column_dim(const char *chunk_table, const VectorTarget *target)
+{
+	const char *relation;
+	const char *column = "embedding";
+	bool		isnull = true;
+	Datum		val = (Datum) 0;
+	int			ret;
+
+	/* source_table is a regclass text and already quoted */
+	if (target->embedding_column != NULL)
+	{
+		relation = target->source_table;
+		column = target->embedding_column;
+	}
+	else
+		relation = quote_identifier(target->embedding_table != NULL ?
+									target->embedding_table : chunk_table);
+
+	ret = SPI_execute(psprintf(
+		"SELECT atttypmod FROM pg_attribute "
+		"WHERE attrelid = %s::regclass "
+		"AND attname = %s",
+		quote_literal_cstr(relation),
+		quote_literal_cstr(column)),
+		true, 1);
+
+	if (ret == SPI_OK_SELECT && SPI_processed == 1)
+		val = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull);
+
+	return isnull ? -1 : DatumGetInt32(val);
+}
+
+/*
+ * Process a batch of chunks from the hot queue
+ *
+ * Returns the number of chunks taken off the hot queue.  If embedding them
+ * fails, the whole batch moves to the queue table, where the usual retry
+ * and failure handling applies.
+ */
+static int
+process_hot_batch(int worker_id)
+{
+	MemoryContext worker_context = CurrentMemoryContext;
+	HotQueueEntry *entries;
+	int			n_entries;
+
+	if (!hot_queue_enabled())
+		return 0;
+
+	entries = palloc(pgedge_vectorizer_batch_size * sizeof(HotQueueEntry));
+
+	batch_stats_begin(true);
+	batch_stats_stage_begin(BATCH_STAGE_CLAIM);
+	n_entries = hot_queue_pop(MyDatabaseId, entries, pgedge_vectorizer_batch_size);
+	batch_stats_stage_end(BATCH_STAGE_CLAIM);
+
+	if (n_entries > 0)
+	{
+		PG_TRY();
+		{
+			embed_hot_entries(worker_id, entries, n_entries);
+		}
+		PG_CATCH();
+		{
+			MemoryContextSwitchTo(worker_context);
+			EmitErrorReport();
+			FlushErrorState();
+			AbortCurrentTransaction();
+
+			elog(LOG, "pgedge_vectorizer worker %d: moving %d hot queue items to the queue table",
+				 worker_id + 1, n_entries);
+
+			SetCurrentStatementStartTimestamp();
+			StartTransactionCommand();
+			PushActiveSnapshot(GetTransactionSnapshot());
+			SPI_connect();
+			queue_hot_entries(entries, n_entries, "Failed to update embedding");
+			SPI_finish();
+			PopActiveSnapshot();
+			CommitTransactionCommand();
+		}
+		PG_END_TRY();
+	}
+
+	pfree(entries);
+	return n_entries;
+}
+
+/*
+ * Embed and store a batch of chunks taken off the hot queue
+ *
+ * Works like process_queue_batch() without a queue row per chunk: the
+ * text is read from the chunk table, which also drops chunks deleted
+ * since they were queued, and nothing tracks the items' progress.
+ */
+static void
+embed_hot_entries(int worker_id, const HotQueueEntry *entries, int n_entries)
+{
+	HotQueueEntry *items;
+	HotQueueEntry *spilled;
+	int64	   *chunk_ids;
+	char	  **chunk_tables;
+	VectorTarget **targets;
+	char	  **entry_tables;
+	int64	   *entry_ids;
+	const char **entry_contents;
+	const char **contents;
+	const char **dense_contents;
+	char	  **dense_tables;
+	bool	   *sparse_only;
+	bool	   *traced;
+	float	  **embeddings;
+	float	  **dense_embeddings = NULL;
+	int			n_items = 0;
+	int			n_dense = 0;
+	int			n_spilled = 0;
+	int			n_failed = 0;
+	const char *batch_model = NULL;
+	int			dim = 0;
+	char	   *error_msg = NULL;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	SPI_connect();
+
+	/* Freed with the SPI context at SPI_finish() */
+	items = palloc(n_entries * sizeof(HotQueueEntry));
+	spilled = palloc(n_entries * sizeof(HotQueueEntry));
+	chunk_ids = palloc(n_entries * sizeof(int64));
+	chunk_tables = palloc(n_entries * sizeof(char *));
+	targets = palloc(n_entries * sizeof(VectorTarget *));
+	entry_tables = palloc(n_entries * sizeof(char *));
+	entry_ids = palloc(n_entries * sizeof(int64));
+	entry_contents = palloc0(n_entries * sizeof(char *));
+	contents = palloc(n_entries * sizeof(char *));
+	dense_contents = palloc(n_entries * sizeof(char *));
+	dense_tables = palloc(n_entries * sizeof(char *));
+	sparse_only = palloc(n_entries * sizeof(bool));
+	traced = palloc(n_entries * sizeof(bool));
+	embeddings = palloc0(n_entries * sizeof(float *));
+
+	batch_stats_stage_begin(BATCH_STAGE_PROBE);
+
+	/* Read the text of all the entries at once */
+	for (int i = 0; i < n_entries; i++)
+	{
+		entry_tables[i] = (char *) entries[i].chunk_table;
+		entry_ids[i] = entries[i].chunk_id;
+	}
+	fetch_chunk_contents(n_entries, entry_tables, entry_ids, entry_contents);
+
+	for (int i = 0; i < n_entries; i++)
+	{
+		if (entry_contents[i] == NULL)
+		{
+			elog(DEBUG1, "Chunk " INT64_FORMAT " not found in table %s, "
+				 "dropping hot queue item",
+				 entries[i].chunk_id, entries[i].chunk_table);
+			continue;
+		}
+
+		chunk_ids[n_items] = entries[i].chunk_id;
+		chunk_tables[n_items] = pstrdup(entries[i].chunk_table);
+		contents[n_items] = entry_contents[i];
+
+		if (n_items > 0 && strcmp(chunk_tables[n_items], chunk_tables[n_items - 1]) == 0)
+			targets[n_items] = targets[n_items - 1];
+		else
+			targets[n_items] = lookup_vector_target(chunk_tables[n_items]);
+
+		sparse_only[n_items] = chunk_has_dense_embedding(chunk_tables[n_items],
+														 targets[n_items],
+														 chunk_ids[n_items]);
+
+		/* Already embedded and no sparse vector to add: nothing to do */
+		if (sparse_only[n_items] && !pgedge_vectorizer_enable_hybrid)
+			continue;
+
+		if (!sparse_only[n_items])
+		{
+			/*
+			 * One provider call embeds with one model: chunks of tables
+			 * migrated to another model go through the queue table.
+			 */
+			if (batch_model != NULL && strcmp(targets[n_items]->model, batch_model) != 0)
+			{
+				spilled[n_spilled++] = entries[i];
+				continue;
+			}
+			batch_model = targets[n_items]->model;
+			dense_tables[n_dense] = chunk_tables[n_items];
+			dense_contents[n_dense++] = contents[n_items];
+		}
+		else
+			usage_stats_count(chunk_tables[n_items], 1, 0);
+
+		items[n_items] = entries[i];
+		traced[n_items] = entries[i].traced;
+		n_items++;
+	}
+	batch_stats_stage_end(BATCH_STAGE_PROBE);
+
+	queue_hot_entries(spilled, n_spilled, NULL);
+
+	/* Trace the claim of sampled chunks, with the time they waited */
+	for (int i = 0; i < n_items; i++)
+	{
+		if (traced[i])
+			trace_event(chunk_tables[i], chunk_ids[i], "claim",
+						(double) (GetCurrentTimestamp() - items[i].queued_at) / 1000.0,
+						(int) strlen(contents[i]), "hot queue");
+	}
+
+	elog(DEBUG1, "Worker %d processing %d hot queue items", worker_id + 1, n_items);
+
+	if (n_dense > 0)
+	{
+		EmbeddingProvider *provider = get_current_provider();
+		double		request_secs = batch_stats_stage_secs(BATCH_STAGE_REQUEST_BUILD);
+
+		set_embedding_model(batch_model);
+
+		if (provider == NULL)
+			elog(ERROR, "No provider configured");
+
+		if (!provider->init(&error_msg))
+			elog(ERROR, "Failed to initialize provider: %s",
+				 error_msg ? error_msg : "unknown error");
+
+		batch_stats_stage_begin(BATCH_STAGE_REQUEST_BUILD);
+		usage_stats_begin_call();
+		dense_embeddings = provider->generate_batch(dense_contents, n_dense, &dim, &error_msg);
+		usage_stats_end_call(n_dense, dense_tables, dense_contents);
+		batch_stats_stage_end(BATCH_STAGE_REQUEST_BUILD);
+
+		/* Sparse-only items were not sent to the provider */
+		for (int i = 0; i < n_items; i++)
+		{
+			if (traced[i] && !sparse_only[i])
+				trace_event(chunk_tables[i], chunk_ids[i], "embed",
+							(batch_stats_stage_secs(BATCH_STAGE_REQUEST_BUILD) - request_secs) * 1000.0,
+							-1, psprintf("%d texts, model %s", n_dense, batch_model));
+		}
+
+		if (dense_embeddings == NULL)
+		{
+			elog(WARNING, "Failed to generate embeddings for %d hot queue items: %s",
+				 n_items, error_msg ? error_msg : "unknown error");
+			trace_items(n_items, traced, chunk_tables, chunk_ids, "failed", -1.0,
+						error_msg);
+			queue_hot_entries(items, n_items, error_msg);
+			n_failed = n_items;
+			n_items = 0;
+		}
+	}
+
+	if (n_items > 0)
+	{
+		int			d = 0;
+
+		/* Check each chunk table's vector column against the model */
+		for (int i = 0; i < n_items; i++)
+		{
+			int			table_dim;
+
+			if (sparse_only[i])
+				continue;
+
+			embeddings[i] = dense_embeddings[d++];
+
+			if (i > 0 && strcmp(chunk_tables[i], chunk_tables[i - 1]) == 0)
+				continue;
+
+			table_dim = vector_column_dim(chunk_tables[i], targets[i]);
+			if (table_dim > 0 && table_dim != dim)
+			{
+				/* The queue table path reports the mismatch per item */
+				char	   *mismatch = psprintf("Dimension mismatch: model=%d, table=%d",
+												dim, table_dim);
+
+				trace_items(n_items, traced, chunk_tables, chunk_ids, "failed",
+							-1.0, mismatch);
+				queue_hot_entries(items, n_items, mismatch);
+				n_failed = n_items;
+				n_items = 0;
+				break;
+			}
+		}
+	}
+
+	if (n_items > 0)
+	{
+		double		write_secs = batch_stats_stage_secs(BATCH_STAGE_WRITE);
+		double		bm25_secs = bm25_stage_secs();
+
+		batch_stats_stage_begin(BATCH_STAGE_WRITE);
+		store_batch_embeddings(n_items, chunk_ids, chunk_tables, targets,
+							   contents, sparse_only, embeddings, dim);
+		batch_stats_stage_end(BATCH_STAGE_WRITE);
+
+		trace_write_items(n_items, traced, chunk_tables, chunk_ids,
+						  write_secs, bm25_secs);
+
+		for (int i = 0; i < n_items; i++)
+			freshness_stats_note(items[i].chunk_table, items[i].queued_at);
+	}
+
+	SPI_finish();
+	PopActiveSnapshot();
+	batch_stats_stage_begin(BATCH_STAGE_COMMIT);
+	CommitTransactionCommand();
+	batch_stats_stage_end(BATCH_STAGE_COMMIT);
+
+	batch_stats_finish(worker_id, n_entries, n_failed);
+}
+
+/*
+ * Insert hot queue items into the queue table
+ *
+ * The items are queued without their text, which the worker reads from
+ * the chunk table when it gets to them.  They keep the time they were
+ * first queued, so that their freshness counts from there, and the trace
+ * flag of sampled documents.
+ */
+static void
+queue_hot_entries(const HotQueueEntry *entries, int n_entries,
+				  const char *error_msg)
+{
+	StringInfoData sql;
+
+	if (n_entries == 0)
+		return;
+
+	initStringInfo(&sql);
+	appendStringInfoString(&sql,
+						   "INSERT INTO pgedge_vectorizer.queue "
+						   "(chunk_id, chunk_table, error_message, created_at, metadata) VALUES ");
+	for (int i = 0; i < n_entries; i++)
+		appendStringInfo(&sql, "%s(%ld, %s, %s, %s::timestamptz, %s)",
+						 i > 0 ? ", " : "",
+						 entries[i].chunk_id,
+						 quote_literal_cstr(entries[i].chunk_table),
+						 error_msg ? quote_literal_cstr(error_msg) : "NULL",
+						 quote_literal_cstr(timestamptz_to_str(entries[i].queued_at)),
+						 entries[i].traced ? "'{\"trace\": true}'::jsonb" : "NULL");
+
+	if (SPI_execute(sql.data, false, 0) != SPI_OK_INSERT)
+		elog(ERROR, "Failed to move hot queue items to the queue table");
+
+	pfree(sql.data);
+}
+
+/*
+ * Process a batch of queue items
+ *
+ * Returns the number of queue items claimed.
+ */
+static int
+process_queue_batch(int worker_id)
+{
+	int ret;
+	int batch_size = pgedge_vectorizer_batch_size;
+	EmbeddingProvider *provider = NULL;
+	char *error_msg = NULL;
+	int n_claimed = 0;
+	int n_failed = 0;
+
+	batch_stats_begin(false);
+	batch_stats_stage_begin(BATCH_STAGE_CLAIM);
+
+	/* Start a transaction */
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	SPI_connect();
+
+	/*
+	 * Fetch pending items using FOR UPDATE SKIP LOCKED: from this worker's
+	 * own buckets first, and from any bucket when those are empty, so an
+	 * idle worker helps out with the others' backlog.  idx_queue_bucket
+	 * holds each bucket in the claim order, retries first.  The claimed
+	 * items are grouped by chunk table, which keeps the chunks of each
+	 * embedding model together.
+	 */
+	ret = SPI_OK_SELECT;
+	for (int pass = (own_buckets != NULL ? 0 : 1); pass < 2; pass++)
+	{
+		ret = SPI_execute(psprintf(
+			"SELECT * FROM ("
+			"SELECT id, chunk_id, chunk_table, content, attempts, max_attempts, "
+			"       COALESCE((metadata->>'sparse_only')::boolean, false) AS sparse_only, "
+			"       created_at, "
+			"       COALESCE((metadata->>'trace')::boolean, false) AS traced "
+			"FROM pgedge_vectorizer.queue "
+			"WHERE status = 'pending' %s "
+			"AND (next_retry_at IS NULL OR next_retry_at <= NOW()) "
+			"ORDER BY attempts DESC, created_at "
+			"LIMIT %d "
+			"FOR UPDATE SKIP LOCKED"
+			") AS claimed ORDER BY chunk_table",
+			pass == 0 ? psprintf("AND bucket = ANY ('%s'::smallint[])", own_buckets) : "",
+			batch_size),
+			false, batch_size);
+
+		if (ret != SPI_OK_SELECT || SPI_processed > 0)
+			break;
+	}
+	batch_stats_stage_end(BATCH_STAGE_CLAIM);
+
+	if (ret == SPI_OK_SELECT && SPI_processed > 0)
+	{
+		int n_items = SPI_processed;
+		int64 *queue_ids = palloc(n_items * sizeof(int64));
+		int64 *chunk_ids = palloc(n_items * sizeof(int64));
+		char **chunk_tables = palloc(n_items * sizeof(char *));
+		VectorTarget **targets = palloc(n_items * sizeof(VectorTarget *));
+		const char **contents = palloc(n_items * sizeof(char *));
+		int *content_lens = palloc(n_items * sizeof(int));
+		int *attempts = palloc(n_items * sizeof(int));
+		int *max_attempts = palloc(n_items * sizeof(int));
+		bool *sparse_only = palloc(n_items * sizeof(bool));
+		TimestampTz *created_at = palloc(n_items * sizeof(TimestampTz));
+		bool *traced = palloc(n_items * sizeof(bool));
+		float **embeddings = NULL;
+		int dim = 0;
+		bool has_retries = false;
+		bool has_sparse_only = false;
+		int effective_batch_size = n_items;
+		int batch_end;
+
+		n_claimed = n_items;
+
+		elog(DEBUG1, "Worker %d processing %d queue items", worker_id + 1, n_items);
+
+		/* Extract data from result */
+		for (int i = 0; i < n_items; i++)
+		{
+			bool isnull;
+			Datum val;
+
+			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 1, &isnull);
+			queue_ids[i] = DatumGetInt64(val);
+
+			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 2, &isnull);
+			chunk_ids[i] = DatumGetInt64(val);
+
+			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 3, &isnull);
+			chunk_tables[i] = TextDatumGetCString(val);
+
+			/* NULL for chunks stored as offsets; rebuilt below */
+			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 4, &isnull);
+			content_lens[i] = isnull ? 0 : (int) VARSIZE_ANY_EXHDR(DatumGetTextPP(val));
+			contents[i] = isnull ? NULL : TextDatumGetCString(val);
+
+			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 5, &isnull);
+			attempts[i] = DatumGetInt32(val);
+
+			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 6, &isnull);
+			max_attempts[i] = DatumGetInt32(val);
+
+			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 7, &isnull);
+			sparse_only[i] = (!isnull && DatumGetBool(val));
+
+			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 8, &isnull);
+			created_at[i] = isnull ? 0 : DatumGetTimestampTz(val);
+
+			val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 9, &isnull);
+			traced[i] = (!isnull && DatumGetBool(val));
+
+			if (attempts[i] > 0)
+				has_retries = true;
+		}
+
+		/*
+		 * Rebuild the text of chunks stored as offsets into their source
+		 * row, all in one query.  Items whose chunk has since been deleted
+		 * have nothing left to embed and are completed straight away.
+		 */
+		batch_stats_stage_begin(BATCH_STAGE_PROBE);
+		{
+			int n_kept = 0;
+
+			fetch_chunk_contents(n_items, chunk_tables, chunk_ids, contents);
+
+			for (int i = 0; i < n_items; i++)
+			{
+				if (contents[i] == NULL)
+				{
+					elog(DEBUG1, "Chunk " INT64_FORMAT " not found in table %s, "
+						 "completing queue item %ld",
+						 chunk_ids[i], chunk_tables[i], queue_ids[i]);
+					SPI_execute(psprintf(
+						"UPDATE pgedge_vectorizer.queue "
+						"SET status = 'completed', processed_at = NOW() "
+						"WHERE id = %ld",
+						queue_ids[i]),
+						false, 0);
+					continue;
+				}
+
+				if (content_lens[i] == 0)
+					content_lens[i] = (int) strlen(contents[i]);
+
+				queue_ids[n_kept] = queue_ids[i];
+				chunk_ids[n_kept] = chunk_ids[i];
+				chunk_tables[n_kept] = chunk_tables[i];
+				contents[n_kept] = contents[i];
+				content_lens[n_kept] = content_lens[i];
+				attempts[n_kept] = attempts[i];
+				max_attempts[n_kept] = max_attempts[i];
+				sparse_only[n_kept] = sparse_only[i];
+				created_at[n_kept] = created_at[i];
+				traced[n_kept] = traced[i];
+				n_kept++;
+			}
+
+			n_items = n_kept;
+			effective_batch_size = n_items;
+		}
+
+		/*
+		 * Look up where each chunk table keeps its embeddings: the chunk
+		 * table itself, the narrow table created with embedding_storage =>
+		 * 'table', or the source table of a direct vectorizer.  A dense
+		 * embedding already present means the item can be sparse-only.
+		 */
+		for (int i = 0; i < n_items; i++)
+		{
+			if (i > 0 && strcmp(chunk_tables[i], chunk_tables[i - 1]) == 0)
+				targets[i] = targets[i - 1];
+			else
+				targets[i] = lookup_vector_target(chunk_tables[i]);
+
+			if (chunk_has_dense_embedding(chunk_tables[i], targets[i],
+										  chunk_ids[i]))
+				sparse_only[i] = true;
+
+			if (sparse_only[i])
+				has_sparse_only = true;
+
+			usage_stats_count(chunk_tables[i], sparse_only[i] ? 1 : 0,
+							  attempts[i] > 0 ? 1 : 0);
+		}
+		batch_stats_stage_end(BATCH_STAGE_PROBE);
+
+		/* If any items have been retried, process individually to isolate failures */
+		if (has_retries && n_items > 1)
+		{
+			effective_batch_size = 1;
+			elog(DEBUG1, "Worker %d: found retried items, processing individually", worker_id + 1);
+		}
+		else if (has_sparse_only && n_items > 1)
+		{
+			effective_batch_size = 1;
+			elog(DEBUG1, "Worker %d: found sparse-only items, processing individually", worker_id + 1);
+		}
+
+		/* Mark all as processing */
+		batch_stats_stage_begin(BATCH_STAGE_CLAIM);
+		for (int i = 0; i < n_items; i++)
+		{
+			SPI_execute(psprintf(
+				"UPDATE pgedge_vectorizer.queue "
+				"SET status = 'processing', processing_started_at = NOW() "
+				"WHERE id = %ld",
+				queue_ids[i]),
+				false, 0);
+		}
+		batch_stats_stage_end(BATCH_STAGE_CLAIM);
+
+		/* Trace the claim of sampled chunks, with the time they waited */
+		for (int i = 0; i < n_items; i++)
+		{
+			if (traced[i])
+				trace_event(chunk_tables[i], chunk_ids[i], "claim",
+							created_at[i] != 0 ?
+							(double) (GetCurrentTimestamp() - created_at[i]) / 1000.0 : -1.0,
+							content_lens[i],
+							psprintf("queue table, attempt %d", attempts[i] + 1));
+		}
+
+		/* Get the provider */
+		provider = get_current_provider();
+		if (provider == NULL)
+		{
+			elog(ERROR, "No provider configured");
+		}
+
+		/* Initialize provider if needed */
+		if (!provider->init(&error_msg))
+		{
+			elog(ERROR, "Failed to initialize provider: %s",
+				 error_msg ? error_msg : "unknown error");
+		}
+
+		/*
+		 * Process items in batches of effective_batch_size, cut short where
+		 * the next chunk table uses another model
+		 */
+		for (int batch_start = 0; batch_start < n_items; batch_start = batch_end)
+		{
+			int batch_count;
+			double write_secs;
+			double bm25_secs;
+
+			batch_end = batch_start + effective_batch_size;
+			if (batch_end > n_items)
+				batch_end = n_items;
+			for (int i = batch_start + 1; i < batch_end; i++)
+			{
+				if (strcmp(targets[i]->model, targets[batch_start]->model) != 0)
+				{
+					batch_end = i;
+					break;
+				}
+			}
+			batch_count = batch_end - batch_start;
+
+			/* Skip dense generation when every item in this batch is sparse-only. */
+			{
+				bool batch_sparse_only = true;
+
+				for (int i = 0; i < batch_count; i++)
+				{
+					int idx = batch_start + i;
+					if (!sparse_only[idx])
+					{
+						batch_sparse_only = false;
+						break;
+					}
+				}
+
+				if (batch_sparse_only)
+				{
+					embeddings = palloc0(batch_count * sizeof(float *));
+					dim = 0;
+					error_msg = NULL;
+				}
+				else
+				{
+					double request_secs = batch_stats_stage_secs(BATCH_STAGE_REQUEST_BUILD);
+
+					/* Generate embeddings for this batch */
+					set_embedding_model(targets[batch_start]->model);
+					batch_stats_stage_begin(BATCH_STAGE_REQUEST_BUILD);
+					usage_stats_begin_call();
+					embeddings = provider->generate_batch(&contents[batch_start], batch_count, &dim, &error_msg);
+					usage_stats_end_call(batch_count, &chunk_tables[batch_start], &contents[batch_start]);
+					batch_stats_stage_end(BATCH_STAGE_REQUEST_BUILD);
+
+					trace_items(batch_count, &traced[batch_start],
+								&chunk_tables[batch_start], &chunk_ids[batch_start],
+								"embed",
+								(batch_stats_stage_secs(BATCH_STAGE_REQUEST_BUILD) - request_secs) * 1000.0,
+								psprintf("%d texts, model %s", batch_count,
+										 targets[batch_start]->model));
+				}
+			}
+
+			if (embeddings != NULL)
+			{
+				/*
+				 * Validate that the embedding dimension matches the chunk
+				 * table's vector column. Check once per batch.
+				 */
+				if (!sparse_only[batch_start])
+				{
+					int idx0 = batch_start;
+					int table_dim = vector_column_dim(chunk_tables[idx0], targets[idx0]);
+
+					if (table_dim > 0 && table_dim != dim)
+					{
+						elog(WARNING, "Embedding dimension mismatch for table %s: "
+							 "model returned %d dimensions but table expects %d. "
+							 "Reconfigure pgedge_vectorizer.model or migrate the "
+							 "chunk table with start_model_migration().",
+							 chunk_tables[idx0], dim, table_dim);
+
+						/* Fail all items in this batch */
+						for (int i = 0; i < batch_count; i++)
+						{
+							int fidx = batch_start + i;
+							SPI_execute(psprintf(
+								"UPDATE pgedge_vectorizer.queue "
+								"SET status = 'failed', "
+								"    error_message = 'Dimension mismatch: model=%d, table=%d', "
+								"    next_retry_at = NULL "
+								"WHERE id = %ld",
+								dim, table_dim, queue_ids[fidx]),
+								false, 0);
+						}
+						n_failed += batch_count;
+
+						trace_items(batch_count, &traced[batch_start],
+									&chunk_tables[batch_start], &chunk_ids[batch_start],
+									"failed", -1.0,
+									psprintf("Dimension mismatch: model=%d, table=%d",
+											 dim, table_dim));
+
+						/* Free embeddings and skip to next batch */
+						for (int i = 0; i < batch_count; i++)
+						{
+							if (embeddings[i] != NULL)
+								pfree(embeddings[i]);
+						}
+						pfree(embeddings);
+						embeddings = NULL;
+						continue;
+					}
+				}
+
+				/*
+				 * Write the whole batch back with one set-based statement per
+				 * chunk table and mark its items completed
+				 */
+				write_secs = batch_stats_stage_secs(BATCH_STAGE_WRITE);
+				bm25_secs = bm25_stage_secs();
+				batch_stats_stage_begin(BATCH_STAGE_WRITE);
+				PG_TRY();
+				{
+					store_batch_embeddings(batch_count,
+										   &chunk_ids[batch_start],
+										   &chunk_tables[batch_start],
+										   &targets[batch_start],
+										   &contents[batch_start],
+										   &sparse_only[batch_start],
+										   embeddings, dim);
+
+					for (int i = 0; i < batch_count; i++)
+					{
+						int idx = batch_start + i;
+
+						SPI_execute(psprintf(
+							"UPDATE pgedge_vectorizer.queue "
+							"SET status = 'completed', processed_at = NOW() "
+							"WHERE id = %ld",
+							queue_ids[idx]),
+							false, 0);
+						freshness_stats_note(chunk_tables[idx], created_at[idx]);
+
+						elog(DEBUG2, "Successfully processed queue item %ld", queue_ids[idx]);
+					}
+				}
+				PG_CATCH();
+				{
+					for (int i = 0; i < batch_count; i++)
+					{
+						int idx = batch_start + i;
+
+						/* Check if retries remain */
+						if (attempts[idx] + 1 >= max_attempts[idx])
+						{
+							/* No retries left - mark as permanently failed */
+							SPI_execute(psprintf(
+								"UPDATE pgedge_vectorizer.queue "
+								"SET status = 'failed', "
+								"    attempts = attempts + 1, "
+								"    error_message = 'Failed to update embedding', "
+								"    next_retry_at = NULL "
 								"WHERE id = %ld",
 								queue_ids[idx]),
 								false, 0);
@@ -751,12 +1761,17 @@ process_queue_batch(int worker_id)
 								queue_ids[idx]),
 								false, 0);
 						}
-
-						/* Re-throw */
-						PG_RE_THROW();
 					}
-					PG_END_TRY();
+
+					/* Re-throw */
+					PG_RE_THROW();
 				}
+				PG_END_TRY();
+				batch_stats_stage_end(BATCH_STAGE_WRITE);
+
+				trace_write_items(batch_count, &traced[batch_start],
+								  &chunk_tables[batch_start], &chunk_ids[batch_start],
+								  write_secs, bm25_secs);
 
 				/* Free embeddings */
 				for (int i = 0; i < batch_count; i++)
@@ -773,97 +1788,470 @@ process_queue_batch(int worker_id)
 				{
 					int idx = batch_start + i;
 
-					/* Check if retries remain */
-					if (attempts[idx] + 1 >= max_attempts[idx])
-					{
-						/* No retries left - mark as permanently failed */
-						SPI_execute(psprintf(
-							"UPDATE pgedge_vectorizer.queue "
-							"SET status = 'failed', "
-							"    attempts = attempts + 1, "
-							"    error_message = %s, "
-							"    next_retry_at = NULL "
-							"WHERE id = %ld",
-							error_msg ? psprintf("'%s'", error_msg) : "NULL",
-							queue_ids[idx]),
-							false, 0);
-					}
-					else
-					{
-						/* Retries remain - set back to pending with exponential backoff */
-						SPI_execute(psprintf(
-							"UPDATE pgedge_vectorizer.queue "
-							"SET status = 'pending', "
-							"    attempts = attempts + 1, "
-							"    error_message = %s, "
-							"    next_retry_at = NOW() + (attempts + 1) * INTERVAL '1 minute' "
-							"WHERE id = %ld",
-							error_msg ? psprintf("'%s'", error_msg) : "NULL",
-							queue_ids[idx]),
-							false, 0);
-					}
-				}
+					/* Check if retries remain */
+					if (attempts[idx] + 1 >= max_attempts[idx])
+					{
+						/* No retries left - mark as permanently failed */
+						SPI_execute(psprintf(
+							"UPDATE pgedge_vectorizer.queue "
+							"SET status = 'failed', "
+							"    attempts = attempts + 1, "
+							"    error_message = %s, "
+							"    next_retry_at = NULL "
+							"WHERE id = %ld",
+							error_msg ? psprintf("'%s'", error_msg) : "NULL",
+							queue_ids[idx]),
+							false, 0);
+					}
+					else
+					{
+						/* Retries remain - set back to pending with exponential backoff */
+						SPI_execute(psprintf(
+							"UPDATE pgedge_vectorizer.queue "
+							"SET status = 'pending', "
+							"    attempts = attempts + 1, "
+							"    error_message = %s, "
+							"    next_retry_at = NOW() + (attempts + 1) * INTERVAL '1 minute' "
+							"WHERE id = %ld",
+							error_msg ? psprintf("'%s'", error_msg) : "NULL",
+							queue_ids[idx]),
+							false, 0);
+					}
+				}
+
+				n_failed += batch_count;
+
+				trace_items(batch_count, &traced[batch_start],
+							&chunk_tables[batch_start], &chunk_ids[batch_start],
+							"failed", -1.0, error_msg);
+
+				elog(WARNING, "Failed to generate embeddings for batch starting at %d: %s",
+					 batch_start, error_msg ? error_msg : "unknown error");
+			}
+		}
+
+		/* Cleanup */
+		pfree(queue_ids);
+		pfree(chunk_ids);
+		pfree(chunk_tables);
+		pfree(targets);
+		pfree(contents);
+		pfree(attempts);
+		pfree(max_attempts);
+		pfree(sparse_only);
+		pfree(created_at);
+		pfree(traced);
+	}
+
+	SPI_finish();
+	PopActiveSnapshot();
+	batch_stats_stage_begin(BATCH_STAGE_COMMIT);
+	CommitTransactionCommand();
+	batch_stats_stage_end(BATCH_STAGE_COMMIT);
+
+	batch_stats_finish(worker_id, n_claimed, n_failed);
+
+	return n_claimed;
+}
+
+/*
+ * Format an embedding as a pgvector literal: [0.1,0.2,0.3,...]
+ */
+static char *
+format_vector(const float *embedding, int dim)
+{
+	StringInfoData vector_str;
+
+	initStringInfo(&vector_str);
+	appendStringInfoChar(&vector_str, '[');
+	for (int i = 0; i < dim; i++)
+	{
+		if (i > 0)
+			appendStringInfoChar(&vector_str, ',');
+		appendStringInfo(&vector_str, "%f", embedding[i]);
+	}
+	appendStringInfoChar(&vector_str, ']');
+
+	return vector_str.data;
+}
+
+/*
+ * Embed with the given model for the rest of the transaction
+ *
+ * Providers read pgedge_vectorizer.model when they build a request, so a
+ * transaction-local setting switches them over and is undone at commit
+ * or abort.
+ */
+static void
+set_embedding_model(const char *model)
+{
+	if (strcmp(model, pgedge_vectorizer_model) == 0)
+		return;
+
+	if (SPI_execute(psprintf(
+			"SELECT set_config('pgedge_vectorizer.model', %s, true)",
+			quote_literal_cstr(model)),
+			false, 0) != SPI_OK_SELECT)
+		elog(ERROR, "Failed to switch to embedding model %s", model);
+}
+
+/*
+ * Write back the embeddings of one batch
+ *
+ * Items are grouped by chunk table, since a batch may mix several; a
+ * chunk queued twice in the same batch is written once.
+ */
+static void
+store_batch_embeddings(int n, const int64 *chunk_ids, char **chunk_tables,
+					   VectorTarget **targets, const char **contents,
+					   const bool *sparse_only, float **embeddings, int dim)
+{
+	bool	   *grouped = palloc0(n * sizeof(bool));
+	int64	   *g_chunk_ids = palloc(n * sizeof(int64));
+	const char **g_contents = palloc(n * sizeof(char *));
+	bool	   *g_sparse_only = palloc(n * sizeof(bool));
+	float	  **g_embeddings = palloc(n * sizeof(float *));
+
+	for (int first = 0; first < n; first++)
+	{
+		int			ng = 0;
+
+		if (grouped[first])
+			continue;
+
+		for (int i = first; i < n; i++)
+		{
+			bool		dup = false;
+
+			if (grouped[i] || strcmp(chunk_tables[i], chunk_tables[first]) != 0)
+				continue;
+			grouped[i] = true;
+
+			for (int j = 0; j < ng; j++)
+			{
+				if (g_chunk_ids[j] == chunk_ids[i])
+				{
+					dup = true;
+					break;
+				}
+			}
+			if (dup)
+				continue;
+
+			g_chunk_ids[ng] = chunk_ids[i];
+			g_contents[ng] = contents[i];
+			g_sparse_only[ng] = sparse_only[i];
+			g_embeddings[ng] = embeddings[i];
+			ng++;
+		}
+
+		if (targets[first]->embedding_column != NULL)
+			store_direct_embeddings(targets[first], ng, g_chunk_ids,
+									g_sparse_only, g_embeddings, dim);
+		else
+			store_chunk_table_embeddings(chunk_tables[first],
+										 targets[first]->embedding_table,
+										 ng, g_chunk_ids, g_contents, g_sparse_only,
+										 g_embeddings, dim);
+	}
+
+	pfree(grouped);
+	pfree(g_chunk_ids);
+	pfree(g_contents);
+	pfree(g_sparse_only);
+	pfree(g_embeddings);
+}
+
+/*
+ * Write back the embeddings of the chunks of one chunk table
+ *
+ * With pgedge_vectorizer.enable_hybrid the BM25 sparse vectors are
+ * computed first, so that the dense and sparse vectors of every chunk go
+ * out in a single set-based statement: an UPDATE ... FROM (VALUES ...) of
+ * the chunk table, or an INSERT into the separate embeddings table created
+ * with embedding_storage => 'table'.  Each chunk row thus gets one new
+ * version per pass instead of one per vector.  A NULL dense vector
+ * (sparse-only items) leaves the stored one in place.
+ *
+ * The UPDATE targets the partition holding each chunk directly, so a
+ * hash-partitioned chunk table gets one statement per partition touched
+ * and never scans the other partitions' indexes.
+ */
+static void
+store_chunk_table_embeddings(const char *chunk_table, const char *embedding_table,
+							 int n, const int64 *chunk_ids, const char **contents,
+							 const bool *sparse_only, float **embeddings, int dim)
+{
+	int		   *token_counts = palloc0(n * sizeof(int));
+	bool	   *found = palloc0(n * sizeof(bool));
+	bool	   *is_first_process = palloc(n * sizeof(bool));
+	char	  **relations = palloc0(n * sizeof(char *));
+	char	  **values = palloc0(n * sizeof(char *));
+	bool	   *written = palloc0(n * sizeof(bool));
+	BM25Term  **tokens = palloc0(n * sizeof(BM25Term *));
+	int		   *ntokens = palloc0(n * sizeof(int));
+	HTAB	   *idf_htab = NULL;
+	float8		avg_doc_len = 1.0;
+	StringInfoData sql;
+	int			ret;
+
+	for (int i = 0; i < n; i++)
+	{
+		if (sparse_only[i] && !pgedge_vectorizer_enable_hybrid)
+			elog(ERROR, "cannot process sparse-only queue item while pgedge_vectorizer.enable_hybrid is disabled");
+		is_first_process[i] = true;
+	}
+
+	/*
+	 * Fetch token_count, the relation (partition) holding the chunk and
+	 * whether sparse_embedding is already set (for idempotency — skip IDF
+	 * update on retry).  Chunks missing here have been deleted by a
+	 * concurrent source update.
+	 */
+	initStringInfo(&sql);
+	if (embedding_table != NULL)
+		appendStringInfo(&sql,
+						 "SELECT c.id, c.token_count, e.sparse_embedding IS NOT NULL, "
+						 "       c.tableoid::regclass::text "
+						 "FROM %s c LEFT JOIN %s e ON e.chunk_id = c.id "
+						 "WHERE c.id IN (",
+						 quote_identifier(chunk_table),
+						 quote_identifier(embedding_table));
+	else
+		appendStringInfo(&sql,
+						 "SELECT id, token_count, sparse_embedding IS NOT NULL, "
+						 "       tableoid::regclass::text "
+						 "FROM %s WHERE id IN (",
+						 quote_identifier(chunk_table));
+	for (int i = 0; i < n; i++)
+		appendStringInfo(&sql, "%s%ld", i > 0 ? "," : "", chunk_ids[i]);
+	appendStringInfoChar(&sql, ')');
+
+	ret = SPI_execute(sql.data, true, 0);
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "Failed to read chunks from table %s", chunk_table);
+
+	for (uint64 r = 0; r < SPI_processed; r++)
+	{
+		bool		isnull;
+		int64		id;
+		Datum		val;
+
+		id = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[r],
+										 SPI_tuptable->tupdesc, 1, &isnull));
+
+		for (int i = 0; i < n; i++)
+		{
+			if (chunk_ids[i] != id)
+				continue;
+
+			found[i] = true;
+
+			val = SPI_getbinval(SPI_tuptable->vals[r], SPI_tuptable->tupdesc, 2, &isnull);
+			if (!isnull)
+				token_counts[i] = DatumGetInt32(val);
+
+			val = SPI_getbinval(SPI_tuptable->vals[r], SPI_tuptable->tupdesc, 3, &isnull);
+			if (!isnull)
+				is_first_process[i] = !DatumGetBool(val);
+
+			relations[i] = SPI_getvalue(SPI_tuptable->vals[r], SPI_tuptable->tupdesc, 4);
+		}
+	}
+
+	if (pgedge_vectorizer_enable_hybrid)
+	{
+		batch_stats_stage_begin(BATCH_STAGE_BM25_IDF);
+		idf_htab = bm25_load_idf_stats(chunk_table);
+		avg_doc_len = bm25_avg_doc_len_internal(chunk_table);
+		batch_stats_stage_end(BATCH_STAGE_BM25_IDF);
+	}
+
+	/* Build one VALUES row per chunk: (id, dense, sparse) */
+	for (int i = 0; i < n; i++)
+	{
+		StringInfoData row;
+		char	   *sparse_str = NULL;
+
+		if (!found[i])
+		{
+			elog(WARNING, "Chunk " INT64_FORMAT " not found in table %s "
+				 "(may have been deleted by a concurrent source update)",
+				 chunk_ids[i], chunk_table);
+			continue;
+		}
+
+		/*
+		 * BM25 sparse vector (opt-in via pgedge_vectorizer.enable_hybrid
+		 * GUC).
+		 */
+		if (pgedge_vectorizer_enable_hybrid)
+		{
+			batch_stats_stage_begin(BATCH_STAGE_BM25_TOKENIZE);
+			tokens[i] = bm25_tokenize(contents[i], &ntokens[i]);
+			batch_stats_stage_end(BATCH_STAGE_BM25_TOKENIZE);
+
+			batch_stats_stage_begin(BATCH_STAGE_BM25_SCORE);
+			sparse_str = bm25_compute_sparse_str(tokens[i], ntokens[i],
+												 idf_htab,
+												 pgedge_vectorizer_bm25_k1,
+												 pgedge_vectorizer_bm25_b,
+												 avg_doc_len,
+												 Max(token_counts[i], 1));
+			batch_stats_stage_end(BATCH_STAGE_BM25_SCORE);
+		}
+
+		initStringInfo(&row);
+		appendStringInfo(&row, "(%ld::bigint, ", chunk_ids[i]);
+		if (!sparse_only[i])
+		{
+			char	   *vector_str = format_vector(embeddings[i], dim);
+
+			appendStringInfo(&row, "'%s'::vector, ", vector_str);
+			pfree(vector_str);
+		}
+		else
+			appendStringInfoString(&row, "NULL::vector, ");
+		if (sparse_str != NULL)
+			appendStringInfo(&row, "%s::sparsevec)", quote_literal_cstr(sparse_str));
+		else
+			appendStringInfoString(&row, "NULL::sparsevec)");
+		values[i] = row.data;
+	}
 
-				elog(WARNING, "Failed to generate embeddings for batch starting at %d: %s",
-					 batch_start, error_msg ? error_msg : "unknown error");
-			}
+	if (idf_htab != NULL)
+		hash_destroy(idf_htab);
+
+	/*
+	 * One statement per target: the embeddings table, or each relation
+	 * (the chunk table itself or one of its partitions) holding chunks
+	 */
+	for (int first = 0; first < n; first++)
+	{
+		const char *target;
+		int			nvalues = 0;
+
+		if (!found[first] || written[first])
+			continue;
+
+		target = embedding_table != NULL ?
+			quote_identifier(embedding_table) : relations[first];
+
+		resetStringInfo(&sql);
+		if (embedding_table != NULL)
+			appendStringInfo(&sql,
+							 "INSERT INTO %s AS e (chunk_id, embedding, sparse_embedding) "
+							 "VALUES ",
+							 target);
+		else
+			appendStringInfo(&sql,
+							 "UPDATE %s AS c SET "
+							 "embedding = COALESCE(v.embedding, c.embedding), "
+							 "sparse_embedding = COALESCE(v.sparse_embedding, c.sparse_embedding) "
+							 "FROM (VALUES ",
+							 target);
+
+		for (int i = first; i < n; i++)
+		{
+			if (!found[i] || written[i])
+				continue;
+			if (embedding_table == NULL && strcmp(relations[i], relations[first]) != 0)
+				continue;
+
+			appendStringInfo(&sql, "%s%s", nvalues > 0 ? ", " : "", values[i]);
+			written[i] = true;
+			nvalues++;
 		}
 
-		/* Cleanup */
-		pfree(queue_ids);
-		pfree(chunk_ids);
-		pfree(chunk_tables);
-		pfree(contents);
-		pfree(attempts);
-		pfree(max_attempts);
-		pfree(sparse_only);
+		if (embedding_table != NULL)
+			appendStringInfoString(&sql,
+								   " ON CONFLICT (chunk_id) DO UPDATE SET "
+								   "embedding = COALESCE(EXCLUDED.embedding, e.embedding), "
+								   "sparse_embedding = COALESCE(EXCLUDED.sparse_embedding, e.sparse_embedding)");
+		else
+			appendStringInfoString(&sql,
+								   ") AS v (id, embedding, sparse_embedding) "
+								   "WHERE c.id = v.id");
+
+		ret = SPI_execute(sql.data, false, 0);
+
+		if (ret != (embedding_table != NULL ? SPI_OK_INSERT : SPI_OK_UPDATE))
+			elog(ERROR, "Failed to store embeddings in table %s", target);
 	}
 
-	SPI_finish();
-	PopActiveSnapshot();
-	CommitTransactionCommand();
+	/*
+	 * Only update IDF stats the first time each chunk is processed —
+	 * retries must not increment doc_freq again.
+	 */
+	batch_stats_stage_begin(BATCH_STAGE_BM25_IDF);
+	for (int i = 0; i < n; i++)
+	{
+		if (found[i] && tokens[i] != NULL && is_first_process[i])
+			bm25_update_idf_stats(chunk_table, tokens[i], ntokens[i]);
+	}
+	batch_stats_stage_end(BATCH_STAGE_BM25_IDF);
+
+	pfree(sql.data);
+	pfree(token_counts);
+	pfree(found);
+	pfree(is_first_process);
+	pfree(relations);
+	pfree(values);
+	pfree(written);
+	pfree(tokens);
+	pfree(ntokens);
 }
 
 /*
- * Update a chunk table with the generated embedding
+ * Write back the embeddings of the rows of one direct vectorizer
+ *
+ * A direct vectorizer has one vector per source row and no chunk table,
+ * so a single UPDATE ... FROM (VALUES ...) sets the embedding column of
+ * the source table.  It keeps no sparse vector: sparse-only items have
+ * nothing left to write.  The UPDATE does not fire the vectorizer's own
+ * trigger, which only watches the text column.
  */
 static void
-update_embedding(int64 chunk_id, const char *chunk_table, const float *embedding, int dim)
+store_direct_embeddings(const VectorTarget *target, int n, const int64 *row_ids,
+						const bool *sparse_only, float **embeddings, int dim)
 {
-	StringInfoData vector_str;
-	int ret;
-
-	/* Build vector string: [0.1, 0.2, 0.3, ...] */
-	initStringInfo(&vector_str);
-	appendStringInfoChar(&vector_str, '[');
-	for (int i = 0; i < dim; i++)
+	StringInfoData sql;
+	int			nvalues = 0;
+	int			ret;
+
+	/* source_table is a regclass text and already quoted */
+	initStringInfo(&sql);
+	appendStringInfo(&sql,
+					 "UPDATE %s AS s SET %s = v.embedding FROM (VALUES ",
+					 target->source_table,
+					 quote_identifier(target->embedding_column));
+
+	for (int i = 0; i < n; i++)
 	{
-		if (i > 0)
-			appendStringInfoChar(&vector_str, ',');
-		appendStringInfo(&vector_str, "%f", embedding[i]);
-	}
-	appendStringInfoChar(&vector_str, ']');
+		char	   *vector_str;
 
-	/* Update the chunk table */
-	ret = SPI_execute(psprintf(
-		"UPDATE %s SET embedding = '%s'::vector WHERE id = %ld",
-		chunk_table, vector_str.data, chunk_id),
-		false, 0);
+		if (sparse_only[i])
+			continue;
 
-	if (ret != SPI_OK_UPDATE)
-	{
-		elog(ERROR, "Failed to update embedding in table %s for chunk %ld",
-			 chunk_table, chunk_id);
+		vector_str = format_vector(embeddings[i], dim);
+		appendStringInfo(&sql, "%s(%ld::bigint, '%s'::vector)",
+						 nvalues > 0 ? ", " : "", row_ids[i], vector_str);
+		pfree(vector_str);
+		nvalues++;
 	}
 
-	if (SPI_processed == 0)
+	appendStringInfo(&sql, ") AS v (id, embedding) WHERE s.%s = v.id",
+					 quote_identifier(target->source_pk));
+
+	if (nvalues > 0)
 	{
-		elog(WARNING, "Chunk " INT64_FORMAT " not found in table %s "
-			 "(may have been deleted by a concurrent source update)",
-			 chunk_id, chunk_table);
+		ret = SPI_execute(sql.data, false, 0);
+		if (ret != SPI_OK_UPDATE)
+			elog(ERROR, "Failed to store embeddings in table %s",
+				 target->source_table);
 	}
 
-	pfree(vector_str.data);
+	pfree(sql.data);
 }
 
 /*
@@ -915,3 +2303,520 @@ cleanup_completed_items(int worker_id)
 	PopActiveSnapshot();
 	CommitTransactionCommand();
 }
+
+/*
+ * Run a utility statement at top level, outside a transaction block
+ *
+ * CREATE INDEX CONCURRENTLY refuses to run through SPI or in a transaction
+ * block, and commits and starts transactions of its own.  The parse tree
+ * therefore lives in the caller's context rather than in the transaction.
+ */
+static void
+run_toplevel_statement(const char *sql, MemoryContext context)
+{
+	List	   *parsetree_list;
+	RawStmt    *raw;
+	PlannedStmt *stmt;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	pgstat_report_activity(STATE_RUNNING, sql);
+
+	MemoryContextSwitchTo(context);
+	parsetree_list = pg_parse_query(sql);
+	raw = linitial_node(RawStmt, parsetree_list);
+
+	stmt = makeNode(PlannedStmt);
+	stmt->commandType = CMD_UTILITY;
+	stmt->canSetTag = true;
+	stmt->utilityStmt = raw->stmt;
+	stmt->stmt_location = raw->stmt_location;
+	stmt->stmt_len = raw->stmt_len;
+
+	ProcessUtility(stmt, sql, false, PROCESS_UTILITY_TOPLEVEL,
+				   NULL, NULL, None_Receiver, NULL);
+
+	/* A concurrent build pops the snapshot before its first commit */
+	if (ActiveSnapshotSet())
+		PopActiveSnapshot();
+	CommitTransactionCommand();
+	pgstat_report_activity(STATE_RUNNING, "processing embedding queue");
+}
+
+/*
+ * Build vector indexes that were deferred during a bulk load
+ *
+ * Chunk tables enabled with defer_indexes have no HNSW indexes while their
+ * initial backfill drains, so embedding updates skip the incremental graph
+ * insert.  Once neither the queue table nor the hot queue holds a chunk of
+ * the table, the first worker of its database builds the indexes with
+ * CREATE INDEX CONCURRENTLY, so writes to the chunk table carry on during
+ * the build, and the table switches to incremental index maintenance.
+ */
+static void
+build_deferred_indexes(int worker_id)
+{
+	static MemoryContext build_context = NULL;
+	MemoryContext oldcontext;
+	List	   *statements = NIL;
+	StringInfoData ids;
+	char		build_workers[16];
+	int			n_tables = 0;
+	int			ret;
+	time_t		now;
+	ListCell   *lc;
+
+	now = time(NULL);
+	if (last_index_check_time > 0 &&
+		(now - last_index_check_time) < INDEX_CHECK_INTERVAL)
+		return;
+
+	last_index_check_time = now;
+
+	/* Reset here rather than at the end: a failed build leaves it behind */
+	if (build_context == NULL)
+		build_context = AllocSetContextCreate(TopMemoryContext,
+											  "pgedge_vectorizer index builds",
+											  ALLOCSET_DEFAULT_SIZES);
+	MemoryContextReset(build_context);
+
+	oldcontext = MemoryContextSwitchTo(build_context);
+	initStringInfo(&ids);
+	MemoryContextSwitchTo(oldcontext);
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	SPI_connect();
+
+	ret = SPI_execute(
+		"SELECT vectorizer_id, statement "
+		"FROM pgedge_vectorizer.deferred_index_statements() "
+		"WHERE EXISTS (SELECT 1 FROM pgedge_vectorizer.vectorizers "
+		"              WHERE indexes_deferred)",
+		true, 0);
+
+	if (ret == SPI_OK_SELECT && SPI_processed > 0)
+	{
+		char	   *previous_id = NULL;
+
+		oldcontext = MemoryContextSwitchTo(build_context);
+		for (uint64 i = 0; i < SPI_processed; i++)
+		{
+			char	   *id = SPI_getvalue(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 1);
+
+			statements = lappend(statements,
+								 SPI_getvalue(SPI_tuptable->vals[i],
+											  SPI_tuptable->tupdesc, 2));
+			if (previous_id == NULL || strcmp(id, previous_id) != 0)
+			{
+				appendStringInfo(&ids, "%s%s", n_tables > 0 ? ", " : "", id);
+				n_tables++;
+			}
+			previous_id = id;
+		}
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	SPI_finish();
+
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+
+	if (statements == NIL)
+		return;
+
+	snprintf(build_workers, sizeof(build_workers), "%d",
+			 pgedge_vectorizer_index_build_workers);
+	SetConfigOption("max_parallel_maintenance_workers", build_workers,
+					PGC_SUSET, PGC_S_SESSION);
+
+	foreach(lc, statements)
+		run_toplevel_statement((const char *) lfirst(lc), build_context);
+
+	/* Switch the tables to incremental index maintenance */
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	SPI_connect();
+
+	ret = SPI_execute(psprintf(
+		"UPDATE pgedge_vectorizer.vectorizers SET indexes_deferred = FALSE "
+		"WHERE id IN (%s)", ids.data),
+		false, 0);
+	if (ret != SPI_OK_UPDATE)
+		elog(ERROR, "Failed to clear the deferred index flags");
+
+	SPI_finish();
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+
+	elog(LOG, "pgedge_vectorizer worker %d: built deferred vector indexes for %d chunk tables",
+		 worker_id + 1, n_tables);
+}
+
+/*
+ * Re-embed chunks for a model migration
+ *
+ * start_model_migration() adds an embedding_next column for the new model
+ * next to the embeddings searches use.  Workers fill it only when they
+ * found no new chunks to embed, one batch of
+ * pgedge_vectorizer.migration_batch_size chunks per poll interval, so a
+ * migration takes spare provider capacity and never delays the queue.
+ * The row lock on the migration keeps the other workers of the database
+ * off the same chunks.  Migrations still re-embedding the table come
+ * first; ready ones only get the chunks written since, until
+ * finish_model_migration() switches them over.
+ */
+static void
+migrate_embeddings(int worker_id)
+{
+	int ret;
+
+	if (pgedge_vectorizer_migration_batch_size <= 0)
+		return;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	SPI_connect();
+
+	ret = SPI_execute(
+		"SELECT chunk_table, model, dimension, last_chunk_id, "
+		"       status = 'ready' "
+		"FROM pgedge_vectorizer.model_migrations "
+		"WHERE status IN ('running', 'ready') "
+		"ORDER BY status = 'ready', started_at "
+		"LIMIT 1 "
+		"FOR UPDATE SKIP LOCKED",
+		false, 1);
+
+	if (ret == SPI_OK_SELECT && SPI_processed == 1)
+	{
+		HeapTuple	tuple = SPI_tuptable->vals[0];
+		TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+		bool		isnull;
+
+		migrate_chunk_batch(worker_id,
+							SPI_getvalue(tuple, tupdesc, 1),
+							SPI_getvalue(tuple, tupdesc, 2),
+							DatumGetInt32(SPI_getbinval(tuple, tupdesc, 3, &isnull)),
+							DatumGetInt64(SPI_getbinval(tuple, tupdesc, 4, &isnull)),
+							DatumGetBool(SPI_getbinval(tuple, tupdesc, 5, &isnull)));
+	}
+
+	SPI_finish();
+
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+}
+
+/*
+ * Embed the next chunks of a model migration with its model
+ *
+ * The chunks are walked in id order from last_chunk_id, the position
+ * saved in the migration; chunks added since it started get higher ids
+ * and are reached on the way.  At the end one more pass from the start
+ * picks up anything left behind, and when that finds nothing the
+ * migration moves on to 'indexing', with last_chunk_id at the last chunk,
+ * for build_migration_indexes().  A ready migration is only walked on from
+ * there, for the chunks written since.  A failed provider call is retried
+ * on the next pass; a model of the wrong dimension fails the migration.
+ */
+static void
+migrate_chunk_batch(int worker_id, const char *chunk_table, const char *model,
+					int migration_dim, int64 last_chunk_id, bool ready)
+{
+	VectorTarget *target = lookup_vector_target(chunk_table);
+	const char *vector_table;
+	EmbeddingProvider *provider;
+	int64	   *chunk_ids;
+	const char **contents;
+	char	  **chunk_tables;
+	float	  **embeddings;
+	int			n_chunks = 0;
+	int			dim = 0;
+	char	   *error_msg = NULL;
+	StringInfoData sql;
+	int			ret;
+
+	vector_table = quote_identifier(target->embedding_table != NULL ?
+									target->embedding_table : chunk_table);
+
+	for (int pass = (last_chunk_id > 0 || ready ? 0 : 1);
+		 pass < (ready ? 1 : 2) && n_chunks == 0; pass++)
+	{
+		ret = SPI_execute(psprintf(
+			"SELECT chunk_id, content "
+			"FROM pgedge_vectorizer.model_migration_chunks(%s, %ld, %d)",
+			quote_literal_cstr(chunk_table),
+			pass == 0 ? last_chunk_id : 0,
+			pgedge_vectorizer_migration_batch_size),
+			true, 0);
+		if (ret != SPI_OK_SELECT)
+			elog(ERROR, "Failed to read chunks to migrate from table %s", chunk_table);
+
+		n_chunks = SPI_processed;
+	}
+
+	if (n_chunks == 0)
+	{
+		if (ready)
+			return;
+
+		/* Every chunk has its new embedding: index them for the switch-over */
+		SPI_execute(psprintf(
+			"UPDATE pgedge_vectorizer.model_migrations "
+			"SET status = 'indexing', "
+			"    last_chunk_id = (SELECT COALESCE(max(id), 0) FROM %s) "
+			"WHERE chunk_table = %s",
+			quote_identifier(chunk_table), quote_literal_cstr(chunk_table)),
+			false, 0);
+
+		elog(LOG, "pgedge_vectorizer worker %d: model migration of %s to %s has re-embedded every chunk",
+			 worker_id + 1, chunk_table, model);
+		return;
+	}
+
+	chunk_ids = palloc(n_chunks * sizeof(int64));
+	contents = palloc(n_chunks * sizeof(char *));
+	chunk_tables = palloc(n_chunks * sizeof(char *));
+
+	for (int i = 0; i < n_chunks; i++)
+	{
+		bool isnull;
+		Datum val;
+
+		/* Migrations are charged to the chunk table they re-embed */
+		chunk_tables[i] = (char *) chunk_table;
+
+		val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 1, &isnull);
+		chunk_ids[i] = DatumGetInt64(val);
+
+		val = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 2, &isnull);
+		contents[i] = TextDatumGetCString(val);
+	}
+
+	provider = get_current_provider();
+	if (provider == NULL)
+		elog(ERROR, "No provider configured");
+
+	if (!provider->init(&error_msg))
+		elog(ERROR, "Failed to initialize provider: %s",
+			 error_msg ? error_msg : "unknown error");
+
+	set_embedding_model(model);
+	usage_stats_begin_call();
+	embeddings = provider->generate_batch(contents, n_chunks, &dim, &error_msg);
+	usage_stats_end_call(n_chunks, chunk_tables, contents);
+
+	if (embeddings == NULL)
+	{
+		elog(WARNING, "Failed to generate embeddings with model %s for the migration of %s: %s",
+			 model, chunk_table, error_msg ? error_msg : "unknown error");
+		return;
+	}
+
+	if (dim != migration_dim)
+	{
+		elog(WARNING, "Model %s returned %d dimensions, but the migration of %s expects %d",
+			 model, dim, chunk_table, migration_dim);
+		SPI_execute(psprintf(
+			"UPDATE pgedge_vectorizer.model_migrations "
+			"SET status = 'failed', "
+			"    error_message = 'Dimension mismatch: model=%d, migration=%d' "
+			"WHERE chunk_table = %s",
+			dim, migration_dim, quote_literal_cstr(chunk_table)),
+			false, 0);
+		return;
+	}
+
+	/*
+	 * One statement for the batch.  Chunk rows only get embedding_next; in
+	 * the embeddings table a chunk not embedded by the current model yet
+	 * has no row, and one is added for it.
+	 */
+	initStringInfo(&sql);
+	if (target->embedding_table != NULL)
+		appendStringInfo(&sql,
+						 "INSERT INTO %s AS e (chunk_id, embedding_next) "
+						 "SELECT v.id, v.embedding FROM (VALUES ",
+						 vector_table);
+	else
+		appendStringInfo(&sql,
+						 "UPDATE %s AS c SET embedding_next = v.embedding "
+						 "FROM (VALUES ",
+						 vector_table);
+
+	for (int i = 0; i < n_chunks; i++)
+	{
+		char	   *vector_str = format_vector(embeddings[i], dim);
+
+		appendStringInfo(&sql, "%s(%ld::bigint, '%s'::vector)",
+						 i > 0 ? ", " : "", chunk_ids[i], vector_str);
+		pfree(vector_str);
+		pfree(embeddings[i]);
+	}
+	pfree(embeddings);
+
+	/* Chunks deleted by a concurrent source update are skipped */
+	if (target->embedding_table != NULL)
+		appendStringInfo(&sql,
+						 ") AS v (id, embedding) "
+						 "WHERE EXISTS (SELECT 1 FROM %s c WHERE c.id = v.id) "
+						 "ON CONFLICT (chunk_id) DO UPDATE SET "
+						 "embedding_next = EXCLUDED.embedding_next",
+						 quote_identifier(chunk_table));
+	else
+		appendStringInfoString(&sql,
+							   ") AS v (id, embedding) WHERE c.id = v.id");
+
+	ret = SPI_execute(sql.data, false, 0);
+	if (ret != (target->embedding_table != NULL ? SPI_OK_INSERT : SPI_OK_UPDATE))
+		elog(ERROR, "Failed to store migrated embeddings in table %s", vector_table);
+
+	SPI_execute(psprintf(
+		"UPDATE pgedge_vectorizer.model_migrations "
+		"SET last_chunk_id = %ld "
+		"WHERE chunk_table = %s",
+		chunk_ids[n_chunks - 1], quote_literal_cstr(chunk_table)),
+		false, 0);
+
+	elog(DEBUG1, "Worker %d re-embedded %d chunks of %s with model %s",
+		 worker_id + 1, n_chunks, chunk_table, model);
+
+	pfree(sql.data);
+	pfree(chunk_ids);
+	pfree(contents);
+	pfree(chunk_tables);
+}
+
+/*
+ * Build the embedding_next indexes of re-embedded model migrations
+ *
+ * Like the deferred indexes, they are built with CREATE INDEX
+ * CONCURRENTLY outside any transaction block, so the chunk table keeps
+ * taking writes meanwhile, and the migration row is not locked for the
+ * build.  An invalid index left by a failed build is dropped and built
+ * again; the migration only becomes ready once its index is valid.
+ */
+static void
+build_migration_indexes(int worker_id)
+{
+	static MemoryContext build_context = NULL;
+	MemoryContext oldcontext;
+	List	   *statements = NIL;
+	StringInfoData tables;
+	char		build_workers[16];
+	int			n_tables = 0;
+	int			ret;
+	time_t		now;
+	ListCell   *lc;
+
+	now = time(NULL);
+	if (last_migration_index_time > 0 &&
+		(now - last_migration_index_time) < INDEX_CHECK_INTERVAL)
+		return;
+
+	last_migration_index_time = now;
+
+	/* Reset here rather than at the end: a failed build leaves it behind */
+	if (build_context == NULL)
+		build_context = AllocSetContextCreate(TopMemoryContext,
+											  "pgedge_vectorizer migration index builds",
+											  ALLOCSET_DEFAULT_SIZES);
+	MemoryContextReset(build_context);
+
+	oldcontext = MemoryContextSwitchTo(build_context);
+	initStringInfo(&tables);
+	MemoryContextSwitchTo(oldcontext);
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	SPI_connect();
+
+	ret = SPI_execute(
+		"SELECT m.chunk_table, "
+		"       COALESCE(v.embedding_table, v.chunk_table), "
+		"       NOT x.indisvalid "
+		"FROM pgedge_vectorizer.model_migrations m "
+		"JOIN pgedge_vectorizer.vectorizers v ON v.chunk_table = m.chunk_table "
+		"LEFT JOIN pg_index x ON x.indexrelid = "
+		"    to_regclass(quote_ident(m.chunk_table || '_embedding_next_idx')) "
+		"WHERE m.status = 'indexing' "
+		"ORDER BY m.started_at",
+		true, 0);
+
+	if (ret == SPI_OK_SELECT && SPI_processed > 0)
+	{
+		oldcontext = MemoryContextSwitchTo(build_context);
+		for (uint64 i = 0; i < SPI_processed; i++)
+		{
+			HeapTuple	tuple = SPI_tuptable->vals[i];
+			TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+			char	   *chunk_table = SPI_getvalue(tuple, tupdesc, 1);
+			const char *index_name;
+			bool		isnull;
+			bool		invalid;
+
+			index_name = quote_identifier(psprintf("%s_embedding_next_idx", chunk_table));
+			invalid = DatumGetBool(SPI_getbinval(tuple, tupdesc, 3, &isnull));
+
+			if (!isnull && invalid)
+				statements = lappend(statements,
+									 psprintf("DROP INDEX CONCURRENTLY IF EXISTS %s",
+											  index_name));
+			statements = lappend(statements,
+								 psprintf("CREATE INDEX CONCURRENTLY IF NOT EXISTS %s ON %s "
+										  "USING hnsw (embedding_next vector_cosine_ops)",
+										  index_name,
+										  quote_identifier(SPI_getvalue(tuple, tupdesc, 2))));
+			appendStringInfo(&tables, "%s%s", n_tables > 0 ? ", " : "",
+							 quote_literal_cstr(chunk_table));
+			n_tables++;
+		}
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	SPI_finish();
+
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+
+	if (statements == NIL)
+		return;
+
+	snprintf(build_workers, sizeof(build_workers), "%d",
+			 pgedge_vectorizer_index_build_workers);
+	SetConfigOption("max_parallel_maintenance_workers", build_workers,
+					PGC_SUSET, PGC_S_SESSION);
+
+	foreach(lc, statements)
+		run_toplevel_statement((const char *) lfirst(lc), build_context);
+
+	/* A migration cancelled during the build is gone and stays gone */
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	SPI_connect();
+
+	ret = SPI_execute(psprintf(
+		"UPDATE pgedge_vectorizer.model_migrations "
+		"SET status = 'ready', ready_at = NOW() "
+		"WHERE status = 'indexing' AND chunk_table IN (%s)", tables.data),
+		false, 0);
+	if (ret != SPI_OK_UPDATE)
+		elog(ERROR, "Failed to mark the model migrations ready");
+
+	SPI_finish();
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+
+	elog(LOG, "pgedge_vectorizer worker %d: model migrations of %d chunk tables are ready to finish",
+		 worker_id + 1, n_tables);
+}
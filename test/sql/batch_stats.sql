@@ -0,0 +1,7 @@
+-- Batch statistics test
+-- Stage timings of the worker batches
+
+-- Batch statistics: one row of counters, at most 128 recent batches
+SELECT pgedge_vectorizer.reset_batch_stats();
+SELECT count(*) FROM pgedge_vectorizer.batch_stats();
+SELECT count(*) <= 128 AS bounded FROM pgedge_vectorizer.recent_batches();
@@ -0,0 +1,29 @@
+-- Benchmark functions test
+-- This test verifies the micro-benchmark functions run every kernel
+
+-- Generated corpora are deterministic and cut to the requested size
+SELECT
+    length(pgedge_vectorizer.bench_corpus('prose', 1000)) AS prose_len,
+    length(pgedge_vectorizer.bench_corpus('code', 1000)) AS code_len,
+    pgedge_vectorizer.bench_corpus('markdown', 500) =
+        pgedge_vectorizer.bench_corpus('markdown', 500) AS deterministic;
+
+-- Every kernel runs over a generated corpus and reports results
+SELECT
+    k AS kernel,
+    b.input_bytes > 0 AS has_input,
+    b.items_per_iteration > 0 AS produced_items,
+    b.total_ms >= 0 AS timed,
+    b.retained_context_bytes BETWEEN 1 AND b.peak_context_bytes AS measured_memory
+FROM unnest(ARRAY['token_based', 'markdown', 'hybrid', 'bm25_tokenize',
+                  'openai_parse', 'ollama_parse']) AS k,
+     LATERAL pgedge_vectorizer.bench_kernel(k, 2, NULL, NULL, 8192) AS b;
+
+-- A supplied corpus is used as-is
+SELECT input_bytes, items_per_iteration
+FROM pgedge_vectorizer.bench_kernel('bm25_tokenize', 1, 'vector search database');
+
+-- Invalid arguments are rejected
+SELECT * FROM pgedge_vectorizer.bench_kernel('nonexistent', 1);
+SELECT * FROM pgedge_vectorizer.bench_kernel('token_based', 0);
+SELECT pgedge_vectorizer.bench_corpus('poetry', 100);
@@ -0,0 +1,109 @@
+-- Chunk offsets storage test
+-- This test verifies chunk tables that store offsets into the source column
+
+-- chunk_slice returns a 0-based byte range
+SELECT pgedge_vectorizer.chunk_slice('hello world', 6, 5) AS slice;
+
+-- Every chunk is located in the untrimmed source
+WITH o AS (
+    SELECT d.doc, x.*
+    FROM (SELECT '  ' || repeat('The quick brown fox jumps over the lazy dog. ', 10) AS doc) d,
+         pgedge_vectorizer.chunk_text_offsets(d.doc, 'token_based', 20, 5) x
+)
+SELECT
+    array_length(chunks, 1) > 1 AS multiple_chunks,
+    start_offsets[1] AS first_offset,
+    (SELECT bool_and(pgedge_vectorizer.chunk_slice(doc, start_offsets[i], lengths[i]) = chunks[i])
+     FROM generate_subscripts(chunks, 1) AS i) AS all_located
+FROM o;
+
+-- Chunks rewritten by the chunker are not located
+SELECT start_offsets[1] IS NULL AS stored_as_text
+FROM pgedge_vectorizer.chunk_text_offsets(
+    'caf' || chr(233) || ' au lait', 'token_based', 100, 0);
+
+-- Invalid storage mode
+CREATE TABLE offset_docs (
+    id BIGINT PRIMARY KEY,
+    body TEXT
+);
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'offset_docs'::regclass,
+    'body',
+    'token_based',
+    20,
+    5,
+    1536,
+    chunk_storage := 'bogus'
+);
+
+-- Existing rows are chunked into offsets
+INSERT INTO offset_docs VALUES
+    (1, repeat('Offsets keep the chunk table small. ', 8));
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'offset_docs'::regclass,
+    'body',
+    'token_based',
+    20,
+    5,
+    1536,
+    chunk_storage := 'offsets'
+);
+
+-- New rows go through the trigger
+INSERT INTO offset_docs VALUES
+    (2, repeat('Large documents are stored only once. ', 8));
+
+SELECT chunk_storage
+FROM pgedge_vectorizer.vectorizers
+WHERE chunk_table = 'offset_docs_body_chunks';
+
+-- No chunk or queue row keeps a copy of the text
+SELECT
+    COUNT(*) > 2 AS chunks_created,
+    COUNT(*) FILTER (WHERE content IS NOT NULL) AS chunks_with_text,
+    COUNT(*) FILTER (WHERE start_offset IS NULL) AS chunks_without_offsets
+FROM offset_docs_body_chunks;
+
+SELECT
+    COUNT(*) > 2 AS items_queued,
+    COUNT(*) FILTER (WHERE content IS NOT NULL) AS items_with_text
+FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'offset_docs_body_chunks';
+
+-- Rebuilt chunks match the chunker output
+SELECT
+    d.id,
+    array_agg(pgedge_vectorizer.chunk_content('offset_docs_body_chunks', c.id)
+              ORDER BY c.chunk_index)
+        = pgedge_vectorizer.chunk_text(trim(d.body), 'token_based', 20, 5) AS matches
+FROM offset_docs d
+JOIN offset_docs_body_chunks c ON c.source_id = d.id
+GROUP BY d.id
+ORDER BY d.id;
+
+-- A batch read returns the same text, leaving out chunks that do not exist
+WITH batch AS (
+    SELECT array_agg(id ORDER BY id) || ARRAY[-1::BIGINT] AS ids
+    FROM offset_docs_body_chunks
+)
+SELECT
+    COUNT(*) = cardinality(ids) - 1 AS all_found,
+    bool_and(cc.content = pgedge_vectorizer.chunk_content('offset_docs_body_chunks', ids[cc.item])) AS matches
+FROM batch,
+     pgedge_vectorizer.chunk_contents(
+         array_fill('offset_docs_body_chunks'::TEXT, ARRAY[cardinality(ids)]), ids) cc
+GROUP BY ids;
+
+-- Updating the source rebuilds its chunks
+UPDATE offset_docs SET body = 'A short replacement.' WHERE id = 2;
+
+SELECT pgedge_vectorizer.chunk_content('offset_docs_body_chunks', c.id) AS chunk
+FROM offset_docs_body_chunks c
+WHERE c.source_id = 2;
+
+-- Clean up
+SELECT pgedge_vectorizer.disable_vectorization('offset_docs'::regclass, 'body', true);
+DROP TABLE offset_docs;
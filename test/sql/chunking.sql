@@ -83,3 +83,68 @@ SELECT
         ),
         1
     ) >= 1 AS large_overlap_works;
+
+-- Test non-ASCII runs collapse to a single space
+SELECT
+    (pgedge_vectorizer.chunk_text(
+        repeat('caf' || chr(233) || ' ', 20),
+        'token_based',
+        1000,
+        0
+    ))[1] = repeat('caf  ', 20) AS non_ascii_stripped;
+
+-- Test sentence chunking packs whole sentences
+SELECT chunk
+FROM unnest(
+    pgedge_vectorizer.chunk_text(
+        'First sentence here. Second sentence here. Third sentence here.',
+        'sentence',
+        12,
+        0
+    )
+) AS chunk;
+
+-- Test sentence chunking overlaps by whole sentences
+SELECT chunk
+FROM unnest(
+    pgedge_vectorizer.chunk_text(
+        'First sentence here. Second sentence here. Third sentence here.',
+        'sentence',
+        12,
+        6
+    )
+) AS chunk;
+
+-- Test recursive chunking splits paragraphs, then sentences
+SELECT chunk
+FROM unnest(
+    pgedge_vectorizer.chunk_text(
+        E'Para one is short.\n\nPara two has two sentences. Here is the second.',
+        'recursive',
+        10,
+        0
+    )
+) AS chunk;
+
+-- Test recursive chunking keeps text that fits in one chunk
+SELECT
+    array_length(
+        pgedge_vectorizer.chunk_text(
+            E'Para one is short.\n\nPara two has two sentences. Here is the second.',
+            'recursive',
+            100,
+            0
+        ),
+        1
+    ) AS recursive_chunks;
+
+-- Test a word longer than the chunk size is cut by token count
+SELECT chunk
+FROM unnest(
+    pgedge_vectorizer.chunk_text(
+        'Antidisestablishmentarianism',
+        'sentence',
+        3,
+        0
+    )
+) AS chunk;
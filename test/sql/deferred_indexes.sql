@@ -0,0 +1,58 @@
+-- Deferred index test
+-- This test verifies bulk loads that build the vector indexes afterwards
+
+CREATE TABLE deferred_docs (
+    id BIGINT PRIMARY KEY,
+    content TEXT
+);
+
+INSERT INTO deferred_docs VALUES
+    (1, 'A document loaded before vectorization was enabled.');
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'deferred_docs'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    1536,
+    defer_indexes := true
+);
+
+-- No HNSW index exists while the backfill is queued
+SELECT indexname FROM pg_indexes
+WHERE tablename = 'deferred_docs_content_chunks'
+ORDER BY indexname;
+
+SELECT indexes_deferred
+FROM pgedge_vectorizer.vectorizers
+WHERE chunk_table = 'deferred_docs_content_chunks';
+
+-- Nothing is built while queue items are outstanding
+SELECT pgedge_vectorizer.build_deferred_indexes('deferred_docs_content_chunks');
+
+-- Workers build them concurrently, once the backlog has drained
+SELECT count(*) FROM pgedge_vectorizer.deferred_index_statements('deferred_docs_content_chunks');
+
+SELECT statement
+FROM pgedge_vectorizer.deferred_index_statements('deferred_docs_content_chunks', force := true);
+
+-- force builds the indexes regardless of the queue
+SELECT pgedge_vectorizer.build_deferred_indexes('deferred_docs_content_chunks',
+                                                force := true,
+                                                parallel_workers := 0);
+
+SELECT indexname FROM pg_indexes
+WHERE tablename = 'deferred_docs_content_chunks'
+ORDER BY indexname;
+
+SELECT indexes_deferred
+FROM pgedge_vectorizer.vectorizers
+WHERE chunk_table = 'deferred_docs_content_chunks';
+
+-- Nothing is left to build
+SELECT pgedge_vectorizer.build_deferred_indexes(force := true);
+
+-- Clean up
+SELECT pgedge_vectorizer.disable_vectorization('deferred_docs'::regclass, 'content', true);
+DROP TABLE deferred_docs;
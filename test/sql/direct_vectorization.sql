@@ -0,0 +1,89 @@
+-- Direct vectorization test
+-- This test verifies short text columns embedded into the source table itself
+
+CREATE TABLE products (
+    id SERIAL PRIMARY KEY,
+    title TEXT
+);
+
+INSERT INTO products (title) VALUES
+    ('Stainless steel water bottle'),
+    ('   ');
+
+-- Only rows with text are queued, keyed by their primary key
+SELECT pgedge_vectorizer.enable_direct_vectorization('products'::regclass, 'title', 3);
+
+-- No chunk table: the embedding column and its index are on the source table
+SELECT to_regclass('products_title_chunks');
+
+SELECT format_type(atttypid, atttypmod) FROM pg_attribute
+WHERE attrelid = 'products'::regclass AND attname = 'title_embedding';
+
+SELECT indexname FROM pg_indexes
+WHERE tablename = 'products'
+ORDER BY indexname COLLATE "C";
+
+SELECT chunk_table, source_pk, embedding_column
+FROM pgedge_vectorizer.vectorizers
+WHERE source_table = 'products';
+
+SELECT chunk_id, chunk_table, content FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'products_title_embedding'
+ORDER BY chunk_id;
+
+-- The worker reads the text from the source row
+SELECT pgedge_vectorizer.chunk_content('products_title_embedding', 1);
+
+-- Stand in for the worker; writing the embedding does not requeue the row
+UPDATE products SET title_embedding = '[1,0,0]' WHERE id = 1;
+
+-- Unchanged text keeps its embedding
+UPDATE products SET title = ' Stainless steel water bottle ' WHERE id = 1;
+SELECT title_embedding FROM products WHERE id = 1;
+
+-- Changed text clears the embedding and queues the row again
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'products_title_embedding';
+UPDATE products SET title = 'Insulated water bottle' WHERE id = 1;
+INSERT INTO products (title) VALUES ('Bamboo cutting board');
+
+SELECT id, title_embedding IS NULL AS needs_embedding FROM products ORDER BY id;
+
+SELECT chunk_id, content FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'products_title_embedding'
+ORDER BY chunk_id;
+
+-- Rows already queued are not queued twice
+SELECT pgedge_vectorizer.reprocess_chunks('products_title_embedding');
+
+-- A chunked vectorizer cannot take over the column
+SELECT pgedge_vectorizer.enable_vectorization(
+    'products'::regclass,
+    'title',
+    embedding_dimension := 3
+);
+
+-- There are no chunks for hybrid search
+SET pgedge_vectorizer.enable_hybrid = true;
+SELECT * FROM pgedge_vectorizer.hybrid_search('products'::regclass, 'water bottle');
+RESET pgedge_vectorizer.enable_hybrid;
+
+-- Queue items carry integer row identifiers only
+CREATE TABLE tags (
+    name TEXT PRIMARY KEY,
+    label TEXT
+);
+
+SELECT pgedge_vectorizer.enable_direct_vectorization('tags'::regclass, 'label', 3);
+
+DROP TABLE tags;
+
+-- Clean up
+SELECT pgedge_vectorizer.disable_vectorization('products'::regclass, 'title', true);
+
+SELECT count(*) FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'products_title_embedding';
+
+SELECT count(*) FROM pg_attribute
+WHERE attrelid = 'products'::regclass AND attname = 'title_embedding';
+
+DROP TABLE products;
@@ -0,0 +1,101 @@
+-- Separate embeddings table test
+-- This test verifies chunk tables that keep their embeddings in a narrow table
+
+CREATE TABLE narrow_docs (
+    id BIGINT PRIMARY KEY,
+    content TEXT
+);
+
+INSERT INTO narrow_docs VALUES
+    (1, 'A document loaded before vectorization was enabled.');
+
+-- Invalid storage modes are rejected
+SELECT pgedge_vectorizer.enable_vectorization(
+    'narrow_docs'::regclass,
+    'content',
+    embedding_dimension := 3,
+    embedding_storage := 'columns'
+);
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'narrow_docs'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    3,
+    embedding_storage := 'table'
+);
+
+-- The chunk table has no vector columns; the embeddings table holds them
+SELECT count(*) FROM pg_attribute
+WHERE attrelid = 'narrow_docs_content_chunks'::regclass
+  AND attname IN ('embedding', 'sparse_embedding');
+
+SELECT attname FROM pg_attribute
+WHERE attrelid = 'narrow_docs_content_chunks_embeddings'::regclass
+  AND attnum > 0
+ORDER BY attnum;
+
+-- The HNSW indexes are built on the embeddings table
+SELECT indexname FROM pg_indexes
+WHERE tablename = 'narrow_docs_content_chunks_embeddings'
+ORDER BY indexname COLLATE "C";
+
+SELECT embedding_table
+FROM pgedge_vectorizer.vectorizers
+WHERE chunk_table = 'narrow_docs_content_chunks';
+
+SELECT count(*) FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'narrow_docs_content_chunks' AND status = 'pending';
+
+-- Stand in for the worker: one INSERT per chunk into the narrow table
+INSERT INTO narrow_docs_content_chunks_embeddings (chunk_id, embedding)
+SELECT id, '[1,0,0]' FROM narrow_docs_content_chunks;
+
+-- The view presents the joined shape
+SELECT source_id, chunk_index, content, embedding, sparse_embedding
+FROM narrow_docs_content_chunks_view
+ORDER BY source_id, chunk_index;
+
+-- Only chunks without embeddings are reprocessed
+INSERT INTO narrow_docs VALUES (2, 'A document added after vectorization was enabled.');
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'narrow_docs_content_chunks';
+SELECT pgedge_vectorizer.reprocess_chunks('narrow_docs_content_chunks');
+
+-- Replacing a document's chunks drops their embeddings
+UPDATE narrow_docs SET content = 'The first document, rewritten.' WHERE id = 1;
+SELECT count(*) FROM narrow_docs_content_chunks_embeddings;
+
+-- Re-enabling leaves chunks that already have embeddings alone
+INSERT INTO narrow_docs_content_chunks_embeddings (chunk_id, embedding)
+SELECT id, '[0,1,0]' FROM narrow_docs_content_chunks;
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'narrow_docs_content_chunks';
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'narrow_docs'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    3,
+    embedding_storage := 'table'
+);
+
+SELECT count(*) FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'narrow_docs_content_chunks';
+
+-- The chunk table cannot switch to inline embeddings
+SELECT pgedge_vectorizer.enable_vectorization(
+    'narrow_docs'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    3
+);
+
+-- Clean up
+SELECT pgedge_vectorizer.disable_vectorization('narrow_docs'::regclass, 'content', true);
+SELECT to_regclass('narrow_docs_content_chunks_embeddings');
+DROP TABLE narrow_docs;
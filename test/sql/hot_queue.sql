@@ -0,0 +1,37 @@
+-- Hot queue test
+-- This test verifies the trigger's fallback to the queue table when the
+-- in-memory hot queue is disabled (pgedge_vectorizer.hot_queue_size = 0)
+
+SHOW pgedge_vectorizer.hot_queue_size;
+
+SELECT * FROM pgedge_vectorizer.hot_queue_status();
+
+CREATE TABLE hot_docs (
+    id BIGINT PRIMARY KEY,
+    content TEXT
+);
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'hot_docs'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    3
+);
+
+-- The hot queue takes nothing, so new chunks are queued in the table
+SELECT pgedge_vectorizer.hot_enqueue('hot_docs_content_chunks', 1);
+
+INSERT INTO hot_docs VALUES (1, 'A document written by an interactive client.');
+
+SELECT count(*) FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'hot_docs_content_chunks' AND status = 'pending';
+
+SELECT * FROM pgedge_vectorizer.hot_queue_status();
+
+SELECT count(*) FROM pgedge_vectorizer.hot_queue_entries();
+
+-- Clean up
+SELECT pgedge_vectorizer.disable_vectorization('hot_docs'::regclass, 'content', true);
+DROP TABLE hot_docs;
@@ -334,6 +334,67 @@ SELECT pgedge_vectorizer.disable_vectorization(
 
 DROP TABLE hybrid_multi_test;
 
+---------------------------------------------------------------------------
+-- Test 22: hybrid_search ranks chunks from both lists with RRF
+---------------------------------------------------------------------------
+
+CREATE TABLE hybrid_rank_docs (
+    id      BIGSERIAL PRIMARY KEY,
+    content TEXT
+);
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'hybrid_rank_docs'::regclass, 'content', 'token_based', 100, 10, 3
+);
+
+INSERT INTO hybrid_rank_docs (content) VALUES
+    ('postgres stores rows in heap pages'),
+    ('sourdough bread needs a slow rise'),
+    ('postgres replication ships wal records');
+
+-- Store the vectors a worker would, without a provider: the dense list
+-- ranks 1, 2, 3 against the query below, the sparse list 3, 1, 2
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'hybrid_rank_docs_content_chunks';
+
+UPDATE hybrid_rank_docs_content_chunks
+SET embedding = CASE source_id
+                    WHEN 1 THEN '[1,0,0]'
+                    WHEN 2 THEN '[0.6,0.8,0]'
+                    ELSE '[0,1,0]'
+                END::vector,
+    sparse_embedding = pgedge_vectorizer.bm25_query_vector(
+                           content, 'hybrid_rank_docs_content_chunks');
+
+SET pgedge_vectorizer.enable_hybrid = true;
+
+BEGIN;
+
+-- Stand in for the provider for the query embedding
+CREATE OR REPLACE FUNCTION pgedge_vectorizer.generate_embedding(query_text TEXT)
+RETURNS vector AS $$ SELECT '[1,0,0]'::vector $$ LANGUAGE sql;
+
+SELECT source_id, dense_rank, sparse_rank, round(rrf_score::numeric, 6) AS rrf_score
+FROM pgedge_vectorizer.hybrid_search(
+    'hybrid_rank_docs'::regclass, 'postgres replication', 3
+);
+
+-- Weighting the sparse list moves its best chunk to the top, and the
+-- limit cuts the fused list
+SELECT source_id, dense_rank, sparse_rank, round(rrf_score::numeric, 6) AS rrf_score
+FROM pgedge_vectorizer.hybrid_search(
+    'hybrid_rank_docs'::regclass, 'postgres replication', 2, 0.2
+);
+
+ROLLBACK;
+
+RESET pgedge_vectorizer.enable_hybrid;
+
+SELECT pgedge_vectorizer.disable_vectorization(
+    'hybrid_rank_docs'::regclass, 'content', true
+);
+
+DROP TABLE hybrid_rank_docs;
+
 ---------------------------------------------------------------------------
 -- Cleanup
 ---------------------------------------------------------------------------
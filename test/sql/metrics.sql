@@ -0,0 +1,7 @@
+-- Metrics test
+-- Counters in the OpenMetrics text format
+
+-- Metrics in the OpenMetrics text format end with the EOF marker
+SELECT pgedge_vectorizer.metrics() LIKE E'%# EOF\n' AS complete,
+       position('# TYPE pgedge_vectorizer_provider_latency_seconds histogram'
+                IN pgedge_vectorizer.metrics()) > 0 AS has_latency;
@@ -0,0 +1,143 @@
+-- Model migration test
+-- This test verifies re-embedding a chunk table with another model next to
+-- its current embeddings, and the switch-over
+
+CREATE TABLE migrate_docs (
+    id BIGINT PRIMARY KEY,
+    content TEXT
+);
+
+INSERT INTO migrate_docs VALUES
+    (1, 'The first document, embedded before the migration.'),
+    (2, 'The second document, embedded before the migration.');
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'migrate_docs'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    3
+);
+
+-- Stand in for the worker with the current model
+UPDATE migrate_docs_content_chunks SET embedding = '[1,0,0]';
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'migrate_docs_content_chunks';
+
+SELECT pgedge_vectorizer.start_model_migration('no_such_chunks', 'new-model', 4);
+
+SELECT pgedge_vectorizer.start_model_migration('migrate_docs_content_chunks', 'new-model', 4);
+
+-- The shadow column sits next to the embeddings searches use
+SELECT attname, format_type(atttypid, atttypmod)
+FROM pg_attribute
+WHERE attrelid = 'migrate_docs_content_chunks'::regclass
+  AND attname LIKE 'embedding%'
+ORDER BY attnum;
+
+SELECT chunk_table, model, dimension, status, last_chunk_id
+FROM pgedge_vectorizer.model_migrations;
+
+SELECT pgedge_vectorizer.start_model_migration('migrate_docs_content_chunks', 'other-model', 4);
+
+-- New chunks are still queued for the current model, and migrated as well
+INSERT INTO migrate_docs VALUES (3, 'A document added during the migration.');
+
+SELECT count(*) FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'migrate_docs_content_chunks' AND status = 'pending';
+
+SELECT chunk_id
+FROM pgedge_vectorizer.model_migration_chunks('migrate_docs_content_chunks', 1);
+
+-- No switch-over while chunks are missing new embeddings
+SELECT pgedge_vectorizer.finish_model_migration('migrate_docs_content_chunks');
+
+-- Stand in for the worker with the new model, through to the index build
+UPDATE migrate_docs_content_chunks SET embedding_next = '[0,1,0,0]';
+UPDATE pgedge_vectorizer.model_migrations SET status = 'ready', ready_at = NOW();
+
+-- Chunks written once the migration is ready are embedded by the switch-over
+BEGIN;
+
+-- Stand in for the provider with the new model
+CREATE OR REPLACE FUNCTION pgedge_vectorizer.generate_embedding(query_text TEXT)
+RETURNS vector AS $$ SELECT '[0,0,1,0]'::vector $$ LANGUAGE sql;
+
+INSERT INTO migrate_docs VALUES (4, 'A document added once the migration is ready.');
+
+SELECT chunk_id
+FROM pgedge_vectorizer.model_migration_chunks('migrate_docs_content_chunks');
+
+SELECT pgedge_vectorizer.finish_model_migration('migrate_docs_content_chunks');
+
+SELECT id, embedding FROM migrate_docs_content_chunks ORDER BY id;
+
+ROLLBACK;
+
+SELECT pgedge_vectorizer.finish_model_migration('migrate_docs_content_chunks');
+
+-- The new embeddings and their index have taken the place of the old ones
+SELECT attname, format_type(atttypid, atttypmod)
+FROM pg_attribute
+WHERE attrelid = 'migrate_docs_content_chunks'::regclass
+  AND attname LIKE 'embedding%'
+  AND NOT attisdropped
+ORDER BY attnum;
+
+SELECT indexname FROM pg_indexes
+WHERE tablename = 'migrate_docs_content_chunks'
+  AND indexname LIKE '%embedding%';
+
+SELECT count(*) FROM migrate_docs_content_chunks WHERE embedding = '[0,1,0,0]';
+
+-- The vectorizer now embeds with the new model
+SELECT model FROM pgedge_vectorizer.vectorizers
+WHERE chunk_table = 'migrate_docs_content_chunks';
+
+SELECT count(*) FROM pgedge_vectorizer.model_migrations;
+
+-- A cancelled migration drops its shadow column
+SELECT pgedge_vectorizer.start_model_migration('migrate_docs_content_chunks', 'next-model', 2);
+SELECT pgedge_vectorizer.cancel_model_migration('migrate_docs_content_chunks');
+
+SELECT count(*) FROM pg_attribute
+WHERE attrelid = 'migrate_docs_content_chunks'::regclass
+  AND attname = 'embedding_next';
+
+SELECT pgedge_vectorizer.cancel_model_migration('migrate_docs_content_chunks');
+
+-- With a separate embeddings table the migration writes there, and the
+-- joined view is rebuilt on the new column
+CREATE TABLE migrate_narrow (
+    id BIGINT PRIMARY KEY,
+    content TEXT
+);
+
+INSERT INTO migrate_narrow VALUES
+    (1, 'A document with its embeddings in a narrow table.');
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'migrate_narrow'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    3,
+    embedding_storage := 'table'
+);
+
+SELECT pgedge_vectorizer.start_model_migration('migrate_narrow_content_chunks', 'new-model', 2);
+
+-- Chunks not embedded by the current model get their row from the migration
+INSERT INTO migrate_narrow_content_chunks_embeddings (chunk_id, embedding_next)
+SELECT id, '[1,1]' FROM migrate_narrow_content_chunks;
+
+SELECT pgedge_vectorizer.finish_model_migration('migrate_narrow_content_chunks');
+
+SELECT source_id, embedding FROM migrate_narrow_content_chunks_view;
+
+-- Clean up
+SELECT pgedge_vectorizer.disable_vectorization('migrate_docs'::regclass, 'content', true);
+SELECT pgedge_vectorizer.disable_vectorization('migrate_narrow'::regclass, 'content', true);
+DROP TABLE migrate_docs;
+DROP TABLE migrate_narrow;
@@ -23,9 +23,9 @@ SELECT pgedge_vectorizer.enable_vectorization(
 SELECT tablename FROM pg_tables
 WHERE tablename = 'multi_test_title_chunks';
 
--- Verify first trigger was created
+-- Verify the table's trigger was created
 SELECT tgname FROM pg_trigger
-WHERE tgname = 'multi_test_title_vectorization_trigger';
+WHERE tgname = 'multi_test_vectorization_trigger';
 
 -- Enable vectorization on second column
 SELECT pgedge_vectorizer.enable_vectorization(
@@ -41,14 +41,13 @@ SELECT pgedge_vectorizer.enable_vectorization(
 SELECT tablename FROM pg_tables
 WHERE tablename = 'multi_test_description_chunks';
 
--- Verify second trigger was created
-SELECT tgname FROM pg_trigger
-WHERE tgname = 'multi_test_description_vectorization_trigger';
-
--- Verify both triggers exist
+-- Verify one trigger handles both columns, eight arguments each
 SELECT COUNT(*) AS trigger_count FROM pg_trigger
 WHERE tgname LIKE 'multi_test%vectorization%';
 
+SELECT tgnargs FROM pg_trigger
+WHERE tgname = 'multi_test_vectorization_trigger';
+
 -- Insert test data
 INSERT INTO multi_test (title, description, body)
 VALUES ('Test Title', 'Test Description', 'Test Body');
@@ -57,13 +56,27 @@ VALUES ('Test Title', 'Test Description', 'Test Body');
 SELECT COUNT(*) > 0 AS title_chunks_exist FROM multi_test_title_chunks;
 SELECT COUNT(*) > 0 AS description_chunks_exist FROM multi_test_description_chunks;
 
+-- Updating one column leaves the other column's chunks and queue items alone
+UPDATE multi_test SET description = 'New Description', body = 'New Body' WHERE id = 1;
+
+SELECT chunk_table, COUNT(*) AS queued
+FROM pgedge_vectorizer.queue
+WHERE chunk_table LIKE 'multi_test%'
+GROUP BY chunk_table
+ORDER BY chunk_table COLLATE "C";
+
+SELECT content FROM multi_test_description_chunks;
+
 -- Disable one column
 SELECT pgedge_vectorizer.disable_vectorization('multi_test'::regclass, 'title', true);
 
--- Verify only one trigger remains
+-- Verify the trigger remains for the other column
 SELECT COUNT(*) AS remaining_triggers FROM pg_trigger
 WHERE tgname LIKE 'multi_test%vectorization%';
 
+SELECT tgnargs FROM pg_trigger
+WHERE tgname = 'multi_test_vectorization_trigger';
+
 -- Clean up
 SELECT pgedge_vectorizer.disable_vectorization('multi_test'::regclass, 'description', true);
 DROP TABLE multi_test;
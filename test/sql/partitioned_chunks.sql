@@ -0,0 +1,86 @@
+-- Hash-partitioned chunk table test
+-- This test verifies chunk tables split into hash partitions by source_id
+
+CREATE TABLE part_docs (
+    id BIGINT PRIMARY KEY,
+    content TEXT
+);
+
+INSERT INTO part_docs
+SELECT g, 'Document number ' || g || ' loaded before vectorization was enabled.'
+FROM generate_series(1, 20) g;
+
+-- Invalid partition counts are rejected
+SELECT pgedge_vectorizer.enable_vectorization(
+    'part_docs'::regclass,
+    'content',
+    embedding_dimension := 3,
+    partitions := 1
+);
+
+-- A separate embeddings table cannot reference a partitioned chunk table
+SELECT pgedge_vectorizer.enable_vectorization(
+    'part_docs'::regclass,
+    'content',
+    embedding_dimension := 3,
+    embedding_storage := 'table',
+    partitions := 4
+);
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'part_docs'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    3,
+    partitions := 4
+);
+
+-- The chunk table is partitioned by hash of source_id
+SELECT relkind FROM pg_class WHERE oid = 'part_docs_content_chunks'::regclass;
+
+SELECT i.inhrelid::regclass AS partition
+FROM pg_inherits i
+WHERE i.inhparent = 'part_docs_content_chunks'::regclass
+ORDER BY i.inhrelid::regclass::text COLLATE "C";
+
+-- Every partition gets its own indexes, HNSW graphs included
+SELECT tablename, count(*)
+FROM pg_indexes
+WHERE tablename LIKE 'part\_docs\_content\_chunks\_p_'
+GROUP BY tablename
+ORDER BY tablename COLLATE "C";
+
+-- Existing rows are chunked and spread across the partitions
+SELECT count(*) FROM part_docs_content_chunks;
+
+SELECT count(DISTINCT tableoid) > 1 AS spread
+FROM part_docs_content_chunks;
+
+SELECT count(*) FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'part_docs_content_chunks' AND status = 'pending';
+
+-- Updates replace chunks within the document's partition
+UPDATE part_docs SET content = 'Document one, rewritten.' WHERE id = 1;
+SELECT content FROM part_docs_content_chunks WHERE source_id = 1;
+
+-- Stand in for the worker: write embeddings into each partition
+UPDATE part_docs_content_chunks SET embedding = '[1,0,0]';
+
+SELECT count(*) FROM part_docs_content_chunks WHERE embedding IS NOT NULL;
+
+-- The partitioning cannot be changed on an existing chunk table
+SELECT pgedge_vectorizer.enable_vectorization(
+    'part_docs'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    3
+);
+
+-- Clean up
+SELECT pgedge_vectorizer.disable_vectorization('part_docs'::regclass, 'content', true);
+SELECT to_regclass('part_docs_content_chunks_p0');
+DROP TABLE part_docs;
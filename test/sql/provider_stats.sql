@@ -0,0 +1,7 @@
+-- Provider statistics test
+-- Request counters and latency histograms of the embedding providers
+
+-- Provider statistics start empty after a reset
+SELECT pgedge_vectorizer.reset_provider_stats();
+SELECT count(*) FROM pgedge_vectorizer.provider_stats();
+SELECT count(*) FROM pgedge_vectorizer.provider_latency_histogram();
@@ -18,3 +18,112 @@ FROM pgedge_vectorizer.failed_items;
 SELECT pgedge_vectorizer.retry_failed() >= 0 AS retry_works;
 
 SELECT pgedge_vectorizer.clear_completed() >= 0 AS clear_works;
+
+-- Queue items are spread over claim buckets by chunk id
+INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content)
+VALUES (1, 'bucket_test', 'a'), (64, 'bucket_test', 'b'), (130, 'bucket_test', 'c');
+
+SELECT chunk_id, bucket FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'bucket_test'
+ORDER BY chunk_id;
+
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'bucket_test';
+
+-- Workers claim from their own buckets in the order of idx_queue_bucket:
+-- retries first, then oldest first
+INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content, attempts, created_at)
+VALUES (1, 'bucket_claims', 'a', 0, '2026-01-01 00:00:00+00'),
+       (2, 'bucket_claims', 'b', 0, '2026-01-01 00:01:00+00'),
+       (65, 'bucket_claims', 'c', 2, '2026-01-01 00:02:00+00'),
+       (66, 'bucket_claims', 'd', 0, '2026-01-01 00:03:00+00'),
+       (129, 'bucket_claims', 'e', 1, '2026-01-01 00:04:00+00');
+
+SELECT indexdef FROM pg_indexes WHERE indexname = 'idx_queue_bucket';
+
+-- A worker owning the odd buckets
+SELECT chunk_id, bucket, attempts
+FROM pgedge_vectorizer.queue
+WHERE status = 'pending' AND chunk_table = 'bucket_claims'
+  AND bucket = ANY ('{1,3}'::smallint[])
+  AND (next_retry_at IS NULL OR next_retry_at <= NOW())
+ORDER BY attempts DESC, created_at
+LIMIT 2
+FOR UPDATE SKIP LOCKED;
+
+-- A worker owning the even buckets
+SELECT chunk_id, bucket, attempts
+FROM pgedge_vectorizer.queue
+WHERE status = 'pending' AND chunk_table = 'bucket_claims'
+  AND bucket = ANY ('{0,2}'::smallint[])
+  AND (next_retry_at IS NULL OR next_retry_at <= NOW())
+ORDER BY attempts DESC, created_at
+LIMIT 2
+FOR UPDATE SKIP LOCKED;
+
+-- An idle worker falls back to all buckets
+SELECT chunk_id, bucket, attempts
+FROM pgedge_vectorizer.queue
+WHERE status = 'pending' AND chunk_table = 'bucket_claims'
+  AND (next_retry_at IS NULL OR next_retry_at <= NOW())
+ORDER BY attempts DESC, created_at
+LIMIT 3
+FOR UPDATE SKIP LOCKED;
+
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'bucket_claims';
+
+-- Monitoring views read the queue counters through queue_stats()
+SELECT pgedge_vectorizer.refresh_queue_stats();
+
+INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content, created_at)
+VALUES (1, 'stats_test', 'a', '2026-01-01 00:00:00+00'),
+       (2, 'stats_test', 'b', '2026-01-01 00:01:00+00'),
+       (3, 'stats_test', 'c', '2026-01-01 00:02:00+00');
+
+SELECT * FROM pgedge_vectorizer.pending_count;
+
+UPDATE pgedge_vectorizer.queue
+SET status = 'completed', processed_at = created_at + INTERVAL '10 seconds'
+WHERE chunk_table = 'stats_test' AND chunk_id = 1;
+
+UPDATE pgedge_vectorizer.queue SET status = 'failed'
+WHERE chunk_table = 'stats_test' AND chunk_id = 3;
+
+SELECT status, count,
+       to_char(oldest AT TIME ZONE 'UTC', 'HH24:MI') AS oldest,
+       CASE WHEN status = 'completed' THEN avg_processing_time_secs END AS avg_secs
+FROM pgedge_vectorizer.queue_status
+WHERE chunk_table = 'stats_test';
+
+-- Rolled back items are not counted
+BEGIN;
+INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content, created_at)
+VALUES (4, 'stats_test', 'd', '2026-01-01 00:03:00+00');
+SAVEPOINT s;
+INSERT INTO pgedge_vectorizer.queue (chunk_id, chunk_table, content, created_at)
+VALUES (5, 'stats_test', 'e', '2026-01-01 00:00:30+00');
+ROLLBACK TO SAVEPOINT s;
+COMMIT;
+
+BEGIN;
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'stats_test';
+ROLLBACK;
+
+-- The oldest pending item is looked up again once it is claimed
+UPDATE pgedge_vectorizer.queue SET status = 'processing'
+WHERE chunk_table = 'stats_test' AND chunk_id = 2;
+
+SELECT status, count,
+       to_char(oldest AT TIME ZONE 'UTC', 'HH24:MI') AS oldest
+FROM pgedge_vectorizer.queue_status
+WHERE chunk_table = 'stats_test';
+
+-- Pending chunks count towards the current freshness lag
+SELECT chunk_table, embedded, pending_lag_secs > 0 AS lagging
+FROM pgedge_vectorizer.freshness_stats()
+WHERE chunk_table = 'stats_test';
+
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'stats_test';
+
+SELECT count(*) FROM pgedge_vectorizer.queue_status WHERE chunk_table = 'stats_test';
+
+SELECT * FROM pgedge_vectorizer.pending_count;
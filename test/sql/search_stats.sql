@@ -0,0 +1,66 @@
+-- Search statistics test
+-- Phase timings of hybrid_search()
+
+-- Search statistics: one row of counters; a profile needs every phase
+SELECT pgedge_vectorizer.reset_search_stats();
+SELECT count(*) FROM pgedge_vectorizer.search_stats();
+SELECT pgedge_vectorizer.record_search_profile('docs_chunks', ARRAY[1.0, 2.0]::FLOAT8[], 0, 0, 0);
+
+-- A hybrid search adds to the searches and to the time of every phase
+CREATE TABLE search_stats_docs (
+    id      BIGSERIAL PRIMARY KEY,
+    content TEXT
+);
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'search_stats_docs'::regclass, 'content', 'token_based', 100, 10, 3
+);
+
+INSERT INTO search_stats_docs (content) VALUES
+    ('postgres stores rows in heap pages'),
+    ('postgres replication ships wal records');
+
+-- Store the vectors a worker would, without a provider
+DELETE FROM pgedge_vectorizer.queue WHERE chunk_table = 'search_stats_docs_content_chunks';
+
+UPDATE search_stats_docs_content_chunks
+SET embedding = '[1,0,0]',
+    sparse_embedding = pgedge_vectorizer.bm25_query_vector(
+                           content, 'search_stats_docs_content_chunks');
+
+SET pgedge_vectorizer.enable_hybrid = true;
+
+CREATE TEMP TABLE search_stats_before AS
+SELECT * FROM pgedge_vectorizer.search_stats();
+
+BEGIN;
+
+-- Stand in for the provider for the query embedding
+CREATE OR REPLACE FUNCTION pgedge_vectorizer.generate_embedding(query_text TEXT)
+RETURNS vector AS $$ SELECT '[1,0,0]'::vector $$ LANGUAGE sql;
+
+SELECT count(*) AS results
+FROM pgedge_vectorizer.hybrid_search(
+    'search_stats_docs'::regclass, 'postgres replication', 2
+);
+
+ROLLBACK;
+
+SELECT s.searches - b.searches AS searches,
+       s.lookup_ms > b.lookup_ms AS lookup,
+       s.embed_ms > b.embed_ms AS embed,
+       s.bm25_query_ms > b.bm25_query_ms AS bm25_query,
+       s.idf_load_ms > b.idf_load_ms AS idf_load,
+       s.dense_scan_ms > b.dense_scan_ms AS dense_scan,
+       s.sparse_scan_ms > b.sparse_scan_ms AS sparse_scan,
+       s.merge_ms > b.merge_ms AS merge,
+       s.total_ms > b.total_ms AS total
+FROM pgedge_vectorizer.search_stats() s, search_stats_before b;
+
+RESET pgedge_vectorizer.enable_hybrid;
+
+SELECT pgedge_vectorizer.disable_vectorization(
+    'search_stats_docs'::regclass, 'content', true
+);
+
+DROP TABLE search_stats_docs;
@@ -0,0 +1,12 @@
+-- Throughput history test
+-- Snapshots of the throughput, queue depth and provider latency
+
+-- Throughput history: rates need a previous snapshot
+SELECT pgedge_vectorizer.histogram_percentile(ARRAY[10, 20, 'Infinity']::FLOAT8[], ARRAY[0, 4, 0]::BIGINT[], 0.5) AS p50,
+       pgedge_vectorizer.counter_rate(100, 40, 10) AS rate,
+       pgedge_vectorizer.counter_rate(5, 40, 10) AS rate_after_reset;
+DELETE FROM pgedge_vectorizer.throughput_history;
+SELECT pgedge_vectorizer.capture_throughput();
+SELECT pgedge_vectorizer.capture_throughput();
+SELECT count(*) AS snapshots, count(interval_secs) AS with_rates
+FROM pgedge_vectorizer.throughput_history;
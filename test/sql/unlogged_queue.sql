@@ -0,0 +1,60 @@
+-- Unlogged queue test
+-- This test verifies the unlogged queue mode and rebuilding the queue
+
+SELECT pgedge_vectorizer.set_queue_unlogged();
+
+SELECT relpersistence FROM pg_class
+WHERE oid = 'pgedge_vectorizer.queue'::regclass;
+
+CREATE TABLE unlogged_docs (
+    id BIGINT PRIMARY KEY,
+    content TEXT
+);
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'unlogged_docs'::regclass,
+    'content',
+    'token_based',
+    100,
+    10,
+    3
+);
+
+INSERT INTO unlogged_docs VALUES
+    (1, 'The first document.'),
+    (2, 'The second document.'),
+    (3, 'The third document.');
+
+-- One chunk already has its embedding
+UPDATE unlogged_docs_content_chunks SET embedding = '[1,0,0]'
+WHERE source_id = 1;
+
+-- Stand in for crash recovery, which empties unlogged tables
+TRUNCATE pgedge_vectorizer.queue;
+
+-- Chunk tables left by earlier tests are requeued too
+SET client_min_messages = warning;
+SELECT pgedge_vectorizer.recover_queue() >= 2 AS requeued;
+
+SELECT c.source_id
+FROM pgedge_vectorizer.queue q
+JOIN unlogged_docs_content_chunks c ON c.id = q.chunk_id
+WHERE q.chunk_table = 'unlogged_docs_content_chunks'
+ORDER BY c.source_id;
+
+-- A second pass finds everything already queued
+SELECT pgedge_vectorizer.recover_queue();
+RESET client_min_messages;
+
+-- Back to a logged queue
+SELECT pgedge_vectorizer.set_queue_unlogged(false);
+
+SELECT relpersistence FROM pg_class
+WHERE oid = 'pgedge_vectorizer.queue'::regclass;
+
+SELECT count(*) FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'unlogged_docs_content_chunks';
+
+-- Clean up
+SELECT pgedge_vectorizer.disable_vectorization('unlogged_docs'::regclass, 'content', true);
+DROP TABLE unlogged_docs;
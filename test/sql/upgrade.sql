@@ -0,0 +1,78 @@
+-- Upgrade test
+-- Vectorizers created with 1.0 keep working after ALTER EXTENSION UPDATE,
+-- and further columns of their tables can be enabled
+
+SET client_min_messages = warning;
+DROP EXTENSION pgedge_vectorizer CASCADE;
+CREATE EXTENSION pgedge_vectorizer VERSION '1.0';
+RESET client_min_messages;
+
+CREATE TABLE upgrade_docs (
+    id BIGSERIAL PRIMARY KEY,
+    title TEXT,
+    body TEXT
+);
+
+SELECT pgedge_vectorizer.enable_vectorization(
+    'upgrade_docs'::regclass,
+    'body',
+    'token_based',
+    100,
+    10,
+    3
+);
+
+INSERT INTO upgrade_docs (title, body)
+VALUES ('First', 'A document vectorized before the upgrade.');
+
+SET client_min_messages = warning;
+ALTER EXTENSION pgedge_vectorizer UPDATE TO '1.1';
+RESET client_min_messages;
+
+-- The 1.0 trigger is registered with its chunking settings
+SELECT source_column, chunk_table, chunk_strategy, chunk_size, chunk_overlap, source_pk
+FROM pgedge_vectorizer.vectorizers
+WHERE source_table = 'upgrade_docs';
+
+-- and replaced by the table's combined trigger
+SELECT tgname
+FROM pg_trigger
+WHERE tgrelid = 'upgrade_docs'::regclass AND NOT tgisinternal
+ORDER BY tgname;
+
+-- Enable a second column of the same table
+SELECT pgedge_vectorizer.enable_vectorization(
+    'upgrade_docs'::regclass,
+    'title',
+    'token_based',
+    100,
+    10,
+    3
+);
+
+SELECT tgname
+FROM pg_trigger
+WHERE tgrelid = 'upgrade_docs'::regclass AND NOT tgisinternal
+ORDER BY tgname;
+
+DELETE FROM pgedge_vectorizer.queue;
+
+INSERT INTO upgrade_docs (title, body)
+VALUES ('Second', 'A document written after the upgrade.');
+
+UPDATE upgrade_docs
+SET body = 'The first document, edited after the upgrade.'
+WHERE id = 1;
+
+-- Both columns are chunked, and each chunk is queued once
+SELECT chunk_table, count(*) > 0 AS queued, count(*) = count(DISTINCT chunk_id) AS queued_once
+FROM pgedge_vectorizer.queue
+GROUP BY chunk_table
+ORDER BY chunk_table;
+
+-- Clean up
+SET client_min_messages = warning;
+SELECT pgedge_vectorizer.disable_vectorization('upgrade_docs'::regclass, NULL, true);
+RESET client_min_messages;
+DROP TABLE upgrade_docs;
+DELETE FROM pgedge_vectorizer.queue;
@@ -0,0 +1,34 @@
+-- Usage statistics test
+-- Provider tokens and requests charged to chunk tables
+
+DELETE FROM pgedge_vectorizer.usage_stats
+WHERE chunk_table IN ('usage_a_chunks', 'usage_b_chunks');
+
+-- A call embedding texts of two chunk tables splits its tokens and
+-- requests by text length: usage_a_chunks sent 30 of the 40 bytes
+SELECT pgedge_vectorizer.record_usage(
+    ARRAY['usage_a_chunks', 'usage_b_chunks', 'usage_a_chunks'],
+    ARRAY[repeat('a', 20), repeat('b', 10), repeat('c', 10)],
+    100, 2
+);
+
+SELECT chunk_table, items, tokens, requests, cache_hits, retries
+FROM pgedge_vectorizer.usage_stats
+WHERE chunk_table IN ('usage_a_chunks', 'usage_b_chunks')
+ORDER BY chunk_table;
+
+-- The next batch adds to the counts of its table
+SELECT pgedge_vectorizer.record_usage(
+    ARRAY['usage_b_chunks'], ARRAY['one more text'], 7
+);
+
+SELECT chunk_table, items, tokens, requests, updated_at >= created_at AS updated
+FROM pgedge_vectorizer.usage_stats
+WHERE chunk_table IN ('usage_a_chunks', 'usage_b_chunks')
+ORDER BY chunk_table;
+
+-- Each text needs its chunk table
+SELECT pgedge_vectorizer.record_usage(ARRAY['usage_a_chunks'], ARRAY['a', 'b'], 1);
+
+DELETE FROM pgedge_vectorizer.usage_stats
+WHERE chunk_table IN ('usage_a_chunks', 'usage_b_chunks');
@@ -71,6 +71,18 @@ WHERE tgname LIKE '%test_docs%vectorization%';
 -- Verify chunks still exist (upserted, not duplicated)
 SELECT COUNT(*) AS chunk_count FROM test_docs_content_chunks;
 
+-- A traced document records its chunking and queuing
+SET pgedge_vectorizer.trace_sample_rate = 1;
+INSERT INTO test_docs (title, content) VALUES ('Traced', 'A short traced document.');
+RESET pgedge_vectorizer.trace_sample_rate;
+
+SELECT stage, chunk_id IS NOT NULL AS has_chunk, size, detail
+FROM pgedge_vectorizer.trace_document('test_docs', (SELECT max(id) FROM test_docs));
+
+SELECT metadata FROM pgedge_vectorizer.queue
+WHERE chunk_table = 'test_docs_content_chunks' AND status = 'pending'
+ORDER BY id DESC LIMIT 1;
+
 -- Clean up
 SELECT pgedge_vectorizer.disable_vectorization('test_docs'::regclass, 'content', true);
 DROP TABLE test_docs;